@@ -20,6 +20,7 @@ LICENSE AND COPYRIGHT
 
 #include "libbreseq/fastq.h"
 #include "libbreseq/reference_sequence.h"
+#include "libbreseq/trace.h"
 
 using namespace std;
 
@@ -642,6 +643,7 @@ void tam_file::open_write(const string& tam_file_name, const string& fasta_file_
 bool tam_file::read_alignments(alignment_list& alignments, bool paired)
 {
   (void)paired;
+  TRACE_TIMER("read_alignments_ns");
   alignments.clear();
 
 	string last_read_name = "";
@@ -675,6 +677,7 @@ bool tam_file::read_alignments(alignment_list& alignments, bool paired)
     }
     alignments.push_back(this_alignment);
   }
+  TRACE_COUNT("alignments_read", alignments.size());
   return (!alignments.empty());
 }
  
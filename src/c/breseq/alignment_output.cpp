@@ -347,6 +347,18 @@ void alignment_output::create_alignment ( const string& region, cOutputEvidenceI
   // we need the target_id to properly fill out the reference sequence later
   uint32_t target_id, start_pos, end_pos, insert_start, insert_end;
   m_alignment_output_pileup.parse_region(region, target_id, start_pos, end_pos, insert_start, insert_end);
+  
+  // Clear everything from any previous alignment, so that one object (and its open BAM) can be reused
+  m_alignment_output_pileup.aligned_reads.clear();
+  m_alignment_output_pileup.aligned_references.clear();
+  m_alignment_output_pileup.aligned_annotation = Aligned_Annotation();
+  m_alignment_output_pileup.unique_start = 0;
+  m_alignment_output_pileup.unique_end = 0;
+  m_aligned_reads.clear();
+  m_aligned_references.clear();
+  m_aligned_annotation = Aligned_Annotation();
+  m_quality_range = Quality_Range();
+  m_error_message.clear();
     
   // Check for special reference lines that are junctions...
   bool bDrawAnnotationLine = true;    // draw the | annotation line pointing to region?
@@ -368,7 +380,8 @@ void alignment_output::create_alignment ( const string& region, cOutputEvidenceI
   
   // For junctions JC evidence to set up split reference
   if (m_is_junction_junction) {
-    cDiffEntry& jc_item = *(output_evidence_item_ptr->item);
+    // Copy, because evidence pages for the same junction may be drawn at the same time
+    cDiffEntry jc_item = *(output_evidence_item_ptr->item);
     
     int32_t overlap = from_string<int32_t>(jc_item["overlap"]);
     int32_t alignment_overlap = from_string<int32_t>(jc_item["alignment_overlap"]);
@@ -517,7 +530,7 @@ void alignment_output::create_alignment ( const string& region, cOutputEvidenceI
     
     else if (   ((*output_evidence_item_ptr)[PREFIX] == "JC_SIDE_1")
              || ((*output_evidence_item_ptr)[PREFIX] == "JC_SIDE_2") ) {   
-      cDiffEntry& jc_item = *(output_evidence_item_ptr->item);
+      cDiffEntry jc_item = *(output_evidence_item_ptr->item);
 
       // This stuff is all copied from the code for counting reads...
       int32_t start, end, non_dup_start, non_dup_end;
@@ -827,7 +840,7 @@ void alignment_output::create_alignment ( const string& region, cOutputEvidenceI
 string alignment_output::html_alignment( const string& region, output::cOutputEvidenceItem* output_evidence_item_ptr )
 {
 
-  // this sets object values (not re-usable currently)
+  // this sets object values (cleared by the next call)
   create_alignment(region, output_evidence_item_ptr);
   
   string output;
@@ -893,7 +906,7 @@ string alignment_output::html_alignment( const string& region, output::cOutputEv
 string alignment_output::text_alignment( const string& region, cOutputEvidenceItem* output_evidence_item_ptr )
 {
   
-  // this sets object values (not re-usable currently)
+  // this sets object values (cleared by the next call)
   create_alignment(region, output_evidence_item_ptr);
   
   string output = "";
@@ -945,7 +958,7 @@ string alignment_output::text_alignment( const string& region, cOutputEvidenceIt
 string alignment_output::json_alignment( const string& region, cOutputEvidenceItem* output_evidence_item_ptr )
 {
   
-  // this sets object values (not re-usable currently)
+  // this sets object values (cleared by the next call)
   create_alignment(region, output_evidence_item_ptr);
   
   json j;
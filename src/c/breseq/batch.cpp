@@ -0,0 +1,184 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#include "libbreseq/batch.h"
+
+#include "libbreseq/calculate_trims.h"
+#include "libbreseq/index_cache.h"
+#include "libbreseq/reference_sequence.h"
+#include "libbreseq/samtools_commands.h"
+
+using namespace std;
+
+namespace breseq {
+
+string cPreparedReference::reference_list(const vector<string>& reference_file_names)
+{
+  string reference_list;
+  for (vector<string>::const_iterator it = reference_file_names.begin(); it != reference_file_names.end(); ++it) {
+    reference_list += *it + "\t" + file_md5(*it) + "\n";
+  }
+  return reference_list;
+}
+
+string cPreparedReference::saved_reference_list() const
+{
+  ifstream in(reference_list_file_name().c_str());
+  stringstream saved;
+  saved << in.rdbuf();
+  return saved.str();
+}
+
+bool cPreparedReference::prepare(const vector<string>& reference_file_names) const
+{
+  string reference_list = cPreparedReference::reference_list(reference_file_names);
+
+  // Reuse the files of an earlier batch with the same reference files and contents
+  if (file_exists(done_file_name().c_str())) {
+    if (saved_reference_list() == reference_list) {
+      cerr << "  Using prepared reference: " << m_path << endl;
+      return false;
+    }
+    remove_file(done_file_name().c_str());
+  }
+
+  create_path(m_path);
+
+  cerr << "  Preparing reference: " << m_path << endl;
+  cReferenceSequences ref_seq_info;
+  ref_seq_info.LoadFiles(reference_file_names);
+  ref_seq_info.WriteFASTA(fasta_file_name());
+  ref_seq_info.WriteGFF(gff3_file_name());
+
+  samtools_faidx(fasta_file_name());
+  calculate_trims(fasta_file_name(), m_path);
+
+  ofstream out(reference_list_file_name().c_str());
+  ASSERT(out.good(), "Could not open file for writing: " + reference_list_file_name());
+  out << reference_list;
+  out.close();
+
+  ofstream done(done_file_name().c_str());
+  done.close();
+  return true;
+}
+
+vector<pair<string, uint64_t> > cPreparedReference::read_faidx() const
+{
+  ifstream in(faidx_file_name().c_str());
+  ASSERT(in.good(), "Could not open prepared reference FASTA index: " + faidx_file_name());
+
+  vector<pair<string, uint64_t> > sequences;
+  string line;
+  while (getline(in, line)) {
+    vector<string> columns = split(line, "\t");
+    if (columns.size() < 2) continue;
+    sequences.push_back(make_pair(columns[0], from_string<uint64_t>(columns[1])));
+  }
+  return sequences;
+}
+
+uint64_t cPreparedReference::copy_to(const Settings& settings) const
+{
+  ASSERT(file_exists(done_file_name().c_str()), "Reference was not prepared in: " + m_path);
+
+  // The prepared files must be from the same reference files and contents as this run
+  string saved = saved_reference_list();
+  ASSERT(saved == reference_list(settings.all_reference_file_names),
+         "Reference files of this run do not match those prepared in: " + m_path + "\n" +
+         "Prepared from (file name and MD5):\n" + saved);
+
+  cerr << "  Copying prepared reference: " << m_path << endl;
+  copy_file(fasta_file_name(), settings.reference_fasta_file_name);
+  copy_file(gff3_file_name(), settings.reference_gff3_file_name);
+  copy_file(faidx_file_name(), settings.reference_faidx_file_name);
+
+  uint64_t total_length = 0;
+  vector<pair<string, uint64_t> > sequences = read_faidx();
+  for (vector<pair<string, uint64_t> >::const_iterator it = sequences.begin(); it != sequences.end(); ++it) {
+    copy_file(m_path + "/" + it->first + ".trims", Settings::file_name(settings.reference_trim_file_name, "@", it->first));
+    total_length += it->second;
+  }
+  return total_length;
+}
+
+const string cBatchSample::k_prepared_reference_directory = "reference";
+const string cBatchSample::k_bowtie2_index_cache_directory = "bowtie2_index_cache";
+
+string cBatchSample::name_error(const string& name)
+{
+  if (name.size() == 0)
+    return "Sample name must not be empty.";
+  if (name.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._-") != string::npos)
+    return "Sample name may only contain letters, digits, '.', '_' and '-': " + name;
+  if (name[0] == '.')
+    return "Sample name must not start with '.': " + name;
+  if ((name == k_prepared_reference_directory) || (name == k_bowtie2_index_cache_directory))
+    return "Sample name is used for a directory of the batch output: " + name;
+  return "";
+}
+
+uint64_t cBatchSample::read_files_size() const
+{
+  uint64_t size = 0;
+  for (vector<string>::const_iterator it = read_file_names.begin(); it != read_file_names.end(); ++it) {
+    size += file_size(*it);
+  }
+  return size;
+}
+
+vector<cBatchSample> cBatchSample::read_sample_sheet(const string& file_name)
+{
+  ifstream in(file_name.c_str());
+  ASSERT(in.good(), "Could not open sample sheet: " + file_name);
+
+  vector<cBatchSample> samples;
+  set<string> names;
+  string line;
+  uint32_t line_number = 0;
+  while (getline(in, line)) {
+    line_number++;
+    if (line.size() && (line[line.size() - 1] == '\r')) line.resize(line.size() - 1);
+    if ((line.size() == 0) || (line[0] == '#')) continue;
+
+    string location = "Sample sheet " + file_name + " line " + to_string(line_number) + ": ";
+    vector<string> columns = split(line, "\t");
+    ASSERT((columns.size() == 2) || (columns.size() == 3), location + "Expected 2 or 3 tab-delimited columns (name, read files, options).");
+
+    cBatchSample sample;
+    sample.name = columns[0];
+    string name_error = cBatchSample::name_error(sample.name);
+    ASSERT(name_error.size() == 0, location + name_error);
+    ASSERT(!names.count(sample.name), location + "Sample name is used more than once: " + sample.name);
+    names.insert(sample.name);
+
+    sample.read_file_names = split(columns[1], ",");
+    for (vector<string>::const_iterator it = sample.read_file_names.begin(); it != sample.read_file_names.end(); ++it) {
+      ASSERT(file_exists(it->c_str()), location + "Read file does not exist: " + *it);
+    }
+
+    if (columns.size() == 3) sample.options = columns[2];
+
+    samples.push_back(sample);
+  }
+
+  ASSERT(samples.size(), "No samples in sample sheet: " + file_name);
+  return samples;
+}
+
+} // namespace breseq
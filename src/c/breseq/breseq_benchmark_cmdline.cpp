@@ -0,0 +1,459 @@
+/*****************************************************************************
+
+AUTHORS
+
+  Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+  David B. Knoester
+
+LICENSE AND COPYRIGHT
+
+  Copyright (c) 2008-2010 Michigan State University
+  Copyright (c) 2011-2017 The University of Texas at Austin
+
+  breseq is free software; you can redistribute it and/or modify it under the
+  terms the GNU General Public License as published by the Free Software
+  Foundation; either version 1, or (at your option) any later version.
+
+*****************************************************************************/
+
+#include "libbreseq/common.h"
+#include "libbreseq/anyoption.h"
+#include "libbreseq/calculate_trims.h"
+#include "libbreseq/error_count.h"
+#include "libbreseq/fastq.h"
+#include "libbreseq/flagged_regions.h"
+#include "libbreseq/genome_diff.h"
+#include "libbreseq/identify_mutations.h"
+#include "libbreseq/nw.h"
+#include "libbreseq/settings.h"
+
+#include <chrono>
+#include <random>
+
+using namespace breseq;
+
+/*! Micro-benchmarks of libbreseq kernels.
+
+ Each kernel is run on synthetic inputs that resemble what it sees in a
+ pipeline run (read lengths, error table covariates, GD records, ...). The
+ inputs are created before timing starts, and each kernel is run repeatedly
+ until at least --min-seconds have elapsed, so that throughput is measured
+ over many calls even for the fastest kernels.
+ */
+
+// Defeats optimizing away results that are otherwise unused
+static volatile uint64_t benchmark_sink = 0;
+
+struct benchmark_result {
+  string   kernel;
+  string   unit;      // what one item is
+  uint64_t items;     // items processed in total
+  uint64_t bytes;     // bytes processed in total, or zero if not meaningful
+  double   seconds;
+};
+
+class cBenchmark {
+public:
+
+  cBenchmark(double _min_seconds, uint32_t _scale, uint32_t _seed, const string& _work_path)
+  : min_seconds(_min_seconds), scale(_scale), rng(_seed), work_path(_work_path)
+  { }
+
+  // Runs one pass over the inputs until min_seconds have elapsed.
+  // The pass function returns the number of items it processed.
+  template<typename pass_t>
+  benchmark_result time_passes(const string& kernel, const string& unit, uint64_t bytes_per_pass, pass_t pass)
+  {
+    benchmark_result r;
+    r.kernel = kernel;
+    r.unit = unit;
+    r.items = 0;
+    r.bytes = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    do {
+      r.items += pass();
+      r.bytes += bytes_per_pass;
+      r.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (r.seconds < min_seconds);
+
+    return r;
+  }
+
+  //! Random sequence of A, C, G and T
+  string random_sequence(uint32_t length)
+  {
+    string seq(length, 'A');
+    for (uint32_t i=0; i<length; i++) {
+      seq[i] = base_char_list[rng() % 4];
+    }
+    return seq;
+  }
+
+  //! Random sequence with a short tandem repeat or homopolymer about every 200 bp,
+  //! so that repeat-based trimming has something to find
+  string random_genome(uint32_t length)
+  {
+    string seq = random_sequence(length);
+    for (uint32_t pos=0; pos + 40 < length; pos += 100 + rng() % 200) {
+      string unit = random_sequence(1 + rng() % 4);
+      uint32_t repeat_length = 8 + rng() % 24;
+      for (uint32_t i=0; i<repeat_length; i++) {
+        seq[pos+i] = unit[i % unit.size()];
+      }
+    }
+    return seq;
+  }
+
+  //! Copy of a sequence with random substitutions and single-base indels
+  string mutate_sequence(const string& seq, uint32_t num_mutations)
+  {
+    string mutated = seq;
+    for (uint32_t i=0; i<num_mutations; i++) {
+      uint32_t pos = rng() % mutated.size();
+      switch (rng() % 3) {
+        case 0: mutated[pos] = base_char_list[rng() % 4]; break;
+        case 1: mutated.insert(pos, 1, base_char_list[rng() % 4]); break;
+        case 2: if (mutated.size() > 1) mutated.erase(pos, 1); break;
+      }
+    }
+    return mutated;
+  }
+
+  //! Error table with the covariates used by breseq for two read files,
+  //! and counts drawn so that most observed bases match the reference
+  void fill_error_table(cErrorTable& error_table)
+  {
+    for (uint32_t i=0; i<1000000; i++) {
+      covariate_values_t cv = random_covariates();
+      if (rng() % 100) cv.obs_base() = cv.ref_base();
+      error_table.count_covariate(cv);
+    }
+    error_table.counts_to_log10_prob();
+  }
+
+  covariate_values_t random_covariates()
+  {
+    covariate_values_t cv;
+    for (uint32_t i=0; i<k_num_covariates; i++) cv[i] = 0;
+    cv.read_set() = rng() % k_read_sets;
+    cv.ref_base() = rng() % 4;
+    cv.obs_base() = rng() % 4;
+    cv.quality() = 2 + rng() % (k_max_quality - 2);
+    return cv;
+  }
+
+  benchmark_result fastq_read_sequence();
+  benchmark_result reverse_complement_reads();
+  benchmark_result sequence_trims();
+  benchmark_result needleman_wunsch();
+  benchmark_result covariates_to_index();
+  benchmark_result two_base_model_likelihood();
+  benchmark_result genome_diff_read();
+  benchmark_result genome_diff_write();
+  benchmark_result flagged_regions_is_flagged();
+
+  static const uint32_t k_read_length = 150;
+  static const uint32_t k_read_sets = 2;
+  static const uint32_t k_max_quality = 41;
+  static const string k_covariates;
+
+  double min_seconds;
+  uint32_t scale;
+  mt19937 rng;
+  string work_path;
+};
+
+const string cBenchmark::k_covariates = "read_set=" + to_string(cBenchmark::k_read_sets) + ",obs_base,ref_base,quality=" + to_string(cBenchmark::k_max_quality);
+
+benchmark_result cBenchmark::fastq_read_sequence()
+{
+  uint32_t num_reads = 100000 * scale;
+  string file_name = work_path + "/reads.fastq";
+  uint64_t file_size = 0;
+
+  ofstream out(file_name.c_str());
+  ASSERT(out.good(), "Could not open file for writing: " + file_name);
+  for (uint32_t i=0; i<num_reads; i++) {
+    string name = "READ-" + to_string(i+1);
+    string qualities(k_read_length, '!');
+    for (uint32_t j=0; j<k_read_length; j++) qualities[j] = '!' + 2 + rng() % (k_max_quality - 2);
+    out << "@" << name << "\n" << random_sequence(k_read_length) << "\n+\n" << qualities << "\n";
+    file_size += 1 + name.size() + 1 + k_read_length + 3 + k_read_length + 1;
+  }
+  out.close();
+
+  benchmark_result r = time_passes("fastq_read_sequence", "reads", file_size, [&]() {
+    cFastqFile in(file_name, ios_base::in);
+    cFastqQualityConverter fqc("SANGER", "SANGER");
+    cFastqSequence seq;
+    uint64_t n = 0;
+    while (in.read_sequence(seq, fqc)) {
+      n++;
+    }
+    return n;
+  });
+
+  remove_file(file_name, true);
+  return r;
+}
+
+benchmark_result cBenchmark::reverse_complement_reads()
+{
+  vector<string> reads;
+  for (uint32_t i=0; i<100000 * scale; i++) {
+    reads.push_back(random_sequence(k_read_length));
+  }
+
+  return time_passes("reverse_complement", "reads", reads.size() * k_read_length, [&]() {
+    uint64_t sum = 0;
+    for (vector<string>::const_iterator it=reads.begin(); it!=reads.end(); it++) {
+      sum += reverse_complement(*it)[0];
+    }
+    benchmark_sink += sum;
+    return reads.size();
+  });
+}
+
+benchmark_result cBenchmark::sequence_trims()
+{
+  string genome = random_genome(1000000 * scale);
+
+  return time_passes("SequenceTrims", "bases", genome.size(), [&]() {
+    SequenceTrims trims(genome);
+    benchmark_sink += trims.left_trim_0(genome.size() / 2);
+    return genome.size();
+  });
+}
+
+// Pairs of candidate junction sequences, as compared by nw() when
+// junctions with similar sequences are merged
+benchmark_result cBenchmark::needleman_wunsch()
+{
+  const int32_t min_nw_score = -20;
+  vector<pair<string, string> > pairs;
+  for (uint32_t i=0; i<500 * scale; i++) {
+    string seq = random_sequence(2 * (k_read_length - 10));
+    pairs.push_back(make_pair(seq, mutate_sequence(seq, rng() % 8)));
+  }
+
+  return time_passes("nw", "alignments", 0, [&]() {
+    string al1, al2;
+    for (vector<pair<string, string> >::const_iterator it=pairs.begin(); it!=pairs.end(); it++) {
+      benchmark_sink += nw(it->first, it->second, al1, al2, false, min_nw_score);
+    }
+    return pairs.size();
+  });
+}
+
+benchmark_result cBenchmark::covariates_to_index()
+{
+  cErrorTable error_table(k_covariates);
+  vector<covariate_values_t> cvs;
+  for (uint32_t i=0; i<1000000 * scale; i++) {
+    cvs.push_back(random_covariates());
+  }
+
+  return time_passes("cErrorTable::covariates_to_index", "lookups", 0, [&]() {
+    uint64_t sum = 0;
+    for (vector<covariate_values_t>::const_iterator it=cvs.begin(); it!=cvs.end(); it++) {
+      sum += error_table.covariates_to_index(*it);
+    }
+    benchmark_sink += sum;
+    return cvs.size();
+  });
+}
+
+// Positions with read depth and base qualities like a polymorphic site, each
+// evaluated at the frequencies tried while searching for the best mixture
+benchmark_result cBenchmark::two_base_model_likelihood()
+{
+  cErrorTable error_table(k_covariates);
+  fill_error_table(error_table);
+
+  const uint32_t depth = 100;
+  const uint32_t num_frequencies = 20;
+  vector<vector<polymorphism_data> > positions(2000 * scale);
+  for (vector<vector<polymorphism_data> >::iterator it=positions.begin(); it!=positions.end(); it++) {
+    for (uint32_t i=0; i<depth; i++) {
+      covariate_values_t cv = random_covariates();
+      cv.obs_base() = (rng() % 3) ? 0 : 2;
+      int strand = (rng() % 2) ? 1 : -1;
+      it->push_back(polymorphism_data(baseindex2char(cv.obs_base()), cv.quality(), strand, cv.read_set(), cv));
+    }
+  }
+
+  return time_passes("calculate_two_base_model_log10_likelihood", "evaluations", 0, [&]() {
+    double sum = 0;
+    for (vector<vector<polymorphism_data> >::const_iterator it=positions.begin(); it!=positions.end(); it++) {
+      for (uint32_t i=1; i<=num_frequencies; i++) {
+        sum += identify_mutations_pileup::calculate_two_base_model_log10_likelihood(error_table, 'A', 'G', *it, i / (num_frequencies + 1.0));
+      }
+    }
+    benchmark_sink += static_cast<uint64_t>(-sum);
+    return positions.size() * num_frequencies;
+  });
+}
+
+// Writes a GD with RA evidence like the output of a polymorphism-mode run
+static void write_ra_genome_diff(const string& file_name, uint32_t num_records)
+{
+  ofstream out(file_name.c_str());
+  ASSERT(out.good(), "Could not open file for writing: " + file_name);
+  out << "#=GENOME_DIFF\t1.0" << "\n";
+  out << "#=TITLE\tbreseq_benchmark" << "\n";
+  for (uint32_t i=1; i<=num_records; i++) {
+    char ref = base_char_list[i % 4];
+    char alt = base_char_list[(i + 1) % 4];
+    out << "RA\t" << i << "\t.\tseq_" << (i % 3) << "\t" << i << "\t0\t" << ref << "\t" << alt
+        << "\tconsensus_score=" << (i % 300) << ".5\tfrequency=" << ((i % 100) / 100.0)
+        << "\tmajor_base=" << ref << "\tmajor_cov=" << (i % 47) << "/" << (i % 53)
+        << "\tminor_base=" << alt << "\tminor_cov=" << (i % 7) << "/" << (i % 5)
+        << "\tpolymorphism_score=" << (i % 17) << ".2\tprediction=polymorphism"
+        << "\ttotal_cov=" << (i % 47 + i % 7) << "/" << (i % 53 + i % 5) << "\n";
+  }
+}
+
+benchmark_result cBenchmark::genome_diff_read()
+{
+  uint32_t num_records = 20000 * scale;
+  string file_name = work_path + "/input.gd";
+  write_ra_genome_diff(file_name, num_records);
+
+  benchmark_result r = time_passes("cGenomeDiff::read", "entries", 0, [&]() {
+    cGenomeDiff gd;
+    gd.read(file_name, false, false);
+    return num_records;
+  });
+
+  remove_file(file_name, true);
+  return r;
+}
+
+benchmark_result cBenchmark::genome_diff_write()
+{
+  string input_file_name = work_path + "/input.gd";
+  string output_file_name = work_path + "/output.gd";
+  write_ra_genome_diff(input_file_name, 20000 * scale);
+  cGenomeDiff gd;
+  gd.read(input_file_name, false, false);
+  uint32_t num_records = gd.get_list().size();
+
+  benchmark_result r = time_passes("cGenomeDiff::write", "entries", 0, [&]() {
+    gd.write(output_file_name);
+    return num_records;
+  });
+
+  remove_file(input_file_name, true);
+  remove_file(output_file_name, true);
+  return r;
+}
+
+// Regions like those flagged as repeats or user masks on a few sequences,
+// queried with read-length intervals
+benchmark_result cBenchmark::flagged_regions_is_flagged()
+{
+  const uint32_t num_seq_ids = 3;
+  const uint32_t sequence_length = 5000000;
+  cFlaggedRegions flagged_regions;
+  for (uint32_t i=0; i<10000; i++) {
+    uint32_t start_1 = 1 + rng() % (sequence_length - 2000);
+    flagged_regions.flag_region("seq_" + to_string(rng() % num_seq_ids), start_1, start_1 + rng() % 2000);
+  }
+
+  struct query_t { string seq_id; uint32_t start_1; uint32_t end_1; };
+  vector<query_t> queries(10000 * scale);
+  for (vector<query_t>::iterator it=queries.begin(); it!=queries.end(); it++) {
+    it->seq_id = "seq_" + to_string(rng() % num_seq_ids);
+    it->start_1 = 1 + rng() % (sequence_length - k_read_length);
+    it->end_1 = it->start_1 + k_read_length - 1;
+  }
+
+  return time_passes("cFlaggedRegions::is_flagged", "queries", 0, [&]() {
+    uint64_t n = 0;
+    for (vector<query_t>::const_iterator it=queries.begin(); it!=queries.end(); it++) {
+      n += flagged_regions.is_flagged(it->seq_id, it->start_1, it->end_1);
+    }
+    benchmark_sink += n;
+    return queries.size();
+  });
+}
+
+int main(int argc, char* argv[])
+{
+  AnyOption options("Usage: breseq_benchmark [--kernel name] [--scale 1] [--min-seconds 1] [--seed 1] [--work-dir breseq_benchmark_tmp]");
+  options("help,h", "Display detailed help message", TAKES_NO_ARGUMENT);
+  options("kernel,k", "Only run this kernel. Option may be provided multiple times. (DEFAULT=all)");
+  options("scale,s", "Multiply the size of each synthetic input by this factor", 1);
+  options("min-seconds,m", "Run each kernel repeatedly for at least this many seconds", 1.0);
+  options("seed", "Random number seed used to create the synthetic inputs", 1);
+  options("work-dir,w", "Directory for temporary files, which are removed afterward", "breseq_benchmark_tmp");
+  options.addUsage("");
+  options.addUsage("Measures the throughput of libbreseq kernels on synthetic inputs.");
+  options.addUsage("Results are printed as a tab-delimited table.");
+  options.addUsage("");
+  options.addUsage("Kernels: fastq_read_sequence, reverse_complement, SequenceTrims, nw,");
+  options.addUsage("  covariates_to_index, two_base_model_likelihood, genome_diff_read,");
+  options.addUsage("  genome_diff_write, is_flagged");
+  options.processCommandArgs(argc, argv);
+
+  if (options.count("help")) {
+    options.printUsage();
+    return -1;
+  }
+
+  cBenchmark benchmark(
+                       from_string<double>(options["min-seconds"]),
+                       from_string<uint32_t>(options["scale"]),
+                       from_string<uint32_t>(options["seed"]),
+                       options["work-dir"]
+                       );
+  create_path(benchmark.work_path);
+
+  typedef benchmark_result (cBenchmark::*kernel_function_t)();
+  vector<pair<string, kernel_function_t> > kernels = make_vector<pair<string, kernel_function_t> >
+    (make_pair(string("fastq_read_sequence"), &cBenchmark::fastq_read_sequence))
+    (make_pair(string("reverse_complement"), &cBenchmark::reverse_complement_reads))
+    (make_pair(string("SequenceTrims"), &cBenchmark::sequence_trims))
+    (make_pair(string("nw"), &cBenchmark::needleman_wunsch))
+    (make_pair(string("covariates_to_index"), &cBenchmark::covariates_to_index))
+    (make_pair(string("two_base_model_likelihood"), &cBenchmark::two_base_model_likelihood))
+    (make_pair(string("genome_diff_read"), &cBenchmark::genome_diff_read))
+    (make_pair(string("genome_diff_write"), &cBenchmark::genome_diff_write))
+    (make_pair(string("is_flagged"), &cBenchmark::flagged_regions_is_flagged))
+  ;
+
+  vector<string> selected;
+  if (options.count("kernel")) {
+    selected = from_string<vector<string> >(options["kernel"]);
+    for (vector<string>::iterator it=selected.begin(); it!=selected.end(); it++) {
+      bool found = false;
+      for (vector<pair<string, kernel_function_t> >::iterator k=kernels.begin(); k!=kernels.end(); k++) {
+        found = found || (k->first == *it);
+      }
+      if (!found) {
+        options.addUsage("");
+        options.addUsage("Unknown kernel: " + *it);
+        options.printUsage();
+        return -1;
+      }
+    }
+  }
+
+  cout << "kernel" << "\t" << "items" << "\t" << "unit" << "\t" << "seconds" << "\t" << "items_per_second" << "\t" << "MB_per_second" << endl;
+  for (vector<pair<string, kernel_function_t> >::iterator k=kernels.begin(); k!=kernels.end(); k++) {
+    if (selected.size() && (find(selected.begin(), selected.end(), k->first) == selected.end())) continue;
+
+    benchmark_result r = (benchmark.*(k->second))();
+    cout << r.kernel << "\t" << r.items << "\t" << r.unit << "\t" << fixed << setprecision(3) << r.seconds
+         << "\t" << setprecision(0) << (r.items / r.seconds) << "\t";
+    if (r.bytes)
+      cout << setprecision(1) << (r.bytes / r.seconds / 1000000);
+    else
+      cout << "NA";
+    cout << endl;
+  }
+
+  SYSTEM("rm -rf " + benchmark.work_path, true, true);
+  return 0;
+}
@@ -16,12 +16,15 @@ LICENSE AND COPYRIGHT
 
 *****************************************************************************/
 
+#include <chrono>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "libbreseq/anyoption.h"
 #include "libbreseq/alignment_output.h"
+#include "libbreseq/batch.h"
 #include "libbreseq/reference_sequence.h"
 #include "libbreseq/calculate_trims.h"
 #include "libbreseq/candidate_junctions.h"
@@ -32,9 +35,11 @@ LICENSE AND COPYRIGHT
 #include "libbreseq/fastq.h"
 #include "libbreseq/genome_diff.h"
 #include "libbreseq/identify_mutations.h"
+#include "libbreseq/index_cache.h"
 #include "libbreseq/resolve_alignments.h"
 #include "libbreseq/samtools_commands.h"
 #include "libbreseq/settings.h"
+#include "libbreseq/step_scheduler.h"
 #include "libbreseq/summary.h"
 #include "libbreseq/contingency_loci.h"
 #include "libbreseq/mutation_predictor.h"
@@ -119,24 +124,29 @@ int do_bam2aln(int argc, char* argv[]) {
   cerr << "COMMAND: BAM2ALN" << endl;
   cerr << "+++   Creating alignments..." << endl;
 
+  // One object (and open BAM) is used for all regions
+  alignment_output ao(
+                      options["bam"],
+                      options["fasta"],
+                      from_string<uint32_t>(options["max-reads"]),
+                      from_string<uint32_t>(options["quality-score-cutoff"]),
+                      1,
+                      false,
+                      options.count("repeat"),
+                      from_string<uint32_t>(options["minimum-mapping-quality"])
+                      );
+  
+  // Read the BAM once for all regions
   for(uint32_t j = 0; j < region_list.size(); j++) {
-    
     cReferenceSequences::normalize_region(region_list[j]);
-    cerr << "  Region : " << region_list[j] << endl;
+  }
+  ao.set_region_batch(region_list);
+  
+  for(uint32_t j = 0; j < region_list.size(); j++) {
     
+    cerr << "  Region : " << region_list[j] << endl;
     
     // Generate Alignment!
-    alignment_output ao(
-                        options["bam"],
-                        options["fasta"],
-                        from_string<uint32_t>(options["max-reads"]),
-                        from_string<uint32_t>(options["quality-score-cutoff"]),
-                        1,
-                        false,
-                        options.count("repeat"),
-                        from_string<uint32_t>(options["minimum-mapping-quality"])
-                        );
-    
     string default_file_name = region_list[j];
     
     string output_string;
@@ -204,7 +214,7 @@ int do_bam2cov(int argc, char* argv[]) {
   // options controlling what files are output
   options("output,o", "Output path. If there is just one region, the name of the output file (DEFAULT=region1.*). If there are multiple regions, this argument must be a directory path, and all output files will be output here with names region1.*, region2.*, ... (DEFAULT=.)");
   options("region,r", "Regions to create alignments for. Must be provided as sequence regions in the format ACCESSION:START-END, where ACCESSION is a valid identifier for one of the sequences in the FASTA file, and START and END are 1-indexed coordinates of the beginning and end positions. Any read overlapping these positions will be shown. A separate output file is created for each region. Regions may be provided at the end of the command line as unnamed arguments");
-  options("format", "Format of output plot(s): PNG or PDF", "PNG");
+  options("format", "Format of output plot(s): PNG, SVG, or PDF. PDF output requires R", "PNG");
   options("table,t", "Create tab-delimited file of coverage instead of a plot", TAKES_NO_ARGUMENT);
   options.addUsage("", ADVANCED_OPTION);
   options.addUsage("Advanced Output Options", ADVANCED_OPTION);
@@ -212,6 +222,9 @@ int do_bam2cov(int argc, char* argv[]) {
   options("resolution,p", "Number of positions to output coverage information for in interval (0=ALL)", 600, ADVANCED_OPTION);
   options("show-average,a", "Show the average coverage across the reference sequence as a horizontal line. Only possible if used in the main output directory of breseq output", TAKES_NO_ARGUMENT, ADVANCED_OPTION);
   options("fixed-coverage-scale,s", "Fix the maximum value on plots the coverage scale in plots. If the show-average option is provided, then this is a factor that will be multiplied times the average coverage (e.g., 1.5 x avg). Otherwise, this is a coverage value (e.g., 100-fold coverage)", "", ADVANCED_OPTION);
+  options("r-plots", "Draw PNG plots by running R (the previous, slower method) instead of with the built-in renderer", TAKES_NO_ARGUMENT, ADVANCED_OPTION);
+  options("coverage-file", "Binary file of the coverage at every position of every reference sequence. If it does not exist or is older than the BAM file, it is created. Otherwise, coverage is read from it instead of the BAM file, which is much faster when making many plots or tables in separate runs", "", ADVANCED_OPTION);
+  options("num-processors,j", "Number of processors to use when tabulating the coverage of entire reference sequences", 1, ADVANCED_OPTION);
   
   options.addUsage("", ADVANCED_OPTION);
   options.addUsage("Tiling Mode (produce plots that span reference sequences from end to end)", ADVANCED_OPTION);
@@ -295,6 +308,7 @@ int do_bam2cov(int argc, char* argv[]) {
   // Set options
   co.total_only(options.count("total-only"));
   co.output_format( options["format"] );
+  co.use_r(options.count("r-plots"));
   if (options.count("show-average")) {
     co.show_average( options.count("show-average"), settings.error_rates_summary_file_name );
   }
@@ -335,6 +349,46 @@ int do_bam2cov(int argc, char* argv[]) {
     }
   }
   
+  // Coverage of entire reference sequences, used instead of a pileup for each region
+  cCoverageProfile profile;
+  uint32_t num_processors = max(1, from_string<int32_t>(options["num-processors"]));
+  
+  if (options.count("coverage-file")) {
+    string coverage_file_name = options["coverage-file"];
+    struct stat coverage_file_stat, bam_file_stat;
+    bool coverage_file_current = (stat(coverage_file_name.c_str(), &coverage_file_stat) == 0)
+      && (stat(options["bam"].c_str(), &bam_file_stat) == 0)
+      && (coverage_file_stat.st_mtime >= bam_file_stat.st_mtime);
+    
+    if (coverage_file_current) {
+      cerr << "  Reading coverage : " << coverage_file_name << endl;
+      profile.map(coverage_file_name);
+    } else {
+      cerr << "  Saving coverage : " << coverage_file_name << endl;
+      coverage_output::profile_targets(profile, options["bam"], options["fasta"], co.valid_seq_ids(), num_processors);
+      profile.write(coverage_file_name);
+    }
+  } else {
+    // When the regions on a sequence add up to at least half of its length, one pileup
+    // of the entire sequence is faster than a pileup of each region
+    vector<uint64_t> region_lengths(co.num_targets(), 0);
+    for(vector<string>::iterator it = region_list.begin(); it!= region_list.end(); it++) {
+      string region = *it;
+      cReferenceSequences::normalize_region(region);
+      uint32_t target_id, start_pos, end_pos;
+      co.parse_region(region, target_id, start_pos, end_pos);
+      region_lengths[target_id] += end_pos - start_pos + 1;
+    }
+    
+    vector<string> profile_seq_ids;
+    for(uint32_t target_id=0; target_id < co.num_targets(); target_id++) {
+      if (2 * region_lengths[target_id] >= co.target_length(target_id))
+        profile_seq_ids.push_back(co.target_name(target_id));
+    }
+    coverage_output::profile_targets(profile, options["bam"], options["fasta"], profile_seq_ids, num_processors);
+  }
+  co.use_profile(&profile);
+  
   // Create output path if necessary
   if ((region_list.size() > 1) && (!options["output"].empty())) {
     create_path(options["output"]);
@@ -750,9 +804,10 @@ int do_get_sequence(int argc, char *argv[])
     cAnnotatedSequence& new_seq = new_seq_info[seq_name];
     new_seq.m_fasta_sequence = ref_seq_info[replace_target_id].m_fasta_sequence;
     new_seq.m_fasta_sequence.set_name(seq_name);
-    new_seq.m_fasta_sequence.set_sequence(to_upper(ref_seq_info.get_sequence_1(replace_target_id, replace_start, replace_end)));
+    string region_sequence = to_upper(ref_seq_info.get_sequence_1(replace_target_id, replace_start, replace_end));
     if(do_reverse_complement)
-      new_seq.m_fasta_sequence.set_sequence(reverse_complement(new_seq.m_fasta_sequence.get_sequence()));
+      region_sequence = reverse_complement(region_sequence);
+    new_seq.m_fasta_sequence.set_sequence(region_sequence);
     new_seq.m_seq_id = region_list[j];
     new_seq.m_length = new_seq.m_fasta_sequence.get_sequence_length();
     
@@ -1022,6 +1077,100 @@ int do_simulate_read(int argc, char *argv[])
 }
 
 
+/*
+ * Function: copy_number_variation
+ * --------------------------------
+ * Tiles the coverage of each reference sequence and then finds and smooths
+ * segments with different copy numbers. Sequences are analyzed in parallel,
+ * and any processors left over are used to test the significance of segments
+ * within each sequence. The messages for each sequence are printed together
+ * when it is finished.
+ */
+void copy_number_variation(const Settings& settings, Summary& summary, cReferenceSequences& ref_seq_info)
+{
+  // Look these up before starting threads, since unique_coverage is a map
+  vector<double> nbinom_mean_parameters;
+  for (uint32_t i = 0; i < ref_seq_info.size(); i++) {
+    nbinom_mean_parameters.push_back(summary.unique_coverage[ref_seq_info[i].m_seq_id].nbinom_mean_parameter);
+  }
+  
+  uint32_t num_sequence_threads = min<uint32_t>(ref_seq_info.size(), max(1, settings.num_processors));
+  uint32_t num_segment_threads = max<uint32_t>(1, max(1, settings.num_processors) / max<uint32_t>(1, num_sequence_threads));
+  
+  parallel_for(ref_seq_info.size(), num_sequence_threads, [&](size_t i) {
+    
+    // One sequence at a time from the reference
+    const cAnnotatedSequence& seq = ref_seq_info[i];
+    stringstream log;
+    
+    // Create filename: [genome].coverage.bin, this is the binary file of coverage at every position
+    string this_complete_coverage_file_name = settings.file_name(settings.complete_coverage_file_name, "@", seq.m_seq_id);
+    
+    // Create filename: [genome].tiled.tab, this is LONG file where the tiled coverage data will be output
+    string this_tiled_complete_coverage_text_file_name = settings.file_name(settings.tiled_complete_coverage_text_file_name, "@", seq.m_seq_id);
+    
+    // Create filename: [genome].tiled_for_edging.tab, this is where the tiled
+    // coverage data at a smaller tile_size will be output for use in improved
+    // edge detection (aka "edging")
+    string this_tiled_for_edging_text_file_name = settings.file_name(settings.tiled_for_edging_text_file_name, "@", seq.m_seq_id);
+    
+    // Generates [genome].tiled.tab, one line at a time with each for-loop,
+    // where the avg coverage of each tile is calculated.
+    CoverageDistribution::tile(settings.ignore_redundant_coverage,
+                               this_complete_coverage_file_name, // in_file_name
+                               this_tiled_complete_coverage_text_file_name, // out_file_name
+                               this_tiled_for_edging_text_file_name,
+                               settings.copy_number_variation_tile_size,
+                               log);
+    
+    // Create filename: [genome].ranges.tab, this is SHORT file used for ???
+    // (contains: Start_Position, End_Position, T_Score, P_Value)
+    string this_ranges_text_file_name = settings.file_name(settings.ranges_text_file_name, "@", seq.m_seq_id);
+    
+    // Get filename: [genome].history.tab, this is SHORT file used for ???
+    // (contains: Start_Search, End_Search, Start_Position, End_Position, Start_Segment, End_Segment... 16 values total)
+    string this_cnv_history_text_file_name = settings.file_name(settings.cnv_history_text_file_name, "@", seq.m_seq_id);
+    
+    // Generates [genome].ranges.tab & [genome].history.tab, one line at a time with each for-loop,
+    CoverageDistribution::find_segments(settings,
+                                        nbinom_mean_parameters[i],
+                                        this_tiled_complete_coverage_text_file_name,
+                                        this_tiled_for_edging_text_file_name, // tiled_for_edging_file_name (tiled_for_edging.tab)
+                                        this_ranges_text_file_name,
+                                        this_cnv_history_text_file_name,
+                                        num_segment_threads,
+                                        log
+                                        );
+    
+    // Create filename: [genome].smoothed_ranges.tab, this is LONG file used for ???
+    // (contains: Position, Smooth_Coverage)
+    string this_smoothed_ranges_text_file_name = settings.file_name(settings.smoothed_ranges_text_file_name, "@", seq.m_seq_id);
+    
+    // Create filename: [genome].cnv_final.tab, this is SHORT file used for ???
+    // (contains: Start_Position, End_Position, Z_Score, Greater_Than, Copy_Number)
+    string this_final_cnv_file_name = settings.file_name(settings.final_cnv_text_file_name, "@", seq.m_seq_id);
+    
+    // Create filename: [genome].cn_evidence.gd, this is SHORT file used for ???
+    // (contains no labels)
+    string this_copy_number_variation_cn_genome_diff_file_name = settings.file_name(settings.copy_number_variation_cn_genome_diff_file_name, "@", seq.m_seq_id);
+    
+    // Generates [genome].smoothed_ranges.tab & [genome].cnv_final.tab & [genome].cn_evidence.gd,
+    // one line at a time with each for-loop,
+    CoverageDistribution::smooth_segments(settings,
+                                          seq.m_seq_id,
+                                          nbinom_mean_parameters[i],
+                                          this_tiled_for_edging_text_file_name,
+                                          this_ranges_text_file_name,
+                                          this_smoothed_ranges_text_file_name,
+                                          this_final_cnv_file_name,
+                                          this_copy_number_variation_cn_genome_diff_file_name,
+                                          log
+                                          );
+    
+    cout << log.str() << flush;
+  });
+}
+
 /*
  * Function: do_copy_number_variation
  * --------------------------------
@@ -1049,72 +1198,7 @@ int do_copy_number_variation(int argc, char *argv[])
     // Create copy_number_variation directory
     create_path( settings.copy_number_variation_path );
 
-    for (cReferenceSequences::iterator it = ref_seq_info.begin(); it != ref_seq_info.end(); ++it) {
-        
-        // Sequence iterator, one sequence at a time from .fastq file
-        cAnnotatedSequence& seq = *it;
-
-        // Create filename: [genome].coverage.txt, this is LONG file where the coverage data is coming from
-        string this_complete_coverage_text_file_name = settings.file_name(settings.complete_coverage_text_file_name, "@", seq.m_seq_id);
-
-        // Create filename: [genome].tiled.tab, this is LONG file where the tiled coverage data will be output
-        string this_tiled_complete_coverage_text_file_name = settings.file_name(settings.tiled_complete_coverage_text_file_name, "@", seq.m_seq_id);
-
-        // Create filename: [genome].tiled_for_edging.tab, this is where the tiled
-        // coverage data at a smaller tile_size will be output for use in improved
-        // edge detection (aka "edging")
-        string this_tiled_for_edging_text_file_name = settings.file_name(settings.tiled_for_edging_text_file_name, "@", seq.m_seq_id);
-        
-        // Generates [genome].tiled.tab, one line at a time with each for-loop,
-        // where the avg coverage of each tile is calculated.
-        CoverageDistribution::tile(settings.ignore_redundant_coverage,
-                                   this_complete_coverage_text_file_name, // in_file_name
-                                   this_tiled_complete_coverage_text_file_name, // out_file_name
-                                   this_tiled_for_edging_text_file_name,
-                                   settings.copy_number_variation_tile_size);
-
-        // Create filename: [genome].ranges.tab, this is SHORT file used for ???
-        // (contains: Start_Position, End_Position, T_Score, P_Value)
-        string this_ranges_text_file_name = settings.file_name(settings.ranges_text_file_name, "@", seq.m_seq_id);
-
-        // Get filename: [genome].history.tab, this is SHORT file used for ???
-        // (contains: Start_Search, End_Search, Start_Position, End_Position, Start_Segment, End_Segment... 16 values total)
-        string this_cnv_history_text_file_name = settings.file_name(settings.cnv_history_text_file_name, "@", seq.m_seq_id);
-
-        // Generates [genome].ranges.tab & [genome].history.tab, one line at a time with each for-loop,
-        CoverageDistribution::find_segments(settings,
-                                            summary.unique_coverage[seq.m_seq_id].nbinom_mean_parameter,
-                                            this_tiled_complete_coverage_text_file_name,
-                                            this_tiled_for_edging_text_file_name, // tiled_for_edging_file_name (tiled_for_edging.tab)
-                                            this_ranges_text_file_name,
-                                            this_cnv_history_text_file_name
-                                            );
-
-        // Create filename: [genome].smoothed_ranges.tab, this is LONG file used for ???
-        // (contains: Position, Smooth_Coverage)
-        string this_smoothed_ranges_text_file_name = settings.file_name(settings.smoothed_ranges_text_file_name, "@", seq.m_seq_id);
-
-        // Create filename: [genome].cnv_final.tab, this is SHORT file used for ???
-        // (contains: Start_Position, End_Position, Z_Score, Greater_Than, Copy_Number)
-        string this_final_cnv_file_name = settings.file_name(settings.final_cnv_text_file_name, "@", seq.m_seq_id);
-
-        // Create filename: [genome].cn_evidence.gd, this is SHORT file used for ???
-        // (contains no labels)
-        string this_copy_number_variation_cn_genome_diff_file_name = settings.file_name(settings.copy_number_variation_cn_genome_diff_file_name, "@", seq.m_seq_id);
-
-        // Generates [genome].smoothed_ranges.tab & [genome].cnv_final.tab & [genome].cn_evidence.gd,
-        // one line at a time with each for-loop,
-        CoverageDistribution::smooth_segments(settings,
-                                              seq.m_seq_id,
-                                              summary.unique_coverage[seq.m_seq_id].nbinom_mean_parameter, 
-                                              this_tiled_for_edging_text_file_name, 
-                                              this_ranges_text_file_name, 
-                                              this_smoothed_ranges_text_file_name,
-                                              this_final_cnv_file_name,
-                                              this_copy_number_variation_cn_genome_diff_file_name
-                                              );
-
-    } // End of for loop
+    copy_number_variation(settings, summary, ref_seq_info);
 
     return 0;
 }
@@ -1170,6 +1254,87 @@ int do_coverage_bias(int argc, char *argv[])
 }
 
 
+// Fit the unique-only coverage distribution as during a breseq run
+int do_coverage_distribution(int argc, char *argv[])
+{
+  AnyOption options("Usage: breseq COVERAGE-DISTRIBUTION -i unique_only_coverage_distribution.tab -l 4629812 [-o fit.tab -p plot.pdf --compare-r]");
+  options.addUsage("");
+  options.addUsage("Fit a negative binomial distribution to a coverage distribution file created");
+  options.addUsage("during a breseq run (output/calibration/*.unique_only_coverage_distribution.tab)");
+  options.addUsage("and print the parameters and deletion propagation cutoff that breseq would use.");
+  options.addUsage("");
+  options.addUsage("Allowed Options");
+  options("help,h", "Display detailed help message", TAKES_NO_ARGUMENT);
+  options("input,i", "Coverage distribution file");
+  options("sequence-length,l", "Total length of the reference sequences in this coverage group");
+  options("output,o", "Write the fit values to this file instead of the screen");
+  options("plot,p", "Graph the fit to this PDF file using R");
+  options("compare-r", "Also fit the distribution using R and print the differences", TAKES_NO_ARGUMENT);
+  options.processCommandArgs(argc, argv);
+  
+  if(options.count("help")) {
+    options.printAdvancedUsage();
+    return -1;
+  }
+  
+  if (!options.count("input") || !file_exists(options["input"].c_str())) {
+    options.addUsage("");
+    options.addUsage("Could not open input coverage distribution file (-i).");
+    options.printUsage();
+    return -1;
+  }
+  
+  if (!options.count("sequence-length") || (from_string<uint32_t>(options["sequence-length"]) == 0)) {
+    options.addUsage("");
+    options.addUsage("You must provide a positive sequence length (-l).");
+    options.printUsage();
+    return -1;
+  }
+  
+  // Same as during a breseq run
+  double deletion_propagation_pr_cutoff = 0.05 / sqrt(from_string<uint32_t>(options["sequence-length"]));
+  
+  CoverageSummary fit;
+  CoverageDistribution::fit(options["input"], deletion_propagation_pr_cutoff, fit);
+  
+  vector<string> names = make_vector<string>
+  ("nbinom_size_parameter")("nbinom_mean_parameter")("average")("variance")("dispersion")("deletion_coverage_propagation_cutoff");
+  vector<double> values = make_vector<double>
+  (fit.nbinom_size_parameter)(fit.nbinom_mean_parameter)(fit.average)(fit.variance)(fit.dispersion)(fit.deletion_coverage_propagation_cutoff);
+  
+  ofstream output_file;
+  if (options.count("output")) {
+    output_file.open(options["output"].c_str());
+    ASSERT(output_file.good(), "Could not open output file: " + options["output"]);
+  }
+  ostream& out = options.count("output") ? output_file : cout;
+  
+  out << setprecision(5);
+  for (size_t i = 0; i < names.size(); i++) {
+    out << names[i] << "\t" << values[i] << endl;
+  }
+  
+  if (options.count("compare-r") || options.count("plot")) {
+    Settings settings;
+    
+    if (!options.count("compare-r")) {
+      CoverageDistribution::plot_fit(settings, options["input"], options["plot"], fit);
+      return 0;
+    }
+    
+    vector<string> lines = CoverageDistribution::fit_with_r(settings, options["input"], options.count("plot") ? options["plot"] : "/dev/null", deletion_propagation_pr_cutoff);
+    ASSERT(lines.size() == names.size(), "Did not find all fit values in R output: " + options["input"] + ".r.log");
+    
+    cout << endl << "Compared to R" << endl;
+    for (size_t i = 0; i < names.size(); i++) {
+      double r_value = from_string<double>(lines[i]);
+      cout << names[i] << "\t" << r_value << "\t" << (r_value != 0 ? (values[i] - r_value) / r_value : values[i] - r_value) << endl;
+    }
+  }
+  
+  return 0;
+}
+
 int do_junction_polymorphism(int argc, char *argv[])
 {
   AnyOption options("Usage: breseq JUNCTION-POLYMORPHISM -g input.gd [ -o output.gd ]");  
@@ -1312,6 +1477,275 @@ int do_assemble_unmatched(int argc, char* argv[])
   return 0;
 }
   
+/*! Check the job scheduler used to run steps and alignments concurrently.
+ 
+ Writes name<TAB>value lines that do not depend on timing, for comparison
+ with the expected output of a test.
+ */
+int do_test_scheduler(int argc, char* argv[])
+{
+  AnyOption options("Usage: breseq TEST-SCHEDULER [-o output.tab]");
+  options.addUsage("Runs cases of dividing threads among jobs and of running jobs with dependencies.");
+  options("output,o","Output file of results", "output.tab");
+  options.processCommandArgs(argc, argv);
+
+  ofstream out(options["output"].c_str());
+  ASSERT(out.good(), "Could not open output file: " + options["output"]);
+
+  // Dividing processors among files by size
+  vector<pair<string, pair<vector<uint64_t>, uint32_t> > > split_cases;
+  split_cases.push_back(make_pair("split_fewer_processors_than_files", make_pair(make_vector<uint64_t>(100)(200)(300), 2)));
+  split_cases.push_back(make_pair("split_as_many_processors_as_files", make_pair(make_vector<uint64_t>(5)(500), 2)));
+  split_cases.push_back(make_pair("split_zero_size_files", make_pair(make_vector<uint64_t>(0)(0), 4)));
+  split_cases.push_back(make_pair("split_one_zero_size_file", make_pair(make_vector<uint64_t>(100)(0)(300), 8)));
+  split_cases.push_back(make_pair("split_remainders", make_pair(make_vector<uint64_t>(1)(1)(1), 5)));
+
+  for (vector<pair<string, pair<vector<uint64_t>, uint32_t> > >::iterator it = split_cases.begin(); it != split_cases.end(); it++) {
+    vector<uint32_t> num_threads = cJobScheduler::split_threads_by_size(it->second.first, it->second.second);
+    vector<string> num_threads_strings;
+    for (vector<uint32_t>::iterator nt = num_threads.begin(); nt != num_threads.end(); nt++) {
+      num_threads_strings.push_back(to_string(*nt));
+    }
+    out << it->first << "\t" << join(num_threads_strings, ",") << endl;
+  }
+
+  // Running jobs: each records the jobs that were running or finished when
+  // it started, and holds its threads for long enough that jobs overlap
+  mutex jobs_mutex;
+  vector<uint32_t> job_threads;
+  vector<vector<size_t> > job_dependencies;
+  vector<string> job_states;
+  uint32_t threads_in_use = 0;
+  uint32_t max_threads_in_use = 0;
+  uint32_t num_started_before_dependencies = 0;
+  uint32_t num_started_beside_large_job = 0;
+  size_t large_job = 0;
+
+  cJobScheduler jobs(2);
+  function<size_t(uint32_t, const vector<size_t>&)> add_test_job = [&](uint32_t num_threads, const vector<size_t>& dependencies) {
+    size_t job_index = job_threads.size();
+    job_threads.push_back(min(num_threads, jobs.num_processors()));
+    job_dependencies.push_back(dependencies);
+    job_states.push_back("waiting");
+
+    return jobs.add_job(num_threads, dependencies, [&, job_index]() {
+      {
+        lock_guard<mutex> lock(jobs_mutex);
+        for (vector<size_t>::iterator it = job_dependencies[job_index].begin(); it != job_dependencies[job_index].end(); it++) {
+          if (job_states[*it] != "finished") num_started_before_dependencies++;
+        }
+        if (large_job && ((job_index == large_job) ? (threads_in_use > 0) : (job_states[large_job] == "running"))) num_started_beside_large_job++;
+        job_states[job_index] = "running";
+        threads_in_use += job_threads[job_index];
+        max_threads_in_use = max(max_threads_in_use, threads_in_use);
+      }
+
+      this_thread::sleep_for(chrono::milliseconds(50));
+
+      lock_guard<mutex> lock(jobs_mutex);
+      job_states[job_index] = "finished";
+      threads_in_use -= job_threads[job_index];
+    });
+  };
+
+  // Three files on two processors, each aligned in two stages, then merged
+  vector<size_t> stage_2_jobs;
+  for (uint32_t i = 0; i < 3; i++) {
+    size_t stage_1_job = add_test_job(1, vector<size_t>());
+    stage_2_jobs.push_back(add_test_job(1, make_vector<size_t>(stage_1_job)));
+  }
+  size_t merge_job = add_test_job(1, stage_2_jobs);
+
+  // A job that asks for more threads than there are processors, followed by
+  // one that is ready at the same time
+  large_job = add_test_job(4, make_vector<size_t>(merge_job));
+  add_test_job(1, make_vector<size_t>(merge_job));
+
+  jobs.run();
+
+  uint32_t num_finished = 0;
+  for (vector<string>::iterator it = job_states.begin(); it != job_states.end(); it++) {
+    if (*it == "finished") num_finished++;
+  }
+
+  out << "jobs_finished" << "\t" << num_finished << "/" << job_states.size() << endl;
+  out << "jobs_started_before_dependencies" << "\t" << num_started_before_dependencies << endl;
+  out << "max_threads_in_use" << "\t" << max_threads_in_use << endl;
+  out << "jobs_started_beside_large_job" << "\t" << num_started_beside_large_job << endl;
+
+  return 0;
+}
+
+/*! Run breseq on many samples with the same reference.
+ 
+ The reference is converted and its bowtie2 index is built once, then each
+ sample's pipeline runs as a separate breseq process using them. As many
+ samples run at once as fit within the processors and the memory budget.
+ */
+int do_batch(int argc, char* argv[])
+{
+  AnyOption options("Usage: breseq BATCH -r reference.gbk [-o batch -j 8] samples.tab");
+  options.addUsage("");
+  options.addUsage("Run breseq on each sample in a sample sheet, all against the same reference");
+  options.addUsage("sequences. The reference files are converted and indexed for bowtie2 once,");
+  options.addUsage("and then the samples are run as separate breseq processes sharing the");
+  options.addUsage("processors. Each sample's output is written to its own directory: <output>/<name>,");
+  options.addUsage("with the messages from that run in <output>/<name>/breseq.log.");
+  options.addUsage("");
+  options.addUsage("Each line of the sample sheet is tab-delimited: the sample name, its read files");
+  options.addUsage("separated by commas, and optionally other options for that sample's breseq run");
+  options.addUsage("(for example: -p -l 80). Blank lines and lines starting with '#' are skipped.");
+  options.addUsage("");
+  options.addUsage("Allowed Options");
+  options("help,h", "Display detailed help message", TAKES_NO_ARGUMENT);
+  options("reference,r", "File containing reference sequences in GenBank, GFF3, or FASTA format. Option may be provided multiple times for multiple files (REQUIRED)");
+  options("contig-reference,c", "File containing contig reference sequences, as for breseq -c");
+  options("junction-only-reference,s", "File containing junction-only reference sequences, as for breseq -s");
+  options("output,o", "Path to batch output", ".");
+  options("num-processors,j", "Total number of processors to use for all samples", 1);
+  options("threads-per-sample", "Number of processors used by each sample's run (DEFAULT = processors divided among the samples that can run at once)", 0);
+  options("max-memory", "Total memory in GB that runs may use at once (0 = no limit)", 0.0);
+  options("memory-per-sample", "Memory in GB expected for each sample's run, used with --max-memory to limit how many run at once", 4.0);
+  options("bowtie2-index-cache", "Directory where the bowtie2 index of the reference is kept (DEFAULT = <output>/bowtie2_index_cache)");
+  options.processCommandArgs(argc, argv);
+
+  if (options.count("help")) {
+    options.printUsage();
+    return -1;
+  }
+
+  if (options.getArgc() != 1) {
+    options.addUsage("");
+    options.addUsage("Exactly one sample sheet must be provided.");
+    options.printUsage();
+    return -1;
+  }
+
+  if (options.count("reference") + options.count("contig-reference") + options.count("junction-only-reference") == 0) {
+    options.addUsage("");
+    options.addUsage("No reference sequence files provided (-r).");
+    options.printUsage();
+    return -1;
+  }
+
+  cerr << "COMMAND: BATCH" << endl;
+
+  // Same order as Settings, so that each run's references match the prepared ones
+  vector<string> reference_file_names;
+  string reference_arguments;
+  const char* reference_options[] = { "reference", "contig-reference", "junction-only-reference" };
+  const char* reference_flags[] = { "-r", "-c", "-s" };
+  for (uint32_t i = 0; i < 3; i++) {
+    if (!options.count(reference_options[i])) continue;
+    vector<string> file_names = from_string<vector<string> >(options[reference_options[i]]);
+    for (vector<string>::const_iterator it = file_names.begin(); it != file_names.end(); ++it) {
+      reference_file_names.push_back(*it);
+      reference_arguments += string(" ") + reference_flags[i] + " " + shell_quote(*it);
+    }
+  }
+
+  string output_path = options["output"];
+  create_path(output_path);
+
+  vector<cBatchSample> samples = cBatchSample::read_sample_sheet(options.getArgv(0));
+
+  // Limit how many samples run at once by memory, then divide up the processors
+  uint32_t num_processors = max<uint32_t>(1, from_string<uint32_t>(options["num-processors"]));
+  double max_memory = from_string<double>(options["max-memory"]);
+  double memory_per_sample = from_string<double>(options["memory-per-sample"]);
+  ASSERT(memory_per_sample > 0, "Argument --memory-per-sample must be > 0");
+
+  uint32_t max_concurrent_samples = samples.size();
+  if (max_memory > 0) {
+    max_concurrent_samples = min<uint32_t>(max_concurrent_samples, max<uint32_t>(1, floor(max_memory / memory_per_sample)));
+  }
+
+  uint32_t threads_per_sample = from_string<uint32_t>(options["threads-per-sample"]);
+  if (threads_per_sample == 0) {
+    threads_per_sample = max<uint32_t>(1, num_processors / max_concurrent_samples);
+  }
+  uint32_t processor_budget = min<uint32_t>(num_processors, max_concurrent_samples * threads_per_sample);
+
+  cerr << "  Samples: " << samples.size() << endl;
+  cerr << "  Processors: " << processor_budget << " (" << threads_per_sample << " per sample, up to " << max_concurrent_samples << " samples at once)" << endl;
+
+  cerr << "+++   Preparing reference..." << endl;
+  cPreparedReference prepared_reference(output_path + "/" + cBatchSample::k_prepared_reference_directory);
+  bool reference_converted = prepared_reference.prepare(reference_file_names);
+
+  // Runs of an earlier batch used other reference sequences, so start them over
+  if (reference_converted) {
+    for (vector<cBatchSample>::const_iterator it = samples.begin(); it != samples.end(); ++it) {
+      string sample_path = output_path + "/" + it->name;
+      if (access(sample_path.c_str(), F_OK) != 0) continue;
+      cerr << "  Removing output made with other reference sequences: " << sample_path << endl;
+      SYSTEM("rm -rf " + shell_quote(sample_path), true, false, false);
+    }
+  }
+
+  // Build the bowtie2 index before any runs start, unless no sample needs it
+  string bowtie2_index_cache_path = options.count("bowtie2-index-cache") ? options["bowtie2-index-cache"] : output_path + "/" + cBatchSample::k_bowtie2_index_cache_directory;
+  bool need_bowtie2_index = false;
+  for (vector<cBatchSample>::const_iterator it = samples.begin(); it != samples.end(); ++it) {
+    if (it->options.find("--aligned-sam") == string::npos) need_bowtie2_index = true;
+  }
+  if (need_bowtie2_index) {
+    cerr << "+++   Building bowtie2 index..." << endl;
+    Settings settings(output_path);
+    settings.check_installed();
+    cBowtie2IndexCache(bowtie2_index_cache_path, settings.installed["bowtie2_version_string"]).index(prepared_reference.fasta_file_name());
+  }
+
+  // Larger samples start first, so that the last runs to finish are short
+  vector<size_t> sample_order(samples.size());
+  vector<uint64_t> sample_sizes(samples.size());
+  for (size_t i = 0; i < samples.size(); i++) {
+    sample_order[i] = i;
+    sample_sizes[i] = samples[i].read_files_size();
+  }
+  stable_sort(sample_order.begin(), sample_order.end(), [&sample_sizes](size_t a, size_t b) { return sample_sizes[a] > sample_sizes[b]; });
+
+  cerr << "+++   Running samples..." << endl;
+  vector<int> return_values(samples.size(), 0);
+  cJobScheduler jobs(processor_budget);
+  for (vector<size_t>::const_iterator it = sample_order.begin(); it != sample_order.end(); ++it) {
+    const cBatchSample& sample = samples[*it];
+    int& return_value = return_values[*it];
+    string sample_path = output_path + "/" + sample.name;
+    // Only the options column is left for the shell to split
+    string command = shell_quote(Settings::get_bin_path() + "/breseq") + " -j " + to_string(threads_per_sample)
+      + " -o " + shell_quote(sample_path) + reference_arguments
+      + " --prepared-reference " + shell_quote(prepared_reference.path())
+      + " --bowtie2-index-cache " + shell_quote(bowtie2_index_cache_path)
+      + (sample.options.size() ? " " + sample.options : "");
+    for (vector<string>::const_iterator read_it = sample.read_file_names.begin(); read_it != sample.read_file_names.end(); ++read_it) {
+      command += " " + shell_quote(*read_it);
+    }
+    command += " > " + shell_quote(sample_path + "/breseq.log") + " 2>&1";
+    jobs.add_job(threads_per_sample, vector<size_t>(), [sample, sample_path, command, &return_value]() {
+      cerr << "  Started: " << sample.name << endl;
+      create_path(sample_path);
+      return_value = SYSTEM(command, true, true, false);
+      cerr << "  " << (return_value ? "FAILED: " : "Finished: ") << sample.name << endl;
+    });
+  }
+  jobs.run();
+
+  uint32_t num_failed = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    if (return_values[i] == 0) continue;
+    if (num_failed++ == 0) cerr << "+++   Samples that failed:" << endl;
+    cerr << "  " << samples[i].name << " (see " << output_path + "/" + samples[i].name + "/breseq.log)" << endl;
+  }
+  if (num_failed) {
+    cerr << "+++   " << num_failed << " of " << samples.size() << " samples FAILED" << endl;
+    return -1;
+  }
+
+  cerr << "+++   SUCCESSFULLY COMPLETED" << endl;
+  return 0;
+}
+
 int breseq_default_action(int argc, char* argv[])
 {
 	///
@@ -1329,6 +1763,8 @@ int breseq_default_action(int argc, char* argv[])
 	create_path(settings.sequence_conversion_path);
   create_path(settings.data_path);
 
+  if (settings.trace) cTrace::open(settings.trace_file_name);
+
   cReferenceSequences ref_seq_info;
 
 	if (settings.do_step(settings.sequence_conversion_done_file_name, "Read and reference sequence file input"))
@@ -1336,14 +1772,21 @@ int breseq_default_action(int argc, char* argv[])
 		SequenceConversionSummary s;
     cReferenceSequences conv_ref_seq_info;
     
-    // Load all of the reference sequences and convert to FASTA and GFF3
-    conv_ref_seq_info.LoadFiles(settings.all_reference_file_names);
-    conv_ref_seq_info.WriteFASTA(settings.reference_fasta_file_name);
-    conv_ref_seq_info.WriteGFF(settings.reference_gff3_file_name);
-    s.total_reference_sequence_length = conv_ref_seq_info.get_total_length();
+    if (settings.prepared_reference_path.size()) {
+      // Copy the FASTA, GFF3, index and trims converted once for a batch of samples
+      s.total_reference_sequence_length = cPreparedReference(settings.prepared_reference_path).copy_to(settings);
+    } else {
+      // Load all of the reference sequences and convert to FASTA and GFF3
+      conv_ref_seq_info.LoadFiles(settings.all_reference_file_names);
+      conv_ref_seq_info.WriteFASTA(settings.reference_fasta_file_name);
+      conv_ref_seq_info.WriteGFF(settings.reference_gff3_file_name);
+      s.total_reference_sequence_length = conv_ref_seq_info.get_total_length();
+    }
     
     // Do a quick load of the file to detect formatting errors.
     if (settings.user_evidence_genome_diff_file_name != "") {
+      if (settings.prepared_reference_path.size())
+        conv_ref_seq_info.LoadFiles(make_vector<string>(settings.reference_gff3_file_name));
       cGenomeDiff gd(settings.user_evidence_genome_diff_file_name);
       gd.valid_with_reference_sequences(conv_ref_seq_info, false);
     }
@@ -1360,7 +1803,22 @@ int breseq_default_action(int argc, char* argv[])
       s.num_bases = 0;
       
       
-      uint64_t read_file_base_limit = floor(settings.read_file_coverage_fold_limit * static_cast<double>(conv_ref_seq_info.get_total_length())); 
+      uint64_t read_file_base_limit = floor(settings.read_file_coverage_fold_limit * static_cast<double>(s.total_reference_sequence_length));
+      
+      // For random subsampling, the same fraction of the reads is kept from every
+      // file, from the bases counted in all of the files before any are converted
+      double read_file_sample_fraction = 0;
+      if (settings.read_file_coverage_fold_limit_random) {
+        uint64_t total_original_bases = 0;
+        for (uint32_t i = 0; i < settings.read_files.size(); i++) {
+          uint64_t num_original_reads, num_original_bases;
+          uint32_t read_length_min, read_length_max;
+          uint8_t min_quality_score, max_quality_score;
+          cFastqQualityConverter::predict_fastq_file_format(settings.base_name_to_read_file_name(settings.read_files[i].m_base_name), num_original_reads, num_original_bases, read_length_min, read_length_max, min_quality_score, max_quality_score);
+          total_original_bases += num_original_bases;
+        }
+        read_file_sample_fraction = total_original_bases ? static_cast<double>(read_file_base_limit) / static_cast<double>(total_original_bases) : 0;
+      }
       
       for (uint32_t i = 0; i < settings.read_files.size(); i++)
       {
@@ -1370,14 +1828,14 @@ int breseq_default_action(int argc, char* argv[])
         
         // If we have reached the read limit or within some number of it -- delete further read files 
         // The 1000, is so that we have enough bases counted in a read file to fit the error rates.
-        if ((settings.read_file_coverage_fold_limit) && (i!= 0) && (s.num_bases + 1000 >= read_file_base_limit)) {
+        if ((settings.read_file_coverage_fold_limit) && !settings.read_file_coverage_fold_limit_random && (i!= 0) && (s.num_bases + 1000 >= read_file_base_limit)) {
           cerr << "  ::SKIPPED DUE TO REACHING COVERAGE LIMIT::" << endl;
           continue;
         }
         
         string fastq_file_name = settings.base_name_to_read_file_name(base_name);
         string convert_file_name =  settings.file_name(settings.converted_fastq_file_name, "#", base_name);
-
+        
         // Parse output
         AnalyzeFastqSummary s_rf = normalize_fastq(fastq_file_name,
                                                      convert_file_name,
@@ -1385,7 +1843,8 @@ int breseq_default_action(int argc, char* argv[])
                                                      settings.quality_score_trim,
                                                      !settings.skip_read_filtering,
                                                      s.num_bases,
-                                                     read_file_base_limit,
+                                                     settings.read_file_coverage_fold_limit_random ? 0 : read_file_base_limit,
+                                                     read_file_sample_fraction,
                                                      settings.read_file_read_length_min,
                                                      settings.read_file_max_same_base_fraction,
                                                      settings.read_file_max_N_fraction
@@ -1430,10 +1889,11 @@ int breseq_default_action(int argc, char* argv[])
 		string command = samtools + " faidx " + settings.reference_fasta_file_name;
 		SYSTEM(command);
     */
-    samtools_faidx(settings.reference_fasta_file_name);
-    
-		// calculate trim files
-		calculate_trims(settings.reference_fasta_file_name, settings.sequence_conversion_path);
+    // index and calculate trim files, unless copied from a prepared reference
+    if (!settings.prepared_reference_path.size()) {
+      samtools_faidx(settings.reference_fasta_file_name);
+      calculate_trims(settings.reference_fasta_file_name, settings.sequence_conversion_path);
+    }
     settings.track_intermediate_file(settings.output_done_file_name, settings.sequence_conversion_path + "/*.trims");
 
 		// store summary information
@@ -1449,6 +1909,8 @@ int breseq_default_action(int argc, char* argv[])
   // so that contig and junction-only references are correctly flagged
   ref_seq_info.LoadFiles(make_vector<string>(settings.reference_gff3_file_name));
   ref_seq_info.use_original_file_names();
+  if (settings.pack_reference_sequences)
+    ref_seq_info.pack_sequences();
   
   // update the normal versus junction-only lists
   // - must be done after reading from our own GFF3 file
@@ -1506,9 +1968,27 @@ int breseq_default_action(int argc, char* argv[])
     
     string reference_hash_file_name = settings.reference_hash_file_name;
     string reference_fasta_file_name = settings.reference_fasta_file_name;
-    string command = "bowtie2-build -q " + settings.reference_fasta_file_name + " " + reference_hash_file_name;
-    SYSTEM(command);
-    settings.track_intermediate_file(settings.reference_alignment_done_file_name, settings.reference_hash_file_name + "*");
+    if (settings.bowtie2_index_cache_path.size()) {
+      // Shared with other runs, so it is never deleted as an intermediate
+      cBowtie2IndexCache index_cache(settings.bowtie2_index_cache_path, settings.installed["bowtie2_version_string"]);
+      reference_hash_file_name = index_cache.index(reference_fasta_file_name);
+    } else {
+      string command = "bowtie2-build -q " + settings.reference_fasta_file_name + " " + reference_hash_file_name;
+      SYSTEM(command);
+      settings.track_intermediate_file(settings.reference_alignment_done_file_name, settings.reference_hash_file_name + "*");
+    }
+
+    bool do_2_stage_alignment = settings.bowtie2_stage2.size() != 0;
+
+    // Read files are aligned at the same time, with the processors divided
+    // among them by file size. Stage 2 of each file starts as soon as its
+    // stage 1 is done, while other files may still be in stage 1.
+    vector<uint64_t> read_file_sizes;
+    for (uint32_t i = 0; i < settings.read_files.size(); i++) {
+      read_file_sizes.push_back(file_size(settings.base_name_to_read_file_name(settings.read_files[i].base_name())));
+    }
+    vector<uint32_t> num_alignment_threads = cJobScheduler::split_threads_by_size(read_file_sizes, settings.num_processors);
+    cJobScheduler alignment_jobs(settings.num_processors);
 
     ////// For each read_file
     for (uint32_t i = 0; i < settings.read_files.size(); i++)
@@ -1517,11 +1997,10 @@ int breseq_default_action(int argc, char* argv[])
       // STAGE 1 ALIGNMENT //
       ///////////////////////
       
-      bool do_2_stage_alignment = settings.bowtie2_stage2.size() != 0;
-      
       cReadFile read_file = settings.read_files[i];
       string base_read_file_name = read_file.base_name();
       string reference_sam_file_name = settings.file_name(settings.reference_sam_file_name, "#", base_read_file_name);
+      size_t stage1_job;
       
       { // local vars
 
@@ -1537,8 +2016,8 @@ int breseq_default_action(int argc, char* argv[])
         bowtie2_seed_substring_size_stringent = max<uint32_t>(9, bowtie2_seed_substring_size_stringent);
         bowtie2_seed_substring_size_stringent = min<uint32_t>(31, bowtie2_seed_substring_size_stringent);
         
-        string command = "bowtie2 -t --no-unal -p " + s(settings.num_processors) + " -L " +  to_string<uint32_t>(bowtie2_seed_substring_size_stringent) + " " + settings.bowtie2_scoring + " " + settings.bowtie2_stage1 + " --reorder -x " + reference_hash_file_name + " -U " + read_fastq_file + " -S " + (do_2_stage_alignment ? stage1_reference_sam_file_name + " --un " + stage1_unmatched_fastq_file_name : reference_sam_file_name);
-        SYSTEM(command);
+        string command = "bowtie2 -t --no-unal -p " + s(num_alignment_threads[i]) + " -L " +  to_string<uint32_t>(bowtie2_seed_substring_size_stringent) + " " + settings.bowtie2_scoring + " " + settings.bowtie2_stage1 + " --reorder -x " + reference_hash_file_name + " -U " + read_fastq_file + " -S " + (do_2_stage_alignment ? stage1_reference_sam_file_name + " --un " + stage1_unmatched_fastq_file_name : reference_sam_file_name);
+        stage1_job = alignment_jobs.add_job(num_alignment_threads[i], vector<size_t>(), [command]() { SYSTEM(command); });
         
         if (do_2_stage_alignment) {
           settings.track_intermediate_file(settings.reference_alignment_done_file_name, stage1_unmatched_fastq_file_name);
@@ -1555,6 +2034,8 @@ int breseq_default_action(int argc, char* argv[])
       /// align reads to reference sequences
       if (do_2_stage_alignment) {
         
+        size_t stage2_job;
+        
         { // local vars
         
           // If we are doing staged alignment -- only align the unmatched reads and save to different name initially
@@ -1566,8 +2047,8 @@ int breseq_default_action(int argc, char* argv[])
           bowtie2_seed_substring_size_relaxed = max<uint32_t>(9, bowtie2_seed_substring_size_relaxed);
           bowtie2_seed_substring_size_relaxed = min<uint32_t>(31, bowtie2_seed_substring_size_relaxed);
         
-          string command = "bowtie2 -t --no-unal -p " + s(settings.num_processors) + " -L " + to_string<uint32_t>(bowtie2_seed_substring_size_relaxed) + " " + settings.bowtie2_scoring + " " + settings.bowtie2_stage2 + " --reorder -x " + reference_hash_file_name + " -U " + read_fastq_file + " -S " + stage2_reference_sam_file_name;
-          SYSTEM(command);
+          string command = "bowtie2 -t --no-unal -p " + s(num_alignment_threads[i]) + " -L " + to_string<uint32_t>(bowtie2_seed_substring_size_relaxed) + " " + settings.bowtie2_scoring + " " + settings.bowtie2_stage2 + " --reorder -x " + reference_hash_file_name + " -U " + read_fastq_file + " -S " + stage2_reference_sam_file_name;
+          stage2_job = alignment_jobs.add_job(num_alignment_threads[i], make_vector<size_t>(stage1_job), [command]() { SYSTEM(command); });
           
           settings.track_intermediate_file(settings.reference_alignment_done_file_name, stage2_reference_sam_file_name);
         }
@@ -1581,15 +2062,14 @@ int breseq_default_action(int argc, char* argv[])
           
           string stage1_reference_sam_file_name = settings.file_name(settings.stage1_reference_sam_file_name, "#", base_read_file_name);
           string stage2_reference_sam_file_name = settings.file_name(settings.stage2_reference_sam_file_name, "#", base_read_file_name);
-          string reference_sam_file_name = settings.file_name(settings.reference_sam_file_name, "#", base_read_file_name);
-          string reference_fasta_file_name = settings.file_name(settings.reference_fasta_file_name, "#", base_read_file_name);
-          
-          PreprocessAlignments::merge_sort_sam_files(
-                                                     stage1_reference_sam_file_name,
-                                                     stage2_reference_sam_file_name,
-                                                     reference_sam_file_name
-                                                     );
           
+          alignment_jobs.add_job(1, make_vector<size_t>(stage2_job), [stage1_reference_sam_file_name, stage2_reference_sam_file_name, reference_sam_file_name]() {
+            PreprocessAlignments::merge_sort_sam_files(
+                                                       stage1_reference_sam_file_name,
+                                                       stage2_reference_sam_file_name,
+                                                       reference_sam_file_name
+                                                       );
+          });
           
         }
       } // end do_stage_2_alignment
@@ -1600,6 +2080,8 @@ int breseq_default_action(int argc, char* argv[])
       
     }
 
+    alignment_jobs.run();
+
 		settings.done_step(settings.reference_alignment_done_file_name);
 	}
 
@@ -1726,7 +2208,15 @@ int breseq_default_action(int argc, char* argv[])
         SYSTEM(command);
         settings.track_intermediate_file(settings.candidate_junction_alignment_done_file_name, candidate_junction_hash_file_name + "*");
 
-        /// align reads to candidate junction sequences
+        /// align reads to candidate junction sequences, with all read files
+        /// at the same time as for the reference alignment
+        vector<uint64_t> read_file_sizes;
+        for (uint32_t i = 0; i < settings.read_files.size(); i++) {
+          read_file_sizes.push_back(file_size(settings.base_name_to_read_file_name(settings.read_files[i].m_base_name)));
+        }
+        vector<uint32_t> num_alignment_threads = cJobScheduler::split_threads_by_size(read_file_sizes, settings.num_processors);
+        cJobScheduler alignment_jobs(settings.num_processors);
+
         for (uint32_t i = 0; i < settings.read_files.size(); i++)
         {
           string base_read_file_name = settings.read_files[i].m_base_name;
@@ -1744,13 +2234,15 @@ int breseq_default_action(int argc, char* argv[])
           bowtie2_seed_substring_size_junction = max<uint32_t>(9, bowtie2_seed_substring_size_junction);
           bowtie2_seed_substring_size_junction = min<uint32_t>(31, bowtie2_seed_substring_size_junction);
           
-          string command = "bowtie2 -t --no-unal -p " + s(settings.num_processors) + " --local " + " -L " + to_string<uint32_t>(bowtie2_seed_substring_size_junction) + " "
+          string command = "bowtie2 -t --no-unal -p " + s(num_alignment_threads[i]) + " --local " + " -L " + to_string<uint32_t>(bowtie2_seed_substring_size_junction) + " "
           + settings.bowtie2_scoring + " " + settings.bowtie2_junction + " --reorder -x " + candidate_junction_hash_file_name + " -U " + read_fastq_file + " -S " + candidate_junction_sam_file_name;
           
-          SYSTEM(command);
+          alignment_jobs.add_job(num_alignment_threads[i], vector<size_t>(), [command]() { SYSTEM(command); });
           
           settings.track_intermediate_file(settings.alignment_correction_done_file_name, candidate_junction_sam_file_name + "*");
         }
+
+        alignment_jobs.run();
       }
       
 			settings.done_step(settings.candidate_junction_alignment_done_file_name);
@@ -1977,6 +2469,14 @@ int breseq_default_action(int argc, char* argv[])
 	//# }
 	//#
 
+  //
+  // Steps 07 to 09 are run as a dependency graph, so that steps that do not
+  // depend on each other (such as plotting error rates and examining read
+  // alignment evidence) run at the same time.
+  //
+  
+  cStepScheduler scheduler(settings, settings.num_processors);
+  
   if (!settings.skip_read_alignment_and_missing_coverage_prediction)
   {
     
@@ -1984,7 +2484,9 @@ int breseq_default_action(int argc, char* argv[])
     // Tabulate error counts and coverage distribution at unique only sites
     //
 
-    if (settings.do_step(settings.error_counts_done_file_name, "Tabulating error counts"))
+    scheduler.add_step(settings.error_counts_done_file_name, "Tabulating error counts",
+                       vector<string>(), 1,
+                       [&]()
     {
       create_path(settings.error_calibration_path);
 
@@ -2014,9 +2516,7 @@ int breseq_default_action(int argc, char* argv[])
         settings.base_quality_cutoff, // minimum quality score
         "read_set=" + to_string(num_read_files) + ",obs_base,ref_base,quality=" + to_string(num_qual) // covariates
       );
-
-      settings.done_step(settings.error_counts_done_file_name);
-    }
+    });
 
 
     //
@@ -2026,7 +2526,9 @@ int breseq_default_action(int argc, char* argv[])
     create_path(settings.output_path); //need output for plots
     create_path(settings.output_calibration_path);
     
-    if (settings.do_step(settings.error_rates_done_file_name, "Re-calibrating base error rates"))
+    scheduler.add_step(settings.error_rates_done_file_name, "Re-calibrating base error rates",
+                       make_vector<string>(settings.error_counts_done_file_name), 1,
+                       [&]()
     {
       if (!settings.skip_missing_coverage_prediction) {
         CoverageDistribution::analyze_unique_coverage_distributions(
@@ -2120,6 +2622,22 @@ int breseq_default_action(int argc, char* argv[])
         }
         
       }
+
+      summary.unique_coverage.store(settings.error_rates_summary_file_name);
+    },
+                       [&]()
+    {
+      summary.unique_coverage.retrieve(settings.error_rates_summary_file_name);
+    });
+    
+    //
+    // Plot error rates, which only needs the error counts
+    //
+    
+    scheduler.add_step(settings.error_rates_plot_done_file_name, "Plotting base error rates",
+                       make_vector<string>(settings.error_counts_done_file_name), 1,
+                       [&]()
+    {
       string command;
       for (uint32_t i = 0; i<settings.read_files.size(); i++) {
         string base_name = settings.read_files[i].base_name();
@@ -2133,11 +2651,7 @@ int breseq_default_action(int argc, char* argv[])
           " > "        + cString(plot_error_rates_r_script_log_file_name).escape_shell_chars();
         SYSTEM(command,false, false, false); //NOTE: Not escaping shell characters here.
       }
-
-      summary.unique_coverage.store(settings.error_rates_summary_file_name);
-      settings.done_step(settings.error_rates_done_file_name);
-    }
-    summary.unique_coverage.retrieve(settings.error_rates_summary_file_name);
+    });
 
     //
     // 08 Mutation Identification
@@ -2146,7 +2660,9 @@ int breseq_default_action(int argc, char* argv[])
 
 		create_path(settings.mutation_identification_path);
 
-		if (settings.do_step(settings.mutation_identification_done_file_name, "Examining read alignment evidence"))
+    scheduler.add_step(settings.mutation_identification_done_file_name, "Examining read alignment evidence",
+                       make_vector<string>(settings.error_rates_done_file_name), 1,
+                       [&]()
 		{
 			string reference_fasta_file_name = settings.reference_fasta_file_name;
 			string reference_bam_file_name = settings.reference_bam_file_name;
@@ -2178,21 +2694,9 @@ int breseq_default_action(int argc, char* argv[])
         settings.polymorphism_precision_places,
 				settings.print_mutation_identification_per_position_file //per_position_file
 			);
-
-			settings.done_step(settings.mutation_identification_done_file_name);
-		}
-    // extra processing for polymorphisms / mixed-base prediction
-		if ( (settings.polymorphism_prediction || settings.mixed_base_prediction) && settings.do_step(settings.polymorphism_statistics_done_file_name, "Polymorphism statistics"))
-		{
-			ref_seq_info.polymorphism_statistics(settings, summary);
-			settings.done_step(settings.polymorphism_statistics_done_file_name);
-		}
+		});
 	}
 
-	//rewire which GenomeDiff we get data from if we have the elaborated polymorphism_statistics version
-  if (settings.polymorphism_prediction || settings.mixed_base_prediction)
-    settings.ra_mc_genome_diff_file_name = settings.polymorphism_statistics_ra_mc_genome_diff_file_name;
-
     /*
      * 09 Copy number variation
      * --------------------------------
@@ -2203,81 +2707,16 @@ int breseq_default_action(int argc, char* argv[])
     // Create copy_number_variation directory
     create_path( settings.copy_number_variation_path );
 
-    if (settings.do_step(settings.copy_number_variation_done_file_name, "Predicting copy number variation")) { 
-
-      for (cReferenceSequences::iterator it = ref_seq_info.begin(); it != ref_seq_info.end(); ++it) {
-
-        // Sequence iterator, one sequence at a time from .fastq file
-        cAnnotatedSequence& seq = *it;
-
-        // Create filename: [genome].coverage.txt, this is LONG file where the coverage data is coming from
-        string this_complete_coverage_text_file_name = settings.file_name(settings.complete_coverage_text_file_name, "@", seq.m_seq_id);
-
-        // Create filename: [genome].tiled.tab, this is LONG file where the tiled coverage data will be output
-        string this_tiled_complete_coverage_text_file_name = settings.file_name(settings.tiled_complete_coverage_text_file_name, "@", seq.m_seq_id);
-
-        // Create filename: [genome].tiled_for_edging.tab, this is where the tiled
-        // coverage data at a smaller tile_size will be output for use in improved
-        // edge detection (aka "edging")
-        string this_tiled_for_edging_text_file_name = settings.file_name(settings.tiled_for_edging_text_file_name, "@", seq.m_seq_id);
-
-        // Generates [genome].tiled.tab, one line at a time with each for-loop,
-        // where the avg coverage of each tile is calculated.
-        CoverageDistribution::tile(settings.ignore_redundant_coverage,
-                                   this_complete_coverage_text_file_name, // in_file_name
-                                   this_tiled_complete_coverage_text_file_name, // out_file_name
-                                   this_tiled_for_edging_text_file_name,
-                                   settings.copy_number_variation_tile_size);
-
-        // Create filename: [genome].ranges.tab, this is SHORT file used for ???
-        // (contains: Start_Position, End_Position, T_Score, P_Value)
-        string this_ranges_text_file_name = settings.file_name(settings.ranges_text_file_name, "@", seq.m_seq_id);
-
-        // Get filename: [genome].history.tab, this is SHORT file used for ???
-        // (contains: Start_Search, End_Search, Start_Position, End_Position, Start_Segment, End_Segment... 16 values total)
-        string this_cnv_history_text_file_name = settings.file_name(settings.cnv_history_text_file_name, "@", seq.m_seq_id);
-
-        // Generates [genome].ranges.tab & [genome].history.tab, one line at a time with each for-loop,
-        CoverageDistribution::find_segments(settings,
-                                            summary.unique_coverage[seq.m_seq_id].nbinom_mean_parameter,
-                                            this_tiled_complete_coverage_text_file_name,
-                                            this_tiled_for_edging_text_file_name, // tiled_for_edging_file_name (tiled_for_edging.tab)
-                                            this_ranges_text_file_name,
-                                            this_cnv_history_text_file_name
-                                            );
-        
-        // Create filename: [genome].smoothed_ranges.tab, this is LONG file used for ???
-        // (contains: Position, Smooth_Coverage)
-        string this_smoothed_ranges_text_file_name = settings.file_name(settings.smoothed_ranges_text_file_name, "@", seq.m_seq_id);
-
-        // Create filename: [genome].cnv_final.tab, this is SHORT file used for ???
-        // (contains: Start_Position, End_Position, Z_Score, Greater_Than, Copy_Number)
-        string this_final_cnv_file_name = settings.file_name(settings.final_cnv_text_file_name, "@", seq.m_seq_id);
-
-        // Create filename: [genome].cn_evidence.gd, this is SHORT file used for ???
-        // (contains no labels)
-        string this_copy_number_variation_cn_genome_diff_file_name = settings.file_name(settings.copy_number_variation_cn_genome_diff_file_name, "@", seq.m_seq_id);
-
-        // Generates [genome].smoothed_ranges.tab & [genome].cnv_final.tab & [genome].cn_evidence.gd,
-        // one line at a time with each for-loop,
-        CoverageDistribution::smooth_segments(settings,
-                                              seq.m_seq_id,
-                                              summary.unique_coverage[seq.m_seq_id].nbinom_mean_parameter, 
-                                              this_tiled_for_edging_text_file_name, 
-                                              this_ranges_text_file_name, 
-                                              this_smoothed_ranges_text_file_name,
-                                              this_final_cnv_file_name,
-                                              this_copy_number_variation_cn_genome_diff_file_name
-                                              );
-
-      } // End of foreach reference loop
-      
-      
-      settings.done_step(settings.copy_number_variation_done_file_name);
-                       
-    } // End of if cnv done file
+    scheduler.add_step(settings.copy_number_variation_done_file_name, "Predicting copy number variation",
+                       make_vector<string>(settings.mutation_identification_done_file_name), settings.num_processors,
+                       [&]()
+    {
+      copy_number_variation(settings, summary, ref_seq_info);
+    });
   
   } // End of if do_cnv
+  
+  scheduler.run();
 
    
   create_path(settings.evidence_path); //need output for plots
@@ -2386,10 +2825,6 @@ int breseq_default_action(int argc, char* argv[])
     cerr << "  Writing final VCF file..." << endl;
     mpgd.write_vcf(settings.output_vcf_file_name, ref_seq_info);
     
-    // Write a final JSON file with all summary information
-    PublicSummary public_summary(summary, settings, ref_seq_info);
-    public_summary.store(settings.data_summary_file_name);
-    
     //
     // Mark marginal items as no_show to prevent further processing
     //
@@ -2436,10 +2871,16 @@ int breseq_default_action(int argc, char* argv[])
 		// record the final time and print summary table
 		settings.record_end_time("Output");
 
+    // Write a final JSON file with all summary information, now that the
+    // execution times include this step
+    PublicSummary public_summary(summary, settings, ref_seq_info);
+    public_summary.store(settings.data_summary_file_name);
+
 		output::html_summary(settings.summary_html_file_name, settings, summary, ref_seq_info);
 
 		settings.done_step(settings.output_done_file_name);
 	}
+  cTrace::close();
   cerr << "+++   SUCCESSFULLY COMPLETED" << endl;
 
   
@@ -2510,6 +2951,10 @@ int main(int argc, char* argv[]) {
     return do_bam2aln( argc_new, argv_new);  
   } else if (command == "BAM2COV") {
     return do_bam2cov( argc_new, argv_new);
+
+  // Multiple Sample Commands:
+  } else if (command == "BATCH") {
+    return do_batch(argc_new, argv_new);
     
     
   // Experimental and Development Commands:
@@ -2522,6 +2967,8 @@ int main(int argc, char* argv[]) {
     return do_copy_number_variation(argc_new, argv_new);
   } else if (command == "COVERAGE-BIAS"){
     return do_coverage_bias(argc_new, argv_new);
+  } else if (command == "COVERAGE-DISTRIBUTION"){
+    return do_coverage_distribution(argc_new, argv_new);
   } else if (command == "ERROR_COUNT") {
     return do_error_count(argc_new, argv_new);
   } else if (command == "JUNCTION-POLYMORPHISM") {
@@ -2532,6 +2979,8 @@ int main(int argc, char* argv[]) {
     return do_analyze_contingency_loci_significance( argc_new, argv_new);
   } else if (command == "ASSEMBLE-UNMATCHED") {
     return do_assemble_unmatched( argc_new, argv_new);
+  } else if (command == "TEST-SCHEDULER") {
+    return do_test_scheduler( argc_new, argv_new);
   }
   else {
     // Not a sub-command. Use original argument list.
@@ -31,8 +31,8 @@ const uint32_t k_max_repeat_length = 18;
 /*
 calc_trims
 
-Currently each reference sequence is loaded entirely into memory, 
-which isn't necessary.
+Each reference sequence is read a window at a time (plus enough bases past
+it to find the longest trim) rather than loaded entirely into memory.
 */
 
 
@@ -65,21 +65,44 @@ void calculate_trims_1 ( const string& _in_seq, const string& in_output_filename
 SequenceTrims::SequenceTrims(const string& _in_seq) 
 : trim_data(NULL), m_length(0) 
 {
+  allocate(_in_seq.length());
+  add_window(_in_seq, 0, m_length);
+}
 
-  //cerr << _in_seq.length() << endl;
-    
+SequenceTrims::SequenceTrims(const cFastaSequence& _in_seq)
+: trim_data(NULL), m_length(0)
+{
+  allocate(_in_seq.get_sequence_length());
+  
+  string window;
+  for (uint32_t start_0=0; start_0<m_length; start_0+=k_window_length) {
+    uint32_t num_positions = min(k_window_length, m_length - start_0);
+    uint32_t end_0 = min(start_0 + num_positions + k_lookahead, m_length) - 1;
+    _in_seq.get_sequence_1(start_0 + 1, end_0 + 1, window);
+    add_window(window, start_0, num_positions);
+  }
+}
+
+void SequenceTrims::allocate(uint32_t length)
+{
+  if (trim_data) delete[] trim_data;
+  
   // use one structure to avoid byte alignment issues when writing
-  trim_data = new unsigned char[2*_in_seq.length()];
-  m_length = _in_seq.length();
+  trim_data = new unsigned char[2*length];
+  m_length = length;
 
   assert(trim_data != NULL);
   memset( trim_data, 0, 2*m_length );
-  
+}
+
+void SequenceTrims::add_window(const string& window, uint32_t start_0, uint32_t num_positions)
+{
   const uint32_t left_trim_offset = 0;
   const uint32_t right_trim_offset = m_length;
   
-
-  for (uint32_t pos_0=0; pos_0<m_length; pos_0++) {
+  for (uint32_t window_pos_0=0; window_pos_0<num_positions; window_pos_0++) {
+    
+    uint32_t pos_0 = start_0 + window_pos_0;
     
     // always trim at least one bp
     uint32_t max_trim_length = 1;
@@ -87,8 +110,9 @@ SequenceTrims::SequenceTrims(const string& _in_seq)
     //compare starting at this nucleotide
     for (uint32_t repeat_size=1; repeat_size<=k_max_repeat_length; repeat_size++) {
       
+      // stop at the longest trim that is kept
       unsigned int repeat_num = 1;
-      while (repeat_match(_in_seq, pos_0, repeat_size, repeat_num) ) {
+      while ( (repeat_num * repeat_size < 255) && repeat_match(window, window_pos_0, repeat_size, repeat_num) ) {
         repeat_num++;
       }
     
@@ -108,7 +132,7 @@ SequenceTrims::SequenceTrims(const string& _in_seq)
   
     // update relevant trims
     for (int32_t offset=0; offset<add_max_trim_length; offset++) {
-      if (pos_0 + offset >= _in_seq.length()) continue;
+      if (pos_0 + offset >= m_length) continue;
       
       uint8_t this_trim = offset + 1;
       //cerr << (right_trim_offset + pos + offset) << " " << (int)(this_trim) << " " << (int)(trim[right_trim_offset + pos + offset]) << endl;
@@ -116,23 +140,13 @@ SequenceTrims::SequenceTrims(const string& _in_seq)
     }
  
     for (int32_t offset=add_max_trim_length; offset>=0; offset--) {
-      if (pos_0 + offset >= _in_seq.length()) continue;
+      if (pos_0 + offset >= m_length) continue;
 
       uint8_t this_trim = add_max_trim_length - offset;      
       //cerr << (left_trim_offset + pos + offset) << " " << (int)(this_trim) << " " << int(trim[left_trim_offset + pos + offset]) << endl;
       trim_data[left_trim_offset + pos_0 + offset] = max(this_trim, trim_data[left_trim_offset + pos_0 + offset]);
     }
-    
-    
-    // debug
-    //if (pos == 10000) break;
   }
-
-//debugging...
-//  for (uint32_t i=0; i<_in_seq.length(); i++)
-//  {
-//    cerr << (i+1) << " " << (int)left_trim[i] << " " << (int)right_trim[i] << endl;
-//  }
 }
 
 void calculate_trims( const string& in_fasta, const string& in_output_path) {
@@ -151,29 +165,40 @@ void calculate_trims( const string& in_fasta, const string& in_output_path) {
   assert(fasta_index);
 
 
-	// load all the reference sequences:
+	// read each reference sequence a window at a time:
 	for(int32_t i=0; i<nseq; ++i) {
 
 		cerr << "  REFERENCE: " << bam_header->target_name[i] << endl;
 		cerr << "  LENGTH: " << bam_header->target_len[i] << endl;
     
-    int len;
-    const char* cseq = fai_fetch(fasta_index, bam_header->target_name[i], &len);
+    uint32_t seq_length = bam_header->target_len[i];
+    assert(seq_length > 0);
     
-    assert(cseq);
-    assert(len > 0);
-    assert(static_cast<unsigned int>(len) == bam_header->target_len[i]);
+    SequenceTrims trims;
+    trims.allocate(seq_length);
     
-    const string seq(cseq);
+    for (uint32_t start_0=0; start_0<seq_length; start_0+=SequenceTrims::k_window_length) {
+      uint32_t num_positions = min(SequenceTrims::k_window_length, seq_length - start_0);
+      uint32_t end_0 = min(start_0 + num_positions + SequenceTrims::k_lookahead, seq_length) - 1;
+      
+      int len;
+      char* cseq = faidx_fetch_seq(fasta_index, bam_header->target_name[i], start_0, end_0, &len);
+      assert(cseq);
+      assert(static_cast<uint32_t>(len) == end_0 - start_0 + 1);
+      
+      trims.add_window(string(cseq, len), start_0, num_positions);
+      free(cseq);
+    }
     
     string output_filename(in_output_path);
     output_filename += "/";
     output_filename += bam_header->target_name[i];
     output_filename += ".trims";
 
-    calculate_trims_1(seq, output_filename);
+    trims.WriteFile(output_filename);
 	}
   
+  fai_destroy(fasta_index);
   bam_header_destroy(bam_header);
 }
 
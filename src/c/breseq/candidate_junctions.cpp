@@ -22,6 +22,7 @@ LICENSE AND COPYRIGHT
 
 #include "libbreseq/fastq.h"
 #include "libbreseq/nw.h"
+#include "libbreseq/trace.h"
 
 using namespace std;
 
@@ -246,21 +247,90 @@ namespace breseq {
     return;
   }
   
-  void line_to_read_index(string s, int64_t& index, bool& mapped) {
-    size_t start = s.find_first_of(":");
-    size_t end = s.find_first_of(" \t", start);
-    index = n(s.substr(start+1, end-(start+1)));
+  // Reads lines from a file through a large buffer. Each line is returned as
+  // a pointer into the buffer, valid until the next call, so nothing is
+  // copied or allocated per line.
+  class SamLineReader {
+  public:
+    SamLineReader(const string& file_name, size_t buffer_size = 1 << 22)
+      : m_file(fopen(file_name.c_str(), "rb")), m_buffer(buffer_size), m_begin(0), m_end(0), m_eof(false)
+    {
+      ASSERT(m_file, "Could not open file for reading: " + file_name);
+    }
     
-    size_t next = s.find_first_not_of(" \t", end);
-    next = s.find_first_of(" \t", next);
-    next = s.find_first_not_of(" \t", next);
-
-    mapped = (s[next] != '*');
+    ~SamLineReader() { fclose(m_file); }
     
+    // Returns false when there are no more lines
+    bool next_line(const char*& line, size_t& length)
+    {
+      while (true) {
+        char* newline = static_cast<char*>(memchr(&m_buffer[m_begin], '\n', m_end - m_begin));
+        if (newline) {
+          line = &m_buffer[m_begin];
+          length = newline - line;
+          m_begin += length + 1;
+          return true;
+        }
+        
+        if (m_eof) {
+          // Last line without a newline at the end of the file
+          if (m_begin == m_end) return false;
+          line = &m_buffer[m_begin];
+          length = m_end - m_begin;
+          m_begin = m_end;
+          return true;
+        }
+        
+        // Move the partial line to the front, growing the buffer if it is full
+        m_end -= m_begin;
+        memmove(&m_buffer[0], &m_buffer[m_begin], m_end);
+        m_begin = 0;
+        if (m_end == m_buffer.size()) m_buffer.resize(2 * m_buffer.size());
+        
+        size_t bytes_read = fread(&m_buffer[m_end], 1, m_buffer.size() - m_end, m_file);
+        m_end += bytes_read;
+        if (bytes_read == 0) m_eof = true;
+      }
+    }
+    
+  private:
+    FILE* m_file;
+    vector<char> m_buffer;
+    size_t m_begin, m_end;
+    bool m_eof;
+  };
+  
+  // Reads the next alignment line (skipping any header lines) and parses the
+  // read index from its name (file_num:read_num) and whether it is mapped.
+  bool next_alignment_line(SamLineReader& in, const char*& line, size_t& length, int64_t& index, bool& mapped)
+  {
+    do {
+      if (!in.next_line(line, length)) return false;
+    } while ((length == 0) || (line[0] == '@'));
+    
+    const char* end = line + length;
+    const char* p = static_cast<const char*>(memchr(line, ':', length));
+    ASSERT(p, "Could not find read index in SAM line:\n" + string(line, length));
+    
+    index = 0;
+    for (p++; (p < end) && (*p >= '0') && (*p <= '9'); p++) {
+      index = index * 10 + (*p - '0');
+    }
+    
+    // Skip the rest of the name and the flag to reach the reference name
+    for (uint32_t field = 0; field < 2; field++) {
+      while ((p < end) && (*p != ' ') && (*p != '\t')) p++;
+      while ((p < end) && ((*p == ' ') || (*p == '\t'))) p++;
+    }
+    
+    mapped = (p < end) && (*p != '*');
+    return true;
   }
   
   // Takes two SAM files and re-sorts read order so that it matches the original FASTQ file.
   // Requires reads to be renamed as we expect from 01_sequence_onversion: file_num/read_num.
+  // Lines are copied straight from the input buffers to a buffered output, without parsing
+  // alignments or flushing each line.
   void PreprocessAlignments::merge_sort_sam_files(
                                                   string input_sam_file_name_1,
                                                   string input_sam_file_name_2,
@@ -270,33 +340,25 @@ namespace breseq {
     
     // Beware of potential crash here on simulated data if 2nd stage alignment file is empty 
     // (because all reads mapped in the first stage)
-    ifstream input_sam_file_1(input_sam_file_name_1.c_str());
-    ifstream input_sam_file_2(input_sam_file_name_2.c_str());
-
-    ofstream out_sam_file(output_sam_file_name.c_str());
-    
-    string line_1, line_2;
-    bool not_done_1 = !getline(input_sam_file_1, line_1).eof();
-    while (not_done_1 && (line_1[0] == '@')) {
-      not_done_1 = !getline(input_sam_file_1, line_1).eof();
-    }
-    
-    bool not_done_2 = !getline(input_sam_file_2, line_2).eof();
-    while (not_done_2 && (line_2[0] == '@')) {
-      not_done_2 = !getline(input_sam_file_2, line_2).eof();
-    }
-         
+    SamLineReader input_sam_file_1(input_sam_file_name_1);
+    SamLineReader input_sam_file_2(input_sam_file_name_2);
+
+    FILE* out_sam_file = fopen(output_sam_file_name.c_str(), "wb");
+    ASSERT(out_sam_file, "Could not open file for writing: " + output_sam_file_name);
+    vector<char> out_buffer(1 << 22);
+    setvbuf(out_sam_file, &out_buffer[0], _IOFBF, out_buffer.size());
+    
+    const char* line_1 = NULL;
+    const char* line_2 = NULL;
+    size_t length_1 = 0;
+    size_t length_2 = 0;
     int64_t index_1 = -1; 
     int64_t index_2 = -1; 
     bool mapped_1 = false;
     bool mapped_2 = false;
     
-    if (not_done_1) {
-      line_to_read_index(line_1, index_1, mapped_1);
-    }
-    if (not_done_2) {
-      line_to_read_index(line_2, index_2, mapped_2);
-    }
+    bool not_done_1 = next_alignment_line(input_sam_file_1, line_1, length_1, index_1, mapped_1);
+    bool not_done_2 = next_alignment_line(input_sam_file_2, line_2, length_2, index_2, mapped_2);
     
     while (not_done_1 || not_done_2) {
       
@@ -304,32 +366,27 @@ namespace breseq {
       //   the read index is smaller in file 1 than in file 2 OR file 2 is already done
       if (not_done_1 && ((index_1 < index_2) || !not_done_2)) {
         
-        if (mapped_1)
-          out_sam_file << line_1 << endl;
-        
-        // read next line not beginning in @
-        not_done_1 = !getline(input_sam_file_1, line_1).eof();
-        
-        if (not_done_1) {
-          line_to_read_index(line_1, index_1, mapped_1);
-        } else {
-          index_1 = numeric_limits<int64_t>::max();
+        if (mapped_1) {
+          fwrite(line_1, 1, length_1, out_sam_file);
+          fputc('\n', out_sam_file);
         }
+        
+        not_done_1 = next_alignment_line(input_sam_file_1, line_1, length_1, index_1, mapped_1);
+        if (!not_done_1) index_1 = numeric_limits<int64_t>::max();
       }
       else if (not_done_2) {
-        if (mapped_2)
-          out_sam_file << line_2 << endl;
         
-        // read next line
-        not_done_2 = !getline(input_sam_file_2, line_2).eof();
-
-        if (not_done_2) {
-          line_to_read_index(line_2, index_2, mapped_2);
-        } else {
-          index_2 = numeric_limits<int64_t>::max();
+        if (mapped_2) {
+          fwrite(line_2, 1, length_2, out_sam_file);
+          fputc('\n', out_sam_file);
         }
+        
+        not_done_2 = next_alignment_line(input_sam_file_2, line_2, length_2, index_2, mapped_2);
+        if (!not_done_2) index_2 = numeric_limits<int64_t>::max();
       }
     }
+    
+    ASSERT(fclose(out_sam_file) == 0, "Error writing file: " + output_sam_file_name);
   }
   
   /*
@@ -543,6 +600,8 @@ namespace breseq {
 	{
 		(void)summary; // TO DO: save statistics
     bool verbose = false;
+
+    TRACE_SCOPE(trace, "identify_candidate_junctions examine alignments");
     int32_t read_length_max = summary.sequence_conversion.read_length_max;
     
     /// Load all of the user-defined junctions
@@ -577,6 +636,7 @@ namespace breseq {
         if (alignments.size() == 0)
           break;
         
+        TRACE_COUNT("reads", 1);
         if (++i % 10000 == 0)
           cerr << "    ALIGNED READ:" << i << " CANDIDATE JUNCTIONS:" << candidate_junctions.size() << endl;
         
@@ -603,6 +663,8 @@ namespace breseq {
       cerr << "  WARNING: Reached limit of " << settings.maximum_junction_sequence_passed_alignment_pairs_to_consider << " passed alignment pairs." << endl;
       cerr << "  Specify a greater value for --junction-alignment-pair-limit for more thorough junction prediction." << endl;
     }
+    TRACE_NEXT(trace, "identify_candidate_junctions merge");
+
     ///
 		// Merge all junctions with the same exact sequence 
     //   * They are hashed together for speed in this comparison
@@ -776,6 +838,8 @@ namespace breseq {
     //   (3) But take at least some minimum despite these
 		///
     
+		TRACE_NEXT(trace, "identify_candidate_junctions select");
+
 		cerr << "  Taking top candidate junctions..." << endl;
     
 		// adding up the lengths might be too time-consuming to be worth it...
@@ -989,6 +1053,8 @@ namespace breseq {
     
 		sort(combined_candidate_junctions.begin(), combined_candidate_junctions.end(), JunctionCandidate::sort_by_ref_seq_coord);
     
+    TRACE_NEXT(trace, "identify_candidate_junctions write");
+
     cFastaFile out(settings.candidate_junction_fasta_file_name, ios_base::out);
     ofstream detailed;
     if (settings.junction_debug) {
@@ -990,6 +990,92 @@ namespace breseq {
     return( incbet( dn, dk, p ) );
   }  
   
+  // Smallest k such that pnbinom(k, size, mu) >= p, matching qnbinom() in R
+  // (including its fuzz factor to ensure left continuity).
+  double qnbinom(double p, double size, double mu)
+  {
+    ASSERT( (p >= 0.0) && (p < 1.0) && (size > 0) && (mu > 0), "Domain error in qnbinom" );
+    
+    p *= 1 - 64 * numeric_limits<double>::epsilon();
+    if (pnbinom(0, size, mu) >= p) return 0;
+    
+    // Bracket the answer between lo (too small) and hi (large enough)
+    double lo = 0;
+    double hi = max(1.0, floor(mu));
+    while (pnbinom(hi, size, mu) < p) {
+      lo = hi;
+      hi *= 2;
+    }
+    
+    while (hi - lo > 1) {
+      double mid = floor((lo + hi) / 2);
+      if (pnbinom(mid, size, mu) >= p)
+        hi = mid;
+      else
+        lo = mid;
+    }
+    return hi;
+  }
+  
+  // The margins fix the hypergeometric distribution of a. Probabilities are
+  // compared with R's relative tolerance so tables that tie the observed one count.
+  double fisher_exact_test(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+  {
+    double m = static_cast<double>(a) + c;  // first column total
+    double n = static_cast<double>(b) + d;  // second column total
+    double k = static_cast<double>(a) + b;  // first row total
+    
+    uint32_t lo = static_cast<uint32_t>(max(0.0, k - n));
+    uint32_t hi = static_cast<uint32_t>(min(k, m));
+    
+    // Relative log probabilities using dhyper(x+1) / dhyper(x) = (m - x)(k - x) / ((x + 1)(n - k + x + 1)).
+    // The first pass finds the maximum (to avoid underflow) and the value of the observed table.
+    double log_d = 0.0;
+    double max_log_d = 0.0;
+    double observed_log_d = 0.0;
+    for (uint32_t x = lo; x <= hi; x++) {
+      if (x > lo) log_d += log((m - x + 1) * (k - x + 1) / (x * (n - k + x)));
+      if (x == a) observed_log_d = log_d;
+      max_log_d = max(max_log_d, log_d);
+    }
+    
+    const double relative_error = 1 + 1E-7;
+    double observed_d = exp(observed_log_d - max_log_d) * relative_error;
+    double total = 0.0;
+    double p_value = 0.0;
+    log_d = 0.0;
+    for (uint32_t x = lo; x <= hi; x++) {
+      if (x > lo) log_d += log((m - x + 1) * (k - x + 1) / (x * (n - k + x)));
+      double this_d = exp(log_d - max_log_d);
+      total += this_d;
+      if (this_d <= observed_d) p_value += this_d;
+    }
+    
+    return max(0.0, min(1.0, p_value / total));
+  }
+  
+  // The statistic is the largest amount by which the empirical CDF of y exceeds
+  // that of x, checked only after all values tied at each point.
+  double ks_test_less(vector<double> x, vector<double> y)
+  {
+    ASSERT(x.size() && y.size(), "Kolmogorov-Smirnov test requires values in both samples");
+    
+    sort(x.begin(), x.end());
+    sort(y.begin(), y.end());
+    
+    double statistic = 0.0;
+    size_t i = 0, j = 0;
+    while ((i < x.size()) || (j < y.size())) {
+      double value = (j == y.size()) || ((i < x.size()) && (x[i] <= y[j])) ? x[i] : y[j];
+      while ((i < x.size()) && (x[i] == value)) i++;
+      while ((j < y.size()) && (y[j] == value)) j++;
+      statistic = max(statistic, static_cast<double>(j) / y.size() - static_cast<double>(i) / x.size());
+    }
+    
+    double n = static_cast<double>(x.size()) * y.size() / (x.size() + y.size());
+    return max(0.0, min(1.0, exp(-2 * n * statistic * statistic)));
+  }
+  
   /*							nbdtr.c
    *
    *	Functional inverse of negative binomial distribution
@@ -21,20 +21,369 @@
 
 #include "libbreseq/coverage_distribution.h"
 
+#include "libbreseq/chisquare.h"
+#include "libbreseq/coverage_profile.h"
+
 #include "libbreseq/genome_diff.h"
 
 using namespace std;
 
 namespace breseq {
+
+// Least-squares fit of a negative binomial to the counts within the censored
+// window [start_i, end_i] after normalizing each to sum to one (f_nb in coverage_distribution.r).
+class cNegativeBinomialCensoredFit
+{
+public:
+  cNegativeBinomialCensoredFit(const vector<double>& counts, uint32_t start_i, uint32_t end_i)
+  : m_counts(counts), m_start_i(start_i), m_end_i(end_i), m_inner_total(0.0), m_dist(end_i - start_i + 1)
+  {
+    for (uint32_t i = start_i; i <= end_i; i++) {
+      m_inner_total += counts[i];
+    }
+  }
+  
+  double inner_total() const { return m_inner_total; }
+  
+  // Squared error for the parameters (log(mu), log(size))
+  double error(const double* log_parameters)
+  {
+    // Beyond this size the distribution is indistinguishable from Poisson
+    if (log_parameters[1] > s_max_log_size) return numeric_limits<double>::infinity();
+    
+    double mu = exp(log_parameters[0]);
+    double size = exp(log_parameters[1]);
+    
+    // Relative probabilities using dnbinom(i) / dnbinom(i-1) = (i - 1 + size) / i * mu / (size + mu)
+    double log_ratio = log(mu / (size + mu));
+    double log_d = 0.0;
+    double max_log_d = 0.0;
+    for (uint32_t i = m_start_i; i <= m_end_i; i++) {
+      if (i > m_start_i) log_d += log((i - 1 + size) / i) + log_ratio;
+      m_dist[i - m_start_i] = log_d;
+      max_log_d = max(max_log_d, log_d);
+    }
+    
+    double total = 0.0;
+    for (uint32_t i = m_start_i; i <= m_end_i; i++) {
+      m_dist[i - m_start_i] = exp(m_dist[i - m_start_i] - max_log_d);
+      total += m_dist[i - m_start_i];
+    }
+    
+    double l = 0.0;
+    for (uint32_t i = m_start_i; i <= m_end_i; i++) {
+      double diff = m_counts[i] / m_inner_total - m_dist[i - m_start_i] / total;
+      l += diff * diff;
+    }
+    return l;
+  }
+  
+  // Nelder-Mead simplex minimization over log(mu) and log(size), which keeps both
+  // parameters positive. Starts from and updates mu and size. Returns false if it did not converge.
+  bool minimize(double& mu, double& size)
+  {
+    double simplex[3][2] = { { log(mu), log(size) }, { log(mu) + 0.1, log(size) }, { log(mu), log(size) - 0.5 } };
+    double values[3];
+    for (uint32_t v = 0; v < 3; v++) values[v] = error(simplex[v]);
+    
+    bool converged = false;
+    for (uint32_t iteration = 0; iteration < s_max_iterations; iteration++) {
+      
+      // Order vertices: best (0), next worst (1), worst (2)
+      for (uint32_t a = 0; a < 2; a++) {
+        for (uint32_t b = a + 1; b < 3; b++) {
+          if (values[b] < values[a]) {
+            swap(values[a], values[b]);
+            swap(simplex[a][0], simplex[b][0]);
+            swap(simplex[a][1], simplex[b][1]);
+          }
+        }
+      }
+      
+      double spread = 0.0;
+      for (uint32_t v = 1; v < 3; v++) {
+        spread = max(spread, max(fabs(simplex[v][0] - simplex[0][0]), fabs(simplex[v][1] - simplex[0][1])));
+      }
+      if (spread < s_tolerance) {
+        converged = true;
+        break;
+      }
+      
+      double centroid[2] = { (simplex[0][0] + simplex[1][0]) / 2, (simplex[0][1] + simplex[1][1]) / 2 };
+      double reflected[2] = { 2 * centroid[0] - simplex[2][0], 2 * centroid[1] - simplex[2][1] };
+      double reflected_value = error(reflected);
+      
+      if (reflected_value < values[0]) {
+        double expanded[2] = { 3 * centroid[0] - 2 * simplex[2][0], 3 * centroid[1] - 2 * simplex[2][1] };
+        double expanded_value = error(expanded);
+        if (expanded_value < reflected_value) {
+          replace_worst(simplex, values, expanded, expanded_value);
+        } else {
+          replace_worst(simplex, values, reflected, reflected_value);
+        }
+        continue;
+      }
+      
+      if (reflected_value < values[1]) {
+        replace_worst(simplex, values, reflected, reflected_value);
+        continue;
+      }
+      
+      // Contract toward the better of the worst vertex and its reflection
+      const double* from = (reflected_value < values[2]) ? reflected : simplex[2];
+      double contracted[2] = { (centroid[0] + from[0]) / 2, (centroid[1] + from[1]) / 2 };
+      double contracted_value = error(contracted);
+      if (contracted_value < min(reflected_value, values[2])) {
+        replace_worst(simplex, values, contracted, contracted_value);
+        continue;
+      }
+      
+      // Shrink toward the best vertex
+      for (uint32_t v = 1; v < 3; v++) {
+        simplex[v][0] = (simplex[0][0] + simplex[v][0]) / 2;
+        simplex[v][1] = (simplex[0][1] + simplex[v][1]) / 2;
+        values[v] = error(simplex[v]);
+      }
+    }
+    
+    mu = exp(simplex[0][0]);
+    size = exp(simplex[0][1]);
+    return converged && isfinite(values[0]);
+  }
+  
+private:
+  
+  static void replace_worst(double simplex[3][2], double values[3], const double* point, double value)
+  {
+    simplex[2][0] = point[0];
+    simplex[2][1] = point[1];
+    values[2] = value;
+  }
+  
+  static const uint32_t s_max_iterations = 5000;
+  static constexpr double s_tolerance = 1E-10;
+  static constexpr double s_max_log_size = 13.815510557964274; // log(1E6)
+  
+  const vector<double>& m_counts;
+  uint32_t m_start_i, m_end_i;
+  double m_inner_total;
+  vector<double> m_dist;
+};
+
 /*! fit
- @abstract Function for the interaction with R using the script coverage_distribution.r
+ @abstract Fits a negative binomial to the unique-only coverage distribution, censored around its peak.
+ @param distribution_file_name Input created by error_count() and saved as *.unique_only_coverage_distribution.tab
+ @param deletion_propagation_pr_cutoff Tail probability used to choose the deletion propagation coverage
+ @param fit Filled in with the fit parameters, the uncensored statistics, and the deletion cutoff
+ 
+ Follows the same steps as coverage_distribution.r, which was previously run to
+ perform this fit. Size and mean are zero if the fit failed.
+ !*/
+
+void CoverageDistribution::fit(
+                               const string& distribution_file_name,
+                               double deletion_propagation_pr_cutoff,
+                               CoverageSummary& fit
+                               )
+{
+  fit.nbinom_size_parameter = 0;
+  fit.nbinom_mean_parameter = 0;
+  fit.nbinom_prob_parameter = 0;
+  fit.nbinom_variance = 0;
+  fit.nbinom_dispersion = 0;
+  fit.average = 0;
+  fit.variance = 0;
+  fit.dispersion = 0;
+  fit.deletion_coverage_propagation_cutoff = -1;
+  
+  // Load data: rows are coverage = 1, 2, 3 ... so that n[coverage] is the number of positions
+  vector<double> n(1, 0.0);
+  ifstream in(distribution_file_name.c_str());
+  ASSERT(in.good(), "Could not open file: " + distribution_file_name);
+  string line;
+  getline(in, line); // header
+  while (getline(in, line)) {
+    if (line.empty()) continue;
+    vector<string> split_line = split(line, "\t");
+    ASSERT((split_line.size() == 2) && (from_string<uint32_t>(split_line[0]) == n.size()),
+           "Unexpected line in coverage distribution file: " + distribution_file_name + "\n" + line);
+    n.push_back(from_string<double>(split_line[1]));
+  }
+  uint32_t num_rows = n.size() - 1;
+  
+  // Statistics of the full (uncensored) distribution
+  double total_total = 0.0;
+  double sum = 0.0;
+  for (uint32_t i = 1; i <= num_rows; i++) {
+    total_total += n[i];
+    sum += i * n[i];
+  }
+  
+  // Table might be empty (or have too few positions for a variance)
+  if (total_total < 2) return;
+  
+  double m = sum / total_total;
+  double sum_sq = 0.0;
+  for (uint32_t i = 1; i <= num_rows; i++) {
+    sum_sq += n[i] * (i - m) * (i - m);
+  }
+  double v = sum_sq / (total_total - 1);
+  fit.average = m;
+  fit.variance = v;
+  fit.dispersion = v / m;
+  
+  // Smooth the distribution with a moving average window of size 5
+  // so that we can more reliably find its maximum value
+  vector<double> ma(n);
+  vector<bool> ma_defined(num_rows + 1, true);
+  if (num_rows >= 5) {
+    for (uint32_t i = 1; i <= num_rows; i++) {
+      if ((i < 3) || (i + 2 > num_rows)) {
+        ma_defined[i] = false;
+        continue;
+      }
+      ma[i] = (n[i-2] + n[i-1] + n[i] + n[i+1] + n[i+2]) / 5;
+    }
+  }
+  
+  double max_n = 0;
+  uint32_t max_i = 0;
+  uint32_t min_i = max(static_cast<uint32_t>(trunc(m / 4)), 1u); // prevents zero for pathological distributions
+  for (uint32_t i = min(min_i, num_rows); i <= max(min_i, num_rows); i++) {
+    if ((i <= num_rows) && ma_defined[i] && (ma[i] > max_n)) {
+      max_n = ma[i];
+      max_i = i;
+    }
+  }
+  
+  // Censor data on the right and left of the maximum
+  uint32_t start_i = max(static_cast<uint32_t>(floor(max_i * 0.5)), 1u);
+  uint32_t end_i = min(static_cast<uint32_t>(ceil(max_i * 1.5)), num_rows);
+  
+  if (start_i >= end_i) return;
+  
+  // Coarse grain so that we are only fitting a number of bins that is 1000-2000.
+  // Means are multiplied by the binning number afterward; the size parameter is unchanged.
+  uint32_t num_per_bin = (end_i - start_i) / 1000;
+  uint32_t start_i_for_fits = start_i;
+  uint32_t end_i_for_fits = end_i;
+  vector<double> counts_for_fits(n.begin(), n.begin() + end_i + 1);
+  if (num_per_bin > 1) {
+    start_i_for_fits = max(start_i / num_per_bin, 1u);
+    end_i_for_fits = static_cast<uint32_t>(ceil(static_cast<double>(end_i) / num_per_bin));
+    counts_for_fits.assign(end_i_for_fits + 1, 0.0);
+    for (uint32_t i = start_i_for_fits; i <= end_i_for_fits; i++) {
+      for (uint32_t j = 1; j <= num_per_bin; j++) {
+        if (i * num_per_bin + j <= num_rows) {
+          counts_for_fits[i] += n[i * num_per_bin + j];
+        }
+      }
+    }
+  } else {
+    num_per_bin = 1;
+  }
+  
+  cNegativeBinomialCensoredFit nb_fit(counts_for_fits, start_i_for_fits, end_i_for_fits);
+  
+  double nb_fit_mu = 0;
+  double nb_fit_size = 0;
+  if (nb_fit.inner_total() > 0) {
+    double weighted_sum = 0.0;
+    double counts_sum = 0.0;
+    for (uint32_t i = 1; i <= end_i_for_fits; i++) {
+      weighted_sum += i * counts_for_fits[i];
+      counts_sum += counts_for_fits[i];
+    }
+    double mean_estimate = weighted_sum / counts_sum;
+    
+    // Sometimes the actual mean doesn't lead to a fit, so try others
+    double try_means[] = {
+      mean_estimate,
+      static_cast<double>(end_i_for_fits),
+      static_cast<double>(start_i_for_fits),
+      1 * (end_i_for_fits + start_i_for_fits) / 4.0,
+      2 * (end_i_for_fits + start_i_for_fits) / 4.0,
+      3 * (end_i_for_fits + start_i_for_fits) / 4.0
+    };
+    
+    bool fit_succeeded = false;
+    for (uint32_t try_means_index = 0; !fit_succeeded && (try_means_index < 6); try_means_index++) {
+      for (double try_size = 1E4; !fit_succeeded && (try_size >= 0.001); try_size /= 10) {
+        nb_fit_mu = try_means[try_means_index];
+        nb_fit_size = try_size;
+        if (nb_fit_mu <= 0) break;
+        fit_succeeded = nb_fit.minimize(nb_fit_mu, nb_fit_size);
+      }
+    }
+    
+    if (!fit_succeeded) {
+      nb_fit_mu = 0;
+      nb_fit_size = 0;
+    }
+  }
+  
+  // Invalidate fits that include too little of the distribution
+  if (nb_fit_mu > 0) {
+    double included_fract = pnbinom(end_i_for_fits, nb_fit_size, nb_fit_mu) - pnbinom(start_i_for_fits, nb_fit_size, nb_fit_mu);
+    if (included_fract >= 0.01) {
+      // Adjust so that we are back in full coords
+      nb_fit_mu *= num_per_bin;
+    } else {
+      nb_fit_mu = 0;
+      nb_fit_size = 0;
+    }
+  }
+  
+  // Fit the marginal value that we use for propagating deletions
+  double deletion_propagation_coverage;
+  if (nb_fit_mu > 0) {
+    deletion_propagation_coverage = qnbinom(deletion_propagation_pr_cutoff, nb_fit_size, nb_fit_mu);
+  } else {
+    // Fallback to calculating off an estimate of just variance = mu + mu^2/size
+    double size_estimate = (1 / (v - m)) * (m * m);
+    deletion_propagation_coverage = -1;
+    if (isfinite(size_estimate) && (size_estimate > 0)) {
+      deletion_propagation_coverage = qnbinom(deletion_propagation_pr_cutoff, size_estimate, m);
+    }
+    // Double fallback to calculating as just 10% of the mean
+    if (deletion_propagation_coverage < 1) {
+      deletion_propagation_coverage = m * 0.1;
+    }
+  }
+  
+  // Don't allow one read to indicate non-deleted regions
+  if (deletion_propagation_coverage < 1) {
+    deletion_propagation_coverage = 1;
+  }
+  
+  // If we have both low fit coverage and low straight average coverage then we're deleted...
+  if ((nb_fit_mu <= 3) && (m <= 3)) {
+    deletion_propagation_coverage = -1;
+  }
+  
+  fit.nbinom_size_parameter = nb_fit_size;
+  fit.nbinom_mean_parameter = nb_fit_mu;
+  // These remain at their defaults of zero if the fit failed
+  if (nb_fit_mu != 0) {
+    // prob = size/(size + mu)
+    fit.nbinom_prob_parameter = nb_fit_size / (nb_fit_mu + nb_fit_size);
+    // variance = mu + mu ^ 2 / size
+    fit.nbinom_variance = nb_fit_mu + pow(nb_fit_mu, 2) / nb_fit_size;
+    // dispersion = variance / mu
+    fit.nbinom_dispersion = fit.nbinom_variance / nb_fit_mu;
+  }
+  fit.deletion_coverage_propagation_cutoff = deletion_propagation_coverage;
+}
+
+/*! fit_with_r
+ @abstract Performs the same fit as fit() by running the R script coverage_distribution.r
  @param settings Used for file_paths
  @param distribution_file_name Input file for R, created by error_count() and saved as *.unique_only_coverage_distribution.tab
  @param plot_file Output by R
  @return vector<string> Each line contains a parameter set by R
  !*/
 
-vector<string> CoverageDistribution::fit(
+vector<string> CoverageDistribution::fit_with_r(
                                          Settings& settings,
                                          string distribution_file_name,
                                          string plot_file,
@@ -69,9 +418,37 @@ vector<string> CoverageDistribution::fit(
   return(lines);
 }
 
+/*! plot_fit
+ @abstract Graphs a coverage distribution and its fit using the R script coverage_distribution.r
+ @param settings Used for file_paths
+ @param distribution_file_name Input created by error_count() and saved as *.unique_only_coverage_distribution.tab
+ @param plot_file Output by R
+ @param fit Parameters from fit(). R does not refit the distribution.
+ !*/
+
+void CoverageDistribution::plot_fit(
+                                    Settings& settings,
+                                    const string& distribution_file_name,
+                                    const string& plot_file,
+                                    const CoverageSummary& fit
+                                    )
+{
+  string log_file_name = distribution_file_name + ".r.log";
+  
+  string command = "R --vanilla < " + cString(settings.program_data_path).escape_shell_chars() +
+  "/coverage_distribution.r" + " > " + cString(log_file_name).escape_shell_chars();
+  command += " distribution_file=" + cString(distribution_file_name).escape_shell_chars();
+  command += " plot_file=" + cString(plot_file).escape_shell_chars();
+  command += " deletion_propagation_pr_cutoff=0";
+  command += " fixed_nb_fit_size=" + to_string(fit.nbinom_size_parameter, 10, true);
+  command += " fixed_nb_fit_mu=" + to_string(fit.nbinom_mean_parameter, 10, true);
+  
+  SYSTEM(command, false, false, false); //NOTE: Not escaping shell characters here.
+}
+
 // helper functions
 /*! analyze_unique_coverage_distribution
- @abstract Assigns variables to be sent off to the R script coverage_distribution.r
+ @abstract Fits the unique-only coverage distribution of a coverage group and saves the results in the summary
  
  
  @param settings
@@ -127,43 +504,32 @@ void CoverageDistribution::analyze_unique_coverage_distribution(
   double junction_keep_pr_cutoff = 0.01 / sqrt(sequence_length);
   int32_t junction_max_score = int(2 * summary.sequence_conversion.read_length_avg);
   
-  CoverageDistribution dist;
-  vector<string> lines = dist.fit(settings,
-                                  unique_only_coverage_distribution_file_name,
-                                  unique_only_coverage_plot_file_name,
-                                  deletion_propagation_pr_cutoff
-                                  );
-  settings.track_intermediate_file(step_key, unique_only_coverage_plot_file_name);
+  CoverageSummary fit;
+  CoverageDistribution::fit(unique_only_coverage_distribution_file_name, deletion_propagation_pr_cutoff, fit);
   settings.track_intermediate_file(step_key, unique_only_coverage_distribution_file_name);
-  settings.track_intermediate_file(step_key, unique_only_coverage_distribution_file_name + ".r.log");
   
-  // First two lines are negative binomial parameters.
-  // Next three lines are average, standard deviation, and index of overdispersion
+  // R is only needed to draw the graph
+  if (!settings.skip_alignment_or_plot_generation) {
+    CoverageDistribution::plot_fit(settings, unique_only_coverage_distribution_file_name, unique_only_coverage_plot_file_name, fit);
+    settings.track_intermediate_file(step_key, unique_only_coverage_plot_file_name);
+    settings.track_intermediate_file(step_key, unique_only_coverage_distribution_file_name + ".r.log");
+  }
   
   // Put these into summary
   
   for (vector<string>::iterator it=seq_ids.begin(); it!=seq_ids.end(); it++) {
     string seq_id = *it;
-    summary.unique_coverage[seq_id].nbinom_size_parameter = from_string<double>(lines[0]);
-    summary.unique_coverage[seq_id].nbinom_mean_parameter = from_string<double>(lines[1]);
-    // Calculated by formula, prob = size/(size + mu)
-    
-    // These remain at their defaults of zero if this is zero = fit failed
-    if (summary.unique_coverage[seq_id].nbinom_mean_parameter != 0) {
-      summary.unique_coverage[seq_id].nbinom_prob_parameter = summary.unique_coverage[seq_id].nbinom_size_parameter
-      / (summary.unique_coverage[seq_id].nbinom_mean_parameter + summary.unique_coverage[seq_id].nbinom_size_parameter);
-      // Calculated by formula variance = mu + mu ^ 2 / size
-      summary.unique_coverage[seq_id].nbinom_variance = summary.unique_coverage[seq_id].nbinom_mean_parameter
-      + pow(summary.unique_coverage[seq_id].nbinom_mean_parameter, 2) / summary.unique_coverage[seq_id].nbinom_size_parameter;
-      // Calculated by formula dispersion = variance / mu
-      summary.unique_coverage[seq_id].nbinom_dispersion = summary.unique_coverage[seq_id].nbinom_variance / summary.unique_coverage[seq_id].nbinom_mean_parameter;
-    }
+    summary.unique_coverage[seq_id].nbinom_size_parameter = fit.nbinom_size_parameter;
+    summary.unique_coverage[seq_id].nbinom_mean_parameter = fit.nbinom_mean_parameter;
+    summary.unique_coverage[seq_id].nbinom_prob_parameter = fit.nbinom_prob_parameter;
+    summary.unique_coverage[seq_id].nbinom_variance = fit.nbinom_variance;
+    summary.unique_coverage[seq_id].nbinom_dispersion = fit.nbinom_dispersion;
     
-    summary.unique_coverage[seq_id].average = from_string<double>(lines[2]);
-    summary.unique_coverage[seq_id].variance = from_string<double>(lines[3]);
-    summary.unique_coverage[seq_id].dispersion = from_string<double>(lines[4]);
+    summary.unique_coverage[seq_id].average = fit.average;
+    summary.unique_coverage[seq_id].variance = fit.variance;
+    summary.unique_coverage[seq_id].dispersion = fit.dispersion;
     
-    summary.unique_coverage[seq_id].deletion_coverage_propagation_cutoff = from_string<double>(lines[5]);
+    summary.unique_coverage[seq_id].deletion_coverage_propagation_cutoff = fit.deletion_coverage_propagation_cutoff;
     
     bool verbose = false;
     if (verbose)
@@ -212,9 +578,9 @@ void CoverageDistribution::analyze_unique_coverage_distributions(
 /*
  * Function: tile
  * --------------------------------
- * Reads in [genome].coverage.tab and generates [genome].tiled.tab.
+ * Reads in [genome].coverage.bin and generates [genome].tiled.tab.
  
- * Summary: Breaks the [genome].coverage.tab file into sections
+ * Summary: Breaks the [genome].coverage.bin file into sections
  * of equal length (ex: 500 bp) called tiles, calculates the
  * average coverage within each tile, and then writes this data
  * to [genome].tiled.tab
@@ -224,7 +590,7 @@ void CoverageDistribution::analyze_unique_coverage_distributions(
 
 /* Notes & Explanations (below, collapse until needed) */
 /* --------------------------------
- * Conceptual Overview: The functions within the CoverageDistribution class keep track of location within a genome or segment of a genome (hereby referred to as just "segment") in two ways: by "position" and by "tile". POSITION is referring to base pairs, if every base pair within a segment were numbered sequentially from beginning to end, starting at 1 (why 1? because that's where biologists like to start their lists). Each position has a corresponding coverage value. You can see this by looking at the coverage.tab file (in the 08_mutation_identification directory). However, for our purposes, analyzing every single position in an entire segment would take too long. So for efficiency we use this function to break the the segment into sections of equal length (e.g. 500 base pairs long) called TILES. We then calculate the average coverage within within each tile and write this data to a new file called tiled.tab (in the 09_copy_number_variation directory). This file will then be analyzed by the CoverageDistribution::find_segments function to find "outliers" (see find_segments for more about outliers).
+ * Conceptual Overview: The functions within the CoverageDistribution class keep track of location within a genome or segment of a genome (hereby referred to as just "segment") in two ways: by "position" and by "tile". POSITION is referring to base pairs, if every base pair within a segment were numbered sequentially from beginning to end, starting at 1 (why 1? because that's where biologists like to start their lists). Each position has a corresponding coverage value. These are stored in the binary coverage.bin file (in the 08_mutation_identification directory). However, for our purposes, analyzing every single position in an entire segment would take too long. So for efficiency we use this function to break the the segment into sections of equal length (e.g. 500 base pairs long) called TILES. We then calculate the average coverage within within each tile and write this data to a new file called tiled.tab (in the 09_copy_number_variation directory). This file will then be analyzed by the CoverageDistribution::find_segments function to find "outliers" (see find_segments for more about outliers).
  
  */
 void CoverageDistribution::tile(
@@ -232,16 +598,17 @@ void CoverageDistribution::tile(
                                 string in_file_name,
                                 string out_file_name,
                                 string tiled_for_edging_file_name,
-                                uint32_t tile_size
+                                uint32_t tile_size,
+                                ostream& log
                                 )
 {
   // @DTF: make this a default setting later on to pass as parameter
   // to this function:
   int32_t tile_size_for_edging = 10;
   
-  cout << "Performing tiling..." << endl;
-  cout << "  1: Identification tile size    " << setw(6) << right <<  tile_size << " bp"<< endl;
-  cout << "  2: Edge optimization tile size " << setw(6) << right << tile_size_for_edging << " bp"<< endl;
+  log << "Performing tiling..." << endl;
+  log << "  1: Identification tile size    " << setw(6) << right <<  tile_size << " bp"<< endl;
+  log << "  2: Edge optimization tile size " << setw(6) << right << tile_size_for_edging << " bp"<< endl;
 
   
   //The index is the marker of the current tile.
@@ -271,21 +638,22 @@ void CoverageDistribution::tile(
   bool do_write;
   
   //used to make sure the very last position is not written twice.
-  uint32_t last_position;
-  
-  //used to ignore values in the input file.
-  string skip;
+  uint32_t last_position = 0;
   
-  ifstream in_file;
+  cCoverageColumnFile in_file;
   ofstream out_file;
   ofstream out_file_for_edging;
   
-  in_file.open ( in_file_name.c_str() );
+  in_file.map ( in_file_name );
   out_file.open ( out_file_name.c_str() );
   out_file_for_edging.open( tiled_for_edging_file_name.c_str() );
   
-  //skipping the first line in the input file.
-  getline(in_file, skip);
+  const uint32_t* unique_top = in_file.counts(cCoverageColumnFile::UNIQUE_TOP);
+  const uint32_t* unique_bot = in_file.counts(cCoverageColumnFile::UNIQUE_BOT);
+  const float* redundant_top = in_file.values(cCoverageColumnFile::REDUNDANT_TOP);
+  const float* redundant_bot = in_file.values(cCoverageColumnFile::REDUNDANT_BOT);
+  const uint32_t* raw_redundant_top = in_file.counts(cCoverageColumnFile::RAW_REDUNDANT_TOP);
+  const uint32_t* raw_redundant_bot = in_file.counts(cCoverageColumnFile::RAW_REDUNDANT_BOT);
   
   out_file << "position\tcoverage\t" << tile_size << "\n";
   out_file_for_edging << "position\tcoverage\t" << tile_size_for_edging << "\n";
@@ -301,21 +669,20 @@ void CoverageDistribution::tile(
   
   do_write = true;
   
-  while ( in_file >> coverage )
+  position = 0;
+  for (uint32_t i = 0; i < in_file.size(); i++)
   {
-    sum_coverage = coverage;
-    
-    in_file >> coverage;
-    sum_coverage += coverage;
+    sum_coverage = unique_top[i];
+    sum_coverage += unique_bot[i];
     
     //next 4 are values that represent redundancy
-    in_file >> redundant1 >> redundant2 >> redundant3 >> redundant4;
+    redundant1 = redundant_top[i];
+    redundant2 = redundant_bot[i];
+    redundant3 = raw_redundant_top[i];
+    redundant4 = raw_redundant_bot[i];
     
-    //the next value in the line isn't used.
-    in_file >> skip;
-    
-    //last is position (@DTF: begins at 1, not 0)
-    in_file >> position;
+    //position (@DTF: begins at 1, not 0)
+    position = in_file.first_position() + i;
     
     coverage = sum_coverage;
     
@@ -416,6 +783,88 @@ void CoverageDistribution::tile(
 }
 
 
+// Random number generator for shuffling segments in find_segments. It gives
+// the same sequence as rand() after srand(0) with glibc (an additive feedback
+// generator), but with its own state, so that sequences can be segmented
+// concurrently and the results do not depend on anything else calling rand().
+class cSegmentRandom
+{
+public:
+  cSegmentRandom(uint32_t seed = 0)
+  : m_front(3), m_rear(0)
+  {
+    int32_t word = (seed == 0) ? 1 : seed;
+    m_state[0] = word;
+    for (uint32_t i = 1; i < 31; i++) {
+      // word = (16807 * word) % 2147483647 without overflow
+      int32_t hi = word / 127773;
+      int32_t lo = word % 127773;
+      word = 16807 * lo - 2836 * hi;
+      if (word < 0) word += 2147483647;
+      m_state[i] = word;
+    }
+    for (uint32_t i = 0; i < 310; i++) next();
+  }
+  
+  int32_t next()
+  {
+    uint32_t value = static_cast<uint32_t>(m_state[m_front]) + static_cast<uint32_t>(m_state[m_rear]);
+    m_state[m_front] = value;
+    m_front = (m_front + 1) % 31;
+    m_rear = (m_rear + 1) % 31;
+    return (value >> 1) & 0x7fffffff;
+  }
+  
+private:
+  int32_t m_state[31];
+  uint32_t m_front;
+  uint32_t m_rear;
+};
+
+// Largest absolute t_score of any subsegment of a (randomized) search segment,
+// given the sum of coverage up to each of its tiles. Uses the same formula as
+// the search for outliers in find_segments below.
+static double best_absolute_t_score(const vector<double>& sum_of_coverage_to_tile,
+                                    const vector<int32_t>& ordered_positions_in_segment,
+                                    int32_t first_tile,
+                                    int32_t last_tile,
+                                    int32_t position_hash,
+                                    double sum_of_coverage_in_segment,
+                                    int32_t num_positions_in_segment)
+{
+  // Set to largest possible negative number so the first t_score found
+  // is always greater than the initialized value
+  double best_t_score = -1.7e-308;
+  
+  // For every possible value of i within the segment...
+  for (int32_t i_tile = first_tile - 1; i_tile < last_tile; i_tile++)
+  {
+    int32_t i_position = ordered_positions_in_segment[i_tile] - position_hash;
+    double sum_of_coverage_to_i_pos = sum_of_coverage_to_tile[i_tile - (first_tile - 1)];
+    
+    // For every possible value of j within the segment...
+    for (int32_t j_tile = i_tile + 1; j_tile <= last_tile; j_tile++)
+    {
+      int32_t j_position = ordered_positions_in_segment[j_tile] - position_hash;
+      double sum_of_coverage_to_j_pos = sum_of_coverage_to_tile[j_tile - (first_tile - 1)];
+      
+      double y = (sum_of_coverage_to_j_pos - sum_of_coverage_to_i_pos) / (j_position - i_position);
+      double z = (sum_of_coverage_in_segment - sum_of_coverage_to_j_pos + sum_of_coverage_to_i_pos) / (num_positions_in_segment - j_position + i_position);
+      double d1 = 1.0 / (j_position - i_position);
+      double d2 = 1.0 / (num_positions_in_segment - j_position + i_position);
+      double t_score = abs((y - z) / sqrt( d1 + d2 ));
+      
+      // Note: Floats are being compared here (see the notes for find_segments)
+      if ( t_score > best_t_score )
+      {
+        best_t_score = t_score;
+      }
+    }
+  }
+  
+  return best_t_score;
+}
+
 /*
  * Function: find_segments
  * --------------------------------
@@ -458,7 +907,7 @@ void CoverageDistribution::tile(
  d2 = (1.0 / (num_positions_in_segment - j_position + i_position));
  t = (y - z) / sqrt( d1 + d2 );
  
- * Tiles vs Position: Please read documentation for the CoverageDistribution::tile function before going any further. This function keeps track of location within a segment in two ways: by "position" and by "tile". Each entry in our input file, tiled.tab, represents the average coverage of every 500 positions across the entire genome (or whatever tile_size is). So of course each POSITION within tiled.tab will be a multiple of tile_size (i.e. 0, 500, 1000, 1500, etc). Say we're looking in tiled.tab at position 30500 which shows coverage of 60.2. This means that the avg coverage is 60.2 for the previous 500 positions (inclusive), so from 30001 to 30500. Each of these 500 position-long sections is considered a TILE, so there are as many tiles as entries in tiled.tab. Although not explicitly labeled in the file, in the code we refer to each tile with a number in sequence, where the first entry in tiled.tab represents tile 0, the next is tile 1, then tile 2, tile 3, and so on. We do this to make it easier to manipulate the entries later on, like loading them into data structures and iterating through them with loops. NOTE: The first entry in every tiled.tab is a pair of zeros, meaning that at position 0, avg coverage is 0. Although there technically is no position 0, because the coverage data in coverage.tab starts at position 1, we make one up because it allows us to eliminate special cases during for-loops throughout the code. (Coverage.tab is the file used to generate tiled.tab)
+ * Tiles vs Position: Please read documentation for the CoverageDistribution::tile function before going any further. This function keeps track of location within a segment in two ways: by "position" and by "tile". Each entry in our input file, tiled.tab, represents the average coverage of every 500 positions across the entire genome (or whatever tile_size is). So of course each POSITION within tiled.tab will be a multiple of tile_size (i.e. 0, 500, 1000, 1500, etc). Say we're looking in tiled.tab at position 30500 which shows coverage of 60.2. This means that the avg coverage is 60.2 for the previous 500 positions (inclusive), so from 30001 to 30500. Each of these 500 position-long sections is considered a TILE, so there are as many tiles as entries in tiled.tab. Although not explicitly labeled in the file, in the code we refer to each tile with a number in sequence, where the first entry in tiled.tab represents tile 0, the next is tile 1, then tile 2, tile 3, and so on. We do this to make it easier to manipulate the entries later on, like loading them into data structures and iterating through them with loops. NOTE: The first entry in every tiled.tab is a pair of zeros, meaning that at position 0, avg coverage is 0. Although there technically is no position 0, because the coverage data in coverage.bin starts at position 1, we make one up because it allows us to eliminate special cases during for-loops throughout the code. (Coverage.bin is the file used to generate tiled.tab)
  
  * Single-Tile Outliers: The algorithm will have trouble finding outliers that are only one tile wide if they are isolated and not connected to other outlying segments. It is much better at finding these single-tile outliers if they border the edge of another larger outlier that is two or more tiles wide (for an example, look at the HTML output for genome REL10951). This trade-off is intentional because there isn't a good way to find a single-tile outlier: the noise we are trying to screen-out often occurs in spikes that are only one tile wide. The chances of finding something meaningful increase significantly when you require the outlier to be at least two tiles wide because, statistically, it's a much rarer occurrence.
  
@@ -470,10 +919,12 @@ void CoverageDistribution::find_segments(const Settings& settings,
                                          string in_file_name,          // tiled.tab
                                          string tiled_for_edging_file_name,// tiled_for_edging.tab
                                          string out_file_name,         // ranges.tab
-                                         string history_file_name)     // history.tab
+                                         string history_file_name,     // history.tab
+                                         uint32_t num_threads,
+                                         ostream& log)
 
 {
-  cout << "Finding significant regions..." << endl;
+  log << "Finding significant regions..." << endl;
   
   (void)settings;
   
@@ -546,9 +997,11 @@ void CoverageDistribution::find_segments(const Settings& settings,
   int32_t num_positions_in_segment;
   int32_t num_positions_in_genome;
   
-  // Maps the relative sum of coverage up to every position within the search segment
-  map<int32_t, double> sum_of_coverage_to_position;
-  double running_sum = 0; // Used to populate above
+  // Prefix sums: the sum of coverage up to each tile within the search segment,
+  // where index 0 is the tile just before the segment, so any subsegment's sum
+  // is the difference of two entries
+  vector<double> sum_of_coverage_to_tile;
+  int32_t tile_offset;
   
   // Relative sums of coverage up to i_position and j_position within the search segment.
   // Can be reused for both high and low coveage calculations.
@@ -585,8 +1038,6 @@ void CoverageDistribution::find_segments(const Settings& settings,
    */
   
   // For keeping track of the highest and lowest t_score among the random segments
-  double r_t_score;
-  double r_best_t_score_hi;
   double r_best_t_score_lo;
   int32_t r_best_t_length_hi;
   int32_t r_best_t_length_lo;
@@ -605,9 +1056,9 @@ void CoverageDistribution::find_segments(const Settings& settings,
   //double mean_error;
   
   // Used for randomizing a segment
-  vector<double> vector_of_randomized_coverage;
-  list<int32_t>::iterator list_iter;
-  list<int32_t> list_of_tiles_in_segment;
+  vector< vector<double> > randomized_coverage;
+  vector<double> r_best_t_scores;
+  vector<int32_t> list_of_tiles_in_segment;
   int32_t random_num;
   int32_t best_t_was_higher_counter;
   int32_t best_t_was_lower_counter;
@@ -616,7 +1067,7 @@ void CoverageDistribution::find_segments(const Settings& settings,
   // Used for randomized testing for statistical significance
   int32_t randomizations = 100; // How many times the random test loop will run
   max_error_threshold = int(randomizations * .05) + 1; // Ex: 6
-  srand(0);
+  cSegmentRandom random_generator;
   
   // Define filestreams
   ifstream tiles_file;
@@ -648,6 +1099,7 @@ void CoverageDistribution::find_segments(const Settings& settings,
   int32_t position;
   double coverage;
   map<int32_t, double> coverage_map;
+  vector<double> coverage_by_tile;
   vector<int32_t> ordered_positions_in_segment;
   
   // Skip header of tiled.tab and get tile_size
@@ -658,8 +1110,8 @@ void CoverageDistribution::find_segments(const Settings& settings,
   // Read each line of data (position & coverage) from tiled.tab file
   while ( tiles_file >> position >> coverage )
   {
-    // Each position and it's corresponding coverage is populated into this map
-    coverage_map[position] = coverage;
+    // Each tile's coverage is populated into this vector, in order
+    coverage_by_tile.push_back(coverage);
     
     // Each position that exists within tiled.tab is populated into this vector.
     // Since the positions are populated in order, each can be accessed by its
@@ -710,7 +1162,7 @@ void CoverageDistribution::find_segments(const Settings& settings,
     int32_t end_coord = ordered_positions_in_segment[current_search_pair_by_tile.second];
 
     // Print to stdout
-    cout << "  REGION: " << setw(8) << right << start_coord << " - " << setw(8) << right << end_coord << endl;
+    log << "  REGION: " << setw(8) << right << start_coord << " - " << setw(8) << right << end_coord << endl;
     
     // If the current search segment consists of 1 tile, it cannot be examined for
     // outliers because no outliers can exist within it.
@@ -765,20 +1217,18 @@ void CoverageDistribution::find_segments(const Settings& settings,
       cin.get();
     }
     
-    // Clear map before populating it
-    sum_of_coverage_to_position.clear();
-    
     // Keep track of our relative position within the search segment. This always sets
     // current_position to 0.
     current_position = ordered_positions_in_segment[current_search_pair_by_tile.first - 1] - position_hash;
     
     // The sum of coverage at position 0 is always 0
-    sum_of_coverage_to_position[current_position] = 0;
+    tile_offset = current_search_pair_by_tile.first - 1;
+    sum_of_coverage_to_tile.assign(1, 0.0);
     num_tiles = 0;
     
     // This loop is the prep work. Before you can search for outliers in this
     // segment, you must figure out how many positions it has (i.e. base pairs),
-    // and you must populate a map with the sum of coverage up to each position.
+    // and you must find the sum of coverage up to each tile.
     // NOTE: Don't forget we are treating this current search segment as its own
     // entity. Thus, no matter where this segment is within the actual genome,
     // we are treating the first position of this segment as zero.
@@ -788,7 +1238,7 @@ void CoverageDistribution::find_segments(const Settings& settings,
       current_position = ordered_positions_in_segment[tile_index] - position_hash;
       previous_position = ordered_positions_in_segment[tile_index - 1] - position_hash;
       
-      sum_of_coverage_to_position[current_position] = coverage_map[current_position + position_hash] + sum_of_coverage_to_position[previous_position];
+      sum_of_coverage_to_tile.push_back(coverage_by_tile[tile_index] + sum_of_coverage_to_tile.back());
       num_tiles++;
       
       if (VERBOSE) {
@@ -799,11 +1249,11 @@ void CoverageDistribution::find_segments(const Settings& settings,
         cout << "previous_position:" << previous_position << " "
         << "= ordered_positions_in_segment[tile_index-1]:" << ordered_positions_in_segment[tile_index - 1] << " "
         << "- position_hash:" << position_hash << endl;
-        cout << "sum_of_coverage_to_position[current_position]:" << sum_of_coverage_to_position[current_position] << " "
-        << "= coverage_map[current_position+position_hash]:"
-        << coverage_map[current_position + position_hash] << " "
-        << "+ sum_of_coverage_to_position[previous_position]:"
-        << sum_of_coverage_to_position[previous_position] << endl;
+        cout << "sum_of_coverage_to_tile[current_tile]:" << sum_of_coverage_to_tile[tile_index - tile_offset] << " "
+        << "= coverage_by_tile[tile_index]:"
+        << coverage_by_tile[tile_index] << " "
+        << "+ sum_of_coverage_to_tile[previous_tile]:"
+        << sum_of_coverage_to_tile[tile_index - tile_offset - 1] << endl;
         cout << "num_tiles: " << num_tiles << endl;
       }
     }
@@ -821,7 +1271,7 @@ void CoverageDistribution::find_segments(const Settings& settings,
     current_position = ordered_positions_in_segment[current_search_pair_by_tile.second] - position_hash;
     
     // Set values for upcoming step 1 of algorithm
-    sum_of_coverage_in_segment = sum_of_coverage_to_position[current_position];
+    sum_of_coverage_in_segment = sum_of_coverage_to_tile.back();
     num_positions_in_segment = current_position;
     
     // Set to largest possible negative number so the first t_score found
@@ -846,7 +1296,7 @@ void CoverageDistribution::find_segments(const Settings& settings,
       
       // These always start at zero and increase with each iteration of the for-loop
       i_position = ordered_positions_in_segment[i_tile] - position_hash;
-      sum_of_coverage_to_i_pos = sum_of_coverage_to_position[ i_position ];
+      sum_of_coverage_to_i_pos = sum_of_coverage_to_tile[ i_tile - tile_offset ];
       
       
       
@@ -857,7 +1307,7 @@ void CoverageDistribution::find_segments(const Settings& settings,
         // These always start at zero and increase with each
         // iteration of the for-loop
         j_position = ordered_positions_in_segment[j_tile] - position_hash;
-        sum_of_coverage_to_j_pos = sum_of_coverage_to_position[ j_position ];
+        sum_of_coverage_to_j_pos = sum_of_coverage_to_tile[ j_tile - tile_offset ];
         
         // Calculate the t_score of the subsegment with the given i and j
         y = (sum_of_coverage_to_j_pos - sum_of_coverage_to_i_pos) / (j_position - i_position);
@@ -887,8 +1337,8 @@ void CoverageDistribution::find_segments(const Settings& settings,
     // Save info about the potential outlier that has just been found
     i_position = ordered_positions_in_segment[best_i_tile_hi] - position_hash;
     j_position = ordered_positions_in_segment[best_j_tile_hi] - position_hash;
-    sum_of_coverage_to_i_pos = sum_of_coverage_to_position[ i_position ];
-    sum_of_coverage_to_j_pos = sum_of_coverage_to_position[ j_position ];
+    sum_of_coverage_to_i_pos = sum_of_coverage_to_tile[ best_i_tile_hi - tile_offset ];
+    sum_of_coverage_to_j_pos = sum_of_coverage_to_tile[ best_j_tile_hi - tile_offset ];
     
     /*
      * Make debugging info for the history file.
@@ -942,11 +1392,16 @@ void CoverageDistribution::find_segments(const Settings& settings,
      tiles of the search segment. It counts how many times the search segment's best t_score
      is larger than the random best t_score.
      
+     All of the random segments are generated first, so that the random numbers are
+     drawn in the same order no matter how many threads are used. Then the best t_score
+     of each random segment, which is most of the work, is found in parallel.
+     
      NOTE: The actual check for statistical significance does not happen in this for-loop.
      Later on it will determine if the current best t_score was larger than the random
      best t_score 95 times out of 100; if yes, the current best t_score is "accepted"
      as an outlier. */
     
+    randomized_coverage.resize(randomizations);
     for ( int32_t examinations = 0; examinations < randomizations; examinations++ )
     {
       
@@ -954,12 +1409,8 @@ void CoverageDistribution::find_segments(const Settings& settings,
        * Generate random segment
        */
       
-      /* Below is an unusual yet efficient way to randomly select tiles within the
-       current search segment and then populate them into a new random segment to be
-       used for testing purposes: */
-      
       list_of_tiles_in_segment.clear();
-      vector_of_randomized_coverage.clear();
+      randomized_coverage[examinations].clear();
       
       // First, create a reference list of all the tile indexes in the
       // current search segment that will need to be shuffled:
@@ -967,7 +1418,6 @@ void CoverageDistribution::find_segments(const Settings& settings,
       for (int32_t tile_index = current_search_pair_by_tile.first;
            tile_index <= current_search_pair_by_tile.second; tile_index++)
       {
-        // Populate the tile index into a linked list
         list_of_tiles_in_segment.push_back(tile_index);
       }
       
@@ -979,123 +1429,42 @@ void CoverageDistribution::find_segments(const Settings& settings,
            tile_count <= current_search_pair_by_tile.second; tile_count++)
       {
         // Generate a random number that is less than the total number of
-        // tiles in the current segment (but greater than or equal to zero)
-        random_num = rand() % list_of_tiles_in_segment.size();
-        
-        /* The next for-loop is how the random tile is actually chosen. It is not
-         designed to run from beginning to end. Instead, it is meant to run a random
-         number of times as specified by the random_num above. It iterates thru the
-         list of tile indexes, decrementing the random_num by 1 each time, and
-         whatever tile the iterator is pointing to when random_num = 0 becomes the
-         next randomly chosen tile. */
-        for (list_iter = list_of_tiles_in_segment.begin();
-             list_iter != list_of_tiles_in_segment.end(); list_iter++)
-        {
-          if ( random_num == 0 )
-          {
-            /* Note that list_of_tiles_in_segment represents the same tiles of the
-             search segment that exist within ordered_positions_in_segment (ex: 61
-             thru 97). Thus, the list_iter is just a pointer to a value (a tile
-             index, ex: 63), and that value is accessed by *list_iter. Using this
-             tile to access a specific element within ordered_positions_in_segment
-             returns the corresponding position (ex: 31500), and then this position
-             is used to access the corresponding coverage at this position within
-             coverage_map. Finally, this average coverage value is pushed onto the
-             end of the vector_of_randomized_coverage. */
-            vector_of_randomized_coverage.push_back(coverage_map[ordered_positions_in_segment[*list_iter]]);
-            
-            // To prevent this same coverage value from being used again, its
-            // corresponding tile is removed from the list_of_tiles_in_segment list.
-            list_of_tiles_in_segment.erase(list_iter);
-            break;
-          }
-          
-          // Decrement random_num by 1
-          random_num--;
-          
-        }
-      } // End of tile_count for-loop
-
-      
-      /*
-       * More prep work (still in randomized testing)
-       */
-      
-      // This loop repopulates the sum_of_coverage_to_position vector with the randomly
-      // chosen values from vector_of_randomized_coverage.
-      // Note: sum_of_coverage_to_position does not need to be zeroed-out before this
-      // loop is run; see "sum_of_coverage_to_position" below...
-      for (size_t iter = 0; iter < vector_of_randomized_coverage.size(); iter++)
-      {
-        // current_position always starts at tile_size and then increases
-        // by tile_size with every loop (ex: 500, 1000, 1500, ...)
-        current_position = ordered_positions_in_segment[current_search_pair_by_tile.first + iter] - position_hash;
+        // tiles remaining in the list (but greater than or equal to zero)
+        random_num = random_generator.next() % list_of_tiles_in_segment.size();
         
-        // ?2? previous_position always starts at zero and then increases
-        // by tile_size with every loop (ex: 0, 500, 1000, ...)
-        previous_position = ordered_positions_in_segment[current_search_pair_by_tile.first + iter - 1] - position_hash;
-        
-        // The first time through this loop (i.e. when iter=0 and previous_position=0),
-        // the sum_of_coverage_to_position[previous_position] will always
-        // equal zero, because sum_of_coverage_to_position[0] will always equal zero.
-        sum_of_coverage_to_position[current_position] = sum_of_coverage_to_position[previous_position] + vector_of_randomized_coverage[iter];
+        // The tile at that index in the list is the next randomly chosen tile.
+        // Its coverage is added to the random segment, and it is removed from the
+        // list to prevent this same coverage value from being used again.
+        randomized_coverage[examinations].push_back(coverage_by_tile[list_of_tiles_in_segment[random_num]]);
+        list_of_tiles_in_segment.erase(list_of_tiles_in_segment.begin() + random_num);
       }
+    }
+    
+    /*
+     * Find the best t_score within each random segment
+     */
+    
+    r_best_t_scores.assign(randomizations, 0.0);
+    parallel_for(randomizations, num_threads, [&](size_t examination) {
       
-      /*
-       * Find the best t_score within the random segment
-       */
-      
-      // Set to largest possible negative number so the first t_score found
-      // is always greater than the initialized value
-      r_best_t_score_hi = -1.7e-308;
-      
-      // For every possible value of i within the current search segment...
-      for ( int32_t i_tile = current_search_pair_by_tile.first - 1;
-           i_tile < current_search_pair_by_tile.second; i_tile++ )
-      {
-        // These always start at zero and increase with each iteration of the for-loop
-        i_position = ordered_positions_in_segment[i_tile] - position_hash;
-        sum_of_coverage_to_i_pos = sum_of_coverage_to_position[ i_position ];
-
-        // For every possible value of j within the current search segment...
-        for ( int32_t j_tile = i_tile + 1;
-             j_tile <= current_search_pair_by_tile.second; j_tile++ )
-        {
-          // These always start at zero and increase with each
-          // iteration of the for-loop
-          j_position = ordered_positions_in_segment[j_tile] - position_hash;
-          sum_of_coverage_to_j_pos = sum_of_coverage_to_position[ j_position ];
-          
-          // Calculate the t_score of the subsegment with the given i and j
-          y = (sum_of_coverage_to_j_pos - sum_of_coverage_to_i_pos) / (j_position - i_position);
-          z = (sum_of_coverage_in_segment - sum_of_coverage_to_j_pos + sum_of_coverage_to_i_pos) / (num_positions_in_segment - j_position + i_position);
-          d1 = 1.0 / (j_position - i_position);
-          d2 = 1.0 / (num_positions_in_segment - j_position + i_position);
-          r_t_score = (y - z) / sqrt( d1 + d2 );
-          r_t_score = abs(r_t_score);
-          
-          
-          // Keep track of subsegment with the largest t_score
-          // Note: Floats are being compared here; also, an "equality" comparison
-          // (that actually compares within a range) might need to be added so that
-          // it mirrors the methodology of the similar code block near line 740.
-          if ( r_t_score > r_best_t_score_hi )
-          {
-            r_best_t_score_hi = abs(r_t_score);
-            
-            // Used for stepping thru the code in debug mode
-            r_best_i_tile_hi = i_tile;
-            r_best_j_tile_hi = j_tile;
-          }
-          
-        } // End of for-loop j_tile
-      } // End of for-loop i_tile
+      // The sum of coverage up to each tile of the random segment
+      vector<double> r_sum_of_coverage_to_tile(1, 0.0);
+      for (size_t iter = 0; iter < randomized_coverage[examination].size(); iter++) {
+        r_sum_of_coverage_to_tile.push_back(r_sum_of_coverage_to_tile.back() + randomized_coverage[examination][iter]);
+      }
       
+      r_best_t_scores[examination] = best_absolute_t_score(r_sum_of_coverage_to_tile, ordered_positions_in_segment,
+                                                           current_search_pair_by_tile.first, current_search_pair_by_tile.second,
+                                                           position_hash, sum_of_coverage_in_segment, num_positions_in_segment);
+    });
+    
+    for ( int32_t examinations = 0; examinations < randomizations; examinations++ )
+    {
       //  Now we know the best t_score of the random segment
       if (VERBOSE) {
         cout << "\n\n#####################################";
         cout << "\n best_t_score: " << fixed << setprecision(40) << best_t_score_hi;
-        cout << "\r_best_t_score: " << fixed << setprecision(40) << r_best_t_score_hi
+        cout << "\r_best_t_score: " << fixed << setprecision(40) << r_best_t_scores[examinations]
         << endl;
       }
       
@@ -1103,7 +1472,7 @@ void CoverageDistribution::find_segments(const Settings& settings,
        * Count the times best_t_score is larger than r_best_t_score
        */
       
-      if ( best_t_score_hi > r_best_t_score_hi )
+      if ( best_t_score_hi > r_best_t_scores[examinations] )
       {
         best_t_was_higher_counter++;
       }
@@ -1366,7 +1735,7 @@ void CoverageDistribution::find_segments(const Settings& settings,
     num_tiles++;
   }
   
-  cout << "Optimizing edges of significant regions..." << endl;
+  log << "Optimizing edges of significant regions..." << endl;
   
   // Reset these values based on tiled_for_edging file
   num_tiles_in_genome = num_tiles;
@@ -1642,10 +2011,11 @@ void CoverageDistribution::smooth_segments(
                                            string segment_file_name,
                                            string out_file_name,
                                            string final_file_name,
-                                           string gd_file_name
+                                           string gd_file_name,
+                                           ostream& log
                                            )
 {
-  cout << "Smoothing significant regions..." << endl;
+  log << "Smoothing significant regions..." << endl;
 
   
   cGenomeDiff gd; /* cGenomeDiff is a data type defined by breseq. it holds
@@ -1929,7 +2299,7 @@ void CoverageDistribution::analyze_coverage_bias (
   // Third line is GC of reference sequences
   for (cReferenceSequences::iterator it=ref_seq_info.begin(); it != ref_seq_info.end(); it++) {
     if (it != ref_seq_info.begin()) read_out << ",";
-    read_out << gc_percentage_string(it->m_fasta_sequence.get_sequence()) << endl;
+    read_out << gc_percentage_string(it->m_fasta_sequence) << endl;
   }
   
   alignment_list alignments;
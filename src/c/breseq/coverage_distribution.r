@@ -21,6 +21,9 @@
 ##   deletion_propagation_pr_cutoff=float
 ##   plot_poisson=0 or 1
 ##   pdf_output=0 or 1
+##   fixed_nb_fit_size=float and fixed_nb_fit_mu=float (optional)
+##     graph these negative binomial parameters (already fit by breseq,
+##     mu in full coverage coordinates) instead of fitting them here
 
 ## Returns these values printed out to output log
 ## 
@@ -242,40 +245,48 @@ nb_fit = NULL
 ## as.numeric prevents overflow in sums involving integers
 mean_estimate = sum((as.numeric(1:end_i_for_fits)*as.numeric(X.for.fits)))/sum(as.numeric(X.for.fits))
 
-nb_fit_mu = -1
-nb_fit_size = -1
-try_size = 100000
-try_means_index = 1
-#This is a list of different means to test <-  sometimes the actual mean doesn't lead to a fit
-try_means = c(mean_estimate, 
-              end_i_for_fits, 
-              start_i_for_fits, 
-              1*(end_i_for_fits + start_i_for_fits)/4,
-              2*(end_i_for_fits + start_i_for_fits)/4,
-              3*(end_i_for_fits + start_i_for_fits)/4
-              )
+if (exists("fixed_nb_fit_size") && exists("fixed_nb_fit_mu")) {
+  ## Use the parameters we were given, converted to the coordinates of the fit bins
+  nb_fit_size = as.numeric(fixed_nb_fit_size)
+  nb_fit_mu = as.numeric(fixed_nb_fit_mu) / num_per_bin
+  nb_fit = list(code = 1)
+  try_size = NA
+} else {
+  nb_fit_mu = -1
+  nb_fit_size = -1
+  try_size = 100000
+  try_means_index = 1
+  #This is a list of different means to test <-  sometimes the actual mean doesn't lead to a fit
+  try_means = c(mean_estimate, 
+                end_i_for_fits, 
+                start_i_for_fits, 
+                1*(end_i_for_fits + start_i_for_fits)/4,
+                2*(end_i_for_fits + start_i_for_fits)/4,
+                3*(end_i_for_fits + start_i_for_fits)/4
+                )
               
               
-nb_fit = c()
+  nb_fit = c()
 
-while ( ((nb_fit_mu < 0) || (nb_fit_size < 0) || (nb_fit$code != 1)) && (try_size > 0.001) && (try_means_index <= length(try_means)))
-{
-  try_size = try_size / 10
-  try_mean = try_means[try_means_index]
+  while ( ((nb_fit_mu < 0) || (nb_fit_size < 0) || (nb_fit$code != 1)) && (try_size > 0.001) && (try_means_index <= length(try_means)))
+  {
+    try_size = try_size / 10
+    try_mean = try_means[try_means_index]
 
-  ## SIZE ESTIMATE from the censored data can be negative, so try various values instead
-  cat("Try Mean: ", try_mean, " Size: ", try_size, "\n")
+    ## SIZE ESTIMATE from the censored data can be negative, so try various values instead
+    cat("Try Mean: ", try_mean, " Size: ", try_size, "\n")
 
-  try( suppressWarnings(nb_fit<-nlm(f_nb, c(try_mean, try_size), iterlim=1000, print.level=this.print.level)) )
+    try( suppressWarnings(nb_fit<-nlm(f_nb, c(try_mean, try_size), iterlim=1000, print.level=this.print.level)) )
 
-  nb_fit_mu = nb_fit$estimate[1];
-  nb_fit_size = nb_fit$estimate[2];
+    nb_fit_mu = nb_fit$estimate[1];
+    nb_fit_size = nb_fit$estimate[2];
 
-  cat("Fit Mean: ", nb_fit_mu, " Size: ", nb_fit_size, " Code: ", nb_fit$code, "\n")
+    cat("Fit Mean: ", nb_fit_mu, " Size: ", nb_fit_size, " Code: ", nb_fit$code, "\n")
   
-  if (try_size <= 0.001) {
-    try_size = 100000
-    try_means_index = try_means_index + 1
+    if (try_size <= 0.001) {
+      try_size = 100000
+      try_means_index = try_means_index + 1
+    }
   }
 }
 
@@ -58,15 +58,47 @@ void coverage_output::plot(const string& region, const string& output_file_name,
     _output_file_name += "." + m_output_format;
   }
 	
-  pid_t pid = getpid();
-	string tmp_coverage = m_intermediate_path + "/" + to_string(pid) + ".coverage.tab";
-	
-  this->table(extended_region, tmp_coverage, resolution);
-  
   // default is zero
   double average_coverage = m_show_average ? m_summary.unique_coverage[seq_id].average : 0;
+  double fixed_coverage_scale = average_coverage ? average_coverage * m_fixed_coverage_scale : m_fixed_coverage_scale;
+  
+  // R is needed for PDF output. The R script cannot write SVG.
+  bool plot_with_r = (m_output_format == "pdf") || (m_use_r && (m_output_format == "png"));
+  
+  if (!plot_with_r) {
+    
+    m_save_positions = true;
+    m_saved_positions.clear();
+    this->tabulate(extended_region, resolution);
+    m_save_positions = false;
+    
+    // There may be no reads at all
+    if (m_saved_positions.size() == 0) {
+      coverage_plot_position c = { 0, 'N', {0, 0}, {0.0, 0.0}, {0, 0}, {0, 0} };
+      c.position = extended_start;
+      m_saved_positions.push_back(c);
+      c.position = extended_end;
+      m_saved_positions.push_back(c);
+    }
+    
+    cCoveragePlot coverage_plot;
+    coverage_plot.set_window(start_pos, end_pos);
+    coverage_plot.set_average_coverage(average_coverage);
+    coverage_plot.set_fixed_coverage_scale(fixed_coverage_scale);
+    coverage_plot.set_total_only(m_total_only);
+    coverage_plot.draw(m_saved_positions, _output_file_name, m_output_format);
+    
+    m_saved_positions.clear();
+    return;
+  }
+  
+  // Intermediate files are named after the plot, so that several can be drawn at once
+  string intermediate_prefix = m_intermediate_path + "/" + to_string(getpid()) + "." + cString(_output_file_name).get_base_name();
+  string tmp_coverage = intermediate_prefix + ".coverage.tab";
 	
-  string log_file_name = m_intermediate_path + "/" + to_string(pid) + ".r.log";
+  this->table(extended_region, tmp_coverage, resolution);
+	
+  string log_file_name = intermediate_prefix + ".r.log";
   string command = "R --vanilla";
   command += " in_file=" + cString(tmp_coverage).escape_shell_chars();
   command += " out_file=" + cString(_output_file_name).escape_shell_chars();
@@ -77,7 +109,7 @@ void coverage_output::plot(const string& region, const string& output_file_name,
   command += " window_start=" + to_string(start_pos);
   command += " window_end=" + to_string(end_pos);
   command += " avg_coverage=" + to_string(average_coverage);
-  command += " fixed_coverage_scale=" + ( average_coverage ? to_string<double>(average_coverage * m_fixed_coverage_scale) : to_string<double>(m_fixed_coverage_scale) );
+  command += " fixed_coverage_scale=" + to_string<double>(fixed_coverage_scale);
 
   command += " < " + cString(m_r_script_file_name).escape_shell_chars();
   command += " > " + cString(log_file_name).escape_shell_chars();
@@ -91,18 +123,6 @@ void coverage_output::plot(const string& region, const string& output_file_name,
 
 void coverage_output::table(const string& region, const string& output_file_name, uint32_t resolution)
 {
-  uint32_t target_id, start_pos, end_pos, insert_start, insert_end;
-  this->parse_region(region, target_id, start_pos, end_pos, insert_start, insert_end);
-	uint32_t size = end_pos - start_pos + 1;
-
-  // Resolution of 0 implies no downsampling, otherwise adjust to get close to resolution # of pts
-  uint32_t downsample = 1;
-  if (resolution != 0)
-  {
-    downsample = static_cast<uint32_t>(floor(static_cast<double>(size) / static_cast<double>(resolution)));
-    if (downsample < 1) downsample = 1;
-  }
-  
   m_output_table.open(output_file_name.c_str());
   
   if (m_read_begin_output_file_name.length() > 0) m_read_begin_output.open(m_read_begin_output_file_name.c_str());
@@ -115,15 +135,126 @@ void coverage_output::table(const string& region, const string& output_file_name
   << "unique_top_begin" << "\t" << "unique_bot_begin"    
   << std::endl;
   
+  this->tabulate(region, resolution);
+  
+  m_output_table.close();
+}
+
+void coverage_output::tabulate(const string& region, uint32_t resolution)
+{
+  uint32_t target_id, start_pos, end_pos, insert_start, insert_end;
+  this->parse_region(region, target_id, start_pos, end_pos, insert_start, insert_end);
+	uint32_t size = end_pos - start_pos + 1;
+
+  // Resolution of 0 implies no downsampling, otherwise adjust to get close to resolution # of pts
+  uint32_t downsample = 1;
+  if (resolution != 0)
+  {
+    downsample = static_cast<uint32_t>(floor(static_cast<double>(size) / static_cast<double>(resolution)));
+    if (downsample < 1) downsample = 1;
+  }
+  
   this->clear();
   
+  // the read begin and GC tables need the reads themselves
+  if ( (region.length() != 0) && m_profile && m_profile->has_target(target_id)
+      && (m_read_begin_output_file_name.length() == 0) && (m_gc_output_file_name.length() == 0) ) {
+    this->tabulate_from_profile(target_id, start_pos, end_pos, downsample);
+    return;
+  }
+  
   // pileup handles everything else, including into file
   if (region.length() == 0)
     this->do_pileup();
   else
     this->do_pileup(region, true, downsample);
+}
   
-  m_output_table.close();
+/*! Record the same positions that the pileup would handle for this region
+    (see pileup_base::handle_position) using the counts in the profile.
+ */
+void coverage_output::tabulate_from_profile(uint32_t target_id, uint32_t start_pos, uint32_t end_pos, uint32_t downsample)
+{
+  const coverage_counts* counts = m_profile->target(target_id);
+  ASSERT(m_profile->target_length(target_id) == this->target_length(target_id),
+         "Coverage profile does not match length of reference sequence: " + string(this->target_name(target_id)));
+  
+  char* refseq = get_refseq(target_id);
+  for (uint32_t pos = start_pos; pos <= end_pos; pos++) {
+    if ( (pos + start_pos) % downsample != 0 ) continue;
+    
+    const coverage_counts& n = counts[pos-1];
+    coverage_plot_position c = { pos, refseq[pos-1], 
+      {n.unique_cov[0], n.unique_cov[1]}, 
+      {n.redundant_cov[0], n.redundant_cov[1]}, 
+      {n.raw_redundant_cov[0], n.raw_redundant_cov[1]}, 
+      {n.unique_begin_reads[0], n.unique_begin_reads[1]} };
+    record_position(c);
+  }
+}
+  
+void coverage_output::tabulate_profile(cCoverageProfile& profile, uint32_t target_id, uint32_t start_pos, uint32_t end_pos)
+{
+  m_profile_counts = const_cast<coverage_counts*>(profile.target(target_id));
+  ASSERT(m_profile_counts, "Target not allocated in coverage profile: " + string(this->target_name(target_id)));
+  
+  this->clear();
+  this->do_pileup(string(this->target_name(target_id)) + ":" + to_string(start_pos) + "-" + to_string(end_pos), true);
+  m_profile_counts = NULL;
+}
+
+void coverage_output::profile_targets(cCoverageProfile& profile, const string& bam, const string& fasta,
+                                      const vector<string>& seq_ids, uint32_t num_threads)
+{
+  // Pieces are pileups clipped to their own positions, so they add up to the same counts as one pileup
+  const uint32_t piece_size = 1000000;
+  if (seq_ids.size() == 0) return;
+  
+  vector<uint32_t> piece_target_ids;
+  vector<uint32_t> piece_starts;
+  vector<uint32_t> piece_ends;
+  {
+    coverage_output co(bam, fasta, "");
+    for (vector<string>::const_iterator it = seq_ids.begin(); it != seq_ids.end(); it++) {
+      int32_t target_id = co.seq_id_to_target_id(*it);
+      ASSERT(target_id != -1, "Target seq id was not found in BAM file: " + *it);
+      uint32_t length = co.target_length(target_id);
+      profile.allocate_target(target_id, length);
+      for (uint32_t start = 1; start <= length; start += piece_size) {
+        piece_target_ids.push_back(target_id);
+        piece_starts.push_back(start);
+        piece_ends.push_back(min(start + piece_size - 1, length));
+      }
+    }
+  }
+  
+  // Each thread opens its own BAM and FASTA and tabulates every num_threads-th piece
+  if (num_threads > piece_starts.size()) num_threads = max(static_cast<size_t>(1), piece_starts.size());
+  
+  parallel_for(num_threads, num_threads, [&](size_t thread_index) {
+    coverage_output co(bam, fasta, "");
+    for (size_t i = thread_index; i < piece_starts.size(); i += num_threads) {
+      co.tabulate_profile(profile, piece_target_ids[i], piece_starts[i], piece_ends[i]);
+    }
+  });
+}
+  
+/*! Write one position to the table file and/or save it for drawing a plot.
+ */
+void coverage_output::record_position(const coverage_plot_position& c)
+{
+  if (m_output_table.is_open()) {
+    m_output_table << c.position << "\t" << c.ref_base << "\t" 
+    << c.unique_cov[0] << "\t" << c.unique_cov[1] << "\t" 
+    << c.redundant_cov[0] << "\t" << c.redundant_cov[1] << "\t" 
+    << c.raw_redundant_cov[0] << "\t" << c.raw_redundant_cov[1] << "\t"
+    << c.unique_begin_reads[0] << "\t" << c.unique_begin_reads[1] 
+    << std::endl;
+  }
+  
+  if (m_save_positions) {
+    m_saved_positions.push_back(c);
+  }
 }
   
 /*! Clear all statistics.
@@ -149,8 +280,8 @@ void coverage_output::pileup_callback(const breseq::pileup& p) {
   
   // print positions not called because there were no reads
   for (uint32_t i=m_last_position_1+1; i<pos; i++) {    
-    m_output_table << i << "\t" << refseq[i-1] << "\t" << 0 << "\t" << 0 << "\t" 
-    << 0 << "\t" << 0 << "\t" << 0 << "\t" << 0 << "\t" << 0 << "\t" << 0 << std::endl;
+    coverage_plot_position c = { i, refseq[i-1], {0, 0}, {0.0, 0.0}, {0, 0}, {0, 0} };
+    record_position(c);
   }
   
   // catches this position
@@ -263,13 +394,26 @@ void coverage_output::pileup_callback(const breseq::pileup& p) {
   
   
   //output
-  m_output_table << pos << "\t" << ref_base << "\t" 
-  << unique_cov[0] << "\t" << unique_cov[1] << "\t" 
-  << redundant_cov[0] << "\t" << redundant_cov[1] << "\t" 
-  << raw_redundant_cov[0] << "\t" << raw_redundant_cov[1] << "\t"
-  << unique_begin_reads[0] << "\t" << unique_begin_reads[1] 
+  coverage_plot_position c = { pos, static_cast<char>(ref_base), 
+    {unique_cov[0], unique_cov[1]}, 
+    {redundant_cov[0], redundant_cov[1]}, 
+    {raw_redundant_cov[0], raw_redundant_cov[1]}, 
+    {unique_begin_reads[0], unique_begin_reads[1]} };
   
-  << std::endl;
+  if (m_profile_counts) {
+    coverage_counts& n = m_profile_counts[pos-1];
+    n.unique_cov[0] = unique_cov[0];
+    n.unique_cov[1] = unique_cov[1];
+    n.redundant_cov[0] = static_cast<float>(redundant_cov[0]);
+    n.redundant_cov[1] = static_cast<float>(redundant_cov[1]);
+    n.raw_redundant_cov[0] = raw_redundant_cov[0];
+    n.raw_redundant_cov[1] = raw_redundant_cov[1];
+    n.unique_begin_reads[0] = unique_begin_reads[0];
+    n.unique_begin_reads[1] = unique_begin_reads[1];
+    return;
+  }
+  
+  record_position(c);
   
 }
   
@@ -0,0 +1,610 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#include "libbreseq/coverage_plot.h"
+
+#include <zlib.h>
+
+using namespace std;
+
+namespace breseq {
+
+// 5x7 bitmap font for printable ASCII (32-126). Each glyph is five columns,
+// left to right, with the top row in the lowest bit. Bit 7 is a descender row.
+static const uint8_t kPlotFont[95][5] = {
+  {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14}, // space ! " #
+  {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x56,0x20,0x50}, {0x00,0x05,0x03,0x00,0x00}, // $ % & '
+  {0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08}, // ( ) * +
+  {0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x60,0x60,0x00,0x00}, {0x20,0x10,0x08,0x04,0x02}, // , - . /
+  {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4B,0x31}, // 0 1 2 3
+  {0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03}, // 4 5 6 7
+  {0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1E}, {0x00,0x36,0x36,0x00,0x00}, {0x00,0x56,0x36,0x00,0x00}, // 8 9 : ;
+  {0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06}, // < = > ?
+  {0x32,0x49,0x79,0x41,0x3E}, {0x7E,0x11,0x11,0x11,0x7E}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22}, // @ A B C
+  {0x7F,0x41,0x41,0x22,0x1C}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x49,0x49,0x7A}, // D E F G
+  {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41}, // H I J K
+  {0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x0C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E}, // L M N O
+  {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x46,0x49,0x49,0x49,0x31}, // P Q R S
+  {0x01,0x01,0x7F,0x01,0x01}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F}, // T U V W
+  {0x63,0x14,0x08,0x14,0x63}, {0x07,0x08,0x70,0x08,0x07}, {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7F,0x41,0x41,0x00}, // X Y Z [
+  {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7F,0x00}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40}, // \ ] ^ _
+  {0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78}, {0x7F,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20}, // ` a b c
+  {0x38,0x44,0x44,0x48,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x08,0x7E,0x09,0x01,0x02}, {0x18,0xA4,0xA4,0xA4,0x7C}, // d e f g
+  {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x40,0x80,0x84,0x7D,0x00}, {0x7F,0x10,0x28,0x44,0x00}, // h i j k
+  {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x18,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38}, // l m n o
+  {0xFC,0x24,0x24,0x24,0x18}, {0x18,0x24,0x24,0x24,0xFC}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20}, // p q r s
+  {0x04,0x3F,0x44,0x40,0x20}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C}, // t u v w
+  {0x44,0x28,0x10,0x28,0x44}, {0x1C,0xA0,0xA0,0xA0,0x7C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00}, // x y z {
+  {0x00,0x00,0x7F,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x08,0x04,0x08,0x10,0x08}                               // | } ~
+};
+
+struct cPlotColor {
+  uint8_t r, g, b;
+
+  cPlotColor(uint8_t _r = 0, uint8_t _g = 0, uint8_t _b = 0) : r(_r), g(_g), b(_b) {}
+
+  string svg() const
+  {
+    char buffer[8];
+    snprintf(buffer, sizeof(buffer), "#%02x%02x%02x", r, g, b);
+    return buffer;
+  }
+};
+
+// The R colors used by plot_coverage.r
+static const cPlotColor kPlotBlack(0, 0, 0);
+static const cPlotColor kPlotGrey85(217, 217, 217);
+static const cPlotColor kPlotDarkGrey(169, 169, 169);
+static const cPlotColor kPlotGreen(0, 255, 0);
+static const cPlotColor kPlotRed(255, 0, 0);
+static const cPlotColor kPlotYellow(255, 255, 0);
+static const cPlotColor kPlotOrange(255, 165, 0);
+static const cPlotColor kPlotBlue(0, 0, 255);
+static const cPlotColor kPlotCyan(0, 255, 255);
+static const cPlotColor kPlotPurple(160, 32, 240);
+
+/*! Drawing surface shared by the PNG and SVG output.
+
+ Coordinates are in pixels with the origin at the top left. Text is placed by
+ the vertical center of its capital letters. Vertical text reads bottom to top.
+ */
+class cPlotCanvas {
+public:
+  cPlotCanvas(uint32_t width, uint32_t height) : m_width(width), m_height(height) {}
+  virtual ~cPlotCanvas() {}
+
+  virtual void fill_rect(double x0, double y0, double x1, double y1, const cPlotColor& color) = 0;
+
+  //! Draw a line through these points as steps (horizontal, then vertical).
+  virtual void step_line(const vector<double>& x, const vector<double>& y, const cPlotColor& color, double width) = 0;
+
+  //! Anchor is -1 for left (or bottom, if vertical), 0 for center, 1 for right (or top).
+  virtual void text(double x, double y, const string& s, double cap_height, int32_t anchor, bool vertical) = 0;
+
+  //! Only draw inside this rectangle until clear_clip() is called.
+  virtual void set_clip(double x0, double y0, double x1, double y1) = 0;
+  virtual void clear_clip() = 0;
+
+  virtual void write(const string& file_name) = 0;
+
+  //! Width of a string in pixels.
+  virtual double text_width(const string& s, double cap_height) const = 0;
+
+  //! Outline of a rectangle, with the line centered on its edges.
+  void stroke_rect(double x0, double y0, double x1, double y1, const cPlotColor& color, double width)
+  {
+    double w = width / 2;
+    fill_rect(x0 - w, y0 - w, x1 + w, y0 + w, color);
+    fill_rect(x0 - w, y1 - w, x1 + w, y1 + w, color);
+    fill_rect(x0 - w, y0 - w, x0 + w, y1 + w, color);
+    fill_rect(x1 - w, y0 - w, x1 + w, y1 + w, color);
+  }
+
+protected:
+  uint32_t m_width;
+  uint32_t m_height;
+};
+
+/*! RGB raster written as an 8-bit PNG.
+ */
+class cPlotRasterCanvas : public cPlotCanvas {
+public:
+  cPlotRasterCanvas(uint32_t width, uint32_t height)
+  : cPlotCanvas(width, height), m_pixels(3 * width * height, 255)
+  {
+    clear_clip();
+  }
+
+  virtual void fill_rect(double x0, double y0, double x1, double y1, const cPlotColor& color)
+  {
+    // Round edges to pixel boundaries, but never drop a rectangle entirely
+    int32_t left = static_cast<int32_t>(floor(min(x0, x1) + 0.5));
+    int32_t right = static_cast<int32_t>(floor(max(x0, x1) + 0.5));
+    int32_t top = static_cast<int32_t>(floor(min(y0, y1) + 0.5));
+    int32_t bottom = static_cast<int32_t>(floor(max(y0, y1) + 0.5));
+    if (right == left) right++;
+    if (bottom == top) bottom++;
+
+    left = max(left, m_clip_left);
+    right = min(right, m_clip_right);
+    top = max(top, m_clip_top);
+    bottom = min(bottom, m_clip_bottom);
+    if ((left >= right) || (top >= bottom)) return;
+
+    for (int32_t y = top; y < bottom; y++) {
+      uint8_t* p = &m_pixels[3 * (static_cast<size_t>(y) * m_width + left)];
+      for (int32_t x = left; x < right; x++) {
+        *p++ = color.r;
+        *p++ = color.g;
+        *p++ = color.b;
+      }
+    }
+  }
+
+  virtual void step_line(const vector<double>& x, const vector<double>& y, const cPlotColor& color, double width)
+  {
+    double w = width / 2;
+    for (size_t i = 0; i + 1 < x.size(); i++) {
+      fill_rect(x[i] - w, y[i] - w, x[i + 1] + w, y[i] + w, color);
+      fill_rect(x[i + 1] - w, min(y[i], y[i + 1]) - w, x[i + 1] + w, max(y[i], y[i + 1]) + w, color);
+    }
+  }
+
+  virtual void text(double x, double y, const string& s, double cap_height, int32_t anchor, bool vertical)
+  {
+    double scale = font_scale(cap_height);
+    double length = text_width(s, cap_height);
+    double start = (anchor == -1) ? 0 : ((anchor == 0) ? -length / 2 : -length);
+
+    // Offset along the direction of the text and across it
+    double along = start;
+    double across = -3.5 * scale;
+
+    for (string::const_iterator it = s.begin(); it != s.end(); it++) {
+      const uint8_t* glyph = font_glyph(*it);
+      for (uint32_t c = 0; c < 5; c++) {
+        for (uint32_t r = 0; r < 8; r++) {
+          if (!((glyph[c] >> r) & 1)) continue;
+          double a = along + c * scale;
+          double b = across + r * scale;
+          if (!vertical)
+            fill_rect(x + a, y + b, x + a + scale, y + b + scale, kPlotBlack);
+          else
+            fill_rect(x + b, y - a - scale, x + b + scale, y - a, kPlotBlack);
+        }
+      }
+      along += 6 * scale;
+    }
+  }
+
+  virtual double text_width(const string& s, double cap_height) const
+  {
+    if (s.empty()) return 0;
+    return (6.0 * s.size() - 1) * font_scale(cap_height);
+  }
+
+  virtual void set_clip(double x0, double y0, double x1, double y1)
+  {
+    m_clip_left = max(0, static_cast<int32_t>(floor(x0 + 0.5)));
+    m_clip_right = min(static_cast<int32_t>(m_width), static_cast<int32_t>(floor(x1 + 0.5)));
+    m_clip_top = max(0, static_cast<int32_t>(floor(y0 + 0.5)));
+    m_clip_bottom = min(static_cast<int32_t>(m_height), static_cast<int32_t>(floor(y1 + 0.5)));
+  }
+
+  virtual void clear_clip()
+  {
+    m_clip_left = 0;
+    m_clip_right = m_width;
+    m_clip_top = 0;
+    m_clip_bottom = m_height;
+  }
+
+  virtual void write(const string& file_name)
+  {
+    // Each row is preceded by its filter type (0 = none)
+    string raw;
+    raw.reserve((3 * m_width + 1) * m_height);
+    for (uint32_t y = 0; y < m_height; y++) {
+      raw += '\0';
+      raw.append(reinterpret_cast<const char*>(&m_pixels[3 * static_cast<size_t>(y) * m_width]), 3 * m_width);
+    }
+
+    uLongf compressed_length = compressBound(raw.size());
+    string compressed(compressed_length, '\0');
+    int result = compress2(reinterpret_cast<Bytef*>(&compressed[0]), &compressed_length,
+                           reinterpret_cast<const Bytef*>(raw.data()), raw.size(), Z_DEFAULT_COMPRESSION);
+    ASSERT(result == Z_OK, "Error compressing PNG image data for file: " + file_name);
+    compressed.resize(compressed_length);
+
+    string header;
+    append_uint32(header, m_width);
+    append_uint32(header, m_height);
+    header += '\x08'; // bit depth
+    header += '\x02'; // truecolor RGB
+    header += '\0';   // compression
+    header += '\0';   // filter
+    header += '\0';   // no interlace
+
+    ofstream out(file_name.c_str(), ios::out | ios::binary);
+    ASSERT(out.good(), "Could not open file for writing: " + file_name);
+    out << "\x89PNG\r\n\x1a\n";
+    write_chunk(out, "IHDR", header);
+    write_chunk(out, "IDAT", compressed);
+    write_chunk(out, "IEND", "");
+    ASSERT(out.good(), "Error writing file: " + file_name);
+  }
+
+protected:
+
+  //! Pixels per font pixel, so capitals are about cap_height tall.
+  static double font_scale(double cap_height)
+  {
+    return max(1.0, floor(cap_height / 7.0 + 0.5));
+  }
+
+  static const uint8_t* font_glyph(char c)
+  {
+    if ((c < 32) || (c > 126)) c = '?';
+    return kPlotFont[c - 32];
+  }
+
+  static void append_uint32(string& s, uint32_t value)
+  {
+    s += static_cast<char>((value >> 24) & 0xff);
+    s += static_cast<char>((value >> 16) & 0xff);
+    s += static_cast<char>((value >> 8) & 0xff);
+    s += static_cast<char>(value & 0xff);
+  }
+
+  static void write_chunk(ofstream& out, const string& type, const string& data)
+  {
+    string length;
+    append_uint32(length, data.size());
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(type.data()), type.size());
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(data.data()), data.size());
+    string crc_bytes;
+    append_uint32(crc_bytes, static_cast<uint32_t>(crc));
+    out << length << type << data << crc_bytes;
+  }
+
+  vector<uint8_t> m_pixels;
+  int32_t m_clip_left, m_clip_right, m_clip_top, m_clip_bottom;
+};
+
+/*! Vector drawing written as SVG.
+ */
+class cPlotSvgCanvas : public cPlotCanvas {
+public:
+  cPlotSvgCanvas(uint32_t width, uint32_t height, double pixels_per_inch)
+  : cPlotCanvas(width, height), m_pixels_per_inch(pixels_per_inch), m_num_clips(0), m_clipped(false)
+  {
+    m_svg << fixed << setprecision(2);
+  }
+
+  virtual void fill_rect(double x0, double y0, double x1, double y1, const cPlotColor& color)
+  {
+    m_svg << "<rect x=\"" << min(x0, x1) << "\" y=\"" << min(y0, y1)
+          << "\" width=\"" << fabs(x1 - x0) << "\" height=\"" << fabs(y1 - y0)
+          << "\" fill=\"" << color.svg() << "\"/>" << endl;
+  }
+
+  virtual void step_line(const vector<double>& x, const vector<double>& y, const cPlotColor& color, double width)
+  {
+    if (x.empty()) return;
+    m_svg << "<path fill=\"none\" stroke=\"" << color.svg() << "\" stroke-width=\"" << width
+          << "\" stroke-linecap=\"square\" d=\"M" << x[0] << " " << y[0];
+    for (size_t i = 1; i < x.size(); i++) {
+      m_svg << "H" << x[i] << "V" << y[i];
+    }
+    m_svg << "\"/>" << endl;
+  }
+
+  virtual void text(double x, double y, const string& s, double cap_height, int32_t anchor, bool vertical)
+  {
+    const char* text_anchor = (anchor == -1) ? "start" : ((anchor == 0) ? "middle" : "end");
+    // Shift the baseline down by half the cap height to center capitals on y
+    double baseline = cap_height / 2;
+    m_svg << "<text font-family=\"Helvetica, Arial, sans-serif\" font-size=\"" << font_size(cap_height)
+          << "\" text-anchor=\"" << text_anchor << "\"";
+    if (vertical) {
+      m_svg << " x=\"" << x + baseline << "\" y=\"" << y << "\" transform=\"rotate(-90 " << x + baseline << " " << y << ")\"";
+    } else {
+      m_svg << " x=\"" << x << "\" y=\"" << y + baseline << "\"";
+    }
+    m_svg << ">" << escape(s) << "</text>" << endl;
+  }
+
+  virtual double text_width(const string& s, double cap_height) const
+  {
+    // Average advance of a sans-serif font
+    return 0.55 * font_size(cap_height) * s.size();
+  }
+
+  virtual void set_clip(double x0, double y0, double x1, double y1)
+  {
+    clear_clip();
+    m_num_clips++;
+    m_svg << "<clipPath id=\"clip" << m_num_clips << "\"><rect x=\"" << x0 << "\" y=\"" << y0
+          << "\" width=\"" << x1 - x0 << "\" height=\"" << y1 - y0 << "\"/></clipPath>" << endl;
+    m_svg << "<g clip-path=\"url(#clip" << m_num_clips << ")\">" << endl;
+    m_clipped = true;
+  }
+
+  virtual void clear_clip()
+  {
+    if (m_clipped) m_svg << "</g>" << endl;
+    m_clipped = false;
+  }
+
+  virtual void write(const string& file_name)
+  {
+    clear_clip();
+    ofstream out(file_name.c_str());
+    ASSERT(out.good(), "Could not open file for writing: " + file_name);
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << endl;
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\""
+        << " width=\"" << m_width / m_pixels_per_inch << "in\" height=\"" << m_height / m_pixels_per_inch << "in\""
+        << " viewBox=\"0 0 " << m_width << " " << m_height << "\">" << endl;
+    out << "<rect x=\"0\" y=\"0\" width=\"" << m_width << "\" height=\"" << m_height << "\" fill=\"#ffffff\"/>" << endl;
+    out << m_svg.str();
+    out << "</svg>" << endl;
+    ASSERT(out.good(), "Error writing file: " + file_name);
+  }
+
+protected:
+
+  static double font_size(double cap_height)
+  {
+    return cap_height / 0.72;
+  }
+
+  static string escape(const string& s)
+  {
+    string escaped;
+    for (string::const_iterator it = s.begin(); it != s.end(); it++) {
+      switch (*it) {
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        default: escaped += *it;
+      }
+    }
+    return escaped;
+  }
+
+  double m_pixels_per_inch;
+  stringstream m_svg;
+  uint32_t m_num_clips;
+  bool m_clipped;
+};
+
+/*! Label for an axis tick. Integers are printed without exponents, like
+ *  format(scientific=FALSE) in R.
+ */
+static string tick_label(double value, double step)
+{
+  uint32_t decimals = 0;
+  while ((decimals < 10) && (step * pow(10.0, static_cast<double>(decimals)) < 0.999)) decimals++;
+  stringstream ss;
+  ss << fixed << setprecision(decimals) << value;
+  return ss.str();
+}
+
+vector<double> cCoveragePlot::pretty_ticks(double low, double high, uint32_t num_intervals)
+{
+  vector<double> ticks;
+  double range = high - low;
+  if ((range <= 0) || (num_intervals == 0)) {
+    ticks.push_back(low);
+    return ticks;
+  }
+
+  double magnitude = pow(10.0, floor(log10(range / num_intervals)));
+  double step = 10 * magnitude;
+  double multiples[] = {1, 2, 5};
+  for (uint32_t i = 0; i < 3; i++) {
+    if (multiples[i] * magnitude * num_intervals >= 0.75 * range) {
+      step = multiples[i] * magnitude;
+      break;
+    }
+  }
+
+  double epsilon = step * 1E-7;
+  for (double tick = ceil((low - epsilon) / step) * step; tick <= high + epsilon; tick += step) {
+    // Avoid printing -0
+    ticks.push_back((fabs(tick) < epsilon) ? 0.0 : tick);
+  }
+  return ticks;
+}
+
+void cCoveragePlot::draw(const vector<coverage_plot_position>& positions, const string& output_file_name, const string& format) const
+{
+  ASSERT(positions.size() > 0, "No positions to plot in coverage plot: " + output_file_name);
+
+  // Same page size and resolution as plot_coverage.r: 11 x 6 inches, 200 dpi
+  const double kPixelsPerInch = 200;
+  const uint32_t kWidth = 2200;
+  const uint32_t kHeight = 1200;
+  const double kMarginLine = 53;                // one line of margin for 16 point text
+  const double kLineWidth = kPixelsPerInch / 96; // R's lwd = 1
+  const double kTextHeight = 28;                // height of capitals
+  const double kLegendTextHeight = 21;
+
+  counted_ptr<cPlotCanvas> canvas(NULL);
+  if (format == "png")
+    canvas = counted_ptr<cPlotCanvas>(new cPlotRasterCanvas(kWidth, kHeight));
+  else if (format == "svg")
+    canvas = counted_ptr<cPlotCanvas>(new cPlotSvgCanvas(kWidth, kHeight, kPixelsPerInch));
+  else
+    ERROR("Unsupported coverage plot format '" + format + "'. Valid options are: png or svg");
+
+  // The plot takes 5 / 5.65 of the height and the legend the rest
+  double legend_top = kHeight * 5.0 / 5.65;
+  double plot_left = 5.1 * kMarginLine;
+  double plot_right = kWidth - 1.1 * kMarginLine;
+  double plot_top = 1.1 * kMarginLine;
+  double plot_bottom = legend_top - 4.1 * kMarginLine;
+
+  // Sum the coverage lines
+  size_t n = positions.size();
+  vector<double> unique_top(n), unique_bot(n), unique_tot(n);
+  vector<double> redundant_top(n), redundant_bot(n), redundant_tot(n), grand_tot(n);
+  vector<double> x(n);
+
+  double max_coverage = 0;
+  for (size_t i = 0; i < n; i++) {
+    const coverage_plot_position& p = positions[i];
+    x[i] = p.position;
+    unique_top[i] = p.unique_cov[0];
+    unique_bot[i] = p.unique_cov[1];
+    unique_tot[i] = unique_top[i] + unique_bot[i];
+    redundant_top[i] = p.redundant_cov[0];
+    redundant_bot[i] = p.redundant_cov[1];
+    redundant_tot[i] = redundant_top[i] + redundant_bot[i];
+    grand_tot[i] = unique_tot[i] + redundant_tot[i];
+    max_coverage = max(max_coverage, m_total_only ? grand_tot[i] : max(unique_tot[i], redundant_tot[i]));
+  }
+
+  double max_y = max_coverage + 5;
+  if (m_fixed_coverage_scale != 0)
+    max_y = m_fixed_coverage_scale;
+  else
+    max_y = max(max_y, m_average_coverage * 1.1);
+
+  double start_pos = positions.front().position;
+  double end_pos = positions.back().position;
+  if (end_pos <= start_pos) end_pos = start_pos + 1;
+
+  double window_start = m_window_start ? m_window_start : start_pos;
+  double window_end = m_window_end ? m_window_end : end_pos;
+
+  // Convert to pixels
+  double x_scale = (plot_right - plot_left) / (end_pos - start_pos);
+  double y_scale = (plot_bottom - plot_top) / max_y;
+  auto plot_x = [&](double v) { return plot_left + (v - start_pos) * x_scale; };
+  auto plot_y = [&](double v) { return plot_bottom - v * y_scale; };
+
+  for (size_t i = 0; i < n; i++) {
+    x[i] = plot_x(x[i]);
+    unique_top[i] = plot_y(unique_top[i]);
+    unique_bot[i] = plot_y(unique_bot[i]);
+    unique_tot[i] = plot_y(unique_tot[i]);
+    redundant_top[i] = plot_y(redundant_top[i]);
+    redundant_bot[i] = plot_y(redundant_bot[i]);
+    redundant_tot[i] = plot_y(redundant_tot[i]);
+    grand_tot[i] = plot_y(grand_tot[i]);
+  }
+
+  canvas->set_clip(plot_left, plot_top, plot_right, plot_bottom);
+
+  // Shaded flanking regions
+  if (window_start > start_pos)
+    canvas->fill_rect(plot_x(start_pos), plot_top, plot_x(window_start), plot_bottom, kPlotGrey85);
+  if (window_end + 1 < end_pos)
+    canvas->fill_rect(plot_x(window_end + 1), plot_top, plot_x(end_pos), plot_bottom, kPlotGrey85);
+
+  if (m_average_coverage != 0) {
+    canvas->step_line(make_vector<double>(plot_left)(plot_right),
+                      make_vector<double>(plot_y(m_average_coverage))(plot_y(m_average_coverage)),
+                      kPlotDarkGrey, 4.0 * kLineWidth);
+  }
+
+  if (m_total_only)
+    canvas->step_line(x, grand_tot, kPlotGreen, 4.0 * kLineWidth);
+
+  canvas->step_line(x, redundant_tot, kPlotRed, 1.5 * kLineWidth);
+  if (!m_total_only) {
+    canvas->step_line(x, redundant_top, kPlotYellow, 0.7 * kLineWidth);
+    canvas->step_line(x, redundant_bot, kPlotOrange, 0.7 * kLineWidth);
+  }
+
+  canvas->step_line(x, unique_tot, kPlotBlue, 1.5 * kLineWidth);
+  if (!m_total_only) {
+    canvas->step_line(x, unique_top, kPlotCyan, 0.7 * kLineWidth);
+    canvas->step_line(x, unique_bot, kPlotPurple, 0.7 * kLineWidth);
+  }
+
+  canvas->clear_clip();
+
+  // Axes
+  canvas->stroke_rect(plot_left, plot_top, plot_right, plot_bottom, kPlotBlack, kLineWidth);
+
+  double tick_length = 0.5 * kMarginLine;
+  vector<double> x_ticks = pretty_ticks(start_pos, end_pos);
+  double x_step = (x_ticks.size() > 1) ? x_ticks[1] - x_ticks[0] : 1;
+  for (vector<double>::iterator it = x_ticks.begin(); it != x_ticks.end(); it++) {
+    double px = plot_x(*it);
+    canvas->fill_rect(px - kLineWidth / 2, plot_bottom, px + kLineWidth / 2, plot_bottom + tick_length, kPlotBlack);
+    canvas->text(px, plot_bottom + 1.5 * kMarginLine, tick_label(*it, x_step), kTextHeight, 0, false);
+  }
+
+  vector<double> y_ticks = pretty_ticks(0, max_y);
+  double y_step = (y_ticks.size() > 1) ? y_ticks[1] - y_ticks[0] : 1;
+  for (vector<double>::iterator it = y_ticks.begin(); it != y_ticks.end(); it++) {
+    double py = plot_y(*it);
+    canvas->fill_rect(plot_left - tick_length, py - kLineWidth / 2, plot_left, py + kLineWidth / 2, kPlotBlack);
+    canvas->text(plot_left - 1.5 * kMarginLine, py, tick_label(*it, y_step), kTextHeight, 0, true);
+  }
+
+  canvas->text((plot_left + plot_right) / 2, plot_bottom + 3.2 * kMarginLine, "Coordinate in Reference Genome", kTextHeight, 0, false);
+  canvas->text(plot_left - 3.5 * kMarginLine, (plot_top + plot_bottom) / 2, "Read Coverage Depth", kTextHeight, 0, true);
+
+  // Legend
+  vector<string> labels;
+  vector<cPlotColor> colors;
+  if (m_average_coverage != 0) {
+    labels.push_back("average");
+    colors.push_back(kPlotDarkGrey);
+  }
+  if (!m_total_only) {
+    vector<string> line_labels = make_vector<string>("unique total")("unique top")("unique bottom")("repeat total")("repeat top")("repeat bottom");
+    vector<cPlotColor> line_colors = make_vector<cPlotColor>(kPlotBlue)(kPlotCyan)(kPlotPurple)(kPlotRed)(kPlotYellow)(kPlotOrange);
+    labels.insert(labels.end(), line_labels.begin(), line_labels.end());
+    colors.insert(colors.end(), line_colors.begin(), line_colors.end());
+  } else {
+    vector<string> line_labels = make_vector<string>("total")("unique total")("repeat total");
+    vector<cPlotColor> line_colors = make_vector<cPlotColor>(kPlotGreen)(kPlotBlue)(kPlotRed);
+    labels.insert(labels.end(), line_labels.begin(), line_labels.end());
+    colors.insert(colors.end(), line_colors.begin(), line_colors.end());
+  }
+
+  double box_size = 1.3 * kLegendTextHeight;
+  double box_gap = 0.6 * kLegendTextHeight;
+  double entry_gap = 2.0 * kLegendTextHeight;
+  double legend_width = 0;
+  for (size_t i = 0; i < labels.size(); i++) {
+    legend_width += box_size + box_gap + canvas->text_width(labels[i], kLegendTextHeight);
+  }
+  legend_width += entry_gap * (labels.size() - 1);
+
+  double legend_x = (kWidth - legend_width) / 2;
+  double legend_y = (legend_top + kHeight) / 2;
+  for (size_t i = 0; i < labels.size(); i++) {
+    canvas->fill_rect(legend_x, legend_y - box_size / 2, legend_x + box_size, legend_y + box_size / 2, colors[i]);
+    canvas->stroke_rect(legend_x, legend_y - box_size / 2, legend_x + box_size, legend_y + box_size / 2, kPlotBlack, kLineWidth / 2);
+    legend_x += box_size + box_gap;
+    canvas->text(legend_x, legend_y, labels[i], kLegendTextHeight, -1, false);
+    legend_x += canvas->text_width(labels[i], kLegendTextHeight) + entry_gap;
+  }
+
+  canvas->write(output_file_name);
+}
+
+} // namespace breseq
@@ -0,0 +1,240 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#include "libbreseq/coverage_profile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace breseq {
+
+// File layout: magic, number of targets, then (length, present) for each
+// target, then the counts of each present target in order. Every field is
+// 8 bytes so that the mapped counts are aligned.
+static const char coverage_profile_magic[8] = { 'B', 'R', 'S', 'Q', 'C', 'O', 'V', '2' };
+
+coverage_counts* cCoverageProfile::allocate_target(uint32_t target_id, uint32_t length)
+{
+  if (target_id >= m_targets.size()) m_targets.resize(target_id + 1);
+
+  target_profile& t = m_targets[target_id];
+  coverage_counts zero = { {0, 0}, {0, 0}, {0, 0}, {0.0f, 0.0f} };
+  t.storage.assign(length, zero);
+  t.length = length;
+  t.counts = t.storage.size() ? &(t.storage[0]) : NULL;
+  return t.counts;
+}
+
+void cCoverageProfile::clear()
+{
+  m_targets.clear();
+  if (m_mapped_data) munmap(m_mapped_data, m_mapped_size);
+  m_mapped_data = NULL;
+  m_mapped_size = 0;
+}
+
+void cCoverageProfile::write(const string& file_name) const
+{
+  ofstream out(file_name.c_str(), ios::out | ios::binary);
+  ASSERT(out.good(), "Could not open file for writing: " + file_name);
+
+  out.write(coverage_profile_magic, sizeof(coverage_profile_magic));
+  uint64_t num_targets = m_targets.size();
+  out.write(reinterpret_cast<const char*>(&num_targets), sizeof(num_targets));
+
+  for (uint32_t i = 0; i < m_targets.size(); i++) {
+    uint64_t header[2] = { has_target(i) ? m_targets[i].length : 0, has_target(i) ? 1u : 0u };
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+  }
+
+  for (uint32_t i = 0; i < m_targets.size(); i++) {
+    if (!has_target(i)) continue;
+    out.write(reinterpret_cast<const char*>(m_targets[i].counts), sizeof(coverage_counts) * m_targets[i].length);
+  }
+
+  ASSERT(out.good(), "Error writing file: " + file_name);
+}
+
+bool cCoverageProfile::map(const string& file_name)
+{
+  clear();
+
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat file_stat;
+  bool ok = (fstat(fd, &file_stat) == 0) && (file_stat.st_size >= static_cast<off_t>(2 * sizeof(uint64_t)));
+  if (ok) {
+    m_mapped_size = file_stat.st_size;
+    m_mapped_data = mmap(NULL, m_mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m_mapped_data == MAP_FAILED) {
+      m_mapped_data = NULL;
+      ok = false;
+    }
+  }
+  close(fd);
+  ASSERT(ok, "Could not map coverage file: " + file_name);
+
+  const char* data = static_cast<const char*>(m_mapped_data);
+  ASSERT(memcmp(data, coverage_profile_magic, sizeof(coverage_profile_magic)) == 0, "Not a coverage file: " + file_name);
+
+  const uint64_t* header = reinterpret_cast<const uint64_t*>(data + sizeof(coverage_profile_magic));
+  uint64_t num_targets = header[0];
+  size_t offset = sizeof(coverage_profile_magic) + sizeof(uint64_t) * (1 + 2 * num_targets);
+  ASSERT(offset <= m_mapped_size, "Coverage file is truncated: " + file_name);
+
+  m_targets.resize(num_targets);
+  for (uint32_t i = 0; i < num_targets; i++) {
+    uint64_t length = header[1 + 2 * i];
+    if (!header[2 + 2 * i]) continue;
+
+    ASSERT(offset + sizeof(coverage_counts) * length <= m_mapped_size, "Coverage file is truncated: " + file_name);
+    m_targets[i].length = length;
+    m_targets[i].counts = reinterpret_cast<coverage_counts*>(const_cast<char*>(data + offset));
+    offset += sizeof(coverage_counts) * length;
+  }
+
+  return true;
+}
+
+// File layout: magic, first position, number of positions, capacity, length of
+// the seq_id, then the seq_id padded to 8 bytes. Column i starts capacity * i
+// values after that.
+static const char coverage_column_file_magic[8] = { 'B', 'R', 'S', 'Q', 'C', 'O', 'L', '1' };
+static const uint32_t coverage_column_file_chunk_size = 65536;
+
+void cCoverageColumnFile::create(const string& file_name, const string& seq_id, uint32_t capacity)
+{
+  close();
+
+  m_out.open(file_name.c_str(), ios::out | ios::binary);
+  ASSERT(m_out.good(), "Could not open file for writing: " + file_name);
+
+  m_seq_id = seq_id;
+  m_first_position = 0;
+  m_num_positions = 0;
+  m_capacity = capacity;
+  m_chunk_start = 0;
+
+  uint64_t header[4] = { 0, 0, m_capacity, m_seq_id.size() };
+  m_out.write(coverage_column_file_magic, sizeof(coverage_column_file_magic));
+  m_out.write(reinterpret_cast<const char*>(header), sizeof(header));
+  string padded_seq_id = m_seq_id + string((8 - m_seq_id.size() % 8) % 8, '\0');
+  m_out.write(padded_seq_id.c_str(), padded_seq_id.size());
+  m_columns_offset = sizeof(coverage_column_file_magic) + sizeof(header) + padded_seq_id.size();
+}
+
+void cCoverageColumnFile::add(uint32_t position,
+                              uint32_t unique_top, uint32_t unique_bot,
+                              double redundant_top, double redundant_bot,
+                              uint32_t raw_redundant_top, uint32_t raw_redundant_bot,
+                              double e_value)
+{
+  ASSERT(m_out.is_open(), "Coverage file is not open for writing.");
+  if (m_num_positions == 0) m_first_position = position;
+  ASSERT(position == m_first_position + m_num_positions, "Coverage positions must be consecutive: " + m_seq_id + ":" + to_string(position));
+  ASSERT(m_num_positions < m_capacity, "Too many positions for coverage file: " + m_seq_id);
+
+  value_t v[NUM_COLUMNS];
+  v[UNIQUE_TOP].count = unique_top;
+  v[UNIQUE_BOT].count = unique_bot;
+  v[REDUNDANT_TOP].value = static_cast<float>(redundant_top);
+  v[REDUNDANT_BOT].value = static_cast<float>(redundant_bot);
+  v[RAW_REDUNDANT_TOP].count = raw_redundant_top;
+  v[RAW_REDUNDANT_BOT].count = raw_redundant_bot;
+  v[E_VALUE].value = static_cast<float>(e_value);
+  for (uint32_t c = 0; c < NUM_COLUMNS; c++) m_chunk[c].push_back(v[c]);
+
+  m_num_positions++;
+  if (m_chunk[0].size() == coverage_column_file_chunk_size) flush_chunk();
+}
+
+void cCoverageColumnFile::flush_chunk()
+{
+  if (m_chunk[0].size() == 0) return;
+
+  for (uint32_t c = 0; c < NUM_COLUMNS; c++) {
+    m_out.seekp(m_columns_offset + (static_cast<size_t>(c) * m_capacity + m_chunk_start) * sizeof(value_t));
+    m_out.write(reinterpret_cast<const char*>(&(m_chunk[c][0])), m_chunk[c].size() * sizeof(value_t));
+    m_chunk[c].clear();
+  }
+  m_chunk_start = m_num_positions;
+}
+
+void cCoverageColumnFile::close()
+{
+  if (m_out.is_open()) {
+    flush_chunk();
+    uint64_t counts[2] = { m_first_position, m_num_positions };
+    m_out.seekp(sizeof(coverage_column_file_magic));
+    m_out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+    ASSERT(m_out.good(), "Error writing coverage file for: " + m_seq_id);
+    m_out.close();
+  }
+
+  if (m_mapped_data) munmap(m_mapped_data, m_mapped_size);
+  m_mapped_data = NULL;
+  m_mapped_size = 0;
+  m_num_positions = 0;
+}
+
+void cCoverageColumnFile::map(const string& file_name)
+{
+  close();
+
+  int fd = open(file_name.c_str(), O_RDONLY);
+  ASSERT(fd >= 0, "Could not open coverage file: " + file_name);
+
+  struct stat file_stat;
+  bool ok = (fstat(fd, &file_stat) == 0) && (file_stat.st_size >= static_cast<off_t>(sizeof(coverage_column_file_magic) + 4 * sizeof(uint64_t)));
+  if (ok) {
+    m_mapped_size = file_stat.st_size;
+    m_mapped_data = mmap(NULL, m_mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m_mapped_data == MAP_FAILED) {
+      m_mapped_data = NULL;
+      ok = false;
+    }
+  }
+  ::close(fd);
+  ASSERT(ok, "Could not map coverage file: " + file_name);
+
+  const char* data = static_cast<const char*>(m_mapped_data);
+  ASSERT(memcmp(data, coverage_column_file_magic, sizeof(coverage_column_file_magic)) == 0, "Not a coverage file: " + file_name);
+
+  const uint64_t* header = reinterpret_cast<const uint64_t*>(data + sizeof(coverage_column_file_magic));
+  m_first_position = header[0];
+  m_num_positions = header[1];
+  m_capacity = header[2];
+  size_t seq_id_size = header[3];
+
+  size_t offset = sizeof(coverage_column_file_magic) + 4 * sizeof(uint64_t);
+  ASSERT(offset + seq_id_size <= m_mapped_size, "Coverage file is truncated: " + file_name);
+  m_seq_id = string(data + offset, seq_id_size);
+  offset += seq_id_size + (8 - seq_id_size % 8) % 8;
+
+  for (uint32_t c = 0; c < NUM_COLUMNS; c++) {
+    size_t column_offset = offset + static_cast<size_t>(c) * m_capacity * sizeof(value_t);
+    ASSERT(!m_num_positions || (column_offset + m_num_positions * sizeof(value_t) <= m_mapped_size), "Coverage file is truncated: " + file_name);
+    m_columns[c] = data + column_offset;
+  }
+}
+
+} // namespace breseq
@@ -22,6 +22,78 @@ using namespace std;
 
 namespace breseq {
   
+  const char cPackedSequence::s_code_to_base[4] = {'A', 'C', 'G', 'T'};
+  
+  bool cPackedSequence::pack(const string& sequence)
+  {
+    clear();
+    
+    // Runs are stored as uint32_t
+    if (sequence.length() > numeric_limits<uint32_t>::max()) return false;
+    
+    // Not worth it if each run takes more space than the bases it covers saved
+    const size_t max_runs = sequence.length() / 16 + 1;
+    
+    int8_t base_to_code[256];
+    memset(base_to_code, -1, sizeof(base_to_code));
+    base_to_code[static_cast<uint8_t>('A')] = 0;
+    base_to_code[static_cast<uint8_t>('C')] = 1;
+    base_to_code[static_cast<uint8_t>('G')] = 2;
+    base_to_code[static_cast<uint8_t>('T')] = 3;
+    
+    m_bases.assign((sequence.length() + 3) / 4, 0);
+    for (size_t i = 0; i < sequence.length(); i++) {
+      const char c = sequence[i];
+      const int8_t code = base_to_code[static_cast<uint8_t>(c)];
+      if (code >= 0) {
+        m_bases[i >> 2] |= code << ((i & 3) << 1);
+        continue;
+      }
+      
+      // Extend the previous run or start a new one
+      if (!m_run_start.empty() && (m_run_char[m_run_char.size()-1] == c) && (m_run_start.back() + m_run_length.back() == i)) {
+        m_run_length.back()++;
+      } else {
+        if (m_run_start.size() == max_runs) {
+          clear();
+          return false;
+        }
+        m_run_start.push_back(i);
+        m_run_length.push_back(1);
+        m_run_char += c;
+      }
+    }
+    
+    m_length = sequence.length();
+    return true;
+  }
+  
+  void cPackedSequence::get_sequence_0(const size_t start_0, const size_t length, string& sequence) const
+  {
+    // Not an ASSERT, so that the message is only built on failure
+    if (start_0 + length > m_length) {
+      ERROR("Range " + to_string(start_0) + "+" + to_string(length) + " is outside of packed sequence of length " + to_string(m_length));
+    }
+    
+    sequence.resize(length);
+    for (size_t i = 0; i < length; i++) {
+      const size_t pos_0 = start_0 + i;
+      sequence[i] = s_code_to_base[(m_bases[pos_0 >> 2] >> ((pos_0 & 3) << 1)) & 3];
+    }
+    
+    // Overwrite with any runs that overlap, starting with the last one that begins at or before start_0
+    const size_t end_0 = start_0 + length;
+    size_t run = upper_bound(m_run_start.begin(), m_run_start.end(), start_0) - m_run_start.begin();
+    if (run > 0) run--;
+    for ( ; (run < m_run_start.size()) && (m_run_start[run] < end_0); run++) {
+      const size_t run_start_0 = max(static_cast<size_t>(m_run_start[run]), start_0);
+      const size_t run_end_0 = min(static_cast<size_t>(m_run_start[run]) + m_run_length[run], end_0);
+      for (size_t pos_0 = run_start_0; pos_0 < run_end_0; pos_0++) {
+        sequence[pos_0 - start_0] = m_run_char[run];
+      }
+    }
+  }
+  
   //constructor
   cFastaFile::cFastaFile(const string &file_name, ios_base::openmode mode) 
     : fstream(file_name.c_str(), mode)
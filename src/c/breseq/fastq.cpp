@@ -18,11 +18,22 @@
 
 #include "libbreseq/fastq.h"
 #include "libbreseq/reference_sequence.h"
+#include "libbreseq/trace.h"
 
 using namespace std;
 
 namespace breseq {
   
+  // Mixes the position of a read in its file into a uniformly distributed value
+  // (splitmix64), so that subsampling is random but the same on every run
+  inline uint64_t read_position_hash(uint64_t position)
+  {
+    uint64_t z = position + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+  
   /*
    normalize_fastq
    
@@ -38,6 +49,7 @@ namespace breseq {
                                         const bool filter_reads,
                                         uint64_t current_read_file_bases,
                                         const uint64_t read_file_base_limit,
+                                        const double read_file_sample_fraction,
                                         const uint32_t _read_length_min,
                                         const double _max_same_base_fraction,
                                         const double _max_N_fraction
@@ -45,6 +57,8 @@ namespace breseq {
   {
     cerr << "    Converting/filtering FASTQ file..." << endl;
     
+    TRACE_SCOPE(trace, "normalize_fastq predict format");
+
     // Set up maps between formats
     map<string,uint8_t> format_to_chr_offset;
     format_to_chr_offset["SANGER"] = 33;
@@ -109,9 +123,28 @@ namespace breseq {
     
     // (much faster than looking through all qualities again)
     
+    // Keep each read with this probability, deciding by a hash of its position
+    // so that no reads need to be held in memory. Every file is given the same
+    // fraction, so reads at the same position in paired files stay together.
+    bool sample_reads = (read_file_sample_fraction > 0) && (read_file_sample_fraction < 1);
+    uint64_t sample_threshold = 0;
+    if (sample_reads) {
+      sample_threshold = static_cast<uint64_t>(read_file_sample_fraction * 18446744073709551616.0);
+      cerr << "    Sampling reads at random: " << formatted_double(100 * read_file_sample_fraction, 1).to_string() << "%" << endl;
+    }
+    
+    TRACE_NEXT(trace, "normalize_fastq convert and filter");
+
     uint32_t on_read = 1;
+    uint64_t on_original_read = 0;
     while (input_fastq_file.read_sequence(on_sequence, fqc)) {
       
+      TRACE_COUNT("reads_read", 1);
+      
+      if (sample_reads && (read_position_hash(on_original_read++) >= sample_threshold)) {
+        continue;
+      }
+
       if ( filter_reads ) {
 
         // Discard sequences that are too short
@@ -176,6 +209,7 @@ namespace breseq {
       
       // convert base qualities
       output_fastq_file.write_sequence(on_sequence);
+      TRACE_COUNT("reads_written", 1);
       
       // check to see if we've reached the limit
       if (read_file_base_limit) {
@@ -22,6 +22,7 @@ LICENSE AND COPYRIGHT
 #include "libbreseq/mutation_predictor.h"
 #include "libbreseq/flagged_regions.h"
 #include "libbreseq/genome_diff.h"
+#include "libbreseq/genome_diff_index.h"
 #include "libbreseq/reference_sequence.h"
 #include "libbreseq/output.h"
 
@@ -41,6 +42,7 @@ int gdtools_usage()
 	uout << "MUTATIONS              (re)predict mutations from evidence" << endl;
   uout << "CHECK                  compare control versus test mutations" << endl;
   uout << "NORMALIZE              normalize mutation positions and annotations" << endl;
+  uout << "INDEX                  create binary indexes for faster loading of large files" << endl;
   //uout << "header                 create or add header entries" << endl;
   //uout << "mRNA-Stability         determine mRNA free energy difference of mutations" << endl;
 
@@ -998,9 +1000,18 @@ int do_not_evidence(int argc, char *argv[])
 void load_merge_multiple_gd_files(cGenomeDiff& gd, vector<cGenomeDiff>& gd_list, vector<string>& gd_path_names, vector<string>& gd_titles, cReferenceSequences& ref_seq_info, bool strip_to_mutations_and_unknown, bool& polymorphisms_found, bool compare_mode, AnyOption& options, UserOutput& uout)
 {
 	polymorphisms_found = false; // handled putting in the polymorphism column if only one file provided
+	
 	for (uint32_t i = 0; i < gd_path_names.size(); i++) {
 		uout("Reading input GD file",gd_path_names[i]);
-		cGenomeDiff single_gd(gd_path_names[i]);
+	}
+	
+	// Read all files at once, then merge them one at a time in the original order.
+	// Clean to the desired region here to avoid loading and merging everything
+	vector<cGenomeDiff> single_gd_list;
+	cGenomeDiff::read_multiple(single_gd_list, gd_path_names, from_string<uint32_t>(options["num-processors"]), &ref_seq_info, options.count("region") ? options["region"] : "");
+	
+	for (uint32_t i = 0; i < gd_path_names.size(); i++) {
+		cGenomeDiff& single_gd = single_gd_list[i];
 		
 		if (!compare_mode && (i==0)) {
 			diff_entry_list_t muts = single_gd.mutation_list();
@@ -1020,11 +1031,6 @@ void load_merge_multiple_gd_files(cGenomeDiff& gd, vector<cGenomeDiff>& gd_list,
 		// Safety for downstream operations - must strip_to_mutations_and_unknown if in compare mode
 		ASSERT(compare_mode || strip_to_mutations_and_unknown, "Unable to merge multiple GD files and preserve evidence entries.");
 		
-		// Clean to the desired region here to avoid
-		if (options.count("region")) {
-			single_gd.filter_to_within_region(ref_seq_info, options["region"]);
-		}
-		
 		// Decide whether to merge in a new column
 		if ( (!options.count("collapse")) || (single_gd.mutation_list().size() > 0)) {
 			gd.merge(single_gd, false, options.count("phylogeny-aware"));
@@ -1070,6 +1076,7 @@ int do_annotate(int argc, char* argv[])
 	options("region,g", "Only show mutations that overlap this reference sequence region (e.g., REL606:64722-65312)");
 	options("preserve-evidence,e", "By default evidence items with two-letter codes are removed (RA, JC, MC, ...). Supply this option to retain them. Only affects output in GD and JSON formats. This option can only be used with a single input GD file (i.e., not in COMPARE mode). ", TAKES_NO_ARGUMENT);
 	options("collapse,c", "Do not show samples (columns) unless they have at least one mutation", TAKES_NO_ARGUMENT);
+	options("num-processors,j", "Number of threads to use for reading input GD files", "1");
 	options.addUsage("");
 	options.addUsage("ANNOTATE mutations in one or more GenomeDiff files. If multiple input files are provided, then also COMPARE the frequencies for identical mutations across samples.");
   options.addUsage("");
@@ -1229,9 +1236,14 @@ int do_annotate(int argc, char* argv[])
 		
 		// Load the entire list and pass it to write_tsv
 		for (vector<string>::iterator it=gd_path_names.begin(); it!=gd_path_names.end(); it++) {
-			uout("Reading/annotating input GD file",*it);
-
-			cGenomeDiff this_gd(*it);
+			uout("Reading input GD file",*it);
+		}
+		vector<cGenomeDiff> single_gd_list;
+		cGenomeDiff::read_multiple(single_gd_list, gd_path_names, from_string<uint32_t>(options["num-processors"]));
+		
+		uout("Annotating mutations");
+		for (vector<cGenomeDiff>::iterator it=single_gd_list.begin(); it!=single_gd_list.end(); it++) {
+			cGenomeDiff& this_gd = *it;
 			//remove all but mutations
 			if (!options.count("preserve-evidence")) {
 				this_gd.remove_group(cGenomeDiff::EVIDENCE);
@@ -1340,6 +1352,7 @@ int do_phylogeny(int argc, char* argv[])
 	//options("ignore-pseudogenes", "treats pseudogenes as normal genes for calling AA changes", TAKES_NO_ARGUMENT);
 	options("missing-as-ancestral,a", "Count missing data (mutations in UN regions) as the ancestral allele rather than as an unknown allele (N).", TAKES_NO_ARGUMENT);
 	options("phylogeny-aware,p", "Check the optional 'phylogeny_id' field when deciding if entries are equivalent", TAKES_NO_ARGUMENT);
+	options("num-processors,j", "Number of threads to use for reading input GD files", "1");
 	
 	options.addUsage("");
 	options.addUsage("Uses PHYLIP to construct a phylogentic tree. If you are including an ancestor");
@@ -1385,9 +1398,8 @@ int do_phylogeny(int argc, char* argv[])
 	bool polymorphisms_found = false; // handled putting in the polymorphism column if only one file provided
 	for (uint32_t i = 0; i < gd_path_names.size(); i++){
 		uout("Reading input GD file",gd_path_names[i]);
-		cGenomeDiff single_gd(gd_path_names[i]);
-		gd_list.push_back(single_gd);
-	}    
+	}
+	cGenomeDiff::read_multiple(gd_list, gd_path_names, from_string<uint32_t>(options["num-processors"]));
 
 	uint32_t file_num = 1;
 	vector<string> title_list;
@@ -1495,6 +1507,7 @@ int do_count(int argc, char* argv[])
 	options("calculate-genome-size,s", "use APPLY to calculate final genome sizes", TAKES_NO_ARGUMENT);
 	options("base-substitution-statistics,b", "calculate detailed base substitution statistics", TAKES_NO_ARGUMENT);
 	options("count-polymorphisms,p", "count polymorphic mutations (those with frequencies < 1). (Default = FALSE)", TAKES_NO_ARGUMENT);
+	options("num-processors,j", "Number of threads to use for reading input GD files", "1");
 
 	options.addUsage("");
 	options.addUsage("Counts the numbers of mutations and other statistics for each input GenomeDiff file.");
@@ -1532,12 +1545,11 @@ int do_count(int argc, char* argv[])
   
   // Load and annotate genome diffs
   vector<cGenomeDiff> genome_diffs;
+  cGenomeDiff::read_multiple(genome_diffs, gd_path_names, from_string<uint32_t>(options["num-processors"]));
 	
   for (uint32_t i=0; i<gd_path_names.size(); i++) {
-    cGenomeDiff gd(gd_path_names[i]);
     uout("Annotating mutations " + gd_path_names[i]);
-    ref_seq_info.annotate_mutations(gd, true, options.count("ignore-pseudogenes"), false, kBreseq_large_mutation_size_cutoff, options.count("verbose"));
-    genome_diffs.push_back(gd);
+    ref_seq_info.annotate_mutations(genome_diffs[i], true, options.count("ignore-pseudogenes"), false, kBreseq_large_mutation_size_cutoff, options.count("verbose"));
   }
 	
 	
@@ -1690,7 +1702,7 @@ int do_normalize_gd(int argc, char* argv[])
 		
 		for (vector<string>::const_iterator it = seq_ids.begin(); it != seq_ids.end(); it++)
 		{
-			if (new_ref_seq_info[*it].m_fasta_sequence.get_sequence() != verify_ref_seq_info[*it].m_fasta_sequence.get_sequence()) {
+			if (!new_ref_seq_info[*it].m_fasta_sequence.has_same_sequence(verify_ref_seq_info[*it].m_fasta_sequence)) {
 				WARN("Failed APPLY test. Discrepancies beween sequences produced before and after NORMALIZE. Check ordering of mutations.");
 			}
 		}
@@ -2274,6 +2286,47 @@ int do_header(int argc, char* argv[])
   return 0;
 }
 
+int do_index(int argc, char* argv[])
+{
+  AnyOption options("gdtools INDEX [-r] input1.gd [input2.gd ...]");
+  options("help,h", "Display detailed help message", TAKES_NO_ARGUMENT);
+  options("remove,r", "Remove existing indexes instead of creating them", TAKES_NO_ARGUMENT);
+  options.processCommandArgs(argc, argv);
+  
+  options.addUsage("");
+  options.addUsage("Creates a binary index next to each GenomeDiff file (input.gd.gdx).");
+  options.addUsage("Other commands load entries from the index instead of parsing the");
+  options.addUsage("text file as long as the GenomeDiff file has not been modified.");
+  options.addUsage("With an index, --region options only load mutations in that region.");
+  
+  if (options.count("help")) {
+    options.printUsage();
+    return -1;
+  }
+  
+  if (!options.getArgc()) {
+    options.addUsage("");
+    options.addUsage("No input GenomeDiff files provided.");
+    options.printUsage();
+    return -1;
+  }
+  
+  UserOutput uout("INDEX");
+  
+  for (int32_t i = 0; i < options.getArgc(); ++i) {
+    string file_name = options.getArgv(i);
+    if (options.count("remove")) {
+      uout("Removing index for", file_name);
+      cGenomeDiffIndex::remove(file_name);
+    } else {
+      uout("Creating index for", file_name);
+      cGenomeDiffIndex::create(file_name);
+    }
+  }
+  
+  return 0;
+}
+
 int do_reheader(int argc, char* argv[])
 {
 	AnyOption options("gdtools REHEADER [-o output.gd] header.gd input.gd");
@@ -3628,6 +3681,8 @@ int main(int argc, char* argv[]) {
     return do_gd2circos(argc_new, argv_new);
   } else if(command == "MIRA2GD"){
     return do_mira2gd(argc_new, argv_new);
+  } else if(command == "INDEX"){
+    return do_index(argc_new, argv_new);
   } else if(command == "HEADER"){
     return do_header(argc_new, argv_new);
 	} else if(command == "REHEADER"){
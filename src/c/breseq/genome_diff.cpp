@@ -19,6 +19,7 @@ LICENSE AND COPYRIGHT
 #include "libbreseq/genome_diff.h"
 
 #include "libbreseq/flagged_regions.h"
+#include "libbreseq/genome_diff_index.h"
 #include "libbreseq/reference_sequence.h"
 #include "libbreseq/candidate_junctions.h"
 #include "libbreseq/mutation_predictor.h"
@@ -28,6 +29,9 @@ namespace breseq {
 
 uint32_t cGenomeDiff::s_input_order_counter(0);
   
+// Stream buffer size used when reading and writing GD files
+const size_t kGenomeDiffIOBufferSize = 1 << 20;
+  
 /*! Constructor.
  */
 cGenomeDiff::cGenomeDiff(const string& filename)
@@ -48,13 +52,28 @@ cGenomeDiff::cGenomeDiff(cGenomeDiff& merge1, cGenomeDiff& merge2, bool new_id,
 /*! Read a genome diff(.gd) from the given file to class member
  _entry_list
  */
-cFileParseErrors cGenomeDiff::read(const string& filename, bool suppress_errors) {
+cFileParseErrors cGenomeDiff::read(const string& filename, bool suppress_errors, bool use_index) {
   _file_path = filename;
   
   // title (old base_name) defaults to file name with no extension
   this->set_title(cString(filename).get_base_name_no_extension(true));
   
-  ifstream in(get_file_path().c_str());
+  // Entries in an up-to-date index were already checked and sorted
+  if (use_index) {
+    cGenomeDiffIndex gdx;
+    if (gdx.load(filename)) {
+      cFileParseErrors parse_errors(get_file_path());
+      gdx.restore(*this, parse_errors);
+      if (!suppress_errors) parse_errors.print_errors();
+      return parse_errors;
+    }
+  }
+  
+  // Large read buffer, must be set before the file is opened to take effect
+  vector<char> read_buffer(kGenomeDiffIOBufferSize);
+  ifstream in;
+  in.rdbuf()->pubsetbuf(&read_buffer[0], read_buffer.size());
+  in.open(get_file_path().c_str());
 
   ASSERT(in.good(), "Could not open file for reading: " + get_file_path());
   uint32_t line_number = 0;
@@ -80,108 +99,10 @@ cFileParseErrors cGenomeDiff::read(const string& filename, bool suppress_errors)
     }
     
     string whole_line = "";
-    string second_half = "";
-    
     getline(in, whole_line);
     line_number++;
     
-    vector<string> split_line = split_on_whitespace(whole_line);
-    
-    if(split_line.size() > 1)second_half = split_line[1];
-    for(size_t j = 2; j < split_line.size(); j++)  {
-      second_half += " " + split_line[j];  }    
-    
-    //Evaluate key.
-    if (split_line[0] == "#=GENOME_DIFF" && split_line.size() > 1) {
-      metadata.version = second_half;
-    }
-    else if (split_line[0] == "#=AUTHOR") { 
-      metadata.author = second_half;
-    }
-    else if (split_line[0] == "#=CREATED") {
-      metadata.created = second_half;
-    }
-    else if (split_line[0] == "#=PROGRAM") {
-      metadata.program = second_half;
-    }
-    else if (split_line[0] == "#=COMMAND") {
-      metadata.command = second_half;
-    }
-    else if (split_line[0] == "#=REFSEQ" && split_line.size() > 1) {
-      metadata.ref_seqs.push_back(second_half);
-    }
-    else if (split_line[0] == "#=READSEQ" && split_line.size() > 1) {
-      
-      string read_name = second_half;
-      metadata.read_seqs.push_back(read_name);
-      if (metadata.adapter_seqs.size() > 0) {
-        metadata.adapters_for_reads[read_name] = metadata.adapter_seqs.back();
-      }
-      
-      // Search for corresponding pair
-      string pair_name = read_name;
-      size_t pos = pair_name.find("_R1");
-      if (pos != string::npos) {
-        pair_name = pair_name.replace(pos+2, 1, "2");
-      }
-      else {
-        pos = pair_name.find("_R2");
-        if (pos != string::npos) {
-          pair_name = pair_name.replace(pos+2, 1, "1");
-        }
-      }
-      
-      bool found = false;
-      for (vector<vector<string> >::iterator it=metadata.reads_by_pair.begin(); it != metadata.reads_by_pair.end(); it++) {
-        for (vector<string>::iterator it2=it->begin(); it2 != it->end(); it2++) {
-          if (*it2 == pair_name) {
-            it->push_back(read_name);
-            found = true;
-            break;
-          }
-        }
-        if (found) break;
-      }
-      
-      if (!found) {
-        metadata.reads_by_pair.push_back(make_vector<string>(read_name));
-      }
-      
-    }
-    else if (split_line[0] == "#=ADAPTSEQ" && split_line.size() > 1) {
-      metadata.adapter_seqs.push_back(second_half);
-    }
-    
-    else if (split_line[0] == "#=TITLE" && split_line.size() > 1) {
-      this->set_title(second_half);
-    }
-    else if (split_line[0] == "#=TIME" && split_line.size() > 1) {
-      metadata.time = from_string<double>(second_half);
-    }
-    else if (split_line[0] == "#=POPULATION" && split_line.size() > 1) {
-      metadata.population = second_half;
-      replace(metadata.population.begin(), metadata.population.end(), ' ', '_');
-    }
-    else if (split_line[0] == "#=TREATMENT" && split_line.size() > 1) {
-      metadata.treatment = second_half;
-      replace(metadata.treatment.begin(), metadata.treatment.end(), ' ', '_');
-    }
-    else if (split_line[0] == "#=CLONE" && split_line.size() > 1) {
-      metadata.clone = second_half;
-      replace(metadata.clone.begin(), metadata.clone.end(), ' ', '_');
-    }
-    
-    // Add every header line to be output
-    else {
-      if (split_line[0].substr(0, 2) == "#=" && split_line.size() > 1) {                                                                     
-        string key = split_line[0].substr(2, split_line[0].size());
-        this->add_breseq_data(key, second_half);
-        continue;
-      } else {
-        //Warn if unknown header lines are encountered.
-        parse_errors.add_line_error(line_number, whole_line, "Metadata header line not recognized and will be ignored.", false);
-      }
-    }
+    read_header_line(whole_line, line_number, parse_errors);
   }
   
   /*Error if #=GENOME_DIFF is not found. Genome diff files are required to have
@@ -199,8 +120,11 @@ cFileParseErrors cGenomeDiff::read(const string& filename, bool suppress_errors)
   }
   
   //! Step: Handle the diff entries.
+  // The line buffer is reused and entries are parsed directly into the
+  // heap copy that is stored, so no per-line allocations or entry copies.
+  string line;
+  line.reserve(1024);
   while (in.good()) {
-    string line = "";
     breseq::getline(in, line);
     line_number++;
     //Warn if commented out or a possibly blank line is encountered.
@@ -212,14 +136,15 @@ cFileParseErrors cGenomeDiff::read(const string& filename, bool suppress_errors)
     } else if (line.find_first_not_of(' ') == string::npos) {
       continue;
     }
-    cDiffEntry de(line, line_number, &parse_errors);
-    de.valid_field_variable_types(parse_errors);
+    diff_entry_ptr_t de(new cDiffEntry(line, line_number, &parse_errors));
+    de->valid_field_variable_types(parse_errors);
     
     // Have to check for unique ids being used at this level
-    if (unique_id_used[de._id]) {
-      parse_errors.add_line_error(line_number,de.as_string(), "ID for this entry is not unique.", true);
+    map<string,bool>::const_iterator used_it = unique_id_used.find(de->_id);
+    if ((used_it != unique_id_used.end()) && used_it->second) {
+      parse_errors.add_line_error(line_number,de->as_string(), "ID for this entry is not unique.", true);
     }
-    if (de._type != UNKNOWN) add(de, false); // Don't reassign ids yet    
+    if (de->_type != UNKNOWN) add_entry_ptr(de, false); // Don't reassign ids yet
   }
   
   // Check to be sure all evidence referred to exists
@@ -257,6 +182,166 @@ cFileParseErrors cGenomeDiff::read(const string& filename, bool suppress_errors)
   return parse_errors;
 }
   
+/*! Read a genome diff, removing mutations that are not within the region.
+ 
+ With an up-to-date index, mutations outside of the region are never loaded.
+ */
+cFileParseErrors cGenomeDiff::read_within_region(const string& filename, cReferenceSequences& ref_seq_info, const string& region, bool suppress_errors)
+{
+  cFileParseErrors parse_errors(filename);
+  
+  cGenomeDiffIndex gdx;
+  if (gdx.load(filename)) {
+    _file_path = filename;
+    this->set_title(cString(filename).get_base_name_no_extension(true));
+    
+    uint32_t target_id, start_pos, end_pos;
+    ref_seq_info.parse_region(region, target_id, start_pos, end_pos);
+    gdx.restore_region(*this, parse_errors, ref_seq_info[target_id].m_seq_id, start_pos, end_pos);
+    if (!suppress_errors) parse_errors.print_errors();
+  } else {
+    parse_errors = this->read(filename, suppress_errors, false);
+  }
+  
+  // Exact test, the index only narrows down candidates by position
+  this->filter_to_within_region(ref_seq_info, region);
+  return parse_errors;
+}
+  
+/*! Read many genome diffs, in parallel if num_threads > 1.
+ 
+ Reading only touches the genome diff being filled, and errors are held
+ until the end, so that they are printed in the same order every time.
+ */
+void cGenomeDiff::read_multiple(vector<cGenomeDiff>& gd_list, const vector<string>& file_names, const uint32_t num_threads, cReferenceSequences* ref_seq_info, const string& region)
+{
+  ASSERT(region.empty() || ref_seq_info, "Reference sequences are required to read within a region.");
+  
+  // Construct here rather than in threads, input order comes from a shared counter
+  gd_list.clear();
+  gd_list.resize(file_names.size());
+  vector<cFileParseErrors> parse_errors_list(file_names.size());
+  
+  parallel_for(file_names.size(), num_threads, [&](const size_t i) {
+    if (region.empty()) {
+      parse_errors_list[i] = gd_list[i].read(file_names[i], true);
+    } else {
+      parse_errors_list[i] = gd_list[i].read_within_region(file_names[i], *ref_seq_info, region, true);
+    }
+  });
+  
+  for (size_t i = 0; i < file_names.size(); i++) {
+    parse_errors_list[i].print_errors();
+    if (parse_errors_list[i].fatal()) {
+      ERROR("Parse errors in loading GenomeDiff File. Not safe to continue");
+    }
+  }
+}
+  
+/*! Read one '#=KEY value' metadata header line into this genome diff.
+ */
+void cGenomeDiff::read_header_line(const string& whole_line, uint32_t line_number, cFileParseErrors& parse_errors)
+{
+  string second_half = "";
+  
+  vector<string> split_line = split_on_whitespace(whole_line);
+  
+  if(split_line.size() > 1)second_half = split_line[1];
+  for(size_t j = 2; j < split_line.size(); j++)  {
+    second_half += " " + split_line[j];  }    
+  
+  //Evaluate key.
+  if (split_line[0] == "#=GENOME_DIFF" && split_line.size() > 1) {
+    metadata.version = second_half;
+  }
+  else if (split_line[0] == "#=AUTHOR") { 
+    metadata.author = second_half;
+  }
+  else if (split_line[0] == "#=CREATED") {
+    metadata.created = second_half;
+  }
+  else if (split_line[0] == "#=PROGRAM") {
+    metadata.program = second_half;
+  }
+  else if (split_line[0] == "#=COMMAND") {
+    metadata.command = second_half;
+  }
+  else if (split_line[0] == "#=REFSEQ" && split_line.size() > 1) {
+    metadata.ref_seqs.push_back(second_half);
+  }
+  else if (split_line[0] == "#=READSEQ" && split_line.size() > 1) {
+    
+    string read_name = second_half;
+    metadata.read_seqs.push_back(read_name);
+    if (metadata.adapter_seqs.size() > 0) {
+      metadata.adapters_for_reads[read_name] = metadata.adapter_seqs.back();
+    }
+    
+    // Search for corresponding pair
+    string pair_name = read_name;
+    size_t pos = pair_name.find("_R1");
+    if (pos != string::npos) {
+      pair_name = pair_name.replace(pos+2, 1, "2");
+    }
+    else {
+      pos = pair_name.find("_R2");
+      if (pos != string::npos) {
+        pair_name = pair_name.replace(pos+2, 1, "1");
+      }
+    }
+    
+    bool found = false;
+    for (vector<vector<string> >::iterator it=metadata.reads_by_pair.begin(); it != metadata.reads_by_pair.end(); it++) {
+      for (vector<string>::iterator it2=it->begin(); it2 != it->end(); it2++) {
+        if (*it2 == pair_name) {
+          it->push_back(read_name);
+          found = true;
+          break;
+        }
+      }
+      if (found) break;
+    }
+    
+    if (!found) {
+      metadata.reads_by_pair.push_back(make_vector<string>(read_name));
+    }
+    
+  }
+  else if (split_line[0] == "#=ADAPTSEQ" && split_line.size() > 1) {
+    metadata.adapter_seqs.push_back(second_half);
+  }
+  
+  else if (split_line[0] == "#=TITLE" && split_line.size() > 1) {
+    this->set_title(second_half);
+  }
+  else if (split_line[0] == "#=TIME" && split_line.size() > 1) {
+    metadata.time = from_string<double>(second_half);
+  }
+  else if (split_line[0] == "#=POPULATION" && split_line.size() > 1) {
+    metadata.population = second_half;
+    replace(metadata.population.begin(), metadata.population.end(), ' ', '_');
+  }
+  else if (split_line[0] == "#=TREATMENT" && split_line.size() > 1) {
+    metadata.treatment = second_half;
+    replace(metadata.treatment.begin(), metadata.treatment.end(), ' ', '_');
+  }
+  else if (split_line[0] == "#=CLONE" && split_line.size() > 1) {
+    metadata.clone = second_half;
+    replace(metadata.clone.begin(), metadata.clone.end(), ' ', '_');
+  }
+  
+  // Add every header line to be output
+  else {
+    if (split_line[0].substr(0, 2) == "#=" && split_line.size() > 1) {                                                                     
+      string key = split_line[0].substr(2, split_line[0].size());
+      this->add_breseq_data(key, second_half);
+    } else {
+      //Warn if unknown header lines are encountered.
+      parse_errors.add_line_error(line_number, whole_line, "Metadata header line not recognized and will be ignored.", false);
+    }
+  }
+}
+  
 // Helper struct for below
 typedef struct  {
   cReferenceCoordinate start;
@@ -672,7 +757,13 @@ void cGenomeDiff::write(const string& filename) {
   if (dir.size()) {
     create_path(dir);
   }
-  ofstream os(filename.c_str());
+  // An index would no longer match what is written
+  cGenomeDiffIndex::remove(filename);
+  
+  vector<char> write_buffer(kGenomeDiffIOBufferSize);
+  ofstream os;
+  os.rdbuf()->pubsetbuf(&write_buffer[0], write_buffer.size());
+  os.open(filename.c_str());
   
   
   //! Step: Header lines.
@@ -731,13 +822,19 @@ void cGenomeDiff::write(const string& filename) {
   // @JEB: "comment_out" tag is legacy used internally for filtering where
   // deletion from the list should really be used.
   
+  // Each line is formatted into one reused string and written as a block
+  // (fprintf() to an ostream also truncates lines longer than its buffer).
+  string line;
+  line.reserve(1024);
   for(diff_entry_list_t::iterator it=_entry_list.begin(); it!=_entry_list.end(); ++it) {
-    if (!(*it)->entry_exists("comment_out")) {
-      fprintf(os, "%s\n", (**it).as_string().c_str());
-    } else {
+    line.clear();
+    if ((*it)->entry_exists("comment_out")) {
       (*it)->erase("comment_out");
-      fprintf(os, "#%s\n", (**it).as_string().c_str());
+      line += '#';
     }
+    (*it)->append_to_string(line);
+    line += '\n';
+    os.write(line.c_str(), line.size());
   }
   os.close();
 
@@ -758,6 +855,9 @@ uint32_t cGenomeDiff::new_unique_id()
   {
     assigned_id++;
   }
+  
+  // Everything up to here is used, so don't scan over it again next time
+  _unique_id_counter = assigned_id;
   return assigned_id;
 }
 
@@ -798,6 +898,15 @@ diff_entry_ptr_t cGenomeDiff::add(const cDiffEntry& item, bool assign_unique_id)
   // allocating counted_ptr takes care of disposal
   cDiffEntry* diff_entry_copy = new cDiffEntry(item);
   diff_entry_ptr_t added_item(diff_entry_copy);
+  return add_entry_ptr(added_item, assign_unique_id);
+}
+  
+/*! Add evidence to this genome diff, taking ownership of the existing pointer.
+ */
+diff_entry_ptr_t cGenomeDiff::add_entry_ptr(diff_entry_ptr_t& added_item, bool assign_unique_id) {
+  
+  ASSERT(added_item->_type != UNKNOWN, "Tried to add item of type UNKNOWN to Genome Diff file.");
+  
   _entry_list.push_back(added_item);
   
 
@@ -1262,16 +1371,16 @@ void cGenomeDiff::set_intersect(cGenomeDiff &gd, bool verbose)
 {
   (void)verbose; //unused
   
-  set<cDiffEntry> seen;
-  diff_entry_list_t muts = gd.mutation_list();
-  
-  for (diff_entry_list_t::iterator it = muts.begin(); it != muts.end(); ++it) {
-    seen.insert(**it);
-  }
-
   this->remove_group(cGenomeDiff::EVIDENCE);
   this->remove_group(cGenomeDiff::VALIDATION);
   
+  // Both lists are sorted, so we can walk through them together
+  gd.sort();
+  this->sort();
+  
+  diff_entry_list_t muts = gd.mutation_list();
+  diff_entry_list_t::iterator it_seen = muts.begin();
+  
   diff_entry_list_t::iterator it = _entry_list.begin();
   
   //Handle mutations
@@ -1280,7 +1389,12 @@ void cGenomeDiff::set_intersect(cGenomeDiff &gd, bool verbose)
   while (it != _entry_list.end()) {
     it_advance = true;
     
-    if ( !seen.count(**it) ) {
+    // Skip over mutations that can't match this one or any after it
+    while ( (it_seen != muts.end()) && (**it_seen < **it) ) {
+      it_seen++;
+    }
+    
+    if ( (it_seen == muts.end()) || (**it < **it_seen) ) {
       it = _entry_list.erase(it);
       it_advance = false;
     } else {
@@ -1429,12 +1543,28 @@ void cGenomeDiff::merge(const cGenomeDiff& in_merge_gd, bool reassign_ids, bool
   /// Add the new entries to *this* list and sort.
   /////////////////////////////////////////////////////////////
   
+  // Add them by themselves and then merge the two sorted lists, rather than
+  // sorting everything again.
+  diff_entry_list_t existing_list;
+  existing_list.swap(_entry_list);
+  
   for (diff_entry_list_t::iterator it = new_gd._entry_list.begin(); it != new_gd._entry_list.end(); it++) {
     (**it)["_just_added"] = "1";
     this->add(**it, true);
   }
   this->sort();
   
+  existing_list.merge(_entry_list, diff_entry_ptr_sort);
+  _entry_list.swap(existing_list);
+  
+  // Lookup tables for finding what entries referred to after merging
+  map<string, diff_entry_ptr_t> merge_id_table;
+  for (diff_entry_list_t::iterator it = merge_gd._entry_list.begin(); it != merge_gd._entry_list.end(); it++) {
+    // Keep the first, like find_by_id()
+    merge_id_table.insert(make_pair((*it)->_id, *it));
+  }
+  vector<diff_entry_ptr_t> sorted_entries(_entry_list.begin(), _entry_list.end());
+  
   /////////////////////////////////////////////////////////////
   /// Update evidence items
   /////////////////////////////////////////////////////////////
@@ -1456,16 +1586,17 @@ void cGenomeDiff::merge(const cGenomeDiff& in_merge_gd, bool reassign_ids, bool
     {
       string& evidence_id = *evidence_id_it;
       
-      diff_entry_ptr_t looking_for = merge_gd.find_by_id(evidence_id);
-      if (looking_for.get() == NULL) continue;
+      map<string, diff_entry_ptr_t>::iterator looking_for_it = merge_id_table.find(evidence_id);
+      if (looking_for_it == merge_id_table.end()) continue;
+      diff_entry_ptr_t& looking_for = looking_for_it->second;
       
       //cout << "Looking for: " << looking_for->as_string() << endl;
       
       // Binary search for the match
-      pair<diff_entry_list_t::iterator, diff_entry_list_t::iterator> match;
-      match = equal_range(_entry_list.begin(), _entry_list.end(), looking_for);
+      pair<vector<diff_entry_ptr_t>::iterator, vector<diff_entry_ptr_t>::iterator> match;
+      match = equal_range(sorted_entries.begin(), sorted_entries.end(), looking_for);
       
-      if (match.first != _entry_list.end()) {
+      if (match.first != sorted_entries.end()) {
         
         if (verbose) {
           cout << "Mutation:" << endl << mut.as_string() << endl;
@@ -1513,17 +1644,18 @@ void cGenomeDiff::merge(const cGenomeDiff& in_merge_gd, bool reassign_ids, bool
         
         // looking for original entry
         // ---> note that this is unchanged for phylogeny mode
-        diff_entry_ptr_t looking_for = merge_gd.find_by_id(split_value[0]);
+        map<string, diff_entry_ptr_t>::iterator looking_for_it = merge_id_table.find(split_value[0]);
         
-        if (looking_for.get() == NULL) continue;
+        if (looking_for_it == merge_id_table.end()) continue;
+        diff_entry_ptr_t& looking_for = looking_for_it->second;
         
         //cout << "Looking for: " << looking_for->as_string() << endl;
         
         // Binary search for the match
-        pair<diff_entry_list_t::iterator, diff_entry_list_t::iterator> match;
-        match = equal_range(_entry_list.begin(), _entry_list.end(), looking_for);
+        pair<vector<diff_entry_ptr_t>::iterator, vector<diff_entry_ptr_t>::iterator> match;
+        match = equal_range(sorted_entries.begin(), sorted_entries.end(), looking_for);
         
-        if (match.first != _entry_list.end()) {
+        if (match.first != sorted_entries.end()) {
         
           if (verbose) {
             cout << "Mutation:" << endl << mut.as_string() << endl;
@@ -3857,6 +3989,68 @@ void cGenomeDiff::write_jc_score_table(cGenomeDiff& compare, string table_file_p
 
 // Used to add frequency_base-name columns to the master gd by
 // finding equivalent mutations in 
+/*! Helper class for tabulating frequencies that answers the same question
+    as cGenomeDiff::mutation_in_entry_of_type() for one genome diff and type,
+    with a binary search instead of checking every entry.
+ */
+class cContainingEntryLookup {
+public:
+  
+  // (position, insert_position) orders the same as cReferenceCoordinate
+  typedef pair<int32_t,int32_t> coordinate_t;
+  
+  cContainingEntryLookup(cGenomeDiff& gd, const gd_entry_type type)
+  {
+    map<string, vector<pair<coordinate_t, coordinate_t> > > regions_by_seq_id;
+    
+    diff_entry_list_t check_list = gd.get_list(make_vector<gd_entry_type>(type));
+    for (diff_entry_list_t::iterator itr = check_list.begin(); itr != check_list.end(); itr++) {
+      cDiffEntry& de = **itr;
+      regions_by_seq_id[de[SEQ_ID]].push_back(make_pair(to_coordinate(de.get_reference_coordinate_start()), to_coordinate(de.get_reference_coordinate_end())));
+    }
+    
+    // Sort by start and keep the largest end seen so far
+    for (map<string, vector<pair<coordinate_t, coordinate_t> > >::iterator it = regions_by_seq_id.begin(); it != regions_by_seq_id.end(); it++) {
+      vector<pair<coordinate_t, coordinate_t> >& regions = it->second;
+      std::sort(regions.begin(), regions.end());
+      
+      sRegions& r = m_regions[it->first];
+      for (size_t i = 0; i < regions.size(); i++) {
+        r.starts.push_back(regions[i].first);
+        r.max_ends.push_back( (i == 0) ? regions[i].second : max(regions[i].second, r.max_ends.back()) );
+      }
+    }
+  }
+  
+  //! Is mut completely within any entry?
+  bool contains(const cDiffEntry& mut) const
+  {
+    diff_entry_map_t::const_iterator seq_id_it = mut.find(SEQ_ID);
+    map<string, sRegions>::const_iterator it = m_regions.find( (seq_id_it != mut.end()) ? seq_id_it->second : "");
+    if (it == m_regions.end()) return false;
+    
+    const sRegions& r = it->second;
+    coordinate_t start = to_coordinate(mut.get_reference_coordinate_start());
+    coordinate_t end = to_coordinate(mut.get_reference_coordinate_end());
+    
+    // Only entries starting at or before start can contain it
+    size_t num_before = upper_bound(r.starts.begin(), r.starts.end(), start) - r.starts.begin();
+    return (num_before > 0) && (r.max_ends[num_before - 1] >= end);
+  }
+  
+protected:
+  
+  static coordinate_t to_coordinate(const cReferenceCoordinate& c)
+    { return make_pair(c.get_position(), c.get_insert_position()); }
+  
+  struct sRegions {
+    vector<coordinate_t> starts;
+    vector<coordinate_t> max_ends;
+  };
+  
+  map<string, sRegions> m_regions;
+};
+  
 void cGenomeDiff::tabulate_mutation_frequencies_from_multiple_gds(
                                                          cGenomeDiff& master_gd, 
                                                          vector<cGenomeDiff>& gd_list, 
@@ -3890,8 +4084,12 @@ void cGenomeDiff::tabulate_mutation_frequencies_from_multiple_gds(
   
   
   vector<diff_entry_list_t> mut_lists;
+  vector<cContainingEntryLookup> deleted_lookups;
+  vector<cContainingEntryLookup> unknown_lookups;
   for (vector<cGenomeDiff>::iterator it = gd_list.begin(); it != gd_list.end(); it++) {
     mut_lists.push_back(it->mutation_list());
+    deleted_lookups.push_back(cContainingEntryLookup(*it, DEL));
+    unknown_lookups.push_back(cContainingEntryLookup(*it, UN));
   }
 
   
@@ -3947,12 +4145,12 @@ void cGenomeDiff::tabulate_mutation_frequencies_from_multiple_gds(
       }
       
       // we didn't find the mutation, so we might need to consider it deleted or unknown...
-      if (gd_list[i].mutation_deleted(*this_mut)) {
+      if (deleted_lookups[i].contains(*this_mut)) {
         (*this_mut)[freq_key] = "D";
         continue;
       }
       
-      if (gd_list[i].mutation_unknown(*this_mut)) {
+      if (unknown_lookups[i].contains(*this_mut)) {
         (*this_mut)[freq_key] = "?";
         continue;
       }
@@ -93,7 +93,6 @@ namespace breseq {
   const char* POLYMORPHISM_SCORE="polymorphism_score";
   const char* POLYMORPHISM_FREQUENCY="polymorphism_frequency";
   const char* MAJOR_FREQUENCY="major_frequency";            // frequency of major allele
-  const char* POLYMORPHISM_EXISTS="polymorphism_exists";    // internal flag for running R script
   
   //For MC
   const char* START_RANGE="start_range";
@@ -287,6 +286,48 @@ namespace breseq {
   {
   }
   
+  // Assign [begin, end) to a string with leading and trailing whitespace removed,
+  // matching RemoveLeadingTrailingWhitespace() without the intermediate copies
+  static inline void assign_trimmed(string& dest, const char* begin, const char* end)
+  {
+    while ( (begin < end) && strchr(" \t\n\r", *begin) && (*begin != '\0') ) begin++;
+    while ( (end > begin) && strchr(" \t\n\r", *(end-1)) && (*(end-1) != '\0') ) end--;
+    dest.assign(begin, end - begin);
+  }
+  
+  //! Walks the tab-delimited columns of a GD line in place
+  class cDiffEntryLineTokenizer {
+  public:
+    cDiffEntryLineTokenizer(const string& line)
+    : _pos(line.c_str()), _end(line.c_str() + line.size()), _done(line.empty())
+    , _num_tokens(line.empty() ? 0 : count(line.begin(), line.end(), '\t') + 1)
+    { }
+    
+    //! Sets [begin,end) to the next column, returns false when the line is used up
+    bool next(const char*& begin, const char*& end)
+    {
+      if (_done) return false;
+      begin = _pos;
+      const char* tab = static_cast<const char*>(memchr(_pos, '\t', _end - _pos));
+      if (tab == NULL) {
+        end = _end;
+        _done = true;
+      } else {
+        end = tab;
+        _pos = tab + 1;
+      }
+      return true;
+    }
+    
+    size_t num_tokens() const { return _num_tokens; }
+    
+  private:
+    const char* _pos;
+    const char* _end;
+    bool _done;
+    size_t _num_tokens;
+  };
+  
   cDiffEntry::cDiffEntry(const string &line, uint32_t line_number, cFileParseErrors* file_parse_errors)
   : _type(UNKNOWN)
   ,_id("")
@@ -295,17 +336,23 @@ namespace breseq {
     cDiffEntry& de = *this;
     // this is a hidden field
     de["_line_number"] = to_string<uint32_t>(line_number);
-    vector<string> tokens = split(line, "\t");
     
-    if (tokens.size() < k_num_line_specification_common_prefix_columns) {
+    // Columns are visited in place rather than split into a vector of copies,
+    // this constructor dominates the time spent reading large GD files
+    cDiffEntryLineTokenizer tokens(line);
+    const char* token_begin;
+    const char* token_end;
+    
+    if (tokens.num_tokens() < k_num_line_specification_common_prefix_columns) {
       if (file_parse_errors) file_parse_errors->add_line_error(line_number, line, "Could not determine type, id, or parent_id.", true);
       return;
     }
     
     uint32_t COLUMN = 0;
     //Type.
-    string type = tokens[COLUMN];
-    RemoveLeadingTrailingWhitespace(type);
+    tokens.next(token_begin, token_end);
+    string type;
+    assign_trimmed(type, token_begin, token_end);
     de._type = cDiffEntry::type_to_enum(type);
     
     if (de._type == UNKNOWN) {
@@ -315,41 +362,47 @@ namespace breseq {
     ++COLUMN;
     
     //Id.
-    de._id = tokens[COLUMN];
-    RemoveLeadingTrailingWhitespace(de._id);
+    tokens.next(token_begin, token_end);
+    assign_trimmed(de._id, token_begin, token_end);
     ++COLUMN;
     
     //Evidence.
-    de._evidence = split(tokens[COLUMN], ",");
-    for (uint32_t i = 0; i < de._evidence.size(); ++i) {
-      RemoveLeadingTrailingWhitespace(de._evidence[i]);
+    tokens.next(token_begin, token_end);
+    if (token_begin != token_end) {
+      const char* evidence_begin = token_begin;
+      while (true) {
+        const char* comma = static_cast<const char*>(memchr(evidence_begin, ',', token_end - evidence_begin));
+        const char* evidence_end = comma ? comma : token_end;
+        de._evidence.push_back("");
+        assign_trimmed(de._evidence.back(), evidence_begin, evidence_end);
+        if (!comma) break;
+        evidence_begin = comma + 1;
+      }
     }
     ++COLUMN;
     
     //Specs.
     const vector<string>& specs = line_specification.find(de._type)->second;
     
-    if (tokens.size() - COLUMN < specs.size() ) {
+    if (tokens.num_tokens() - COLUMN < specs.size() ) {
       if (file_parse_errors) file_parse_errors->add_line_error(line_number, line, "Expected " + to_string(specs.size() + COLUMN) + " tab-delimited columns for entry", true);
       return;
     }
     
     for (uint32_t i = 0; i < specs.size(); ++i) {
-      de[specs[i]] = tokens[COLUMN];
-      RemoveLeadingTrailingWhitespace(de[specs[i]]);
+      tokens.next(token_begin, token_end);
+      assign_trimmed(de[specs[i]], token_begin, token_end);
       ++COLUMN;
     }
     
-    //Fields.
-    while(COLUMN < tokens.size() && tokens[tokens.size() - 1].size()) {
-      cKeyValuePair kvp(tokens[COLUMN], '=');
-      if (kvp.valid()) {
-        string key   = kvp.get_key();
-        string value = kvp.get_value();
-        RemoveLeadingTrailingWhitespace(key);
-        RemoveLeadingTrailingWhitespace(value);
-        de[key] = value;
-        
+    //Fields. (None are read if the line ends in an empty column.)
+    bool read_fields = (line[line.size() - 1] != '\t');
+    string key;
+    while(read_fields && tokens.next(token_begin, token_end)) {
+      const char* equals = static_cast<const char*>(memchr(token_begin, '=', token_end - token_begin));
+      if ( equals && (equals != token_begin) && (equals + 1 != token_end) ) {
+        assign_trimmed(key, token_begin, equals);
+        assign_trimmed(de[key], equals + 1, token_end);
         
         // Certain keys are only allowed for specific entries
         if (key == MEDIATED) {
@@ -381,7 +434,7 @@ namespace breseq {
         }
         
       } else {
-        if (file_parse_errors) file_parse_errors->add_line_error(line_number, line, "Field " + kvp + " is not a key=value pair. Ignoring this key.", false);
+        if (file_parse_errors) file_parse_errors->add_line_error(line_number, line, "Field " + string(token_begin, token_end) + " is not a key=value pair. Ignoring this key.", false);
       }
       ++COLUMN;
     }
@@ -485,6 +538,97 @@ namespace breseq {
   }
   
   //Static comparison function used for comparison operators
+  // Sorting converts the same numeric fields many times, so plain digit strings
+  // are converted directly and anything else falls back to from_string<T>()
+  static inline uint32_t sort_uint32_from_string(const string& s)
+  {
+    if ( (s.size() == 0) || (s.size() > 9) ) return from_string<uint32_t>(s);
+    uint32_t value = 0;
+    for (string::const_iterator it = s.begin(); it != s.end(); it++) {
+      if ( (*it < '0') || (*it > '9') ) return from_string<uint32_t>(s);
+      value = value * 10 + (*it - '0');
+    }
+    return value;
+  }
+  
+  static inline int32_t sort_int32_from_string(const string& s)
+  {
+    if ( (s.size() > 1) && (s[0] == '-') ) {
+      if (s.find_first_not_of("0123456789", 1) != string::npos) return from_string<int32_t>(s);
+      return -static_cast<int32_t>(sort_uint32_from_string(s.substr(1)));
+    }
+    if ( (s.size() == 0) || (s.size() > 9) || (s.find_first_not_of("0123456789") != string::npos) )
+      return from_string<int32_t>(s);
+    return static_cast<int32_t>(sort_uint32_from_string(s));
+  }
+  
+  // Compares a single field that is defined in the line specification
+  static inline int32_t compare_spec_field(const cDiffEntry& a, const cDiffEntry& b, const diff_entry_key_t& spec)
+  {
+    diff_entry_map_t::const_iterator a_it = a.find(spec);
+    diff_entry_map_t::const_iterator b_it = b.find(spec);
+    bool a_exists = (a_it != a.end());
+    bool b_exists = (b_it != b.end());
+    
+    // look for other breaks
+    if (!a_exists && !b_exists) return 0;
+    if (!b_exists) return +1;
+    if (!a_exists) return -1;
+    
+    // Perform the proper type of comparison
+    // Default is a string if not provided...
+    map<string, diff_entry_field_variable_t>::const_iterator type_it = diff_entry_field_variable_types.find(spec);
+    
+    if ( (type_it == diff_entry_field_variable_types.end()) ||
+        (type_it->second == kDiffEntryFieldVariableType_BaseSequence) ) {
+      
+      const string& a_val = a_it->second;
+      const string& b_val = b_it->second;
+      
+      if (a_val < b_val)
+        return -1;
+      else if (a_val > b_val)
+        return +1;
+      
+    } else {
+      
+      switch(type_it->second) {
+        case kDiffEntryFieldVariableType_PositiveInteger:
+        case kDiffEntryFieldVariableType_PositiveInteger_ReverseSort:
+        {
+          uint32_t a_val = sort_uint32_from_string(a_it->second);
+          uint32_t b_val = sort_uint32_from_string(b_it->second);
+          
+          if (a_val < b_val)
+            return -1;
+          else if (a_val > b_val)
+            return +1;
+          break;
+        }
+          
+        case kDiffEntryFieldVariableType_Integer:
+        case kDiffEntryFieldVariableType_Strand:
+        {
+          int32_t a_val = sort_int32_from_string(a_it->second);
+          int32_t b_val = sort_int32_from_string(b_it->second);
+          
+          if (a_val < b_val)
+            return -1;
+          else if (a_val > b_val)
+            return +1;
+          break;
+        }
+          // handled above
+        case kDiffEntryFieldVariableType_BaseSequence:
+          break;
+      }
+    }
+    return 0;
+  }
+  
+  // always checked after the line specification for uniqueness testing
+  static const diff_entry_key_t compare_uniqueness_keys[] = { "phylogeny_id", "unique", "population_id" };
+  
   int32_t cDiffEntry::compare(const cDiffEntry& a, const cDiffEntry& b)
   {
     gd_entry_type a_type = a._type;
@@ -493,8 +637,8 @@ namespace breseq {
     //////////////////////////////////////////////////////////////////
     // First we sort according to output order
     
-    cDiffEntry::sort_fields_item a_sort_fields = diff_entry_sort_fields[a_type];
-    cDiffEntry::sort_fields_item b_sort_fields = diff_entry_sort_fields[b_type];
+    const cDiffEntry::sort_fields_item& a_sort_fields = diff_entry_sort_fields[a_type];
+    const cDiffEntry::sort_fields_item& b_sort_fields = diff_entry_sort_fields[b_type];
     
     if (a_sort_fields._f1 < b_sort_fields._f1) {
       return -1;
@@ -502,8 +646,8 @@ namespace breseq {
       return +1;
     }
     
-    string a_sort_field_2 = a.find(a_sort_fields._f2)->second;
-    string b_sort_field_2 = b.find(b_sort_fields._f2)->second;
+    const string& a_sort_field_2 = a.find(a_sort_fields._f2)->second;
+    const string& b_sort_field_2 = b.find(b_sort_fields._f2)->second;
     
     if (a_sort_field_2 < b_sort_field_2) {
       return -1;
@@ -511,8 +655,8 @@ namespace breseq {
       return +1;
     }
     
-    uint32_t a_sort_field_3 = from_string<uint32_t>(a.find(a_sort_fields._f3)->second);
-    uint32_t b_sort_field_3 = from_string<uint32_t>(b.find(b_sort_fields._f3)->second);
+    uint32_t a_sort_field_3 = sort_uint32_from_string(a.find(a_sort_fields._f3)->second);
+    uint32_t b_sort_field_3 = sort_uint32_from_string(b.find(b_sort_fields._f3)->second);
     
     if (a_sort_field_3 < b_sort_field_3) {
       return -1;
@@ -534,72 +678,18 @@ namespace breseq {
     // Then we sort for all fields defined in the line specification
     
     // Get full line spec
-    vector<diff_entry_key_t> specs = extended_line_specification.count(a_type)
-    ? extended_line_specification.find(a_type)->second : line_specification.find(a_type)->second;
-    
-    // always add these for uniqueness testing
-    specs.push_back("phylogeny_id");
-    specs.push_back("unique");
-    specs.push_back("population_id");
+    map<gd_entry_type, vector<diff_entry_key_t> >::const_iterator extended_it = extended_line_specification.find(a_type);
+    const vector<diff_entry_key_t>& specs = (extended_it != extended_line_specification.end())
+    ? extended_it->second : line_specification.find(a_type)->second;
     
     for(vector<diff_entry_key_t>::const_iterator it = specs.begin(); it != specs.end(); it++) {
-      const diff_entry_key_t& spec(*it);
-      
-      bool a_exists = a.entry_exists(spec);
-      bool b_exists = b.entry_exists(spec);
-      
-      // look for other breaks
-      if (!a_exists && !b_exists) continue;
-      if (!b_exists) return +1;
-      if (!a_exists) return -1;
-      
-      // Perform the proper type of comparison
-      // Default is a string if not provided...
-      
-      if (!diff_entry_field_variable_types.count(spec) ||
-          (diff_entry_field_variable_types[spec] == kDiffEntryFieldVariableType_BaseSequence) ) {
-        
-        const string& a_val = a.find(spec)->second;
-        const string& b_val = b.find(spec)->second;
-        
-        if (a_val < b_val)
-          return -1;
-        else if (a_val > b_val)
-          return +1;
-        
-      } else {
-        
-        switch(diff_entry_field_variable_types[spec]) {
-          case kDiffEntryFieldVariableType_PositiveInteger:
-          case kDiffEntryFieldVariableType_PositiveInteger_ReverseSort:
-          {
-            uint32_t a_val = from_string<uint32_t>(a.find(spec)->second);
-            uint32_t b_val = from_string<uint32_t>(b.find(spec)->second);
-            
-            if (a_val < b_val)
-              return -1;
-            else if (a_val > b_val)
-              return +1;
-            break;
-          }
-            
-          case kDiffEntryFieldVariableType_Integer:
-          case kDiffEntryFieldVariableType_Strand:
-          {
-            int32_t a_val = from_string<int32_t>(a.find(spec)->second);
-            int32_t b_val = from_string<int32_t>(b.find(spec)->second);
-            
-            if (a_val < b_val)
-              return -1;
-            else if (a_val > b_val)
-              return +1;
-            break;
-          }
-            // handled above
-          case kDiffEntryFieldVariableType_BaseSequence:
-            break;
-        }
-      }
+      int32_t field_compare = compare_spec_field(a, b, *it);
+      if (field_compare != 0) return field_compare;
+    }
+    
+    for(size_t i = 0; i < sizeof(compare_uniqueness_keys) / sizeof(compare_uniqueness_keys[0]); i++) {
+      int32_t field_compare = compare_spec_field(a, b, compare_uniqueness_keys[i]);
+      if (field_compare != 0) return field_compare;
     }
     
     //////////////////////////////////////////////////////////////////
@@ -1205,12 +1295,67 @@ namespace breseq {
     }
   }
   
+  /*! Append this diff entry to a line in the same field order as marshal().
+   
+   Unlike marshal() this does not deep copy the entry or build a vector of
+   fields, so it is what is used when writing large GD files.
+   */
+  void cDiffEntry::append_to_string(string& line) const {
+    line += gd_entry_type_lookup_table[_type];
+    line += '\t';
+    line += _id;
+    line += '\t';
+    
+    // Use a dot "." if no evidence is provided
+    if (_evidence.size() == 0) {
+      line += '.';
+    } else {
+      size_t evidence_start = line.size();
+      for (vector<string>::const_iterator it = _evidence.begin(); it != _evidence.end(); it++) {
+        if (it != _evidence.begin()) line += ',';
+        line += *it;
+      }
+      if (line.size() == evidence_start) line += '.';
+    }
+    
+    // specified fields in-order
+    const vector<string>& f = line_specification.find(_type)->second;
+    
+    for (vector<string>::const_iterator it=f.begin(); it != f.end(); it++)
+    {
+      diff_entry_map_t::const_iterator iter=this->find(*it);
+      
+      ASSERT(iter != this->end(), "Did not find required field '" + *it + "' to write in entry id " + _id + " of type '" + gd_entry_type_lookup_table[_type] + "'.");
+      
+      line += '\t';
+      line += iter->second;
+    }
+    
+    // Remove insert_position is it was added
+    bool skip_insert_position = (_type == INS) && this->entry_exists("_dont_print_insert_position");
+    
+    // whatever's left, unless it _begins with an underscore or is empty (a placeholder)
+    for(diff_entry_map_t::const_iterator i=this->begin(); i!=this->end(); ++i) {
+      
+      assert(i->first.size());
+      if (is_unprintable_key(i->first)) continue;
+      if (i->second.empty()) continue;
+      if (skip_insert_position && (i->first == INSERT_POSITION)) continue;
+      if (std::find(f.begin(), f.end(), i->first) != f.end()) continue;
+      
+      line += '\t';
+      line += i->first;
+      line += '=';
+      line += i->second;
+    }
+  }
+  
   // Created the line to be printed
   string cDiffEntry::as_string(void) const
   {
-    vector<string> fields;
-    marshal(fields);
-    return join(fields, "\t");
+    string line;
+    append_to_string(line);
+    return line;
   }
   
   size_t cDiffEntry::number_reject_reasons()
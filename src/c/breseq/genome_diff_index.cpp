@@ -0,0 +1,379 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#include "libbreseq/genome_diff_index.h"
+
+#include "libbreseq/genome_diff.h"
+#include "libbreseq/reference_sequence.h"
+
+namespace breseq {
+
+// 'GDX1' when read back on a machine with the same byte order
+const uint32_t cGenomeDiffIndex::kMagic = 0x31584447;
+const uint32_t cGenomeDiffIndex::kFormatVersion = 2;
+
+// Helper struct for sorting mutation positions
+struct sGenomeDiffIndexPosition {
+  uint32_t seq_id;
+  uint32_t start;
+  uint32_t end;
+  uint32_t entry;
+
+  bool operator<(const sGenomeDiffIndexPosition& rhs) const {
+    if (seq_id != rhs.seq_id) return seq_id < rhs.seq_id;
+    if (start != rhs.start) return start < rhs.start;
+    return entry < rhs.entry;
+  }
+};
+
+void cGenomeDiffIndex::create(const string& gd_file_path)
+{
+  // Make sure we parse the text and not an older index
+  cGenomeDiffIndex::remove(gd_file_path);
+
+  cGenomeDiff gd;
+  cFileParseErrors parse_errors = gd.read(gd_file_path, true, false);
+  if (parse_errors._errors.size() > 0) {
+    parse_errors.print_errors();
+    ERROR("Fix errors in GenomeDiff file before creating an index: " + gd_file_path);
+  }
+
+  // Collect the raw metadata lines exactly as cGenomeDiff::read() sees them
+  vector<string> header_lines;
+  ifstream in(gd_file_path.c_str());
+  ASSERT(in.good(), "Could not open file for reading: " + gd_file_path);
+  while (in.peek() == '#') {
+    in.get();
+    if (in.peek() != '=') break;
+    in.unget();
+
+    string line;
+    getline(in, line);
+    header_lines.push_back(line);
+  }
+  in.close();
+
+  cGenomeDiffIndex gdx;
+  gdx.build(gd, header_lines);
+  gdx.write(gd_file_path);
+}
+
+void cGenomeDiffIndex::remove(const string& gd_file_path)
+{
+  // Doesn't matter if it doesn't exist
+  std::remove(index_file_path(gd_file_path).c_str());
+}
+
+bool cGenomeDiffIndex::get_source_stamp(const string& file_path, uint64_t& size, int64_t& mtime)
+{
+  struct stat file_status;
+  if (stat(file_path.c_str(), &file_status) != 0)
+    return false;
+
+  size = static_cast<uint64_t>(file_status.st_size);
+  mtime = file_modification_time_ns(file_status);
+  return true;
+}
+
+uint32_t cGenomeDiffIndex::intern(const string& s, map<string,uint32_t>& lookup)
+{
+  map<string,uint32_t>::iterator it = lookup.find(s);
+  if (it != lookup.end())
+    return it->second;
+
+  uint32_t i = lookup.size();
+  lookup[s] = i;
+  m_string_data.insert(m_string_data.end(), s.begin(), s.end());
+  m_string_start.push_back(m_string_data.size());
+  return i;
+}
+
+void cGenomeDiffIndex::build(cGenomeDiff& gd, const vector<string>& header_lines)
+{
+  map<string,uint32_t> lookup;
+  m_string_start.assign(1, 0);
+  m_string_data.clear();
+
+  for (size_t i = 0; i < gd_entry_type_lookup_table.size(); i++) {
+    m_type_names.push_back(intern(gd_entry_type_lookup_table[i], lookup));
+  }
+
+  for (vector<string>::const_iterator it = header_lines.begin(); it != header_lines.end(); it++) {
+    m_header_lines.push_back(intern(*it, lookup));
+  }
+
+  vector<sGenomeDiffIndexPosition> positions;
+
+  diff_entry_list_t entry_list = gd.get_list();
+  m_entry_field_start.push_back(0);
+  m_entry_evidence_start.push_back(0);
+  for (diff_entry_list_t::iterator it = entry_list.begin(); it != entry_list.end(); it++) {
+    cDiffEntry& de = **it;
+    uint32_t entry = m_entry_type.size();
+
+    m_entry_type.push_back(static_cast<uint32_t>(de._type));
+    m_entry_id.push_back(intern(de._id, lookup));
+
+    for (diff_entry_map_t::const_iterator field_it = de.begin(); field_it != de.end(); field_it++) {
+      m_field_key.push_back(intern(field_it->first, lookup));
+      m_field_value.push_back(intern(field_it->second, lookup));
+    }
+    m_entry_field_start.push_back(m_field_key.size());
+
+    for (vector<string>::const_iterator ev_it = de._evidence.begin(); ev_it != de._evidence.end(); ev_it++) {
+      m_evidence.push_back(intern(*ev_it, lookup));
+    }
+    m_entry_evidence_start.push_back(m_evidence.size());
+
+    // Mutations without a location are not indexed and are always restored
+    if (!de.is_mutation() || !de.entry_exists(SEQ_ID))
+      continue;
+
+    int32_t start_1 = de.get_reference_coordinate_start().get_position();
+    int32_t end_1 = de.get_reference_coordinate_end().get_position();
+    if (end_1 < start_1) swap(start_1, end_1);
+
+    sGenomeDiffIndexPosition p;
+    p.seq_id = intern(de[SEQ_ID], lookup);
+    p.start = max(start_1, 0);
+    p.end = max(end_1, 0);
+    p.entry = entry;
+    positions.push_back(p);
+  }
+
+  sort(positions.begin(), positions.end());
+
+  for (size_t i = 0; i < positions.size(); i++) {
+    if ((i == 0) || (positions[i].seq_id != positions[i-1].seq_id)) {
+      m_seq_id.push_back(positions[i].seq_id);
+      m_seq_id_position_start.push_back(i);
+      m_position_max_end.push_back(positions[i].end);
+    } else {
+      m_position_max_end.push_back(max(positions[i].end, m_position_max_end.back()));
+    }
+    m_position_start.push_back(positions[i].start);
+    m_position_end.push_back(positions[i].end);
+    m_position_entry.push_back(positions[i].entry);
+  }
+  m_seq_id_position_start.push_back(positions.size());
+}
+
+void cGenomeDiffIndex::write_column(ofstream& f, vector<uint32_t>& v)
+{
+  uint32_t size = v.size();
+  write_to_file(f, size);
+  if (size) f.write(reinterpret_cast<char*>(&v[0]), size * sizeof(uint32_t));
+}
+
+void cGenomeDiffIndex::read_column(ifstream& f, vector<uint32_t>& v)
+{
+  uint32_t size = 0;
+  read_from_file(f, size);
+  v.resize(size);
+  if (size) f.read(reinterpret_cast<char*>(&v[0]), size * sizeof(uint32_t));
+}
+
+void cGenomeDiffIndex::serialize(ofstream& f)
+{
+  uint32_t magic = kMagic;
+  uint32_t version = kFormatVersion;
+  write_to_file(f, magic);
+  write_to_file(f, version);
+  write_to_file(f, m_source_size);
+  write_to_file(f, m_source_mtime);
+
+  write_column(f, m_string_start);
+  uint32_t string_data_size = m_string_data.size();
+  write_to_file(f, string_data_size);
+  if (string_data_size) f.write(&m_string_data[0], string_data_size);
+
+  write_column(f, m_type_names);
+  write_column(f, m_header_lines);
+
+  write_column(f, m_entry_type);
+  write_column(f, m_entry_id);
+  write_column(f, m_entry_field_start);
+  write_column(f, m_entry_evidence_start);
+  write_column(f, m_field_key);
+  write_column(f, m_field_value);
+  write_column(f, m_evidence);
+
+  write_column(f, m_seq_id);
+  write_column(f, m_seq_id_position_start);
+  write_column(f, m_position_start);
+  write_column(f, m_position_end);
+  write_column(f, m_position_max_end);
+  write_column(f, m_position_entry);
+}
+
+void cGenomeDiffIndex::deserialize(ifstream& f)
+{
+  uint32_t magic = 0, version = 0;
+  read_from_file(f, magic);
+  read_from_file(f, version);
+  m_valid = f.good() && (magic == kMagic) && (version == kFormatVersion);
+  // Don't try to read columns from something else
+  if (!m_valid) return;
+
+  read_from_file(f, m_source_size);
+  read_from_file(f, m_source_mtime);
+
+  read_column(f, m_string_start);
+  uint32_t string_data_size = 0;
+  read_from_file(f, string_data_size);
+  m_string_data.resize(string_data_size);
+  if (string_data_size) f.read(&m_string_data[0], string_data_size);
+
+  read_column(f, m_type_names);
+  read_column(f, m_header_lines);
+
+  read_column(f, m_entry_type);
+  read_column(f, m_entry_id);
+  read_column(f, m_entry_field_start);
+  read_column(f, m_entry_evidence_start);
+  read_column(f, m_field_key);
+  read_column(f, m_field_value);
+  read_column(f, m_evidence);
+
+  read_column(f, m_seq_id);
+  read_column(f, m_seq_id_position_start);
+  read_column(f, m_position_start);
+  read_column(f, m_position_end);
+  read_column(f, m_position_max_end);
+  read_column(f, m_position_entry);
+
+  m_valid = !f.fail();
+}
+
+void cGenomeDiffIndex::write(const string& gd_file_path)
+{
+  ASSERT(get_source_stamp(gd_file_path, m_source_size, m_source_mtime), "Could not check file: " + gd_file_path);
+
+  // Write to a temporary name so a partial file is never picked up
+  string index_path = index_file_path(gd_file_path);
+  string temp_path = index_path + ".tmp";
+  ofstream out(temp_path.c_str(), ios::out | ios::binary);
+  ASSERT(out.good(), "Could not open file for writing: " + temp_path);
+  serialize(out);
+  out.close();
+  ASSERT(!out.fail(), "Error writing file: " + temp_path);
+  ASSERT(rename(temp_path.c_str(), index_path.c_str()) == 0, "Could not rename file: " + temp_path + " to " + index_path);
+}
+
+bool cGenomeDiffIndex::load(const string& gd_file_path)
+{
+  string index_path = index_file_path(gd_file_path);
+  ifstream in(index_path.c_str(), ios::in | ios::binary);
+  if (!in.good()) return false;
+
+  deserialize(in);
+  if (!m_valid) return false;
+
+  uint64_t source_size;
+  int64_t source_mtime;
+  if (!get_source_stamp(gd_file_path, source_size, source_mtime)) return false;
+  if ((source_size != m_source_size) || (source_mtime != m_source_mtime)) return false;
+
+  // Every type name must still exist
+  for (vector<uint32_t>::const_iterator it = m_type_names.begin(); it != m_type_names.end(); it++) {
+    if (find(gd_entry_type_lookup_table.begin(), gd_entry_type_lookup_table.end(), get_string(*it)) == gd_entry_type_lookup_table.end())
+      return false;
+  }
+
+  return true;
+}
+
+vector<uint32_t> cGenomeDiffIndex::mutations_overlapping(const string& seq_id, const uint32_t start_1, const uint32_t end_1) const
+{
+  vector<uint32_t> entries;
+
+  for (size_t s = 0; s < m_seq_id.size(); s++) {
+    if (get_string(m_seq_id[s]) != seq_id) continue;
+
+    vector<uint32_t>::const_iterator first = m_position_start.begin() + m_seq_id_position_start[s];
+    vector<uint32_t>::const_iterator last = m_position_start.begin() + m_seq_id_position_start[s+1];
+
+    // Everything past here starts after the region. Going backward, stop once
+    // nothing before can reach the start of the region.
+    size_t i = upper_bound(first, last, end_1) - m_position_start.begin();
+    size_t first_i = m_seq_id_position_start[s];
+    while (i > first_i) {
+      i--;
+      if (m_position_max_end[i] < start_1) break;
+      if (m_position_end[i] >= start_1) entries.push_back(m_position_entry[i]);
+    }
+  }
+
+  sort(entries.begin(), entries.end());
+  return entries;
+}
+
+void cGenomeDiffIndex::restore(cGenomeDiff& gd, cFileParseErrors& parse_errors) const
+{
+  vector<bool> include_entry(num_entries(), true);
+  restore_entries(gd, parse_errors, include_entry);
+}
+
+void cGenomeDiffIndex::restore_region(cGenomeDiff& gd, cFileParseErrors& parse_errors, const string& seq_id, const uint32_t start_1, const uint32_t end_1) const
+{
+  vector<bool> include_entry(num_entries(), true);
+  for (vector<uint32_t>::const_iterator it = m_position_entry.begin(); it != m_position_entry.end(); it++) {
+    include_entry[*it] = false;
+  }
+
+  vector<uint32_t> overlapping = mutations_overlapping(seq_id, start_1, end_1);
+  for (vector<uint32_t>::const_iterator it = overlapping.begin(); it != overlapping.end(); it++) {
+    include_entry[*it] = true;
+  }
+
+  restore_entries(gd, parse_errors, include_entry);
+}
+
+void cGenomeDiffIndex::restore_entries(cGenomeDiff& gd, cFileParseErrors& parse_errors, const vector<bool>& include_entry) const
+{
+  gd.metadata.version = "";
+  for (size_t i = 0; i < m_header_lines.size(); i++) {
+    gd.read_header_line(get_string(m_header_lines[i]), i + 1, parse_errors);
+  }
+
+  // Map stored type numbers onto this version's types
+  vector<gd_entry_type> types;
+  for (vector<uint32_t>::const_iterator it = m_type_names.begin(); it != m_type_names.end(); it++) {
+    size_t t = find(gd_entry_type_lookup_table.begin(), gd_entry_type_lookup_table.end(), get_string(*it)) - gd_entry_type_lookup_table.begin();
+    types.push_back(static_cast<gd_entry_type>(t));
+  }
+
+  for (size_t i = 0; i < num_entries(); i++) {
+    if (!include_entry[i]) continue;
+
+    diff_entry_ptr_t de(new cDiffEntry(types[m_entry_type[i]]));
+    de->_id = get_string(m_entry_id[i]);
+
+    for (uint32_t f = m_entry_field_start[i]; f < m_entry_field_start[i+1]; f++) {
+      de->insert(de->end(), make_pair(get_string(m_field_key[f]), get_string(m_field_value[f])));
+    }
+    for (uint32_t e = m_entry_evidence_start[i]; e < m_entry_evidence_start[i+1]; e++) {
+      de->_evidence.push_back(get_string(m_evidence[e]));
+    }
+
+    // Already sorted and ids were assigned before indexing
+    gd.add_entry_ptr(de, false);
+  }
+}
+
+} // breseq namespace
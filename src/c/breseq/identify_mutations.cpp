@@ -682,6 +682,7 @@ identify_mutations_pileup::identify_mutations_pileup(
 , _polymorphism_precision_decimal(polymorphism_precision_decimal)
 , _polymorphism_precision_places(polymorphism_precision_places)
 , _log10_ref_length(0)
+, _total_reference_length(summary.sequence_conversion.total_reference_sequence_length)
 , _snp_caller("haploid", summary.sequence_conversion.total_reference_sequence_length)
 , _this_deletion_reaches_seed_value(false)
 , _this_deletion_redundant_reached_zero(false)
@@ -1102,16 +1103,9 @@ void identify_mutations_pileup::pileup_callback(const pileup& p) {
       mut[POLYMORPHISM_FREQUENCY] = formatted_double(variant_frequency, _polymorphism_precision_places, true).to_string();
 
       
-      // Add line to R input file if we are only a polymorphism
-      
-      // @JEB TO_DO: deprecate going to R here
-      // and in the main PIPELINE. We can now do
-      // Fisher's exact test in C++ and the KS
-      // test is probably not necessary
-      
+      // Strand and quality score bias statistics if we are only a polymorphism
       if (ppred.frequency != 1) {
-        mut[POLYMORPHISM_EXISTS] = "1";
-        write_polymorphism_input_file_line(p, insert_count, ref_base_char, best_base_char, second_best_base_char, ppred, pos_info, pdata );
+        add_polymorphism_statistics(mut, best_base_char, second_best_base_char, pos_info, pdata);
       }
 
       //## More fields common to consensus mutations and polymorphisms
@@ -1171,7 +1165,6 @@ void identify_mutations_pileup::pileup_callback(const pileup& p) {
         cDiffEntry mut = *(_user_evidence_ra_list.front().get());
         mut.to_spec(); //remove additional fields that might be left over!!
         mut[USER_DEFINED] = "1";
-        mut["user_defined_no_poly"] = "1"; // prevents doing stats on it
         
         // These are already assigned correctly by copy of RA
         //mut[SEQ_ID] = p.target_name();
@@ -1254,35 +1247,10 @@ void identify_mutations_pileup::at_target_start(const uint32_t tid)
     
   // Open per-reference coverage file:
 	if(_print_coverage_data) {
-		string filename = _settings.file_name(_settings.complete_coverage_text_file_name, "@", target_name(tid));
-		_coverage_data.open(filename.c_str());
-    ASSERT(!_coverage_data.fail(), "Could not open output file:" + filename);
-		_coverage_data << "unique_top_cov" << "\t" << "unique_bot_cov" << "\t" << "redundant_top_cov" << "\t" << "redundant_bot_cov" << "\t" << "raw_redundant_top_cov" << "\t" << "raw_redundant_bot_cov" << "\t" << "e_value" << "\t" << "position" << endl;
+		string filename = _settings.file_name(_settings.complete_coverage_file_name, "@", target_name(tid));
+		_coverage_data.create(filename, target_name(tid), target_length(tid));
 	}	
   
-  // Polymorphism file used as input to R
-  // Only one file for all reference sequences
-  if((_settings.polymorphism_prediction || _settings.mixed_base_prediction) && !_polymorphism_r_input_file.is_open()) {
-		string filename = _settings.polymorphism_statistics_input_file_name;
-		_polymorphism_r_input_file.open(filename.c_str());
-    ASSERT(!_polymorphism_r_input_file.fail(), "Could not open output file:" + filename);
-		_polymorphism_r_input_file 
-    << "seq_id" << "\t"
-    << "position" << "\t" 
-    << "insert_position" << "\t"
-    << "reference_base" << "\t"
-    << "major_base" << "\t"
-    << "minor_base" << "\t"
-    << "major_frequency" << "\t"
-    << "major_top_strand" << "\t"
-    << "major_bot_strand" << "\t"
-    << "minor_top_strand" << "\t"
-    << "minor_bot_strand" << "\t"
-    << "major_quals" << "\t"
-    << "minor_quals" << "\t"
-    << endl;
-  }
-  
   // Reset the Missing Coverage evidence variables
   _last_deletion_start_position = UNDEFINED_UINT32;
 	_last_deletion_end_position = UNDEFINED_UINT32;
@@ -1348,14 +1316,15 @@ void identify_mutations_pileup::check_deletion_completion(uint32_t position, uin
     _last_position_coverage = position_coverage(numeric_limits<double>::quiet_NaN());
   
   // print to optional output file
-  if (!std::isnan(this_position_coverage.unique[1]) && _coverage_data.is_open()) {
-    _coverage_data << this_position_coverage.unique[0] << "\t"
-    << this_position_coverage.unique[2] << "\t"
-    << this_position_coverage.redundant[0] << "\t"
-    << this_position_coverage.redundant[2] << "\t"
-    << this_position_coverage.raw_redundant[0] << "\t"
-    << this_position_coverage.raw_redundant[2] << "\t"
-    << e_value_call << "\t" << position << endl;
+  if (!std::isnan(this_position_coverage.unique[1]) && _print_coverage_data) {
+    _coverage_data.add(position,
+                       static_cast<uint32_t>(this_position_coverage.unique[0]),
+                       static_cast<uint32_t>(this_position_coverage.unique[2]),
+                       this_position_coverage.redundant[0],
+                       this_position_coverage.redundant[2],
+                       this_position_coverage.raw_redundant[0],
+                       this_position_coverage.raw_redundant[2],
+                       e_value_call);
   }
   
   
@@ -1475,53 +1444,75 @@ void identify_mutations_pileup::update_unknown_intervals(uint32_t position, uint
 	}
 }
   
-void identify_mutations_pileup::write_polymorphism_input_file_line(const pileup& p, const uint32_t insert_count, char ref_base_char, char best_base_char, char second_best_base_char, const polymorphism_prediction& ppred, position_base_info& pos_info, const vector<polymorphism_data>& pdata )
+// Format like R does for signif(value, digits), choosing fixed or scientific
+// notation by which is shorter, so values match those written by earlier versions.
+static string r_signif_string(double value, uint32_t digits = 6)
 {
+  if (value == 0) return "0";
+  if (std::isnan(value)) return "NaN";
+  if (std::isinf(value)) return (value > 0) ? "Inf" : "-Inf";
+  
+  // Significant digits and exponent
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*e", digits - 1, value);
+  string s(buffer);
+  size_t e_pos = s.find('e');
+  int32_t exponent = atoi(s.c_str() + e_pos + 1);
+  string mantissa = s.substr(0, e_pos);
+  if (mantissa.find('.') != string::npos) {
+    mantissa.erase(mantissa.find_last_not_of('0') + 1);
+    if (mantissa[mantissa.size() - 1] == '.') mantissa.erase(mantissa.size() - 1);
+  }
+  int32_t num_digits = 0;
+  for (size_t i = 0; i < mantissa.size(); i++) {
+    if (isdigit(mantissa[i])) num_digits++;
+  }
   
-  _polymorphism_r_input_file
-  << p.target_name() << "\t"
-  << p.position_1() << "\t"
-  << insert_count << "\t"
-  << ref_base_char << "\t"
-  << best_base_char << "\t"
-  << second_best_base_char << "\t"
-  << ppred.frequency << "\t"
-  << pos_info[best_base_char][2] << "\t"
-  << pos_info[best_base_char][0] << "\t"
-  << pos_info[second_best_base_char][2] << "\t"
-  << pos_info[second_best_base_char][0] << "\t"
-  ;
-  
+  int32_t decimals = max(0, num_digits - 1 - exponent);
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+  string fixed_string(buffer);
   
-  string best_base_qualities;
-  string second_best_base_qualities;
+  snprintf(buffer, sizeof(buffer), "%se%c%02d", mantissa.c_str(), (exponent < 0) ? '-' : '+', abs(exponent));
+  string scientific_string(buffer);
   
+  return (fixed_string.size() <= scientific_string.size()) ? fixed_string : scientific_string;
+}
+
+/*! Tests whether the reads supporting the major and minor bases of a polymorphism
+    differ in their strands (Fisher's exact test) or base quality scores (Kolmogorov-Smirnov)
+    and combines these into an overall bias p-value using Fisher's method.
+ */
+void identify_mutations_pileup::add_polymorphism_statistics(cDiffEntry& mut, char best_base_char, char second_best_base_char, position_base_info& pos_info, const vector<polymorphism_data>& pdata)
+{
+  // Rows are top and bottom strand. Columns are minor (second best) and major (best) bases.
+  double fisher_strand_p_value = fisher_exact_test(
+                                                   pos_info[second_best_base_char][2], pos_info[best_base_char][2],
+                                                   pos_info[second_best_base_char][0], pos_info[best_base_char][0]
+                                                   );
+  
+  vector<double> major_quals;
+  vector<double> minor_quals;
   for(vector<polymorphism_data>::const_iterator it=pdata.begin(); it<pdata.end(); ++it) {
-    
     if (it->_base_char == best_base_char) {
-      if (best_base_qualities.length() > 0) {
-        best_base_qualities += ",";
-      }
-      stringstream convert_quality;
-      convert_quality << (unsigned int)it->_quality;
-      best_base_qualities += convert_quality.str();
-    }
-    
-    if (it->_base_char == second_best_base_char) {
-      if (second_best_base_qualities.length() > 0) {
-        second_best_base_qualities += ",";
-      }
-      stringstream convert_quality;
-      convert_quality << (unsigned int)it->_quality;
-      second_best_base_qualities += convert_quality.str();
+      major_quals.push_back(it->_quality);
+    } else if (it->_base_char == second_best_base_char) {
+      minor_quals.push_back(it->_quality);
     }
   }
   
-  _polymorphism_r_input_file << best_base_qualities << "\t";
-  _polymorphism_r_input_file << second_best_base_qualities << "\t";
+  double ks_quality_p_value = 1;
+  if (major_quals.size() && minor_quals.size()) {
+    ks_quality_p_value = ks_test_less(minor_quals, major_quals);
+  }
   
-  _polymorphism_r_input_file << endl;
+  // Fisher's method for combining p-values (chi-squared with 2*2 degrees of freedom)
+  double combined_log = -2 * (log(ks_quality_p_value) + log(fisher_strand_p_value));
+  double bias_p_value = std::isinf(combined_log) ? 0 : incompletegamma(2, combined_log / 2, true);
   
+  mut["ks_quality_p_value"] = r_signif_string(ks_quality_p_value);
+  mut["fisher_strand_p_value"] = r_signif_string(fisher_strand_p_value);
+  mut["bias_p_value"] = r_signif_string(bias_p_value);
+  mut["bias_e_value"] = r_signif_string(bias_p_value * _total_reference_length);
 }
 
 
@@ -1784,6 +1775,7 @@ pair<double,double> identify_mutations_pileup::best_two_base_model_log10_likelih
 /*! Calculate the likelihood of a mixture model of two bases leading to the observed read bases.
  */
 double identify_mutations_pileup::calculate_two_base_model_log10_likelihood(
+                                                                            cErrorTable& error_table,
                                                                             base_char best_base_char, 
                                                                             base_char second_best_base_char, 
                                                                             const vector<polymorphism_data>& pdata, 
@@ -1809,14 +1801,14 @@ double identify_mutations_pileup::calculate_two_base_model_log10_likelihood(
     } else {
       this_cv.ref_base() = basechar2index(complement_base_char(best_base_char));
     }
-    best_base_log10pr = _error_table.get_log10_prob(this_cv);
+    best_base_log10pr = error_table.get_log10_prob(this_cv);
     
     if(it->_strand == 1) {
       this_cv.ref_base() = basechar2index(second_best_base_char);
     } else {
       this_cv.ref_base() = basechar2index(complement_base_char(second_best_base_char));
     }
-    second_best_base_log10pr = _error_table.get_log10_prob(this_cv);
+    second_best_base_log10pr = error_table.get_log10_prob(this_cv);
 
     //debug output
     //cerr << "Base in Read: " << it->base << " Read Strand: " << it->strand << endl;
@@ -0,0 +1,105 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#include "libbreseq/index_cache.h"
+
+#include "htslib/hts.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace breseq {
+
+// Base name of the index files within each cached subdirectory
+static const string bowtie2_index_cache_base_name = "reference";
+
+string file_md5(const string& file_name, const string& suffix)
+{
+  ifstream in(file_name.c_str(), ios::in | ios::binary);
+  ASSERT(in.good(), "Could not open file: " + file_name);
+
+  hts_md5_context* md5 = hts_md5_init();
+  ASSERT(md5 != NULL, "Could not initialize MD5 for file: " + file_name);
+
+  vector<char> buffer(1 << 20);
+  while (in) {
+    in.read(&(buffer[0]), buffer.size());
+    if (in.gcount() > 0) hts_md5_update(md5, &(buffer[0]), in.gcount());
+  }
+
+  if (suffix.size()) hts_md5_update(md5, suffix.c_str(), suffix.size());
+
+  unsigned char digest[16];
+  char hex[33];
+  hts_md5_final(digest, md5);
+  hts_md5_hex(hex, digest);
+  hts_md5_destroy(md5);
+
+  return string(hex);
+}
+
+string cBowtie2IndexCache::key(const string& fasta_file_name) const
+{
+  // Indexes from different versions of bowtie2 are kept separately
+  return file_md5(fasta_file_name, "bowtie2 " + m_bowtie2_version_string);
+}
+
+string cBowtie2IndexCache::index(const string& fasta_file_name) const
+{
+  create_path(m_cache_path);
+
+  string index_key = key(fasta_file_name);
+  string index_path = m_cache_path + "/" + index_key;
+  string index_base_name = index_path + "/" + bowtie2_index_cache_base_name;
+
+  // Already built (the directory only appears when an index is complete)
+  if (access(index_path.c_str(), F_OK) == 0) {
+    cout << "Using cached bowtie2 index: " << index_path << endl;
+    return index_base_name;
+  }
+
+  // Only one run builds the index, others wait for the lock and then find it
+  string lock_file_name = index_path + ".lock";
+  int lock_fd = open(lock_file_name.c_str(), O_RDWR | O_CREAT, 0666);
+  ASSERT(lock_fd >= 0, "Could not open bowtie2 index cache lock file: " + lock_file_name);
+  ASSERT(flock(lock_fd, LOCK_EX) == 0, "Could not lock bowtie2 index cache lock file: " + lock_file_name);
+
+  if (access(index_path.c_str(), F_OK) == 0) {
+    cout << "Using cached bowtie2 index: " << index_path << endl;
+  } else {
+    cout << "Building cached bowtie2 index: " << index_path << endl;
+
+    string temp_index_path = index_path + ".tmp." + to_string(getpid());
+    SYSTEM("rm -rf " + temp_index_path, true, true);
+    create_path(temp_index_path);
+
+    SYSTEM("bowtie2-build -q " + fasta_file_name + " " + temp_index_path + "/" + bowtie2_index_cache_base_name);
+
+    ASSERT(rename(temp_index_path.c_str(), index_path.c_str()) == 0, "Could not move bowtie2 index into cache: " + index_path);
+  }
+
+  flock(lock_fd, LOCK_UN);
+  close(lock_fd);
+
+  return index_base_name;
+}
+
+} // namespace breseq
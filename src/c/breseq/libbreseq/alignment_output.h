@@ -226,6 +226,9 @@ namespace breseq
     string text_alignment ( const string& region, cOutputEvidenceItem * output_evidence_item = NULL );
     string json_alignment ( const string& region, cOutputEvidenceItem * output_evidence_item = NULL );
     void set_quality_range(const uint32_t quality_score_cutoff = 0);
+    //! Read alignments for all of these regions in one pass (see pileup_base::set_region_batch).
+    void set_region_batch(const vector<string>& regions)
+      { m_alignment_output_pileup.set_region_batch(regions); }
   private:
     uint32_t no_color_index;
     string html_header_string();
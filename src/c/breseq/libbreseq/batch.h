@@ -0,0 +1,101 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#ifndef _BRESEQ_BATCH_H_
+#define _BRESEQ_BATCH_H_
+
+#include "common.h"
+#include "settings.h"
+
+namespace breseq {
+
+/*! Reference sequences converted once for all of the samples in a batch.
+
+ Holds the files that the sequence conversion step makes from the reference
+ (FASTA, GFF3, FASTA index and trims) so that each sample's run copies them
+ instead of loading and converting the references itself. The names and
+ MD5s of the reference files they were made from are saved with them. They
+ are remade if a reference file changes, and a run given other references
+ stops with an error rather than using the wrong sequences.
+ */
+class cPreparedReference {
+public:
+
+  cPreparedReference(const string& path)
+  : m_path(path)
+  { }
+
+  //! Convert the reference files into this directory, unless that was
+  //! already done for the same files by an earlier batch. Returns true if
+  //! the references were converted.
+  bool prepare(const vector<string>& reference_file_names) const;
+
+  //! Copy the prepared files to where a run's sequence conversion step would
+  //! write them. Returns the total length of the reference sequences.
+  uint64_t copy_to(const Settings& settings) const;
+
+  string path() const { return m_path; }
+  string fasta_file_name() const { return m_path + "/reference.fasta"; }
+  string gff3_file_name() const { return m_path + "/reference.gff3"; }
+  string faidx_file_name() const { return m_path + "/reference.fasta.fai"; }
+  string reference_list_file_name() const { return m_path + "/reference_files.txt"; }
+  string done_file_name() const { return m_path + "/prepared.done"; }
+
+private:
+
+  //! Reference file names with the MD5 of each file's contents
+  static string reference_list(const vector<string>& reference_file_names);
+  string saved_reference_list() const;
+
+  //! Sequence ids and lengths, read from the FASTA index
+  vector<pair<string, uint64_t> > read_faidx() const;
+
+  string m_path;
+};
+
+/*! One line of a batch sample sheet.
+
+ Each line is tab-delimited: the sample name, its read files separated by
+ commas, and optionally extra options for that sample's breseq run. Blank
+ lines and lines starting with '#' are skipped.
+
+ A sample's output goes in a directory of the batch output path named after
+ it, so names may only use letters, digits, '.', '_' and '-', must not start
+ with '.', and must not be one of the batch's own directories.
+ */
+struct cBatchSample {
+  string         name;
+  vector<string> read_file_names;
+  string         options;
+
+  //! Directories of the batch output path that are not sample outputs
+  static const string k_prepared_reference_directory;
+  static const string k_bowtie2_index_cache_directory;
+
+  //! Sum of the sizes of the read files, used to order the samples
+  uint64_t read_files_size() const;
+
+  //! Empty if the name can be used, otherwise why not
+  static string name_error(const string& name);
+
+  static vector<cBatchSample> read_sample_sheet(const string& file_name);
+};
+
+} // namespace breseq
+
+#endif
@@ -28,6 +28,7 @@ namespace breseq {
   // pre defs
   class alignment_wrapper;
   class cReferenceSequences;
+  class cFastaSequence;
 
   void calculate_trims( const string& in_fasta, const string& in_output_path);
   void calculate_trims_1( const string& in_fasta, const string& in_output_path);
@@ -63,6 +64,20 @@ namespace breseq {
     
     SequenceTrims(const string& _in_seq);
     
+    // Reads the sequence a window at a time, so a packed sequence is never unpacked whole
+    SequenceTrims(const cFastaSequence& _in_seq);
+    
+    // Zeroed trims for a sequence of this length, to be filled by add_window()
+    void allocate(uint32_t length);
+    
+    // Trims for start_0 up to start_0 + num_positions - 1. The window of bases
+    // begins at start_0 and must run k_lookahead bases past these positions, or to
+    // the end of the sequence. Trims are capped at 255, so no more are ever needed.
+    void add_window(const string& window, uint32_t start_0, uint32_t num_positions);
+    
+    static const uint32_t k_window_length = 1 << 16;
+    static const uint32_t k_lookahead = 255 + 18;
+    
     ~SequenceTrims() { if (trim_data) delete[] trim_data; };
     
     inline void ReadFile(const string& trim_file_name, uint32_t in_seq_length) 
@@ -16,6 +16,20 @@ namespace breseq {
   double nbdtr(double k, double n, double p);
   double nbdtri(double k, double n, double p);
   
+  // Negative binomial parameterized by size and mean, as in R
+  inline double pnbinom(double k, double size, double mu)
+  {
+    return nbdtr(k, size, size / (size + mu));
+  }
+  double qnbinom(double p, double size, double mu);
+  
+  // Two-sided Fisher's exact test for the 2x2 table with rows (a, b) and (c, d), as fisher.test() in R
+  double fisher_exact_test(uint32_t a, uint32_t b, uint32_t c, uint32_t d);
+  
+  // Two-sample Kolmogorov-Smirnov test with alternative "less", as ks.test(x, y, alternative="less")
+  // in R, using the asymptotic p-value R reports for one-sided tests (also when there are ties)
+  double ks_test_less(vector<double> x, vector<double> y);
+  
   double incbi(double aa, double bb, double yy0);
   double incbet(double aa, double bb, double xx);
   double incbcf(double a, double b, double x);
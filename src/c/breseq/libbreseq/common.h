@@ -32,6 +32,7 @@ LICENSE AND COPYRIGHT
   #include <libproc.h>
 #endif
 #include <limits.h>
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -39,8 +40,10 @@ LICENSE AND COPYRIGHT
 #include <string.h>
 #include <time.h>
 #include <limits.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
 #if HAVE_LIBUNWIND
   #include <libunwind.h>
@@ -67,6 +70,8 @@ LICENSE AND COPYRIGHT
 #include <utility>
 #include <functional>
 #include <iterator>
+#include <thread>
+#include <atomic>
 
 #include "gzstream.h"
 
@@ -83,6 +88,8 @@ LICENSE AND COPYRIGHT
 #define _base_bam_is_N(x) (x == 0x0f)
 #define _base_char_is_N(x) (x == 'N')
 
+// Passed to commands run by SYSTEM() (not declared by all system headers)
+extern char **environ;
 
 
 using namespace std;
@@ -528,6 +535,26 @@ namespace breseq {
     return file_empty(filename.c_str());
   }
 
+  // size in bytes, or zero if the file does not exist
+  inline uint64_t file_size(const string& filename)
+  {
+    struct stat filestatus;
+    if (stat( filename.c_str(), &filestatus ) == 0)
+      return filestatus.st_size;
+    return 0;
+  }
+
+  // modification time in nanoseconds, so that rewrites within one second can be told apart
+  inline int64_t file_modification_time_ns(const struct stat& filestatus)
+  {
+#ifdef __APPLE__
+    const struct timespec& mtime = filestatus.st_mtimespec;
+#else
+    const struct timespec& mtime = filestatus.st_mtim;
+#endif
+    return static_cast<int64_t>(mtime.tv_sec) * 1000000000 + static_cast<int64_t>(mtime.tv_nsec);
+  }
+
 	inline uint32_t fix_flags(uint32_t flags)
 	{
 		flags = ((flags >> 9) << 9) + flags % 128;
@@ -828,6 +855,17 @@ namespace breseq {
     return "\"" + input + "\"";
   }
   
+  //! Quoted for a shell command line: any characters, including spaces and quotes, stay in one argument
+  inline string shell_quote(const string& input)
+  {
+    string quoted = "'";
+    for (size_t i = 0; i < input.size(); i++) {
+      if (input[i] == '\'') quoted += "'\\''";
+      else quoted += input[i];
+    }
+    return quoted + "'";
+  }
+  
   //  Special handling of NA and INF values in doubles
   //  Used for consensus and polymorphism scores
   //  compatible with C++ limits and R representations
@@ -1429,13 +1467,38 @@ inline ostream &operator<<( ostream &out, const formatted_double &fd ) {
   return out;
 }
   
+//! Largest peak memory (kilobytes) of the commands run by SYSTEM() that
+//! finished since this was last reset to zero
+inline atomic<uint64_t>& system_child_peak_rss()
+{
+  static atomic<uint64_t> child_peak_rss(0);
+  return child_peak_rss;
+}
+
+//! Like system(), but waits with wait4() to keep the command's peak memory
 inline int SYSTEM(string command, bool silent = false, bool ignore_errors = false, bool escape_shell_chars = true)
 {
   if (escape_shell_chars) {
     command = cString(command).escape_shell_chars();
   }
   if (!silent) cerr << "[system] " << command << endl;
-  int return_value = system(command.c_str());
+  
+  int return_value = -1;
+  pid_t pid;
+  const char* argv[] = { "sh", "-c", command.c_str(), NULL };
+  if (posix_spawn(&pid, "/bin/sh", NULL, NULL, const_cast<char* const*>(argv), environ) == 0) {
+    struct rusage usage;
+    while ((wait4(pid, &return_value, 0, &usage) == -1) && (errno == EINTR)) { }
+    
+    // ru_maxrss is in bytes on OS X and kilobytes on Linux
+#ifdef __APPLE__
+    uint64_t peak_rss = usage.ru_maxrss / 1024;
+#else
+    uint64_t peak_rss = usage.ru_maxrss;
+#endif
+    uint64_t previous = system_child_peak_rss();
+    while ((peak_rss > previous) && !system_child_peak_rss().compare_exchange_weak(previous, peak_rss)) { }
+  }
   
   string error_message = "Error running command:\n[system] " + command + "\nResult code: " + to_string(return_value);
   if (ignore_errors)
@@ -1460,6 +1523,36 @@ template<uint32_t nth_place> double roundp(double value) {
   return floor(value * nth_place + 0.5f) / nth_place;
 }
 
+/*! Call function(i) for every i in [0, num_items) using up to num_threads threads.
+ 
+ Items are handed out in order to whichever thread is free, so function must
+ be safe to call concurrently for different items. Each result should be
+ stored by its index, and anything that must happen in order (printing,
+ merging) done after this returns. Runs in the calling thread if num_threads <= 1.
+ */
+template<typename F> void parallel_for(const size_t num_items, const uint32_t num_threads, F function)
+{
+  if ((num_threads <= 1) || (num_items <= 1)) {
+    for (size_t i = 0; i < num_items; i++) {
+      function(i);
+    }
+    return;
+  }
+  
+  atomic<size_t> next_item(0);
+  vector<thread> threads;
+  for (size_t t = 0; t < min(static_cast<size_t>(num_threads), num_items); t++) {
+    threads.push_back(thread([&]() {
+      for (size_t i = next_item++; i < num_items; i = next_item++) {
+        function(i);
+      }
+    }));
+  }
+  for (vector<thread>::iterator it = threads.begin(); it != threads.end(); it++) {
+    it->join();
+  }
+}
+
 } // breseq
 
 #endif
@@ -38,12 +38,25 @@ namespace breseq {
 		string path;
 		string r_script;
 
-		static vector<string> fit(
-                              Settings& settings, 
-                              string distribution_file_name, 
-                              string plot_file, 
-                              double deletion_propagation_pr_cutoff
-                              );
+		static void fit(
+                    const string& distribution_file_name,
+                    double deletion_propagation_pr_cutoff,
+                    CoverageSummary& fit
+                    );
+    
+		static vector<string> fit_with_r(
+                                     Settings& settings, 
+                                     string distribution_file_name, 
+                                     string plot_file, 
+                                     double deletion_propagation_pr_cutoff
+                                     );
+    
+		static void plot_fit(
+                         Settings& settings,
+                         const string& distribution_file_name,
+                         const string& plot_file,
+                         const CoverageSummary& fit
+                         );
     
 		static void analyze_unique_coverage_distribution(
                                                      Settings& settings, 
@@ -81,7 +94,8 @@ namespace breseq {
                       string in_file_name,
                       string out_file_name,
                       string tiled_for_edging_file_name,
-                      uint32_t tile_size
+                      uint32_t tile_size,
+                      ostream& log = cout
                       );
 
     //Given a coverage file, this will perform the circular binary
@@ -92,13 +106,16 @@ namespace breseq {
     //12 30
     //11 11
     //This function also accepts files created by coverage_distribution::tile()
+    //The randomization tests of each search segment are split across num_threads.
     //Written by Aaron Reba
     static void find_segments (const Settings& settings,
                                double summary_average,
                                string in_file_name,
                                string tiled_for_edging_file_name,
                                string out_file_name,
-                               string history_file_name
+                               string history_file_name,
+                               uint32_t num_threads = 1,
+                               ostream& log = cout
                                );
 
     //Given a coverage file and a range file produced from
@@ -112,7 +129,8 @@ namespace breseq {
                                 string segment_file_name,
                                 string out_file_name,
                                 string final_file_name,
-                                string gd_file_name
+                                string gd_file_name,
+                                ostream& log = cout
                                 );
     
     // Output GC content of all reads (of a theorized length)
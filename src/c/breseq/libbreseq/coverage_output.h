@@ -22,6 +22,8 @@
 #include "common.h"
 #include "pileup_base.h"
 #include "pileup.h"
+#include "coverage_plot.h"
+#include "coverage_profile.h"
 
 using namespace std;
 
@@ -43,6 +45,7 @@ namespace breseq
     string    m_average_file_name;
     Summary   m_summary;
     
+    bool      m_use_r;                       // plot with plot_coverage.r instead of cCoveragePlot
     string    m_r_script_file_name;
     string    m_intermediate_path;
     string    m_read_begin_output_file_name; // extra output file set as option
@@ -53,6 +56,16 @@ namespace breseq
     ofstream  m_read_begin_output; 
     ofstream  m_gc_output;
     
+    // positions saved for drawing when plotting without R
+    bool      m_save_positions;
+    vector<coverage_plot_position> m_saved_positions;
+    
+    // coverage of whole sequences tabulated earlier, used instead of a pileup
+    const cCoverageProfile* m_profile;
+    
+    // counts of the target being profiled, set only while profiling
+    coverage_counts* m_profile_counts;
+    
     map<string,uint32_t> m_read_begin_top_bins;
     map<string,uint32_t> m_read_begin_bot_bins;
     map<string,uint32_t> m_ref_begin_top_bins;
@@ -63,6 +76,15 @@ namespace breseq
     //! Clear saved statistics before beginning a new table
     void clear();
     
+    //! Run the pileup over a region, recording every position
+    void tabulate(const string& region, uint32_t resolution);
+    
+    //! Record positions of a region from the profile rather than the BAM
+    void tabulate_from_profile(uint32_t target_id, uint32_t start_pos, uint32_t end_pos, uint32_t downsample);
+    
+    //! Write a position to the table and/or save it for plotting
+    void record_position(const coverage_plot_position& c);
+    
     //! Called for each alignment.
 		virtual void pileup_callback(const pileup& p);
     
@@ -73,8 +95,9 @@ namespace breseq
     
     coverage_output( const string& bam, const string& fasta, const string& r_script_file_name, const string& intermediate_path = "/tmp" )
       : pileup_base(bam, fasta), m_output_format("png"), m_downsample(0), m_total_only(false)
-      , m_shaded_flanking(0), m_show_average(false), m_fixed_coverage_scale(0.0), m_r_script_file_name(r_script_file_name)
-      , m_intermediate_path(intermediate_path) {};
+      , m_shaded_flanking(0), m_show_average(false), m_fixed_coverage_scale(0.0), m_use_r(false)
+      , m_r_script_file_name(r_script_file_name), m_intermediate_path(intermediate_path), m_save_positions(false)
+      , m_profile(NULL), m_profile_counts(NULL) {};
     
     // Get/Set Options
 
@@ -83,8 +106,8 @@ namespace breseq
       if (_output_format.length() > 0)
       {
         m_output_format = to_lower(_output_format);
-        ASSERT( (m_output_format=="png") || (m_output_format=="pdf"), 
-                "Unrecognized coverage plot output format '" + m_output_format + "'.\nValid options are: png or pdf");
+        ASSERT( (m_output_format=="png") || (m_output_format=="svg") || (m_output_format=="pdf"), 
+                "Unrecognized coverage plot output format '" + m_output_format + "'.\nValid options are: png, svg, or pdf");
       }
       return m_output_format; 
     }
@@ -106,9 +129,25 @@ namespace breseq
     
     void fixed_coverage_scale(const double fixed_coverage_scale)
     { m_fixed_coverage_scale = fixed_coverage_scale; }
+    
+    //! Draw plots by running R. PDF output always uses R.
+    void use_r(const bool _use_r)
+    { m_use_r = _use_r; }
      
+    //! Make plots and tables of sequences in this profile from it, without a new pileup.
+    //! The profile must have been made from the same BAM file and stay in scope.
+    void use_profile(const cCoverageProfile* profile)
+    { m_profile = profile; }
+    
     void plot(const string& region, const string& output_file_name, uint32_t resolution = 600);
     void table(const string& region, const string& output_file_name, uint32_t resolution = 0);
+    
+    //! Tabulate coverage of positions start_pos..end_pos of a target already allocated in the profile
+    void tabulate_profile(cCoverageProfile& profile, uint32_t target_id, uint32_t start_pos, uint32_t end_pos);
+    
+    //! Tabulate coverage of entire targets into the profile, splitting each into pieces run in parallel
+    static void profile_targets(cCoverageProfile& profile, const string& bam, const string& fasta,
+                                const vector<string>& seq_ids, uint32_t num_threads);
   };
   
   
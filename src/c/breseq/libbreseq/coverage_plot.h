@@ -0,0 +1,85 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#ifndef _BRESEQ_COVERAGE_PLOT_H_
+#define _BRESEQ_COVERAGE_PLOT_H_
+
+#include "common.h"
+
+namespace breseq {
+
+/*! Coverage at one reference position, as tabulated by coverage_output.
+ */
+struct coverage_plot_position {
+  uint32_t position;
+  char     ref_base;
+  uint32_t unique_cov[2];          // [0] = top strand, [1] = bottom strand
+  double   redundant_cov[2];       // reads weighted by 1/redundancy
+  uint32_t raw_redundant_cov[2];
+  uint32_t unique_begin_reads[2];
+};
+
+/*! Draws a coverage plot directly to a PNG or SVG file.
+
+ Reproduces the layout of plot_coverage.r (11 x 6 inches at 200 dpi, with a
+ legend strip below the plot) without starting R. Coverage lines are drawn
+ as steps, so every segment is horizontal or vertical and the raster output
+ needs no anti-aliasing.
+ */
+class cCoveragePlot {
+public:
+
+  cCoveragePlot()
+  : m_window_start(0), m_window_end(0), m_average_coverage(0.0)
+  , m_fixed_coverage_scale(0.0), m_total_only(false)
+  { }
+
+  //! Positions inside the window are unshaded, those outside it are flanking.
+  void set_window(uint32_t window_start, uint32_t window_end)
+    { m_window_start = window_start; m_window_end = window_end; }
+
+  //! Draw a line at this coverage (0 = none).
+  void set_average_coverage(double average_coverage)
+    { m_average_coverage = average_coverage; }
+
+  //! Maximum of the coverage axis (0 = fit to the data).
+  void set_fixed_coverage_scale(double fixed_coverage_scale)
+    { m_fixed_coverage_scale = fixed_coverage_scale; }
+
+  void set_total_only(bool total_only)
+    { m_total_only = total_only; }
+
+  //! Draw the plot for these positions, which must be in order.
+  //! Format is "png" or "svg".
+  void draw(const vector<coverage_plot_position>& positions, const string& output_file_name, const string& format) const;
+
+  //! Axis tick positions covering [low, high] with about num_intervals
+  //! intervals of 1, 2, or 5 times a power of ten (like R's pretty()).
+  static vector<double> pretty_ticks(double low, double high, uint32_t num_intervals = 5);
+
+protected:
+  uint32_t m_window_start;
+  uint32_t m_window_end;
+  double   m_average_coverage;
+  double   m_fixed_coverage_scale;
+  bool     m_total_only;
+};
+
+} // namespace breseq
+
+#endif
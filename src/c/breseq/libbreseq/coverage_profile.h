@@ -0,0 +1,184 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#ifndef _BRESEQ_COVERAGE_PROFILE_H_
+#define _BRESEQ_COVERAGE_PROFILE_H_
+
+#include "common.h"
+
+namespace breseq {
+
+/*! Coverage counts at one reference position.
+
+ The same values as coverage_plot_position, without the position and base,
+ which are known from where the counts are stored. Redundant coverage is
+ kept as a float, which is precise beyond the six significant digits written
+ to tables, so that a position takes 32 bytes.
+ */
+struct coverage_counts {
+  uint32_t unique_cov[2];          // [0] = top strand, [1] = bottom strand
+  uint32_t raw_redundant_cov[2];
+  uint32_t unique_begin_reads[2];
+  float    redundant_cov[2];       // reads weighted by 1/redundancy
+};
+
+/*! Per-position coverage of entire reference sequences.
+
+ Filled in by coverage_output in one pass through the BAM file, after which
+ coverage tables and plots of any region of a profiled sequence are made
+ from these counts rather than by a new pileup.
+
+ Profiles can be written to a binary file and memory-mapped back in, so the
+ counts for large genomes are paged in from disk as they are used.
+ */
+class cCoverageProfile {
+public:
+
+  cCoverageProfile()
+  : m_mapped_data(NULL), m_mapped_size(0)
+  { }
+
+  ~cCoverageProfile()
+    { clear(); }
+
+  //! Has coverage for this target been tabulated or loaded?
+  bool has_target(uint32_t target_id) const
+    { return (target_id < m_targets.size()) && (m_targets[target_id].counts != NULL); }
+
+  uint32_t target_length(uint32_t target_id) const
+    { return has_target(target_id) ? m_targets[target_id].length : 0; }
+
+  //! Counts for positions 1..length are at indices 0..length-1
+  const coverage_counts* target(uint32_t target_id) const
+    { return has_target(target_id) ? m_targets[target_id].counts : NULL; }
+
+  //! Make zeroed storage for a target, which is then filled in by coverage_output
+  coverage_counts* allocate_target(uint32_t target_id, uint32_t length);
+
+  //! Release all targets and any mapped file
+  void clear();
+
+  //! Write all profiled targets to a binary file
+  void write(const string& file_name) const;
+
+  //! Map a file created by write(). Returns false if it does not exist.
+  bool map(const string& file_name);
+
+private:
+
+  // Not copyable, because targets may point into the mapped file
+  cCoverageProfile(const cCoverageProfile&);
+  cCoverageProfile& operator=(const cCoverageProfile&);
+
+  struct target_profile {
+    target_profile() : length(0), counts(NULL) { }
+    uint32_t                length;
+    coverage_counts*        counts;
+    vector<coverage_counts> storage;  // empty when counts are in the mapped file
+  };
+
+  vector<target_profile> m_targets;
+  void*                  m_mapped_data;
+  size_t                 m_mapped_size;
+};
+
+/*! Columnar binary file of the coverage at each position of one reference
+ sequence, written during mutation identification and read by the copy
+ number variation tiling ([seq_id].coverage.bin).
+
+ After a header with the sequence id, the first position, and the number of
+ positions, each column is stored for all positions in turn. Every value
+ takes 4 bytes. Columns are written in chunks as positions are added, so the
+ whole sequence is never held in memory, and a mapped file is read directly.
+ */
+class cCoverageColumnFile {
+public:
+
+  enum column_t {
+    UNIQUE_TOP = 0, UNIQUE_BOT, REDUNDANT_TOP, REDUNDANT_BOT,
+    RAW_REDUNDANT_TOP, RAW_REDUNDANT_BOT, E_VALUE, NUM_COLUMNS
+  };
+
+  cCoverageColumnFile()
+  : m_first_position(0), m_num_positions(0), m_capacity(0)
+  , m_mapped_data(NULL), m_mapped_size(0)
+  { }
+
+  ~cCoverageColumnFile()
+    { close(); }
+
+  //! Start a new file for at most capacity consecutive positions
+  void create(const string& file_name, const string& seq_id, uint32_t capacity);
+
+  //! Add the next position, which must follow the last one added
+  void add(uint32_t position,
+           uint32_t unique_top, uint32_t unique_bot,
+           double redundant_top, double redundant_bot,
+           uint32_t raw_redundant_top, uint32_t raw_redundant_bot,
+           double e_value);
+
+  //! Finish a file being written, or release a mapped file
+  void close();
+
+  //! Map a file created by create()
+  void map(const string& file_name);
+
+  const string& seq_id() const { return m_seq_id; }
+  uint32_t first_position() const { return m_first_position; }
+  uint32_t size() const { return m_num_positions; }
+
+  //! Values of a column in a mapped file
+  const uint32_t* counts(column_t column) const
+    { return reinterpret_cast<const uint32_t*>(m_columns[column]); }
+  const float* values(column_t column) const
+    { return reinterpret_cast<const float*>(m_columns[column]); }
+
+private:
+
+  // Not copyable, because of the open or mapped file
+  cCoverageColumnFile(const cCoverageColumnFile&);
+  cCoverageColumnFile& operator=(const cCoverageColumnFile&);
+
+  // Each value is stored as 4 bytes, an integer or float depending on the column
+  union value_t {
+    uint32_t count;
+    float    value;
+  };
+
+  void flush_chunk();
+
+  string   m_seq_id;
+  uint32_t m_first_position;
+  uint32_t m_num_positions;
+  uint32_t m_capacity;
+
+  // writing
+  ofstream         m_out;
+  size_t           m_columns_offset;
+  uint32_t         m_chunk_start;
+  vector<value_t>  m_chunk[NUM_COLUMNS];
+
+  // reading
+  const void*      m_columns[NUM_COLUMNS];
+  void*            m_mapped_data;
+  size_t           m_mapped_size;
+};
+
+} // namespace breseq
+
+#endif
@@ -28,7 +28,68 @@ namespace breseq {
 	/*! Interface for loading and manipulating files in FASTA format.
    */
   
+  /*! Nucleotide sequence stored with two bits per base.
+   
+   Characters other than A, C, G, and T (usually runs of N) are kept as a
+   sorted list of runs that override the packed bases at those positions.
+   All positions are 0-indexed.
+   */
+  
+  class cPackedSequence {
+    
+  public:
+    cPackedSequence() : m_length(0) {}
+    ~cPackedSequence() {}
+    
+    //! Returns false and stays empty if there are so many non-ACGT runs
+    //! that packing would not save memory.
+    bool pack(const string& sequence);
+    
+    string unpack() const
+    {
+      string sequence;
+      get_sequence_0(0, m_length, sequence);
+      return sequence;
+    }
+    
+    void clear()
+    {
+      m_length = 0;
+      vector<uint8_t>().swap(m_bases);
+      vector<uint32_t>().swap(m_run_start);
+      vector<uint32_t>().swap(m_run_length);
+      string().swap(m_run_char);
+    }
+    
+    size_t length() const { return m_length; }
+    
+    char get_base_0(const size_t pos_0) const
+    {
+      if (!m_run_start.empty()) {
+        size_t run = upper_bound(m_run_start.begin(), m_run_start.end(), pos_0) - m_run_start.begin();
+        if ((run > 0) && (pos_0 < static_cast<size_t>(m_run_start[run-1]) + m_run_length[run-1]))
+          return m_run_char[run-1];
+      }
+      return s_code_to_base[(m_bases[pos_0 >> 2] >> ((pos_0 & 3) << 1)) & 3];
+    }
+    
+    //! Replace the contents of sequence with length bases starting at start_0.
+    void get_sequence_0(const size_t start_0, const size_t length, string& sequence) const;
+    
+  private:
+    static const char s_code_to_base[4];
+    
+    size_t m_length;
+    vector<uint8_t> m_bases;       //!< Four bases per byte, first base in the low bits.
+    vector<uint32_t> m_run_start;  //!< Runs of one character that is not A, C, G, or T.
+    vector<uint32_t> m_run_length;
+    string m_run_char;
+  };
+  
   /*! Sequence class.
+   
+   The sequence may optionally be packed to two bits per base. Accessors
+   work the same either way, and changing the sequence unpacks it.
    */
    
   class cFastaSequence {
@@ -37,20 +98,47 @@ namespace breseq {
       string m_name;          //>NAME DESCRIPTION
       string m_description;   //
       string m_sequence;      //sequence ...
+      cPackedSequence m_packed_sequence; // used instead of m_sequence when packed
+      bool m_is_packed;
     
     public:
-      cFastaSequence() {}
+      cFastaSequence() : m_is_packed(false) {}
       cFastaSequence(const string& _name, const string& _description, const string& _sequence)
-          : m_name(_name), m_description(_description), m_sequence(_sequence) {}
+          : m_name(_name), m_description(_description), m_sequence(_sequence), m_is_packed(false) {}
       ~cFastaSequence() {}
     
     void set_name(const string& _name) { m_name = _name; }
     void set_description(const string& _description) { m_description = _description; }
-    void set_sequence(const string& _sequence) { m_sequence = _sequence; }
+    void set_sequence(const string& _sequence)
+    {
+      m_sequence = _sequence;
+      m_packed_sequence.clear();
+      m_is_packed = false;
+    }
     
     const string get_description() const { return m_description; }
     const string get_name() const { return m_name; }
-    const string get_sequence() const { return m_sequence; }
+    const string get_sequence() const { return m_is_packed ? m_packed_sequence.unpack() : m_sequence; }
+    
+    //! Returns false and leaves the sequence unpacked if it is not worth packing.
+    bool pack_sequence()
+    {
+      if (m_is_packed) return true;
+      if (!m_packed_sequence.pack(m_sequence)) return false;
+      string().swap(m_sequence);
+      m_is_packed = true;
+      return true;
+    }
+    
+    void unpack_sequence()
+    {
+      if (!m_is_packed) return;
+      m_sequence = m_packed_sequence.unpack();
+      m_packed_sequence.clear();
+      m_is_packed = false;
+    }
+    
+    bool is_packed() const { return m_is_packed; }
     
     // Utility function for checking and correcting bounds
     void correct_coordinate_bounds(int64_t &pos_1) const {
@@ -59,9 +147,9 @@ namespace breseq {
         pos_1 = 1;
       }
       
-      if (pos_1 > (int64_t)(m_sequence.length())) {
-        WARN_WITH_BACKTRACE("Coordinate (" + to_string<int64_t>(pos_1) + ") requested for get_sequence_1 is > length of sequence (" + to_string(m_sequence.length()) + ") .");
-        pos_1 = m_sequence.length();
+      if (pos_1 > (int64_t)(get_sequence_length())) {
+        WARN_WITH_BACKTRACE("Coordinate (" + to_string<int64_t>(pos_1) + ") requested for get_sequence_1 is > length of sequence (" + to_string(get_sequence_length()) + ") .");
+        pos_1 = get_sequence_length();
       }
       
     }
@@ -83,17 +171,39 @@ namespace breseq {
       correct_coordinate_bounds(start_1);
       correct_coordinate_bounds(end_1);
       correct_range_bounds(start_1, end_1);
+      if (m_is_packed) {
+        string sequence;
+        m_packed_sequence.get_sequence_0(start_1-1, end_1-start_1+1, sequence);
+        return sequence;
+      }
       return m_sequence.substr(start_1-1, end_1-start_1+1);
     }
     
+    // Same, but reuses the caller's string, e.g. when scanning a whole sequence in pieces
+    void get_sequence_1(int64_t start_1, int64_t end_1, string& sequence) const
+    {
+      sequence.clear();
+      if ((start_1==0) && (end_1==0)) return;
+      
+      correct_coordinate_bounds(start_1);
+      correct_coordinate_bounds(end_1);
+      correct_range_bounds(start_1, end_1);
+      if (m_is_packed) {
+        m_packed_sequence.get_sequence_0(start_1-1, end_1-start_1+1, sequence);
+      } else {
+        sequence.assign(m_sequence, start_1-1, end_1-start_1+1);
+      }
+    }
+    
     char get_sequence_1(int64_t pos_1) const
     {
       correct_coordinate_bounds(pos_1);
-      return m_sequence[pos_1-1];
+      return m_is_packed ? m_packed_sequence.get_base_0(pos_1-1) : m_sequence[pos_1-1];
     }
 
     
     void replace_sequence_1(int64_t start_1, int64_t end_1, const string &replacement_seq) {
+      unpack_sequence();
       correct_coordinate_bounds(start_1);
       correct_coordinate_bounds(end_1);
       correct_range_bounds(start_1, end_1);
@@ -101,6 +211,7 @@ namespace breseq {
     }
     
     void insert_sequence_1(int64_t pos_1, const string &insertion_seq) {
+      unpack_sequence();
       // Allow a value of zero, whcih means insert at the start of the sequence
       if (pos_1 != 0) correct_coordinate_bounds(pos_1);
       m_sequence.insert(pos_1, insertion_seq);
@@ -109,7 +220,44 @@ namespace breseq {
     
     size_t get_sequence_length() const
     {
-      return m_sequence.length();
+      return m_is_packed ? m_packed_sequence.length() : m_sequence.length();
+    }
+    
+    // Bases per piece when a whole sequence is scanned without copying it
+    static const int64_t k_scan_length = 1 << 16;
+    
+    //! Number of 'G' and 'C' bases
+    uint64_t get_gc_count() const
+    {
+      uint64_t gc = 0;
+      const int64_t seq_length = get_sequence_length();
+      string s;
+      for (int64_t start_1 = 1; start_1 <= seq_length; start_1 += k_scan_length)
+      {
+        get_sequence_1(start_1, min(start_1 + k_scan_length - 1, seq_length), s);
+        for (size_t i=0; i<s.length(); i++)
+        {
+          if ( (s[i] == 'G') ||(s[i] == 'C') )
+            gc++;
+        }
+      }
+      return gc;
+    }
+    
+    //! Same bases as another sequence, whether either is packed or not
+    bool has_same_sequence(const cFastaSequence& other) const
+    {
+      const int64_t seq_length = get_sequence_length();
+      if (seq_length != (int64_t)other.get_sequence_length()) return false;
+      string s, other_s;
+      for (int64_t start_1 = 1; start_1 <= seq_length; start_1 += k_scan_length)
+      {
+        int64_t end_1 = min(start_1 + k_scan_length - 1, seq_length);
+        get_sequence_1(start_1, end_1, s);
+        other.get_sequence_1(start_1, end_1, other_s);
+        if (s != other_s) return false;
+      }
+      return true;
     }
     
 
@@ -118,7 +266,14 @@ namespace breseq {
   inline ostream& operator<<(ostream& out, const cFastaSequence& fasta_sequence)
   {
     out << ">" <<fasta_sequence.get_name() << endl;
-    out << fasta_sequence.get_sequence() << endl;
+    const int64_t seq_length = fasta_sequence.get_sequence_length();
+    string s;
+    for (int64_t start_1 = 1; start_1 <= seq_length; start_1 += cFastaSequence::k_scan_length)
+    {
+      fasta_sequence.get_sequence_1(start_1, min(start_1 + cFastaSequence::k_scan_length - 1, seq_length), s);
+      out << s;
+    }
+    out << endl;
     return out;
   }
 
@@ -34,6 +34,10 @@ class cAnnotatedSequence;
    
       Main function for this analysis. Prints summary information
       about fastq and converts file to SANGER format if necessary.
+   
+      Conversion stops once current_read_file_bases reaches read_file_base_limit.
+      Or, if read_file_sample_fraction is set, reads are chosen at random from the
+      whole file, keeping about that fraction of them.
    */  
   AnalyzeFastqSummary normalize_fastq(
                                         const string &file_name, 
@@ -43,6 +47,7 @@ class cAnnotatedSequence;
                                         const bool filter_reads,
                                         uint64_t current_read_file_bases,
                                         const uint64_t read_file_base_limit,
+                                        const double read_file_sample_fraction,
                                         const uint32_t read_length_min,
                                         const double max_same_base_fraction,
                                         const double max_N_fraction
@@ -120,8 +120,20 @@ public:
   
   //!---- Input and Output ---- !//
   
-  //! Read a genome diff from a file.
-  cFileParseErrors read(const string& filename, bool suppress_errors = false);
+  //! Read a genome diff from a file. Uses a binary index (see gdtools INDEX)
+  //! instead of parsing the file if one is present and up to date.
+  cFileParseErrors read(const string& filename, bool suppress_errors = false, bool use_index = true);
+  
+  //! Read a genome diff from a file, keeping only mutations within a region.
+  cFileParseErrors read_within_region(const string& filename, cReferenceSequences& ref_seq_info, const string& region, bool suppress_errors = false);
+  
+  //! Read many genome diffs using up to num_threads threads. Errors are
+  //! reported in file order after all are read. If region is given, only
+  //! mutations within it are kept, as for read_within_region.
+  static void read_multiple(vector<cGenomeDiff>& gd_list, const vector<string>& file_names, const uint32_t num_threads, cReferenceSequences* ref_seq_info = NULL, const string& region = "");
+  
+  //! Parse one '#=' metadata line.
+  void read_header_line(const string& whole_line, uint32_t line_number, cFileParseErrors& parse_errors);
   
   //! Check to see if genome diff is valid with reference sequences
   cFileParseErrors valid_with_reference_sequences(cReferenceSequences& ref_seq, bool suppress_errors = false);
@@ -141,6 +153,9 @@ public:
   //! Add an item to this genome diff. Returns pointer to new copy of item.
   diff_entry_ptr_t add(const cDiffEntry& item, bool assign_unique_id=true);
   
+  //! Add an item that has already been allocated, without copying it.
+  diff_entry_ptr_t add_entry_ptr(diff_entry_ptr_t& item, bool assign_unique_id=true);
+  
   //! Removes an entry, with properly updating mutations that pointed to it
   diff_entry_list_t::iterator remove(diff_entry_list_t::iterator remove_it);
   
@@ -220,7 +235,7 @@ public:
   static bool diff_entry_ptr_sort_apply_order(const diff_entry_ptr_t& a, const diff_entry_ptr_t& b);
   
   // Normal sort. Used for printing, merging, and compare.
-  void sort() { _entry_list.sort(diff_entry_ptr_sort); }
+  void sort() { if (!is_sorted(_entry_list.begin(), _entry_list.end(), diff_entry_ptr_sort)) _entry_list.sort(diff_entry_ptr_sort); }
 
   // Sort -- taking into account 'before' and 'within' tags
   void sort_apply_order();
@@ -105,7 +105,6 @@ namespace breseq {
   extern const char* POLYMORPHISM_SCORE;
   extern const char* POLYMORPHISM_FREQUENCY;
   extern const char* MAJOR_FREQUENCY;
-  extern const char* POLYMORPHISM_EXISTS;
   
   //For MC
   extern const char* START_RANGE;
@@ -327,6 +326,9 @@ namespace breseq {
     //! Serialize this diff entry into a string for output.
     virtual string as_string(void) const;
     
+    //! Append the serialized line (no newline) to a string without copying fields.
+    void append_to_string(string& line) const;
+    
     //! Output all keys and values
     string as_key_values() const {
       string s;
@@ -0,0 +1,147 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#ifndef _BRESEQ_GENOME_DIFF_INDEX_H_
+#define _BRESEQ_GENOME_DIFF_INDEX_H_
+
+#include "common.h"
+#include "file_parse_errors.h"
+#include "storable.h"
+
+namespace breseq {
+
+// Predefs
+class cGenomeDiff;
+
+/*! Binary sidecar index for a GenomeDiff file.
+
+ Stored next to the text file as <file>.gdx, and only used when its recorded
+ size and modification time still match the text file.
+
+ Entries are stored column-wise in the order they have after reading
+ (sorted, with ids assigned) so they can be restored without parsing or
+ sorting. All strings are kept once in a shared string table. Mutations
+ are also indexed by seq_id and position so that a region can be loaded
+ without constructing every mutation in the file.
+ */
+
+class cGenomeDiffIndex : public Storable {
+public:
+
+  static const uint32_t kMagic;
+  static const uint32_t kFormatVersion;
+
+  cGenomeDiffIndex()
+  : m_valid(false), m_source_size(0), m_source_mtime(0) {
+    return;
+  }
+  virtual ~cGenomeDiffIndex() {}
+
+  //! Name of the sidecar file for a GenomeDiff file.
+  static string index_file_path(const string& gd_file_path)
+    { return gd_file_path + ".gdx"; }
+
+  //! Read a GenomeDiff text file and write its sidecar index.
+  static void create(const string& gd_file_path);
+
+  //! Delete the sidecar index, if there is one.
+  static void remove(const string& gd_file_path);
+
+  //! Load the sidecar for this GenomeDiff file. Returns false if there is
+  //! none or it is out of date or from a different version.
+  bool load(const string& gd_file_path);
+
+  //! Write this index for a GenomeDiff file.
+  void write(const string& gd_file_path);
+
+  //! Fill a genome diff with the indexed header and all entries.
+  void restore(cGenomeDiff& gd, cFileParseErrors& parse_errors) const;
+
+  //! Fill a genome diff with the indexed header, all evidence and validation
+  //! entries, and only mutations that overlap start_1 to end_1 on seq_id.
+  void restore_region(cGenomeDiff& gd, cFileParseErrors& parse_errors, const string& seq_id, const uint32_t start_1, const uint32_t end_1) const;
+
+  //! Indexes of entries that are mutations overlapping start_1 to end_1 on seq_id.
+  vector<uint32_t> mutations_overlapping(const string& seq_id, const uint32_t start_1, const uint32_t end_1) const;
+
+  uint32_t num_entries() const { return m_entry_type.size(); }
+
+  //! Storable
+  void serialize(ofstream& f);
+  void deserialize(ifstream& f);
+
+protected:
+
+  //! Index an already loaded genome diff with its original '#=' header lines.
+  void build(cGenomeDiff& gd, const vector<string>& header_lines);
+
+  //! Add (or look up) a string in the table and return its index.
+  uint32_t intern(const string& s, map<string,uint32_t>& lookup);
+
+  //! Get a string from the table.
+  string get_string(const uint32_t i) const
+    { return string(m_string_data.data() + m_string_start[i], m_string_start[i+1] - m_string_start[i]); }
+
+  //! Add header and selected entries to gd.
+  void restore_entries(cGenomeDiff& gd, cFileParseErrors& parse_errors, const vector<bool>& include_entry) const;
+
+  //! Size and modification time of a file. Returns false if it can't be checked.
+  static bool get_source_stamp(const string& file_path, uint64_t& size, int64_t& mtime);
+
+  static void write_column(ofstream& f, vector<uint32_t>& v);
+  static void read_column(ifstream& f, vector<uint32_t>& v);
+
+  bool m_valid;                         //!< Header was recognized when deserialized.
+  uint64_t m_source_size;               //!< Size of text file that was indexed.
+  int64_t m_source_mtime;               //!< Modification time (ns) of text file that was indexed.
+
+  //! String table.
+  vector<uint32_t> m_string_start;      //!< Offset of each string, plus one past the end.
+  vector<char> m_string_data;
+
+  //! Names of entry types, in case the type enumeration changes between versions.
+  vector<uint32_t> m_type_names;
+
+  //! Raw metadata lines, replayed through the text parser.
+  vector<uint32_t> m_header_lines;
+
+  //! One value per entry.
+  vector<uint32_t> m_entry_type;        //!< Index into m_type_names.
+  vector<uint32_t> m_entry_id;
+  vector<uint32_t> m_entry_field_start; //!< Into field columns, plus one past the end.
+  vector<uint32_t> m_entry_evidence_start; //!< Into evidence column, plus one past the end.
+
+  //! All key=value fields and evidence ids.
+  vector<uint32_t> m_field_key;
+  vector<uint32_t> m_field_value;
+  vector<uint32_t> m_evidence;
+
+  //! One run of positions per seq_id.
+  vector<uint32_t> m_seq_id;
+  vector<uint32_t> m_seq_id_position_start; //!< Into position columns, plus one past the end.
+
+  //! Mutation positions, sorted by start within each seq_id.
+  vector<uint32_t> m_position_start;
+  vector<uint32_t> m_position_end;
+  vector<uint32_t> m_position_max_end;  //!< Largest end so far within the seq_id, for overlap queries.
+  vector<uint32_t> m_position_entry;
+};
+
+} // breseq namespace
+
+#endif
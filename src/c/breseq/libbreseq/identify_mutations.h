@@ -21,6 +21,7 @@ LICENSE AND COPYRIGHT
 
 #include "common.h"
 #include "chisquare.h"
+#include "coverage_profile.h"
 #include "error_count.h"
 #include "genome_diff.h"
 #include "pileup_base.h"
@@ -272,6 +273,9 @@ namespace breseq {
     void write_gd(const string& filename)
       { _gd.write(filename); }
     
+    //! Calculate likelihood of a specific mixture of two bases producing observed read bases, given an error table.
+    static double calculate_two_base_model_log10_likelihood (cErrorTable& error_table, base_char best_base_char, base_char second_best_base_char, const vector<polymorphism_data>& pdata, double best_base_freq);
+    
     
 	protected:
 		//! Helper method to track deletions.
@@ -280,8 +284,8 @@ namespace breseq {
 		//! Helper method to track unknowns.
 		void update_unknown_intervals(uint32_t position, uint32_t seq_id, bool base_predicted, bool this_position_unique_only_coverage);
 
-    //! Helper function for writing a line to the polymorphism file.
-    void write_polymorphism_input_file_line(const pileup& p, const uint32_t insert_count, char ref_base_char, char best_base_char, char second_best_base_char, const polymorphism_prediction& ppred, position_base_info& pos_info, const vector<polymorphism_data>& pdata );
+    //! Helper function for adding strand and quality score bias statistics to a polymorphism.
+    void add_polymorphism_statistics(cDiffEntry& mut, char best_base_char, char second_best_base_char, position_base_info& pos_info, const vector<polymorphism_data>& pdata);
     
 		//! Predict whether there is a significant polymorphism.
     polymorphism_prediction predict_polymorphism (base_char best_base_char, base_char second_best_base_char, vector<polymorphism_data>& pdata );
@@ -296,7 +300,8 @@ namespace breseq {
     pair<double,double> best_two_base_model_log10_likelihood(base_char best_base_char, base_char second_best_base_char, vector<polymorphism_data>& pdata);
 
 		//! Calculate likelihood of a specific mixture of two bases producing observed read bases.
-    double calculate_two_base_model_log10_likelihood (base_char best_base_char, base_char second_best_base_char, const vector<polymorphism_data>& pdata, double best_base_freq);
+    double calculate_two_base_model_log10_likelihood (base_char best_base_char, base_char second_best_base_char, const vector<polymorphism_data>& pdata, double best_base_freq)
+      { return calculate_two_base_model_log10_likelihood(_error_table, best_base_char, second_best_base_char, pdata, best_base_freq); }
 		
     //! Settings passed at command line
     const Settings& _settings;
@@ -313,6 +318,7 @@ namespace breseq {
     
     //! Settings calculated during initialization
 		double _log10_ref_length; //!< log10 of the total reference sequence.
+    uint64_t _total_reference_length; //!< total reference sequence length, for bias E-values.
     
     //! Initialized once per pileup
     cErrorTable _error_table;
@@ -324,11 +330,8 @@ namespace breseq {
 		
 		// this is used to output detailed coverage data:
 		bool _print_coverage_data; //!< whether or not to print
-		ofstream _coverage_data;
+		cCoverageColumnFile _coverage_data;
 
-		// this is used to output strand and quality information for R to process:
-		ofstream _polymorphism_r_input_file;
-		
 		// these are state variables used by the deletion-prediction method.
     double _this_deletion_propagation_cutoff;
     double _this_deletion_seed_cutoff;
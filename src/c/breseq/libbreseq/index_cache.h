@@ -0,0 +1,60 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#ifndef _BRESEQ_INDEX_CACHE_H_
+#define _BRESEQ_INDEX_CACHE_H_
+
+#include "common.h"
+
+namespace breseq {
+
+//! MD5 (in hex) of the contents of a file, followed by suffix if it is not empty
+string file_md5(const string& file_name, const string& suffix = "");
+
+/*! Directory of bowtie2 indexes shared by runs against the same references.
+
+ Each index is stored in a subdirectory named by the MD5 of the reference
+ FASTA written by breseq (so sequences are already normalized) and the
+ bowtie2 version. Building an index holds a lock file, so concurrent runs
+ wait for one build rather than each making their own. The index is built
+ in a temporary directory that is renamed into place only when complete,
+ so a subdirectory that exists is always a finished index.
+ */
+class cBowtie2IndexCache {
+public:
+
+  cBowtie2IndexCache(const string& cache_path, const string& bowtie2_version_string)
+  : m_cache_path(cache_path), m_bowtie2_version_string(bowtie2_version_string)
+  { }
+
+  //! Name of the subdirectory for the index of this FASTA file
+  string key(const string& fasta_file_name) const;
+
+  //! Returns the bowtie2 index base name (for -x) of this FASTA file,
+  //! building the index in the cache if it is not already there
+  string index(const string& fasta_file_name) const;
+
+private:
+
+  string m_cache_path;
+  string m_bowtie2_version_string;
+};
+
+} // namespace breseq
+
+#endif
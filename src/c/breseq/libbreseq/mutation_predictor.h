@@ -36,7 +36,8 @@ namespace breseq {
 	{
 	public:
 
-		static cReferenceSequences ref_seq_info;
+		//! Not copied, must outlive the predictor
+		cReferenceSequences& ref_seq_info;
 
 		MutationPredictor(cReferenceSequences& ref_seq_info);
 
@@ -68,6 +69,9 @@ namespace breseq {
 
 	private:
 
+    //! Reference sequences for the static sort functions
+    static cReferenceSequences* s_ref_seq_info;
+
     // Helper functions for tandem repeats
 		cFeatureLocation* within_repeat(string seq_id, int32_t position);
     void find_repeat_unit(string& mutation_sequence, uint32_t& repeat_size, string& repeat_sequence);
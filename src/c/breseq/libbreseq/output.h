@@ -76,6 +76,9 @@ extern const char* SIDE_2_OVERLAP;
 extern const char* SIDE_1_JC;
 extern const char* SIDE_2_JC;
 
+// Predefs
+class alignment_output;
+
 namespace output 
 {
 
@@ -153,6 +156,39 @@ extern const char* ALIGN_LEFT;
   string html_header(const string& title, const Settings& settings);
   string breseq_header_string(const Settings& settings);
 
+  /*! Output file for large HTML pages.
+   
+   Text goes into a buffer of fixed size that is only written to the file when
+   it fills up or the file is closed, so tables can be written to it directly
+   (endl does not flush) without building the whole page in memory first.
+   */
+  class cHtmlOutputFile : public ostream
+  {
+  public:
+    cHtmlOutputFile(const string& file_name, size_t buffer_size = 4 * 1024 * 1024);
+    ~cHtmlOutputFile() { close(); }
+    
+    void close();
+    
+  private:
+    class buffer : public streambuf
+    {
+    public:
+      buffer(const string& file_name, size_t buffer_size);
+      bool is_open() { return m_file.is_open(); }
+      bool write_to_file();
+      void close() { write_to_file(); m_file.close(); }
+    protected:
+      virtual int_type overflow(int_type c);
+      virtual int sync() { return 0; }
+    private:
+      ofstream m_file;
+      vector<char> m_buffer;
+    };
+    
+    buffer m_buffer;
+  };
+
   
 /*-----------------------------------------------------------------------------
  * HTML FILES 
@@ -209,16 +245,18 @@ void html_compare(
   
 
   
-struct Html_Mutation_Table_String : public string
+//! Writes a table of mutations to a stream, one row at a time.
+struct Html_Mutation_Table
 {
   public:
     //!Constructors
-    Html_Mutation_Table_String(
-                               const Settings& settings,
-                               cGenomeDiff& gd,
-                               diff_entry_list_t& list_ref,
-                               MutationTableOptions& options
-                               );
+    Html_Mutation_Table(
+                        ostream& out,
+                        const Settings& settings,
+                        cGenomeDiff& gd,
+                        diff_entry_list_t& list_ref,
+                        MutationTableOptions& options
+                        );
     
    
     //! Main Build Object
@@ -231,13 +269,35 @@ struct Html_Mutation_Table_String : public string
     size_t total_cols; //!< Shared between Factory Methods, set in Header_Line()
 
     //!Parameters
-    Settings settings;
-    cGenomeDiff gd;
-    diff_entry_list_t list_ref;
-    MutationTableOptions options;
+    ostream& out;
+    const Settings& settings;
+    cGenomeDiff& gd;
+    diff_entry_list_t& list_ref;
+    MutationTableOptions& options;
+};
+  
+//! The same table as a string, for small tables.
+struct Html_Mutation_Table_String : public string
+{
+  public:
+    Html_Mutation_Table_String(
+                               const Settings& settings,
+                               cGenomeDiff& gd,
+                               diff_entry_list_t& list_ref,
+                               MutationTableOptions& options
+                               );
 };
 
-
+// These write each table directly to a stream. The *_string versions
+// return the same table as a string.
+  
+void html_missing_coverage_table(
+                                 ostream& out,
+                                 diff_entry_list_t& list_ref,
+                                 bool show_details,
+                                 const string& title = "Missing coverage evidence...",
+                                 const string& relative_link=""
+                                 );
 string html_missing_coverage_table_string(
                                           diff_entry_list_t& list_ref,
                                           bool show_details,
@@ -245,6 +305,13 @@ string html_missing_coverage_table_string(
                                           const string& relative_link=""
                                           );
 
+void html_read_alignment_table(
+                               ostream& out,
+                               diff_entry_list_t& list_ref,
+                               bool show_details,
+                               const string& title = "Read alignment evidence...",
+                               const string& relative_link = ""
+                               );
 string html_read_alignment_table_string(
                                         diff_entry_list_t& list_ref,
                                         bool show_details,
@@ -252,6 +319,13 @@ string html_read_alignment_table_string(
                                         const string& relative_link = ""
                                         );
 
+void html_new_junction_table(ostream& out,
+                             diff_entry_list_t& jc,
+                             const Settings& settings,
+                             bool show_details,
+                             const string& title = "New junction evidence",
+                             const string& relative_link = ""
+                             );
 string html_new_junction_table_string(diff_entry_list_t& jc,
                                       const Settings& settings,
                                       bool show_details,
@@ -259,6 +333,13 @@ string html_new_junction_table_string(diff_entry_list_t& jc,
                                       const string& relative_link = ""
                                       );
   
+void html_copy_number_table(
+                            ostream& out,
+                            diff_entry_list_t& list_ref, 
+                            bool show_details, 
+                            const string& title = "Copy number evidence", 
+                            const string& relative_link = ""
+                            );
 string html_copy_number_table_string(
                                      diff_entry_list_t& list_ref, 
                                      bool show_details, 
@@ -282,6 +363,40 @@ string decode_reject_reason(const string & reject);
  *  Output Utilities
  *-----------------------------------------------------------------------------*/
 
+/*! Remembers what each evidence page and coverage plot was made from.
+ 
+ A hash of all of the inputs of each file (the entry, render options, and the
+ size and modification time of the BAM and FASTA files) is stored in a table
+ in the evidence directory. When the Output step is run again, files with the
+ same hash are kept instead of being made again.
+ */
+class cOutputFileCache
+{
+public:
+  //! Loads the table, if it exists.
+  cOutputFileCache(const string& cache_file_name);
+  
+  //! Hash of a description of all inputs to an output file.
+  static string hash(const string& inputs);
+  
+  //! Path, size, and modification time (ns), to detect changes to an input file.
+  static string file_fingerprint(const string& file_name);
+  
+  //! True if file_name exists and was made from inputs with this hash.
+  bool is_current(const string& file_name, const string& inputs_hash) const;
+  
+  //! Record the inputs of a newly made file.
+  void update(const string& file_name, const string& inputs_hash)
+    { m_hashes[file_name] = inputs_hash; }
+  
+  //! Save the table.
+  void write() const;
+  
+private:
+  string m_cache_file_name;
+  map<string, string> m_hashes; // output file name => inputs hash
+};
+
 // sub draw_coverage
 void draw_coverage(Settings& settings, cReferenceSequences& ref_seq_info, cGenomeDiff& gd);
   
@@ -310,9 +425,23 @@ struct cOutputEvidenceFiles
   
   private:
   
+    //! Alignment objects reused for each BAM and FASTA file pair
+    typedef map<string, counted_ptr<alignment_output> > alignment_output_map_t;
+  
     void add_evidence(const string& file_name, diff_entry_ptr_t item,
                       diff_entry_ptr_t parent_item, map<string,string>& fields);
-    void html_evidence_file(const Settings& settings, cGenomeDiff& gd, cOutputEvidenceItem& item);
+    //! Page header and tables for the item and its evidence. Not thread safe.
+    string html_evidence_file_header(const Settings& settings, cGenomeDiff& gd, cOutputEvidenceItem& item);
+  
+    //! Region shown in the read alignment of an item without a plot.
+    static string evidence_region(cOutputEvidenceItem& item);
+  
+    //! Alignment object for the item's BAM and FASTA files, created on first use.
+    static alignment_output& evidence_alignment_output(const Settings& settings, cOutputEvidenceItem& item, alignment_output_map_t& alignment_outputs);
+  
+    //! Write the page, adding a read alignment of region if there is no plot. Safe to
+    //! call concurrently for different items with different alignment_outputs.
+    void html_evidence_file(const Settings& settings, cOutputEvidenceItem& item, const string& header, const string& region, alignment_output_map_t& alignment_outputs);
 };
   
 }// end output namespace
@@ -109,6 +109,16 @@ class pileup_base {
   
     //! Do the fetch, (Callback for each read alignment to region.)
     void do_fetch(const string& region);
+  
+    //! Read the alignments to all of these regions in one pass through the BAM.
+    //  Overlapping regions are merged into windows that are read in order and kept
+    //  in memory one at a time. Later calls to do_fetch() and do_pileup(region)
+    //  for regions inside a window use these alignments instead of the BAM index,
+    //  so they are fastest when made in the same order.
+    void set_region_batch(const vector<string>& regions);
+  
+    //! Go back to reading every region from the BAM.
+    void clear_region_batch();
 
     //! Pileup callback.
     virtual void pileup_callback(const pileup& p) {
@@ -259,6 +269,27 @@ class pileup_base {
     uint32_t m_last_tid; //!< The "last target" for which the first-level-callback was called. -1 = none
   
     bool m_print_progress;
+  
+    //! Calls func for each alignment overlapping [start_0, end_0), like bam_fetch,
+    //! but from the current region batch window if one contains this region.
+    void fetch_alignments(uint32_t target_id, uint32_t start_0, uint32_t end_0, void* data, bam_fetch_f func);
+  
+    //! A window of merged regions from set_region_batch().
+    struct region_batch_window {
+      uint32_t target_id;
+      uint32_t start_0;  // 0-indexed, inclusive
+      uint32_t end_0;    // 0-indexed, exclusive
+      
+      bool operator<(const region_batch_window& other) const
+      {
+        if (target_id != other.target_id) return (target_id < other.target_id);
+        return (start_0 < other.start_0);
+      }
+    };
+  
+    vector<region_batch_window> m_region_batch;    //!< Sorted and non-overlapping.
+    size_t m_region_batch_loaded;                  //!< Window in m_region_batch_alignments, or m_region_batch.size() if none.
+    vector<bam1_t*> m_region_batch_alignments;     //!< Alignments to the loaded window, in BAM order.
 };
 
 } // breseq
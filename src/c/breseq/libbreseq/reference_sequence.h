@@ -925,16 +925,20 @@ namespace breseq {
       uint64_t len = 0;
       for (cReferenceSequences::const_iterator it = (*this).begin(); it != (*this).end(); it++)
       {
-        string s = it->m_fasta_sequence.get_sequence();
-        len+= s.size();
-        for (size_t i=0; i<s.length(); i++)
-        {
-          if ( (s[i] == 'G') ||(s[i] == 'C') )
-            gc++;
-        }
+        len+= it->m_fasta_sequence.get_sequence_length();
+        gc+= it->m_fasta_sequence.get_gc_count();
       }
       return gc / len;
     }
+    
+    //!< Store all sequences with two bits per base, see cPackedSequence
+    void pack_sequences()
+    {
+      for (cReferenceSequences::iterator it = (*this).begin(); it != (*this).end(); it++)
+      {
+        it->m_fasta_sequence.pack_sequence();
+      }
+    }
 
     void add_new_seq(const string& seq_id, const string& file_name)
     {
@@ -1134,7 +1138,6 @@ namespace breseq {
     void annotate_1_mutation(cDiffEntry& mut, uint32_t start, uint32_t end, bool repeat_override = false, bool ignore_pseudogenes = false);
     void categorize_1_mutation(cDiffEntry& mut, int32_t large_size_cutoff);
     void annotate_mutations(cGenomeDiff& gd, bool only_muts = false, bool ignore_pseudogenes = false, bool compare_mode = false, int32_t large_size_cutoff=kBreseq_large_mutation_size_cutoff, bool verbose = false);
-    void polymorphism_statistics(Settings& settings, Summary& summary);
     string repeat_family_sequence(const string& repeat_name, int8_t strand, string* repeat_region = NULL, string* picked_seq_id=NULL, cFeatureLocation* picked_sequence_feature=NULL, bool fatal_error=true);
     
     string safe_seq_id_name(const string& input)
@@ -1264,6 +1267,11 @@ namespace breseq {
     return gc / seq.length();
   }
 
+  inline double gc_percentage_string(const cFastaSequence& seq)
+  {
+    return static_cast<double>(seq.get_gc_count()) / seq.get_sequence_length();
+  }
+
 } // breseq namespace
 
 #endif
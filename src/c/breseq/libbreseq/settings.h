@@ -23,6 +23,7 @@ LICENSE AND COPYRIGHT
 #include "common.h"
 #include "storable.h"
 #include "reference_sequence.h"
+#include "trace.h"
 
 namespace breseq
 {
@@ -32,6 +33,40 @@ namespace breseq
   extern const char* kBreseqAlignmentScoreBAMTag;
   extern const char* kBreseqBestAlignmentScoreBAMTag;
 
+  //! Resources used by this process and by its child processes that have
+  //! finished (bowtie2, R, ...). Times are in seconds, memory in kilobytes,
+  //! and bytes are those passed to read/write calls (including cached reads).
+  //! Peak memory is only filled in per step (see Settings::record_peak_memory).
+  struct ResourceUsage {
+    double   user_time;
+    double   system_time;
+    double   child_user_time;
+    double   child_system_time;
+    uint64_t peak_rss;
+    uint64_t child_peak_rss;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+
+    ResourceUsage()
+    : user_time(0), system_time(0), child_user_time(0), child_system_time(0)
+    , peak_rss(0), child_peak_rss(0), bytes_read(0), bytes_written(0)
+    { }
+
+    //! Totals so far for this process
+    static ResourceUsage current();
+
+    //! Resources used between start and this point, without peaks
+    ResourceUsage since(const ResourceUsage& start) const;
+
+    //! Peak memory of this process since the last call, after which the peak
+    //! is reset. Where it cannot be reset (not Linux), this is the peak over
+    //! the whole run so far.
+    static uint64_t take_peak_rss();
+
+    //! Peak memory of commands run by SYSTEM() that finished since the last call
+    static uint64_t take_child_peak_rss();
+  };
+
 	class ExecutionTime : public Storable {
   public:
 		string _message;
@@ -46,7 +81,14 @@ namespace breseq
 		string _formatted_time_end;
     // stores a list of files that need to be cleaned up after later steps
     storable_map<string,storable_vector<string> > _done_key_intermediate_files;
-    
+    // resources used by the step, process-wide while it ran (so steps that
+    // overlap are each charged for everything running at the same time),
+    // with the peaks accumulated while the step is still running
+    ResourceUsage _resources;
+    ResourceUsage _resources_start; // not stored
+    int64_t _trace_start;           // not stored, -1 if not traced
+    
+    ExecutionTime() : _time_start(0), _time_end(0), _trace_start(-1) {};
     virtual ~ExecutionTime() {};
     
     void serialize(ofstream& f)
@@ -62,6 +104,14 @@ namespace breseq
       write_to_file(f, _time_end);
       write_to_file(f, _formatted_time_end);
       _done_key_intermediate_files.serialize(f);
+      write_to_file(f, _resources.user_time);
+      write_to_file(f, _resources.system_time);
+      write_to_file(f, _resources.child_user_time);
+      write_to_file(f, _resources.child_system_time);
+      write_to_file(f, _resources.peak_rss);
+      write_to_file(f, _resources.child_peak_rss);
+      write_to_file(f, _resources.bytes_read);
+      write_to_file(f, _resources.bytes_written);
     }
     void deserialize(ifstream& f)
     {
@@ -76,6 +126,16 @@ namespace breseq
       read_from_file(f, _time_end);
       read_from_file(f, _formatted_time_end);
       _done_key_intermediate_files.deserialize(f);
+      // Done files from older versions end here
+      if (f.peek() == EOF) return;
+      read_from_file(f, _resources.user_time);
+      read_from_file(f, _resources.system_time);
+      read_from_file(f, _resources.child_user_time);
+      read_from_file(f, _resources.child_system_time);
+      read_from_file(f, _resources.peak_rss);
+      read_from_file(f, _resources.child_peak_rss);
+      read_from_file(f, _resources.bytes_read);
+      read_from_file(f, _resources.bytes_written);
     }
 	};
 	
@@ -224,6 +284,7 @@ namespace breseq
     vector<string> read_file_names;             // REQUIRED COMMAND-LINE OPTION
     bool aligned_sam_mode;                      // Default = false COMMAND-LINE OPTION
     double  read_file_coverage_fold_limit;      // Default = 0 (OFF) COMMAND-LINE OPTION
+    bool read_file_coverage_fold_limit_random;  // Default = false COMMAND-LINE OPTION
     uint32_t read_file_read_length_min;         // Default = 18 COMMAND-LINE OPTION
     double read_file_max_same_base_fraction;    // Default = 0.9 COMMAND-LINE OPTION
     double read_file_max_N_fraction;            // Default = 0.5 COMMAND-LINE OPTION
@@ -248,6 +309,8 @@ namespace breseq
 		bool no_unmatched_reads;                  // Default = false
     //! Don't delete intermediate files
     bool keep_all_intermediates;              // Default = false
+    //! Write a timing trace of the run
+    bool trace;                               // Default = false
 
     //! Settings: Read Alignment and Candidate Junction Read Alignment
     
@@ -260,6 +323,7 @@ namespace breseq
     string bowtie2_stage1;          // COMMAND-LINE OPTION
     string bowtie2_stage2;          // COMMAND-LINE OPTION (can be blank to skip step)
     string bowtie2_junction;        // COMMAND-LINE OPTION
+    string bowtie2_index_cache_path; // COMMAND-LINE OPTION (blank to build the index in each run)
     uint64_t bowtie2_junction_maximum_alignments_to_consider_per_read;       // Default = 2000
     uint64_t bowtie2_genome_maximum_alignments_to_consider_per_read;         // Default = 2000
 
@@ -330,6 +394,7 @@ namespace breseq
     //! Settings: Mutation Identification
     
     string user_evidence_genome_diff_file_name; // Default = none COMMAND-LINE OPTION
+    string prepared_reference_path;             // Default = none COMMAND-LINE OPTION (directory written by BATCH)
     
     //! ignore bases below this cutoff for RA evidence (still counted for deletions?)
     uint32_t base_quality_cutoff;                         // Default 3    COMMAND-LINE OPTION
@@ -347,6 +412,9 @@ namespace breseq
     //! References are amplicons or ultra-deep sequencing of a small reference
     bool targeted_sequencing;                             // Default = false COMMAND-LINE OPTION
     
+    //! Keep reference sequences packed two bits per base in memory
+    bool pack_reference_sequences;                        // Default = false COMMAND-LINE OPTION
+    
     //! Verbose output of bases encountered at each position
     bool print_mutation_identification_per_position_file;
 
@@ -389,6 +457,10 @@ namespace breseq
     uint32_t max_displayed_reads;                           // Default = 100   COMMAND-LINE OPTION
     //! don't include javascript in HTML output, for Galaxy integration
     bool no_javascript;                                     // Default = false COMMAND-LINE OPTION
+    //! draw coverage plots with R instead of the built-in renderer
+    bool r_coverage_plots;                                  // Default = false COMMAND-LINE OPTION
+    //! format and file extension of coverage plots: png, svg or pdf
+    string coverage_plot_format;                            // Default = png
     string header_genome_diff_file_name;                    // Default = NONE  COMMAND-LINE OPTION
     uint32_t max_nucleotides_to_show_in_tables;      // Default = 8
     uint32_t max_rejected_read_alignment_evidence_to_show;  // Default = 20
@@ -488,6 +560,7 @@ namespace breseq
 		string error_calibration_path;
 		string error_counts_done_file_name;
 		string error_rates_done_file_name;
+		string error_rates_plot_done_file_name;
     
 		string error_counts_file_name;
 		string error_rates_file_name;
@@ -504,17 +577,9 @@ namespace breseq
     
 		string mutation_identification_done_file_name;    
 		string mutation_identification_per_position_file_name;
-		string complete_coverage_text_file_name;
-		string genome_error_counts_file_name;
+		string complete_coverage_file_name;
     string ra_mc_genome_diff_file_name;
     
-    string polymorphism_statistics_done_file_name;
-    string polymorphism_statistics_input_file_name;
-		string polymorphism_statistics_output_file_name;
-		string polymorphism_statistics_r_script_file_name;
-		string polymorphism_statistics_r_script_log_file_name;
-		string polymorphism_statistics_ra_mc_genome_diff_file_name;
-    
 		//! Paths: Copy Number Variation
     string copy_number_variation_path;
     string copy_number_variation_done_file_name;
@@ -542,6 +607,7 @@ namespace breseq
     string local_evidence_path;
 		string evidence_path;
     string evidence_genome_diff_file_name;
+    string evidence_cache_file_name;
     string final_genome_diff_file_name;
     string annotated_genome_diff_file_name;
 
@@ -569,6 +635,7 @@ namespace breseq
     string output_genome_diff_file_name;
     string output_annotated_genome_diff_file_name;
     string data_summary_file_name;
+    string trace_file_name;
     
     //! Paths: Experimental
 		string long_pairs_file_name;
@@ -761,6 +828,10 @@ namespace breseq
       ex_time._time_elapsed = 0;
       ex_time._formatted_time_elapsed = "";
       ex_time._message = message;
+      ex_time._resources_start = ResourceUsage::current();
+      // The peak so far belongs to the steps already running
+      this->record_peak_memory();
+      if (cTrace::enabled()) ex_time._trace_start = cTrace::now();
 
       this->execution_times.push_back(ex_time);
     }
@@ -782,6 +853,8 @@ namespace breseq
 				this->execution_times.push_back(blank);
 			}
 
+			this->record_peak_memory();
+
 			ExecutionTime& ex_time = this->execution_times[i];
 			ex_time._message = message;
 
@@ -794,8 +867,25 @@ namespace breseq
 			{
 				ex_time._time_elapsed = difftime(ex_time._time_end, ex_time._time_start);
 				ex_time._formatted_time_elapsed = elapsedtime2string(ex_time._time_elapsed);
+				ResourceUsage peaks = ex_time._resources;
+				ex_time._resources = ResourceUsage::current().since(ex_time._resources_start);
+				ex_time._resources.peak_rss = peaks.peak_rss;
+				ex_time._resources.child_peak_rss = peaks.child_peak_rss;
 			}
 		}
+
+    //! Charges the peak memory since a step last started or finished to all
+    //! of the steps that are running, then resets it
+    void record_peak_memory()
+    {
+      uint64_t peak_rss = ResourceUsage::take_peak_rss();
+      uint64_t child_peak_rss = ResourceUsage::take_child_peak_rss();
+      for (vector<ExecutionTime>::iterator it = this->execution_times.begin(); it != this->execution_times.end(); it++) {
+        if (it->_time_end != 0) continue;
+        it->_resources.peak_rss = max(it->_resources.peak_rss, peak_rss);
+        it->_resources.child_peak_rss = max(it->_resources.child_peak_rss, child_peak_rss);
+      }
+    }
     
     // Convenience accessors for reference file settings.
 
@@ -0,0 +1,117 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#ifndef _BRESEQ_STEP_SCHEDULER_H_
+#define _BRESEQ_STEP_SCHEDULER_H_
+
+#include "common.h"
+#include "settings.h"
+
+namespace breseq {
+
+/*! Runs jobs that each use some number of threads, as many at once as fit
+ within the number of processors, and each only after the jobs it depends on.
+
+ Ready jobs are started in the order they were added, but a later job that
+ fits can start while an earlier one is waiting for threads. A job that
+ needs more threads than there are processors runs by itself.
+ */
+class cJobScheduler {
+public:
+
+  cJobScheduler(uint32_t num_processors)
+  : m_num_processors(max<uint32_t>(1, num_processors))
+  { }
+
+  //! Add a job that runs after the jobs with these indexes. Returns the
+  //! index of the new job, for use as a dependency of later jobs.
+  size_t add_job(uint32_t num_threads, const vector<size_t>& dependencies, function<void()> run);
+
+  //! Run all jobs, returning when they are complete
+  void run();
+
+  uint32_t num_processors() const { return m_num_processors; }
+
+  //! Divide the processors among jobs in proportion to the size of their
+  //! input, giving each at least one thread.
+  static vector<uint32_t> split_threads_by_size(const vector<uint64_t>& sizes, uint32_t num_processors);
+
+private:
+
+  enum job_state_t { WAITING, RUNNING, FINISHED };
+
+  struct job_t {
+    vector<size_t>   dependencies;
+    uint32_t         num_threads;
+    function<void()> run;
+    job_state_t      state;
+  };
+
+  uint32_t      m_num_processors;
+  vector<job_t> m_jobs;
+};
+
+/*! Runs pipeline steps as a dependency graph.
+
+ Each step is identified by its done file, as with Settings::do_step and
+ Settings::done_step, so a step completed by an earlier run is skipped and
+ a run that stops partway resumes from the steps that are not done. Steps
+ whose dependencies are complete run concurrently, as long as the threads
+ they use fit within the number of processors. A step that needs more
+ threads than that runs by itself.
+ */
+class cStepScheduler {
+public:
+
+  cStepScheduler(Settings& settings, uint32_t num_processors)
+  : m_settings(settings), m_num_processors(max<uint32_t>(1, num_processors))
+  { }
+
+  //! Add a step that depends on the steps with these done keys. Dependencies
+  //! on steps that were not added (because they are turned off) are ignored.
+  //! finish is called once the step is complete, whether it ran now or in an
+  //! earlier run, for example to load its results into the summary.
+  void add_step(const string& done_key,
+                const string& message,
+                const vector<string>& dependencies,
+                uint32_t num_threads,
+                function<void()> run,
+                function<void()> finish = function<void()>());
+
+  //! Run all steps, returning when they are complete
+  void run();
+
+private:
+
+  struct step_t {
+    string           done_key;
+    string           message;
+    vector<size_t>   dependencies;
+    uint32_t         num_threads;
+    function<void()> run;
+    function<void()> finish;
+  };
+
+  Settings&      m_settings;
+  uint32_t       m_num_processors;
+  vector<step_t> m_steps;
+};
+
+} // namespace breseq
+
+#endif
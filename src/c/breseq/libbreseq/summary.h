@@ -29,6 +29,7 @@ namespace breseq{
   class cAnnotatedSequence;
   class Settings;
   class cReferenceSequenceSettings;
+  class ExecutionTime;
   
   // PRIVATE Summaries
   //
@@ -577,12 +578,38 @@ namespace breseq{
     PublicOptionsSummary(const Settings &t);
   };
   
+  class PublicExecutionTimeSummary : public JSONStorable<PublicExecutionTimeSummary> {
+  public:
+    
+    string step;
+    string time_start;
+    string time_end;
+    double time_elapsed;          // seconds
+    double cpu_user_time;         // seconds
+    double cpu_system_time;       // seconds
+    double children_cpu_user_time;   // seconds
+    double children_cpu_system_time; // seconds
+    uint64_t peak_memory;         // kilobytes, while this step ran
+    uint64_t children_peak_memory;   // kilobytes, largest command that finished while this step ran
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    
+    PublicExecutionTimeSummary() {}
+    PublicExecutionTimeSummary(const ExecutionTime &t);
+  };
+  
+  class PublicExecutionTimeSummaries : public vector<PublicExecutionTimeSummary>, public JSONStorable<PublicExecutionTimeSummaries> {
+  public:
+    PublicExecutionTimeSummaries() {}
+  };
+  
   class PublicSummary : public JSONStorable<PublicSummary>
   {
   public:
     PublicReadSummary reads;
     PublicReferencesSummary references;
     PublicOptionsSummary options;
+    PublicExecutionTimeSummaries execution_times;
     
     PublicSummary() {}
     PublicSummary(const Summary &s, const Settings &t, const cReferenceSequences &r);
@@ -616,6 +643,14 @@ namespace breseq{
   void to_json(json& j, const PublicOptionsSummary& s);
   void from_json(const json& j, PublicOptionsSummary& s);
 
+  // PublicExecutionTimeSummary
+  void to_json(json& j, const PublicExecutionTimeSummary& s);
+  void from_json(const json& j, PublicExecutionTimeSummary& s);
+  
+  // PublicExecutionTimeSummaries
+  void to_json(json& j, const PublicExecutionTimeSummaries& s);
+  void from_json(const json& j, PublicExecutionTimeSummaries& s);
+  
   // PublicSummary
   void to_json(json& j, const PublicSummary& s);
   void from_json(const json& j, PublicSummary& s);
@@ -0,0 +1,172 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#ifndef _BRESEQ_TRACE_H_
+#define _BRESEQ_TRACE_H_
+
+#include "common.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace breseq {
+
+/*! Timing trace of a run, written in the Chrome trace event format
+ (viewable in chrome://tracing or Perfetto) when --trace is given.
+
+ Nothing is recorded until open() is called. Each timed scope becomes one
+ event, with the counters added to it while it was the innermost scope on
+ its thread as arguments.
+ */
+class cTrace {
+public:
+
+  typedef vector<pair<const char*, int64_t> > counters_t;
+
+  //! Start recording events, to be written to this file by close()
+  static void open(const string& file_name);
+
+  //! Write the recorded events and stop recording
+  static void close();
+
+  static bool enabled() { return s_enabled; }
+
+  //! Nanoseconds since the trace was opened
+  static int64_t now()
+    { return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - s_origin).count(); }
+
+  //! Add an event that ran from start to end (in nanoseconds from now())
+  static void record(const string& name, int64_t start, int64_t end, const counters_t& counters = counters_t());
+
+private:
+
+  struct event_t {
+    string     name;
+    int64_t    start;
+    int64_t    end;
+    uint32_t   thread;
+    counters_t counters;
+  };
+
+  static uint32_t thread_index();
+
+  static bool                             s_enabled;
+  static string                           s_file_name;
+  static chrono::steady_clock::time_point s_origin;
+  static mutex                            s_mutex;
+  static vector<event_t>                  s_events;
+  static map<thread::id, uint32_t>        s_threads;
+};
+
+/*! Times the enclosing block as a trace event.
+
+ Counters (and the time spent in cTraceTimer blocks) are added to the
+ innermost scope of the thread they are counted on.
+ */
+class cTraceScope {
+public:
+
+  cTraceScope(const char* name)
+  : m_name(name), m_start(cTrace::enabled() ? cTrace::now() : -1), m_parent(s_current)
+    { if (m_start >= 0) s_current = this; }
+
+  ~cTraceScope()
+  {
+    if (m_start < 0) return;
+    cTrace::record(m_name, m_start, cTrace::now(), m_counters);
+    s_current = m_parent;
+  }
+
+  //! End this event and start a new one for the next phase of the block
+  void next(const char* name)
+  {
+    if (m_start < 0) return;
+    int64_t now = cTrace::now();
+    cTrace::record(m_name, m_start, now, m_counters);
+    m_name = name;
+    m_start = now;
+    m_counters.clear();
+  }
+
+  void count(const char* counter, int64_t n)
+  {
+    for (cTrace::counters_t::iterator it = m_counters.begin(); it != m_counters.end(); it++) {
+      if (strcmp(it->first, counter) == 0) {
+        it->second += n;
+        return;
+      }
+    }
+    m_counters.push_back(make_pair(counter, n));
+  }
+
+  //! Add to a counter of the innermost scope on this thread, if there is one
+  static void count_current(const char* counter, int64_t n)
+    { if (s_current) s_current->count(counter, n); }
+
+  static bool active() { return s_current != NULL; }
+
+private:
+
+  cTraceScope(const cTraceScope&);
+  cTraceScope& operator=(const cTraceScope&);
+
+  const char*            m_name;
+  int64_t                m_start;
+  cTraceScope*           m_parent;
+  cTrace::counters_t     m_counters;
+
+  static thread_local cTraceScope* s_current;
+};
+
+/*! Adds the nanoseconds spent in the enclosing block to a counter of the
+ innermost trace scope, for code that runs too often to be its own event.
+ */
+class cTraceTimer {
+public:
+
+  cTraceTimer(const char* counter)
+  : m_counter(counter), m_start(cTraceScope::active() ? cTrace::now() : -1)
+  { }
+
+  ~cTraceTimer()
+    { if (m_start >= 0) cTraceScope::count_current(m_counter, cTrace::now() - m_start); }
+
+private:
+  const char* m_counter;
+  int64_t     m_start;
+};
+
+} // namespace breseq
+
+// Instrumentation of hot paths, which is compiled out by configuring with
+// --disable-trace. Scopes are named so that phases can be marked with next().
+#if BRESEQ_TRACE
+  #define BRESEQ_TRACE_CONCAT2(a, b) a##b
+  #define BRESEQ_TRACE_CONCAT(a, b) BRESEQ_TRACE_CONCAT2(a, b)
+  #define TRACE_SCOPE(var, name) breseq::cTraceScope var(name)
+  #define TRACE_NEXT(var, name) var.next(name)
+  #define TRACE_COUNT(counter, n) breseq::cTraceScope::count_current(counter, n)
+  #define TRACE_TIMER(counter) breseq::cTraceTimer BRESEQ_TRACE_CONCAT(trace_timer_, __LINE__)(counter)
+#else
+  #define TRACE_SCOPE(var, name)
+  #define TRACE_NEXT(var, name)
+  #define TRACE_COUNT(counter, n)
+  #define TRACE_TIMER(counter)
+#endif
+
+#endif
@@ -26,11 +26,12 @@ using namespace std;
 
 namespace breseq {
 
-  cReferenceSequences MutationPredictor::ref_seq_info;
+  cReferenceSequences* MutationPredictor::s_ref_seq_info(NULL);
   
 	MutationPredictor::MutationPredictor(cReferenceSequences& _ref_seq_info)
+  : ref_seq_info(_ref_seq_info)
 	{
-		 ref_seq_info = _ref_seq_info;
+		 s_ref_seq_info = &ref_seq_info;
 	}
 
 	// Private methods
@@ -54,8 +55,8 @@ namespace breseq {
     int32_t a_pos = n(a->entry_exists("_side_1_is") ? (*a)["side_2_position"] : (*a)["side_1_position"]);
 		int32_t b_pos = n(b->entry_exists("_side_1_is") ? (*b)["side_2_position"] : (*b)["side_1_position"]);
 
-		int32_t a_seq_order = (a->entry_exists("_side_1_is") ? ref_seq_info.seq_order[(*a)["side_2_seq_id"]] : ref_seq_info.seq_order[(*a)["side_1_seq_id"]]);
-		int32_t b_seq_order = (b->entry_exists("_side_1_is") ? ref_seq_info.seq_order[(*b)["side_2_seq_id"]] : ref_seq_info.seq_order[(*b)["side_1_seq_id"]]);
+		int32_t a_seq_order = (a->entry_exists("_side_1_is") ? s_ref_seq_info->seq_order[(*a)["side_2_seq_id"]] : s_ref_seq_info->seq_order[(*a)["side_1_seq_id"]]);
+		int32_t b_seq_order = (b->entry_exists("_side_1_is") ? s_ref_seq_info->seq_order[(*b)["side_2_seq_id"]] : s_ref_seq_info->seq_order[(*b)["side_1_seq_id"]]);
 
 		uint32_t a_reject_order = a->number_reject_reasons();
 		uint32_t b_reject_order = b->number_reject_reasons();
@@ -20,6 +20,7 @@
 #include "libbreseq/anyoption.h"
 #include "libbreseq/alignment_output.h"
 #include "libbreseq/coverage_output.h"
+#include "libbreseq/trace.h"
 
 using namespace std;
 namespace breseq
@@ -210,13 +211,55 @@ string javascript_string()
 
 
 
+cHtmlOutputFile::buffer::buffer(const string& file_name, size_t buffer_size)
+  : m_file(file_name.c_str(), ios_base::out | ios_base::binary)
+  , m_buffer(max(buffer_size, static_cast<size_t>(1)))
+{
+  setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+}
+
+bool cHtmlOutputFile::buffer::write_to_file()
+{
+  if (pptr() > pbase()) {
+    m_file.write(pbase(), pptr() - pbase());
+    setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+  }
+  return m_file.good();
+}
+
+cHtmlOutputFile::buffer::int_type cHtmlOutputFile::buffer::overflow(int_type c)
+{
+  if (!write_to_file()) return traits_type::eof();
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+cHtmlOutputFile::cHtmlOutputFile(const string& file_name, size_t buffer_size)
+  : ostream(NULL)
+  , m_buffer(file_name, buffer_size)
+{
+  rdbuf(&m_buffer);
+  if (!m_buffer.is_open()) setstate(ios_base::badbit);
+}
+
+void cHtmlOutputFile::close()
+{
+  if (!m_buffer.is_open()) return;
+  m_buffer.close();
+}
+
 void html_index(const string& file_name, const Settings& settings, Summary& summary,
                 cReferenceSequences& ref_seq_info, cGenomeDiff& gd)
 {
   (void)summary;
   
+  TRACE_SCOPE(trace, "html_index");
+
   // Create Stream and Confirm It's Open
-  ofstream HTML(file_name.c_str());
+  cHtmlOutputFile HTML(file_name);
 
   if (!HTML.good()) {
     cerr << "Could not open file: " << file_name << endl;
@@ -242,7 +285,8 @@ void html_index(const string& file_name, const Settings& settings, Summary& summ
   MutationTableOptions mt_options(settings);
   mt_options.relative_link = relative_path;
   mt_options.one_ref_seq = (ref_seq_info.size() == 1);
-  HTML << Html_Mutation_Table_String(settings, gd, muts, mt_options) << endl;
+  Html_Mutation_Table(HTML, settings, gd, muts, mt_options);
+  HTML << endl;
   
   /////////////////////////
   // Unassigned MC evidence
@@ -252,7 +296,8 @@ void html_index(const string& file_name, const Settings& settings, Summary& summ
   mc.remove_if(cDiffEntry::rejected());
 
   if (mc.size() > 0) {
-    HTML << "<p>" << html_missing_coverage_table_string(mc, false, "Unassigned missing coverage evidence", relative_path);
+    HTML << "<p>";
+    html_missing_coverage_table(HTML, mc, false, "Unassigned missing coverage evidence", relative_path);
   }
   
   /////////////////////////
@@ -268,7 +313,7 @@ void html_index(const string& file_name, const Settings& settings, Summary& summ
    
   if (jc.size() > 0) {
     HTML << "<p>" << endl;
-    HTML << html_new_junction_table_string(jc, settings, false, "Unassigned new junction evidence", relative_path);
+    html_new_junction_table(HTML, jc, settings, false, "Unassigned new junction evidence", relative_path);
   }
   
   /////////////////////////
@@ -279,7 +324,8 @@ void html_index(const string& file_name, const Settings& settings, Summary& summ
   cn.remove_if(cDiffEntry::rejected());
   
   if (cn.size() > 0) {
-    HTML << "<p>" << html_copy_number_table_string(cn, false, "Unassigned copy number evidence", relative_path);
+    HTML << "<p>";
+    html_copy_number_table(HTML, cn, false, "Unassigned copy number evidence", relative_path);
   }
   
   // This code prints out a message if there was nothing in the previous tables
@@ -348,8 +394,10 @@ void html_marginal_predictions(const string& file_name, const Settings& settings
 {
   (void)summary;
   
+  TRACE_SCOPE(trace, "html_marginal_predictions");
+
   // Create Stream and Confirm It's Open
-  ofstream HTML(file_name.c_str());
+  cHtmlOutputFile HTML(file_name);
   
   if(!HTML.good()) {
     cerr << "Could not open file: " <<  file_name << endl;
@@ -411,7 +459,8 @@ void html_marginal_predictions(const string& file_name, const Settings& settings
       }
     }
     HTML << "<p>" << endl;
-    HTML << html_read_alignment_table_string(ra_list, false, marginal_ra_title, relative_path) << endl;
+    html_read_alignment_table(HTML, ra_list, false, marginal_ra_title, relative_path);
+    HTML << endl;
   }
   
   /////////////////////////
@@ -436,7 +485,7 @@ void html_marginal_predictions(const string& file_name, const Settings& settings
       marginal_jc_title += " (sorted from low to high skew)";
     }
     HTML << "<p>" << endl;
-    HTML << html_new_junction_table_string(jc_list, settings, false, marginal_jc_title, relative_path);
+    html_new_junction_table(HTML, jc_list, settings, false, marginal_jc_title, relative_path);
   }
   
   // This code prints out a message if there was nothing in the previous tables
@@ -489,7 +538,7 @@ void html_compare(
                   )
 {
   // Create stream and confirm it's open
-  ofstream HTML(file_name.c_str());
+  cHtmlOutputFile HTML(file_name);
   
   if(!HTML.good()) {
     cerr << "Could not open file: " <<  file_name << endl;
@@ -500,7 +549,7 @@ void html_compare(
   
   //Build html head
   HTML << html_header(title, settings);
-  HTML << Html_Mutation_Table_String(settings, gd, list_ref, mt_options);
+  Html_Mutation_Table(HTML, settings, gd, list_ref, mt_options);
   HTML << html_footer();
   HTML.close();
 }
@@ -508,6 +557,8 @@ void html_compare(
 
 void html_summary(const string &file_name, const Settings& settings, Summary& summary, cReferenceSequences& ref_seq_info)
 {  
+  TRACE_SCOPE(trace, "html_summary");
+
   // Create stream and confirm it's open
   ofstream HTML(file_name.c_str());
   ASSERT(HTML.good(), "Could not open file: " + file_name);
@@ -628,11 +679,14 @@ void html_summary(const string &file_name, const Settings& settings, Summary& su
       
       // There may be absolutely no coverage and no graph will exist...
       //if (!fragment_no_coverage) {
-      HTML << td( a(Settings::relative_path(
-                                            settings.file_name(settings.unique_only_coverage_plot_file_name, "@", to_string<uint32_t>(settings.seq_id_to_coverage_group(it->m_seq_id))), settings.output_path
-                                            ), 
+      // The graph is not drawn for brief HTML output
+      string unique_only_coverage_plot_file_name = settings.file_name(settings.unique_only_coverage_plot_file_name, "@", to_string<uint32_t>(settings.seq_id_to_coverage_group(it->m_seq_id)));
+      HTML << td( file_exists(unique_only_coverage_plot_file_name.c_str()) ?
+                    a(Settings::relative_path(
+                                              unique_only_coverage_plot_file_name, settings.output_path
+                                              ), 
                     "distribution" 
-                    )
+                    ) : "distribution"
                  ); 
       //}
       //else {
@@ -889,8 +943,10 @@ void html_summary(const string &file_name, const Settings& settings, Summary& su
   HTML << "<p>"<< endl;
   HTML << h2("Execution Times") << endl;
   HTML << start_table("border=\"0\" cellspacing=\"1\" cellpadding=\"5\"") << endl;
-  HTML << "<tr>" << th("step") << th("start") << th("end") << th("elapsed") << "</tr>" << endl; 
+  HTML << "<tr>" << th("step") << th("start") << th("end") << th("elapsed")
+       << th("CPU user") << th("CPU system") << th("CPU children") << th("peak memory") << th("read") << th("written") << "</tr>" << endl;
   double total_time_elapsed = 0; 
+  ResourceUsage total_resources;
 
   for (vector<ExecutionTime>::const_iterator itr = times.begin(); itr != times.end(); itr ++) {  
     const ExecutionTime& t = (*itr);
@@ -902,6 +958,27 @@ void html_summary(const string &file_name, const Settings& settings, Summary& su
     HTML << td(nonbreaking(t._formatted_time_start));
     HTML << td(nonbreaking(t._formatted_time_end));
     HTML << td(nonbreaking(t._formatted_time_elapsed));
+    
+    // Not recorded for steps completed by older versions or still running
+    const ResourceUsage& r = t._resources;
+    if ((r.peak_rss > 0) && (t._time_end != 0)) {
+      HTML << td(ALIGN_RIGHT, nonbreaking(to_string(r.user_time, 1) + " s"));
+      HTML << td(ALIGN_RIGHT, nonbreaking(to_string(r.system_time, 1) + " s"));
+      HTML << td(ALIGN_RIGHT, nonbreaking(to_string(r.child_user_time + r.child_system_time, 1) + " s"));
+      HTML << td(ALIGN_RIGHT, nonbreaking(to_string(max(r.peak_rss, r.child_peak_rss) / 1024.0, 1) + " MB"));
+      HTML << td(ALIGN_RIGHT, nonbreaking(to_string(r.bytes_read / 1048576.0, 1) + " MB"));
+      HTML << td(ALIGN_RIGHT, nonbreaking(to_string(r.bytes_written / 1048576.0, 1) + " MB"));
+      
+      total_resources.user_time += r.user_time;
+      total_resources.system_time += r.system_time;
+      total_resources.child_user_time += r.child_user_time;
+      total_resources.child_system_time += r.child_system_time;
+      total_resources.peak_rss = max(total_resources.peak_rss, max(r.peak_rss, r.child_peak_rss));
+      total_resources.bytes_read += r.bytes_read;
+      total_resources.bytes_written += r.bytes_written;
+    } else {
+      HTML << "<td colspan=\"6\"></td>";
+    }
     HTML << "</tr>" << endl; 
 
     total_time_elapsed += t._time_elapsed;    
@@ -910,6 +987,12 @@ void html_summary(const string &file_name, const Settings& settings, Summary& su
   HTML << "<tr class=\"highlight_table_row\">"<< endl;
   HTML << "<td colspan=\"3\" >" << b("Total") << "</td>" << endl;
   HTML << "<td>" << (b(nonbreaking(Settings::elapsedtime2string(total_time_elapsed)))) << "</td>" << endl;
+  HTML << td(ALIGN_RIGHT, b(nonbreaking(to_string(total_resources.user_time, 1) + " s")));
+  HTML << td(ALIGN_RIGHT, b(nonbreaking(to_string(total_resources.system_time, 1) + " s")));
+  HTML << td(ALIGN_RIGHT, b(nonbreaking(to_string(total_resources.child_user_time + total_resources.child_system_time, 1) + " s")));
+  HTML << td(ALIGN_RIGHT, b(nonbreaking(to_string(total_resources.peak_rss / 1024.0, 1) + " MB")));
+  HTML << td(ALIGN_RIGHT, b(nonbreaking(to_string(total_resources.bytes_read / 1048576.0, 1) + " MB")));
+  HTML << td(ALIGN_RIGHT, b(nonbreaking(to_string(total_resources.bytes_written / 1048576.0, 1) + " MB")));
   HTML << "</tr>" << endl;
   HTML << "</table>";
   
@@ -1184,11 +1267,10 @@ string to_underline_red_codon(const string& _codon_ref_seq, const string& _codon
   return ss.str();
 }
 
-string html_read_alignment_table_string(diff_entry_list_t& list_ref, bool show_details, const string& title, const string& relative_link)
+void html_read_alignment_table(ostream& ss, diff_entry_list_t& list_ref, bool show_details, const string& title, const string& relative_link)
 {  
-  if (list_ref.size()==0) return "";
+  if (list_ref.size()==0) return;
   
-  stringstream ss; //!< Main build object for function
   stringstream ssf; //!< Used for formatting strings
   
   ss << start_table("border=\"0\" cellspacing=\"1\", cellpadding=\"3\"") << endl;
@@ -1430,14 +1512,18 @@ string html_read_alignment_table_string(diff_entry_list_t& list_ref, bool show_d
   } // end list_ref loop
 
   ss << "</table>" << endl;
-  return ss.str();
 }
 
-string html_missing_coverage_table_string(diff_entry_list_t& list_ref, bool show_details, const string& title, const string& relative_link)
+string html_read_alignment_table_string(diff_entry_list_t& list_ref, bool show_details, const string& title, const string& relative_link)
 {
-  if (list_ref.size()==0) return "";
+  stringstream ss;
+  html_read_alignment_table(ss, list_ref, show_details, title, relative_link);
+  return ss.str();
+}
 
-  stringstream ss; //!< Main Build Object in Function
+void html_missing_coverage_table(ostream& ss, diff_entry_list_t& list_ref, bool show_details, const string& title, const string& relative_link)
+{
+  if (list_ref.size()==0) return;
   
   ss << endl;
   ss << start_table("border=\"0\" cellspacing=\"1\" cellpadding=\"3\" width=\"100%\"") << endl;
@@ -1544,6 +1630,12 @@ string html_missing_coverage_table_string(diff_entry_list_t& list_ref, bool show
     }
   }
   ss << "</table>" << endl;
+}
+
+string html_missing_coverage_table_string(diff_entry_list_t& list_ref, bool show_details, const string& title, const string& relative_link)
+{
+  stringstream ss;
+  html_missing_coverage_table(ss, list_ref, show_details, title, relative_link);
   return ss.str();
 }
   
@@ -1559,12 +1651,11 @@ string string_to_fixed_digit_string(string s, uint32_t precision = 2)
   return ss.str();
 }
   
-string html_new_junction_table_string(diff_entry_list_t& list_ref, const Settings& settings, bool show_details, const string& title, const string& relative_link)
+void html_new_junction_table(ostream& ss, diff_entry_list_t& list_ref, const Settings& settings, bool show_details, const string& title, const string& relative_link)
 {
-  if (list_ref.size()==0) return "";
+  if (list_ref.size()==0) return;
 
   
-  stringstream ss; //!<< Main Build Object for Function
   cDiffEntry& test_item = *list_ref.front();
 
   bool link = (test_item.entry_exists(_SIDE_1_EVIDENCE_FILE_NAME) &&
@@ -1668,7 +1759,7 @@ string html_new_junction_table_string(diff_entry_list_t& list_ref, const Setting
       ss << td("rowspan=\"2\" align=\"center\"", 
               c["neg_log10_pos_hash_p_value"]) << endl;
 
-      ss << td("rowspan=\"2\" align=\"center\"", Html_Mutation_Table_String::freq_to_string(c[POLYMORPHISM_FREQUENCY])) << endl;
+      ss << td("rowspan=\"2\" align=\"center\"", Html_Mutation_Table::freq_to_string(c[POLYMORPHISM_FREQUENCY])) << endl;
               
                //" (" + c["max_left"] + "/" + c["max_right"] + ")") << endl;
       ss << td("align=\"center\" class=\"" + annotate_key + "\"", 
@@ -1759,14 +1850,19 @@ string html_new_junction_table_string(diff_entry_list_t& list_ref, const Setting
 
   }// End list_ref Loop
   ss << "</table>" << endl;
+}
+
+string html_new_junction_table_string(diff_entry_list_t& list_ref, const Settings& settings, bool show_details, const string& title, const string& relative_link)
+{
+  stringstream ss;
+  html_new_junction_table(ss, list_ref, settings, show_details, title, relative_link);
   return ss.str();
 }
   
-string html_copy_number_table_string(diff_entry_list_t& list_ref, bool show_details, const string& title, const string& relative_link)
+void html_copy_number_table(ostream& ss, diff_entry_list_t& list_ref, bool show_details, const string& title, const string& relative_link)
 {
-  if (list_ref.size()==0) return "";
+  if (list_ref.size()==0) return;
   
-  stringstream ss; //!<< Main Build Object for Function
   cDiffEntry& test_item = *list_ref.front();
   
   bool link = test_item.entry_exists(_EVIDENCE_FILE_NAME);
@@ -1844,6 +1940,12 @@ string html_copy_number_table_string(diff_entry_list_t& list_ref, bool show_deta
   }// End list_ref Loop
   
   ss << end_table() << endl;
+}
+
+string html_copy_number_table_string(diff_entry_list_t& list_ref, bool show_details, const string& title, const string& relative_link)
+{
+  stringstream ss;
+  html_copy_number_table(ss, list_ref, show_details, title, relative_link);
   return ss.str();
 }
 
@@ -1910,19 +2012,67 @@ string decode_reject_reason(const string& reject)
  *  //End Create_Evidence_Files
  *-----------------------------------------------------------------------------*/
 
+cOutputFileCache::cOutputFileCache(const string& cache_file_name)
+  : m_cache_file_name(cache_file_name)
+{
+  ifstream in(m_cache_file_name.c_str());
+  string line;
+  while (getline(in, line)) {
+    vector<string> fields = split(line, "\t");
+    if (fields.size() != 2) continue;
+    m_hashes[fields[0]] = fields[1];
+  }
+}
+
+string cOutputFileCache::hash(const string& inputs)
+{
+  // 64-bit FNV-1a
+  uint64_t h = 14695981039346656037ULL;
+  for (string::const_iterator it = inputs.begin(); it != inputs.end(); it++) {
+    h ^= static_cast<uint8_t>(*it);
+    h *= 1099511628211ULL;
+  }
+  stringstream ss;
+  ss << hex << setw(16) << setfill('0') << h << "-" << dec << inputs.size();
+  return ss.str();
+}
+
+string cOutputFileCache::file_fingerprint(const string& file_name)
+{
+  struct stat file_stat;
+  if (stat(file_name.c_str(), &file_stat) != 0) return file_name + "\tmissing";
+  return file_name + "\t" + to_string(static_cast<uint64_t>(file_stat.st_size)) + "\t" + to_string(file_modification_time_ns(file_stat));
+}
+
+bool cOutputFileCache::is_current(const string& file_name, const string& inputs_hash) const
+{
+  map<string, string>::const_iterator it = m_hashes.find(file_name);
+  if (it == m_hashes.end()) return false;
+  return (it->second == inputs_hash) && file_exists(file_name.c_str());
+}
+
+void cOutputFileCache::write() const
+{
+  ofstream out(m_cache_file_name.c_str());
+  ASSERT(out.good(), "Could not open file for writing: " + m_cache_file_name);
+  for (map<string, string>::const_iterator it = m_hashes.begin(); it != m_hashes.end(); it++) {
+    out << it->first << "\t" << it->second << "\n";
+  }
+}
+
 void draw_coverage(Settings& settings, cReferenceSequences& ref_seq_info, cGenomeDiff& gd)
 {  
-  coverage_output co(
-                     settings.reference_bam_file_name, 
-                     settings.reference_fasta_file_name, 
-                     settings.coverage_plot_r_script_file_name, 
-                     settings.coverage_plot_path
-                     );
-  co.output_format("png");
-  
+  TRACE_SCOPE(trace, "draw_coverage");
+
   create_path(settings.coverage_plot_path);
   string coverage_plot_path = settings.coverage_plot_path;
   
+  // Collect all plots first, so they can be drawn in parallel
+  vector<string> plot_regions;
+  vector<string> plot_file_names;
+  vector<uint32_t> plot_shaded_flanking;
+  vector<string> plot_seq_ids;
+  
   // Coverage overview plots of entire reference sequences
   for (cReferenceSequences::iterator it = ref_seq_info.begin(); it != ref_seq_info.end(); ++it)
   {
@@ -1930,8 +2080,10 @@ void draw_coverage(Settings& settings, cReferenceSequences& ref_seq_info, cGenom
     string region = seq.m_seq_id + ":" + "1" + "-" + to_string(seq.m_length);
     string this_complete_coverage_text_file_name = settings.file_name(settings.overview_coverage_plot_file_name, "@", seq.m_seq_id);
     
-    cerr << "Creating coverage plot for region: " << region << endl;
-    co.plot(region, this_complete_coverage_text_file_name);
+    plot_regions.push_back(region);
+    plot_file_names.push_back(this_complete_coverage_text_file_name);
+    plot_shaded_flanking.push_back(0);
+    plot_seq_ids.push_back(seq.m_seq_id);
    }
   
   // Don't create other plots in --brief-html-mode
@@ -1948,18 +2100,112 @@ void draw_coverage(Settings& settings, cReferenceSequences& ref_seq_info, cGenom
       
       uint32_t _shaded_flanking = static_cast<uint32_t>(floor(static_cast<double>(size) / 10.0));
       if (_shaded_flanking < 100) _shaded_flanking = 100;
-      co.shaded_flanking(_shaded_flanking);
       
       string region = (*item)[SEQ_ID] + ":" + (*item)[START] + "-" + (*item)[END];
-      string coverage_plot_file_name = settings.evidence_path + "/" + (*item)[SEQ_ID] + "_" + (*item)[START] + "-" + (*item)[END] + "." + co.output_format();
+      string coverage_plot_file_name = settings.evidence_path + "/" + (*item)[SEQ_ID] + "_" + (*item)[START] + "-" + (*item)[END] + "." + settings.coverage_plot_format;
 
       string link_coverage_plot_file_name = Settings::relative_path(coverage_plot_file_name, settings.evidence_path);    
       (*item)[_COVERAGE_PLOT_FILE_NAME] = link_coverage_plot_file_name;
       
-      cerr << "Creating coverage plot for region: " << region << endl;
-      co.plot(region, coverage_plot_file_name);
+      plot_regions.push_back(region);
+      plot_file_names.push_back(coverage_plot_file_name);
+      plot_shaded_flanking.push_back(_shaded_flanking);
+      plot_seq_ids.push_back((*item)[SEQ_ID]);
+    }
+  }
+  
+  // Plots already made from the same BAM and FASTA files are kept
+  cOutputFileCache cache(settings.evidence_cache_file_name);
+  string plot_inputs = string(PACKAGE_STRING) + "\tcoverage_plot"
+    + "\t" + cOutputFileCache::file_fingerprint(settings.reference_bam_file_name)
+    + "\t" + cOutputFileCache::file_fingerprint(settings.reference_fasta_file_name)
+    + "\t" + (settings.r_coverage_plots ? "R" : "native");
+  
+  vector<string> plot_hashes;
+  vector<size_t> plots_to_draw;
+  for (size_t i = 0; i < plot_regions.size(); i++) {
+    plot_hashes.push_back(cOutputFileCache::hash(plot_inputs + "\t" + plot_regions[i] + "\t" + to_string(plot_shaded_flanking[i])));
+    if (cache.is_current(plot_file_names[i], plot_hashes[i])) continue;
+    plots_to_draw.push_back(i);
+  }
+  if (plots_to_draw.size() < plot_regions.size()) {
+    cerr << "Reusing " << plot_regions.size() - plots_to_draw.size() << " unchanged coverage plots." << endl;
+  }
+  
+  // Plots are drawn in batches, all plots of a batch in parallel. When a sequence
+  // has zoom-in plots to draw along with its overview plot, which needs a pileup of
+  // every position anyway, the coverage of the whole sequence is tabulated once
+  // into a profile and all of its plots are drawn from that. Sequences drawn
+  // without a profile form one batch. Profiled sequences are batched up to about
+  // one 1 Mb pileup piece per thread, which bounds the memory of the profiles.
+  uint32_t num_threads = max(1, settings.num_processors);
+  const uint64_t max_profile_batch_length = static_cast<uint64_t>(num_threads) * 1000000;
+  
+  vector<vector<string> > batch_profile_seq_ids(1);
+  vector<vector<size_t> > batch_plots(1);
+  uint64_t batch_length = 0;
+  for (cReferenceSequences::iterator it = ref_seq_info.begin(); it != ref_seq_info.end(); ++it)
+  {
+    vector<size_t> seq_plots_to_draw;
+    bool draw_overview = false;
+    for (vector<size_t>::iterator p = plots_to_draw.begin(); p != plots_to_draw.end(); p++) {
+      if (plot_seq_ids[*p] != it->m_seq_id) continue;
+      seq_plots_to_draw.push_back(*p);
+      if (*p < ref_seq_info.size()) draw_overview = true;
     }
+    
+    if (!draw_overview || (seq_plots_to_draw.size() == 1)) {
+      batch_plots[0].insert(batch_plots[0].end(), seq_plots_to_draw.begin(), seq_plots_to_draw.end());
+      continue;
+    }
+    
+    if ((batch_plots.size() == 1) || (batch_length >= max_profile_batch_length)) {
+      batch_profile_seq_ids.push_back(vector<string>());
+      batch_plots.push_back(vector<size_t>());
+      batch_length = 0;
+    }
+    batch_profile_seq_ids.back().push_back(it->m_seq_id);
+    batch_plots.back().insert(batch_plots.back().end(), seq_plots_to_draw.begin(), seq_plots_to_draw.end());
+    batch_length += it->m_length;
+  }
+  
+  for (size_t b = 0; b < batch_plots.size(); b++)
+  {
+    const vector<size_t>& this_batch_plots = batch_plots[b];
+    if (this_batch_plots.size() == 0) continue;
+    
+    cCoverageProfile profile;
+    coverage_output::profile_targets(profile, settings.reference_bam_file_name, settings.reference_fasta_file_name,
+                                     batch_profile_seq_ids[b], num_threads);
+    
+    // Each thread opens its own BAM and FASTA and draws every batch_threads-th plot
+    uint32_t batch_threads = min(static_cast<size_t>(num_threads), this_batch_plots.size());
+    
+    parallel_for(batch_threads, batch_threads, [&](size_t thread_index) {
+      coverage_output co(
+                         settings.reference_bam_file_name, 
+                         settings.reference_fasta_file_name, 
+                         settings.coverage_plot_r_script_file_name, 
+                         settings.coverage_plot_path
+                         );
+      co.output_format(settings.coverage_plot_format);
+      co.use_r(settings.r_coverage_plots);
+      co.use_profile(&profile);
+      
+      for (size_t j = thread_index; j < this_batch_plots.size(); j += batch_threads) {
+        size_t i = this_batch_plots[j];
+        TRACE_SCOPE(trace_plot, "draw_coverage plot");
+        cerr << ("Creating coverage plot for region: " + plot_regions[i] + "\n");
+        co.shaded_flanking(plot_shaded_flanking[i]);
+        co.plot(plot_regions[i], plot_file_names[i]);
+      }
+    });
   }
+  
+  for (vector<size_t>::iterator it = plots_to_draw.begin(); it != plots_to_draw.end(); it++) {
+    if (file_exists(plot_file_names[*it].c_str())) cache.update(plot_file_names[*it], plot_hashes[*it]);
+  }
+  cache.write();
 }
 
   
@@ -2245,10 +2491,32 @@ void add_html_fields_to_mutation(cDiffEntry& mut, MutationTableOptions& options)
   
 /*
  * =====================================================================================
- *        Class:  Html_Mutation_Table_String
+ *        Class:  Html_Mutation_Table
  *  Description:
  * =====================================================================================
  */
+Html_Mutation_Table::Html_Mutation_Table(
+                                         ostream& _out,
+                                         const Settings& _settings,
+                                         cGenomeDiff& _gd,
+                                         diff_entry_list_t& _list_ref,
+                                         MutationTableOptions& _options
+                                         )
+  : total_cols(0)
+  , out(_out)
+  , settings(_settings)
+  , gd(_gd)
+  , list_ref(_list_ref)
+  , options(_options)
+{
+  out << "<!--Output Html_Mutation_Table_String-->\n";
+  out << "<table border=\"0\" cellspacing=\"1\" cellpadding=\"3\">\n";
+  
+  
+  this->Header_Line();
+  this->Item_Lines();
+}
+
 Html_Mutation_Table_String::Html_Mutation_Table_String(
                                                        const Settings& settings,
                                                        cGenomeDiff& gd,
@@ -2256,28 +2524,20 @@ Html_Mutation_Table_String::Html_Mutation_Table_String(
                                                        MutationTableOptions& options
                                                        )
   : string()
-  , total_cols(0)
-  , settings(settings)
-  , gd(gd)
-  , list_ref(list_ref)
-  , options(options)
 {
-  (*this) += "<!--Output Html_Mutation_Table_String-->\n";
-  (*this) += "<table border=\"0\" cellspacing=\"1\" cellpadding=\"3\">\n";
-  
-  
-  this->Header_Line();
-  this->Item_Lines();
+  stringstream ss;
+  Html_Mutation_Table(ss, settings, gd, list_ref, options);
+  this->assign(ss.str());
 }
 
 /*
  *--------------------------------------------------------------------------------------
- *       Class:  Html_Mutation_Table_String
- *      Method:  Html_Mutation_Table_String :: Header_Line
+ *       Class:  Html_Mutation_Table
+ *      Method:  Html_Mutation_Table :: Header_Line
  * Description:  
  *--------------------------------------------------------------------------------------
  */
-void Html_Mutation_Table_String::Header_Line(bool print_main_header)
+void Html_Mutation_Table::Header_Line(bool print_main_header)
 {
   // #####################
   // #### HEADER LINE ####
@@ -2387,17 +2647,17 @@ void Html_Mutation_Table_String::Header_Line(bool print_main_header)
   }
 
   if(print_main_header && (header_text != ""))
-    (*this) += tr(th("colspan=\"" + to_string(total_cols) + "\" align=\"left\" class=\"mutation_header_row\"", header_text));
+    out << tr(th("colspan=\"" + to_string(total_cols) + "\" align=\"left\" class=\"mutation_header_row\"", header_text));
   
   ss << endl;
-  (*this) += ss.str(); 
+  out << ss.str(); 
 }
 //===============================================================================
-//       CLASS: Html_Mutation_Table_String
+//       CLASS: Html_Mutation_Table
 //      METHOD: Item_Lines
 // DESCRIPTION: 
 //===============================================================================
-void Html_Mutation_Table_String::Item_Lines()
+void Html_Mutation_Table::Item_Lines()
 {
 // #   ####################
 // #   #### ITEM LINES ####
@@ -2405,10 +2665,8 @@ void Html_Mutation_Table_String::Item_Lines()
 // #
   size_t row_num = 0;
 
-  stringstream ss; 
+  ostream& ss = out; // rows are written as they are made
   ss << "<!-- Item Lines -->" << endl;
-  (*this) += ss.str();
-  ss.str("");
   for (diff_entry_list_t::iterator itr = list_ref.begin(); itr != list_ref.end(); itr ++) { 
     cDiffEntry& mut = (**itr);
 
@@ -2533,9 +2791,6 @@ void Html_Mutation_Table_String::Item_Lines()
 
     ss << "<!-- End Table Row -->" << endl;
     
-    (*this) += ss.str();
-    ss.str("");
-    
   } //##### END TABLE ROW ####
   
   if (options.legend_row) {
@@ -2545,16 +2800,14 @@ void Html_Mutation_Table_String::Item_Lines()
     ss << "</tr>" << endl;
   }
   ss << "</table>";
-  
-  (*this) += ss.str();
 }
 // # 
 //===============================================================================
-//       CLASS: Html_Mutation_Table_String
+//       CLASS: Html_Mutation_Table
 //      METHOD: freq_to_string  
 // DESCRIPTION: Helper function used in Item_Lines
 //===============================================================================
-string Html_Mutation_Table_String::freq_to_string(const string& freq, bool multiple_columns)
+string Html_Mutation_Table::freq_to_string(const string& freq, bool multiple_columns)
 {
   if (freq == "?")
     return "?";
@@ -2591,11 +2844,11 @@ string Html_Mutation_Table_String::freq_to_string(const string& freq, bool multi
 }
 
 //===============================================================================
-//       CLASS: Html_Mutation_Table_String
+//       CLASS: Html_Mutation_Table
 //      METHOD: freq_cols  
 // DESCRIPTION: Helper function used in Item_Lines
 //===============================================================================
-string Html_Mutation_Table_String::freq_cols(vector<string> freq_list)
+string Html_Mutation_Table::freq_cols(vector<string> freq_list)
 {
   stringstream ss;
   for (vector<string>::iterator itr = freq_list.begin();
@@ -2628,6 +2881,8 @@ string Html_Mutation_Table_String::freq_cols(vector<string> freq_list)
  */
 cOutputEvidenceFiles::cOutputEvidenceFiles(const Settings& settings, cGenomeDiff& gd)
 {  
+  TRACE_SCOPE(trace, "cOutputEvidenceFiles");
+
   // Fasta and BAM files for making alignments.
   string reference_bam_file_name = settings.reference_bam_file_name;
   string reference_fasta_file_name = settings.reference_fasta_file_name;
@@ -2889,12 +3144,123 @@ cOutputEvidenceFiles::cOutputEvidenceFiles(const Settings& settings, cGenomeDiff
   create_path(settings.evidence_path);
   //cerr << "Total number of evidence items: " << evidence_list.size() << endl;
   
+  // The tables at the top of each page read and annotate entries in gd,
+  // which is not safe to do concurrently, so these are all made first.
+  vector<string> evidence_headers;
   for (vector<cOutputEvidenceItem>::iterator itr = evidence_list.begin(); itr != evidence_list.end(); itr ++) 
   {  
-    cOutputEvidenceItem& e = (*itr);
-    //cerr << "Creating evidence file: " + e[FILE_NAME] << endl;   
-    html_evidence_file(settings, gd, e);
+    evidence_headers.push_back(html_evidence_file_header(settings, gd, *itr));
+  }
+  
+  // Read alignments are the slow part. They are drawn in order along each BAM file,
+  // and each thread takes a consecutive part of this order. A thread uses one
+  // alignment_output (with its own open BAM and FASTA) for each pair of files and
+  // reads all of its regions in that BAM in one pass.
+  struct evidence_order_item {
+    string files;
+    string seq_id;
+    uint32_t start;
+    size_t index;
+    
+    bool operator<(const evidence_order_item& other) const
+    {
+      if (files != other.files) return (files < other.files);
+      if (seq_id != other.seq_id) return (seq_id < other.seq_id);
+      if (start != other.start) return (start < other.start);
+      return (index < other.index);
+    }
+  };
+  
+  // Pages already made from the same inputs are kept
+  cOutputFileCache cache(settings.evidence_cache_file_name);
+  string render_options = string(PACKAGE_STRING) + "\tevidence"
+    + "\t" + to_string(settings.max_displayed_reads)
+    + "\t" + to_string(settings.base_quality_cutoff)
+    + "\t" + to_string(settings.junction_minimum_side_match)
+    + "\t" + to_string(settings.alignment_mask_ref_matches)
+    + "\t" + to_string(settings.minimum_mapping_quality);
+  map<string, string> file_fingerprints;
+  
+  vector<string> evidence_regions(evidence_list.size());
+  vector<string> evidence_hashes(evidence_list.size());
+  vector<evidence_order_item> evidence_order;
+  for (size_t i = 0; i < evidence_list.size(); i++)
+  {
+    cOutputEvidenceItem& item = evidence_list[i];
+    evidence_order_item order_item;
+    order_item.start = 0;
+    order_item.index = i;
+    
+    string inputs = render_options + "\t" + evidence_headers[i];
+    for (diff_entry_map_t::iterator it = item.begin(); it != item.end(); it++) {
+      inputs += "\t" + it->first + "=" + it->second;
+    }
+    inputs += "\t" + to_string(item.item->_type) + "\t" + item.item->_id + "\t" + join(item.item->_evidence, ",");
+    for (diff_entry_map_t::iterator it = item.item->begin(); it != item.item->end(); it++) {
+      inputs += "\t" + it->first + "=" + it->second;
+    }
+    
+    bool has_plot = item.entry_exists(PLOT) && !item[PLOT].empty();
+    if (has_plot) {
+      inputs += file_exists(item[PLOT].c_str()) ? "\tplot" : "\tno plot";
+    } else {
+      evidence_regions[i] = evidence_region(item);
+      
+      if (file_fingerprints.count(item[BAM_PATH]) == 0) file_fingerprints[item[BAM_PATH]] = cOutputFileCache::file_fingerprint(item[BAM_PATH]);
+      if (file_fingerprints.count(item[FASTA_PATH]) == 0) file_fingerprints[item[FASTA_PATH]] = cOutputFileCache::file_fingerprint(item[FASTA_PATH]);
+      inputs += "\t" + file_fingerprints[item[BAM_PATH]] + "\t" + file_fingerprints[item[FASTA_PATH]];
+    }
+    
+    evidence_hashes[i] = cOutputFileCache::hash(inputs);
+    if (cache.is_current(settings.evidence_path + "/" + item[FILE_NAME], evidence_hashes[i])) continue;
+    
+    // Pages with plots (and no alignment) go first
+    if ( !has_plot && file_exists(item[BAM_PATH].c_str()) && file_exists(item[FASTA_PATH].c_str()) ) {
+      order_item.files = item[BAM_PATH] + "\t" + item[FASTA_PATH];
+      order_item.seq_id = item[SEQ_ID];
+      order_item.start = from_string<uint32_t>(item[START]);
+    }
+    evidence_order.push_back(order_item);
+  }
+  sort(evidence_order.begin(), evidence_order.end());
+  
+  if (evidence_order.size() < evidence_list.size()) {
+    cerr << "Reusing " << evidence_list.size() - evidence_order.size() << " unchanged evidence files." << endl;
+  }
+  
+  uint32_t num_threads = max(1, settings.num_processors);
+  if (num_threads > evidence_order.size()) num_threads = max(static_cast<size_t>(1), evidence_order.size());
+  
+  parallel_for(num_threads, num_threads, [&](size_t thread_index) {
+    size_t order_start = thread_index * evidence_order.size() / num_threads;
+    size_t order_end = (thread_index + 1) * evidence_order.size() / num_threads;
+    
+    alignment_output_map_t alignment_outputs;
+    map<string, vector<string> > region_batches;
+    for (size_t i = order_start; i < order_end; i++) {
+      const evidence_order_item& order_item = evidence_order[i];
+      if (order_item.files.empty()) continue;
+      vector<string>& region_batch = region_batches[order_item.files];
+      if (region_batch.empty()) {
+        evidence_alignment_output(settings, evidence_list[order_item.index], alignment_outputs);
+      }
+      region_batch.push_back(evidence_regions[order_item.index]);
+    }
+    for (map<string, vector<string> >::iterator it = region_batches.begin(); it != region_batches.end(); it++) {
+      alignment_outputs[it->first]->set_region_batch(it->second);
+    }
+    
+    for (size_t i = order_start; i < order_end; i++) {
+      size_t index = evidence_order[i].index;
+      //cerr << "Creating evidence file: " + evidence_list[index][FILE_NAME] << endl;   
+      html_evidence_file(settings, evidence_list[index], evidence_headers[index], evidence_regions[index], alignment_outputs);
+    }
+  });
+  
+  for (vector<evidence_order_item>::iterator it = evidence_order.begin(); it != evidence_order.end(); it++) {
+    cache.update(settings.evidence_path + "/" + evidence_list[it->index][FILE_NAME], evidence_hashes[it->index]);
   }
+  cache.write();
 }
 
 
@@ -2919,22 +3285,14 @@ void cOutputEvidenceFiles::add_evidence(const string& evidence_file_name_key, di
  *-----------------------------------------------------------------------------*/
 // # 
 // # 
-void 
-cOutputEvidenceFiles::html_evidence_file (
+string 
+cOutputEvidenceFiles::html_evidence_file_header (
                                     const Settings& settings, 
                                     cGenomeDiff& gd, 
                                     cOutputEvidenceItem& item
                                     )
 {  
-  string output_path = settings.evidence_path + "/" + item[FILE_NAME];
-  
-  // Create Stream and Confirm It's Open
-  ofstream HTML(output_path.c_str());
-  
-  if (!HTML.good()) {
-    cerr << "Could not open file: " << item["output_path"] << endl;
-    assert(HTML.good());
-  }
+  stringstream HTML;
   
   // Build HTML Head
   HTML << html_header("BRESEQ :: Evidence", settings);
@@ -2964,6 +3322,70 @@ cOutputEvidenceFiles::html_evidence_file (
     HTML << "<p>"; 
   }
   
+  return HTML.str();
+}
+  
+string 
+cOutputEvidenceFiles::evidence_region (
+                                    cOutputEvidenceItem& item
+                                    )
+{
+  stringstream ss;
+  
+  ss << item[SEQ_ID] << ":" << item[START];
+  
+  if (item[INSERT_START].size() > 0)
+  {
+    ss << "." << item[INSERT_START];
+  }
+  
+  ss << "-" << item[END];
+  
+  if (item[INSERT_END].size())
+  {
+    ss << "." << item[INSERT_END];
+  }
+  
+  return ss.str();
+}
+  
+alignment_output& 
+cOutputEvidenceFiles::evidence_alignment_output (
+                                    const Settings& settings, 
+                                    cOutputEvidenceItem& item,
+                                    alignment_output_map_t& alignment_outputs
+                                    )
+{
+  string key = item[BAM_PATH] + "\t" + item[FASTA_PATH];
+  if (alignment_outputs.count(key) == 0) {
+    alignment_outputs[key] = counted_ptr<alignment_output>(new alignment_output(item[BAM_PATH], item[FASTA_PATH], settings.max_displayed_reads, settings.base_quality_cutoff, settings.junction_minimum_side_match, settings.alignment_mask_ref_matches, false, settings.minimum_mapping_quality ));
+  }
+  return *alignment_outputs[key];
+}
+  
+void 
+cOutputEvidenceFiles::html_evidence_file (
+                                    const Settings& settings, 
+                                    cOutputEvidenceItem& item,
+                                    const string& header,
+                                    const string& region,
+                                    alignment_output_map_t& alignment_outputs
+                                    )
+{  
+  TRACE_SCOPE(trace, "html_evidence_file");
+
+  string output_path = settings.evidence_path + "/" + item[FILE_NAME];
+  
+  // Create Stream and Confirm It's Open
+  ofstream HTML(output_path.c_str());
+  
+  if (!HTML.good()) {
+    cerr << "Could not open file: " << item["output_path"] << endl;
+    assert(HTML.good());
+  }
+  
+  HTML << header;
+  
   if (item.entry_exists(PLOT) && !item[PLOT].empty()) {
     if (file_exists(item[PLOT].c_str())) {
       HTML << div(ALIGN_LEFT, img("width=800", item[PLOT]));
@@ -2971,30 +3393,13 @@ cOutputEvidenceFiles::html_evidence_file (
       HTML << div(ALIGN_LEFT, "Failed to generate coverage plot.");
     }
   } else {
-    stringstream ss;
-    
-    ss << item[SEQ_ID] << ":" << item[START];
-    
-    if (item[INSERT_START].size() > 0)
-    {
-      ss << "." << item[INSERT_START];
-    }
-    
-    ss << "-" << item[END];
-    
-    if (item[INSERT_END].size())
-    {
-      ss << "." << item[INSERT_END];
-    }
-    cerr << "Creating read alignment for region: " << ss.str() << endl;
+    cerr << ("Creating read alignment for region: " + region + "\n");
     
     if (settings.base_quality_cutoff != 0)
       item["base_quality_cutoff"] = to_string(settings.base_quality_cutoff);
     
     if ( file_exists(item[BAM_PATH].c_str()) && file_exists(item[FASTA_PATH].c_str()) ) {
-      alignment_output ao(item[BAM_PATH], item[FASTA_PATH], settings.max_displayed_reads, settings.base_quality_cutoff, settings.junction_minimum_side_match, settings.alignment_mask_ref_matches, false, settings.minimum_mapping_quality );
-    
-      HTML << ao.html_alignment(ss.str(), &item);
+      HTML << evidence_alignment_output(settings, item, alignment_outputs).html_alignment(region, &item);
     }
     
   }
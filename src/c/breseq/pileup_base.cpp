@@ -19,6 +19,7 @@ LICENSE AND COPYRIGHT
 
 #include "libbreseq/pileup_base.h"
 #include "libbreseq/pileup.h"
+#include "libbreseq/trace.h"
 
 using namespace std;
 
@@ -59,7 +60,7 @@ reference_sequence::~reference_sequence() {
 pileup_base::pileup_base(const string& bam, const string& fasta)
 : m_bam(0), m_bam_header(0), m_bam_index(0), m_bam_file(0), m_faidx(0), m_bam_file_name(bam), m_fasta_file_name(fasta), 
   m_last_position_1(0), m_start_position_1(0), m_end_position_1(0), m_clip_start_position_1(0), m_clip_end_position_1(0), 
-  m_downsample(0), m_last_tid(static_cast<uint32_t>(-1)), m_print_progress(false)
+  m_downsample(0), m_last_tid(static_cast<uint32_t>(-1)), m_print_progress(false), m_region_batch_loaded(0)
 {
 	m_bam = samopen(bam.c_str(), "rb", 0);
   ASSERT(m_bam, "Could not load bam file: " + bam + "\nCheck that file exists and is in right format!");
@@ -90,6 +91,7 @@ pileup_base::pileup_base(const string& bam, const string& fasta)
 /*! Destructor.
  */
 pileup_base::~pileup_base() {
+  clear_region_batch();
 	samclose(m_bam);
   bam_close(m_bam_file);
   bam_header_destroy(m_bam_header);
@@ -195,6 +197,9 @@ int first_level_pileup_callback(uint32_t tid, uint32_t pos, int32_t n, const bam
   // Handle current position
         
   if ( pb->handle_position(this_pos_1) ) {
+    TRACE_TIMER("pileup_callback_ns");
+    TRACE_COUNT("positions", 1);
+    TRACE_COUNT("pileup_depth", n);
     pileup p(tid,this_pos_1,n,pile,*pb);
     pb->pileup_callback(p);
   } 
@@ -220,6 +225,8 @@ int first_level_fetch_callback(const bam1_t *b, void *data)
  */ 
 void pileup_base::do_pileup() {
   
+  TRACE_SCOPE(trace, "pileup_base::do_pileup");
+
   // Start the first target... 
   m_last_position_1 = 0;
   m_downsample = 0;
@@ -274,6 +281,8 @@ int add_pileup_line (const bam1_t *b, void *data) {
  */ 
 void pileup_base::do_pileup(const string& region, bool clip, uint32_t downsample) {
   
+  TRACE_SCOPE(trace, "pileup_base::do_pileup region");
+
   uint32_t target_id, start_pos_1, end_pos_1, insert_start, insert_end;
   parse_region(region.c_str(), target_id, start_pos_1, end_pos_1, insert_start, insert_end);   
 
@@ -298,7 +307,7 @@ void pileup_base::do_pileup(const string& region, bool clip, uint32_t downsample
   
   bam_plbuf_t        *pileup_buff;
   pileup_buff = bam_plbuf_init(first_level_pileup_callback,this);
-  bam_fetch(m_bam_file,m_bam_index,target_id,start_pos_1-1,end_pos_1,(void*)pileup_buff,add_pileup_line);
+  fetch_alignments(target_id,start_pos_1-1,end_pos_1,(void*)pileup_buff,add_pileup_line);
   // bam_fetch expected 0 indexed start_pos and 1 indexed end_pos
   
   bam_plbuf_push(NULL,pileup_buff); // This clears out the clipped right regions... call before at_end!
@@ -352,8 +361,88 @@ void pileup_base::do_fetch(const string& region) {
   m_insert_end = insert_end;
   
   // should throw if target not found!
-  bam_fetch(m_bam_file,m_bam_index,target_id,start_pos_1-1,end_pos_1,this,first_level_fetch_callback);
+  fetch_alignments(target_id,start_pos_1-1,end_pos_1,this,first_level_fetch_callback);
   // bam_fetch expected 0 indexed start_pos and 1 indexed end_pos
 }
 
+int add_region_batch_alignment (const bam1_t *b, void *data) {
+  vector<bam1_t*>* alignments = (vector<bam1_t*>*) data;
+  alignments->push_back(bam_dup1(b));
+  return 0;
+}
+  
+void pileup_base::set_region_batch(const vector<string>& regions) {
+  
+  clear_region_batch();
+  
+  for(vector<string>::const_iterator it=regions.begin(); it!=regions.end(); it++) {
+    uint32_t target_id, start_pos_1, end_pos_1;
+    parse_region(*it, target_id, start_pos_1, end_pos_1);
+    
+    region_batch_window window;
+    window.target_id = target_id;
+    window.start_0 = start_pos_1-1;
+    window.end_0 = end_pos_1;
+    m_region_batch.push_back(window);
+  }
+  sort(m_region_batch.begin(), m_region_batch.end());
+  
+  // Merge windows that overlap
+  vector<region_batch_window> merged;
+  for(vector<region_batch_window>::iterator it=m_region_batch.begin(); it!=m_region_batch.end(); it++) {
+    if ( !merged.empty() && (merged.back().target_id == it->target_id) && (it->start_0 <= merged.back().end_0) ) {
+      merged.back().end_0 = max(merged.back().end_0, it->end_0);
+    } else {
+      merged.push_back(*it);
+    }
+  }
+  m_region_batch.swap(merged);
+  m_region_batch_loaded = m_region_batch.size();
+}
+  
+void pileup_base::clear_region_batch() {
+  
+  for(vector<bam1_t*>::iterator it=m_region_batch_alignments.begin(); it!=m_region_batch_alignments.end(); it++) {
+    bam_destroy1(*it);
+  }
+  m_region_batch_alignments.clear();
+  m_region_batch.clear();
+  m_region_batch_loaded = 0;
+}
+  
+void pileup_base::fetch_alignments(uint32_t target_id, uint32_t start_0, uint32_t end_0, void* data, bam_fetch_f func) {
+  
+  // Find the last window starting at or before this region
+  region_batch_window region;
+  region.target_id = target_id;
+  region.start_0 = start_0;
+  region.end_0 = end_0;
+  vector<region_batch_window>::iterator it = upper_bound(m_region_batch.begin(), m_region_batch.end(), region);
+  
+  if ( (it == m_region_batch.begin()) || ((it-1)->target_id != target_id) || ((it-1)->end_0 < end_0) ) {
+    bam_fetch(m_bam_file,m_bam_index,target_id,start_0,end_0,data,func);
+    return;
+  }
+  size_t window_index = (it - 1) - m_region_batch.begin();
+  
+  // Replace the alignments of the last window used
+  if (window_index != m_region_batch_loaded) {
+    for(vector<bam1_t*>::iterator ait=m_region_batch_alignments.begin(); ait!=m_region_batch_alignments.end(); ait++) {
+      bam_destroy1(*ait);
+    }
+    m_region_batch_alignments.clear();
+    
+    const region_batch_window& window = m_region_batch[window_index];
+    bam_fetch(m_bam_file,m_bam_index,window.target_id,window.start_0,window.end_0,&m_region_batch_alignments,add_region_batch_alignment);
+    m_region_batch_loaded = window_index;
+  }
+  
+  // Same test for overlapping the region as the BAM iterator
+  for(vector<bam1_t*>::iterator ait=m_region_batch_alignments.begin(); ait!=m_region_batch_alignments.end(); ait++) {
+    const bam1_t* b = *ait;
+    if (b->core.pos >= static_cast<int32_t>(end_0)) break;
+    if (bam_endpos(b) > static_cast<int32_t>(start_0)) func(b, data);
+  }
+}
+
 } //end namespace breseq
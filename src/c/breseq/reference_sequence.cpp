@@ -766,26 +766,43 @@ namespace breseq {
     this->m_initialized = true;
     
     // To uppercase and change nonstandard chars to 'N' in all sequences.
+    // Done in pieces, replacing only pieces that change, so no whole copy is made.
     for (size_t i=0; i<this->size(); i++) {
       
-      // Uppercase
-      string this_sequence = to_upper((*this)[i].m_fasta_sequence.get_sequence());
-      
-      // Remedy nonstandard characters to 'N'
+      cFastaSequence& this_fasta_sequence = (*this)[i].m_fasta_sequence;
+      const int64_t seq_length = this_fasta_sequence.get_sequence_length();
       map<char,uint32_t> bad_char;
-      for (size_t j=0; j<this_sequence.size(); j++) {
-        if ( !strchr( "ATCGN",  this_sequence[j] )) {
-          if (bad_char.count(this_sequence[j])) {
-            bad_char[this_sequence[j]]++;
-          } else {
-            bad_char[this_sequence[j]] = 1;
+      string this_sequence;
+      for (int64_t start_1 = 1; start_1 <= seq_length; start_1 += cFastaSequence::k_scan_length) {
+        
+        int64_t end_1 = min(start_1 + cFastaSequence::k_scan_length - 1, seq_length);
+        this_fasta_sequence.get_sequence_1(start_1, end_1, this_sequence);
+        bool changed = false;
+        
+        for (size_t j=0; j<this_sequence.size(); j++) {
+          
+          // Uppercase
+          char c = toupper(this_sequence[j]);
+          
+          // Remedy nonstandard characters to 'N'
+          if ( !strchr( "ATCGN",  c )) {
+            if (bad_char.count(c)) {
+              bad_char[c]++;
+            } else {
+              bad_char[c] = 1;
+            }
+            c = 'N';
+          }
+          
+          if (c != this_sequence[j]) {
+            this_sequence[j] = c;
+            changed = true;
           }
-          this_sequence[j] = 'N';
         }
+        
+        if (changed) this_fasta_sequence.replace_sequence_1(start_1, end_1, this_sequence);
       }
       
-      (*this)[i].m_fasta_sequence.set_sequence(this_sequence);
-      
       // Found some bad characters...
       if (bad_char.size()) {
         string warning_string("Non-standard base characters found in sequence: " + (*this)[i].m_seq_id + "\n");
@@ -3362,148 +3379,6 @@ void cReferenceSequences::annotate_mutations(cGenomeDiff& gd, bool only_muts, bo
   }//for
 }
 
-void cReferenceSequences::polymorphism_statistics(Settings& settings, Summary& summary)
-{
-  string reference_fasta_file_name = settings.reference_fasta_file_name;
-  vector<string> seq_ids = this->seq_ids();
-
-  // some local variable lookups for convenience
-  double log10_ref_length = log(this->get_total_length()) / log(10);
-
-  string count_file_name = settings.error_counts_file_name;
-
-  ifstream COUNT(count_file_name.c_str());
-  assert(COUNT.is_open());
-  string count_header_line, count_covariate_line;
-  getline(COUNT, count_covariate_line); // ignore the first line
-
-  // we parse the covariates to know how many different qualities we are dealing with...
-  covariates_used_t         covariate_used;
-  covariates_max_t          covariate_max;
-  covariates_enforce_max_t  covariate_enforce_max;
-  covariates_offset_t       covariate_offset;
-  bool                      per_position;
-  cErrorTable::read_covariates(count_covariate_line, covariate_used, covariate_max, covariate_enforce_max, covariate_offset, per_position);
-
-  getline(COUNT, count_header_line); // second line is the header
-
-  vector<string> count_header_list = split(count_header_line, "\t");
-
-  uint32_t count_column = UNDEFINED_UINT32;
-  uint32_t quality_column = UNDEFINED_UINT32;
-  for (uint32_t i = 0; i < count_header_list.size(); i++)
-  {
-    if (count_header_list[i] == "quality")
-      quality_column = i;
-    else if (count_header_list[i] == "count")
-      count_column = i;
-  }
-
-  ASSERT( (quality_column != UNDEFINED_UINT32) && (count_column != UNDEFINED_UINT32),
-          "'quality' and 'count' columns not found in file: " + count_file_name);
-
-  vector<uint32_t> quality_count_list(covariate_max[k_quality]);
-  string line;
-  while (COUNT.good())
-  {
-    getline(COUNT, line);
-    vector<string> line_list = split(line,  "\t");
-    if (line_list.size() < 2) break; // empty line
-    uint32_t count = from_string<uint32_t>(line_list[count_column]);
-    uint32_t quality = from_string<uint32_t>(line_list[quality_column]);
-    quality_count_list[quality] += count;
-  }
-  COUNT.close();
-
-  string genome_error_counts_file_name = settings.genome_error_counts_file_name;
-
-  ofstream GEC(genome_error_counts_file_name.c_str());
-  assert(GEC.is_open());
-  for (uint32_t i = 1; i < quality_count_list.size(); i++)
-  {
-    uint32_t val = 0;
-    val = quality_count_list[i];
-    GEC << val << endl;
-  }
-  GEC.close();
-
-  string polymorphism_statistics_input_file_name = settings.polymorphism_statistics_input_file_name;
-  string polymorphism_statistics_output_file_name = settings.polymorphism_statistics_output_file_name;
-
-  /// Load the older GenomeDiff and add new fields
-  string ra_mc_genome_diff_file_name = settings.ra_mc_genome_diff_file_name;
-  cGenomeDiff gd(ra_mc_genome_diff_file_name);
-
-  string polymorphism_statistics_r_script_file_name = settings.polymorphism_statistics_r_script_file_name;
-  string polymorphism_statistics_r_script_log_file_name = settings.polymorphism_statistics_r_script_log_file_name;
-  uint64_t total_reference_length = summary.sequence_conversion.total_reference_sequence_length;
-
-  string command = "R --vanilla total_length=" + to_string<uint32_t>(total_reference_length) +
-    " in_file="   + cString(polymorphism_statistics_input_file_name).escape_shell_chars() +
-    " out_file="  + cString(polymorphism_statistics_output_file_name).escape_shell_chars() +
-    " qual_file=" + cString(genome_error_counts_file_name).escape_shell_chars() +
-    " < "         + cString(polymorphism_statistics_r_script_file_name).escape_shell_chars() +
-    " > "         + cString(polymorphism_statistics_r_script_log_file_name).escape_shell_chars();
-  SYSTEM(command, false, false, false); //NOTE: Not escaping shell characters here.
-
-  // Read R file and add new results corresponding to all columns
-  ifstream ROUT(polymorphism_statistics_output_file_name.c_str());
-  assert(ROUT.is_open()); // or die "Could not find file: $polymorphism_statistics_output_file_name";
-  string header;
-  getline(ROUT, header);
-  vector<string> header_list = split(header, "\t");
-
-  cGenomeDiff new_gd;
-
-  diff_entry_list_t muts = gd.evidence_list();
-  for (diff_entry_list_t::iterator it=muts.begin(); it!=muts.end(); it++)
-  {
-    cDiffEntry& mut= **it;
-
-    // No lines exist for user_defined RA evidence = 1 (if =2 then we need to erase any reject reasons)
-    if (mut.entry_exists("user_defined_no_poly"))
-    {
-      mut.erase("user_defined_no_poly");
-      new_gd.add(mut);
-      continue;
-    }
-    
-    // lines only exist for RA evidence
-    if (mut._type != RA)
-    {
-      new_gd.add(mut);
-      continue;
-    }
-    
-    // lines only exist for polymorphisms
-    if (!mut.entry_exists(POLYMORPHISM_EXISTS)) {
-      new_gd.add(mut);
-      continue;
-    }
-    mut.erase(POLYMORPHISM_EXISTS);
-    
-    // Copy over the values from the R output file back to the RA item
-    string line;
-    getline(ROUT, line);
-    vector<string> line_list = split(line, "\t");
-
-    for (uint32_t j = 0; j < header_list.size(); j++)
-    {
-      assert(line_list.size() > j); // die "Incorrect number of items on line:\n$line"
-      mut[header_list[j]] = line_list[j];
-    }
-
-    new_gd.add(mut);
-  }
-
-  ROUT.close();
-
-  /// Write out the file which now has much more data
-  string polymorphism_statistics_ra_mc_genome_diff_file_name = settings.polymorphism_statistics_ra_mc_genome_diff_file_name;
-  new_gd.write(polymorphism_statistics_ra_mc_genome_diff_file_name);
-
-}
-
 std::string GetWord(std::string &s) {
   RemoveLeadingWhitespace(s);
   int found = s.find_first_of(" =\n\r");
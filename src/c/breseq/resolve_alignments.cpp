@@ -26,6 +26,7 @@ LICENSE AND COPYRIGHT
 #include "libbreseq/reference_sequence.h"
 #include "libbreseq/chisquare.h"
 #include "libbreseq/output.h"
+#include "libbreseq/trace.h"
 
 using namespace std;
 
@@ -262,6 +263,8 @@ void resolve_alignments(
 {    
 	bool verbose = false;
   
+  TRACE_SCOPE(trace, "resolve_alignments load junctions");
+
   // local variables for convenience
   int32_t read_length_avg = static_cast<int32_t>(round(summary.sequence_conversion.read_length_avg));
   
@@ -281,7 +284,7 @@ void resolve_alignments(
     cFastaSequence fs;
     while (ff.read_sequence(fs))
     {
-      SequenceTrims st(fs.get_sequence());
+      SequenceTrims st(fs);
       junction_trims_list.push_back(st);
     }
   }
@@ -337,6 +340,8 @@ void resolve_alignments(
   // stores all junction ids that we have encountered
   map<string,uint32_t> all_junction_ids;
   
+  TRACE_NEXT(trace, "resolve_alignments match reads");
+
   if (!settings.aligned_sam_mode) {
   
     load_junction_alignments(
@@ -393,6 +398,8 @@ void resolve_alignments(
   // Score all of the matches.
   ////
   
+  TRACE_NEXT(trace, "resolve_alignments score junctions");
+
   vector<string> junction_ids = get_keys(all_junction_ids);
   for(vector<string>::iterator it=junction_ids.begin(); it != junction_ids.end(); it++) {
     const string& junction_id = *it;
@@ -480,6 +487,8 @@ void resolve_alignments(
     }
   }
   
+  TRACE_NEXT(trace, "resolve_alignments accept junctions");
+
   PosHashProbabilityTable pos_hash_p_value_calculator(summary, settings);
   
   while(!junction_test_info_list.empty() ) {
@@ -599,6 +608,8 @@ void resolve_alignments(
     junction_test_info_list.sort();
   }
     
+  TRACE_NEXT(trace, "resolve_alignments write evidence");
+
   PosHashScoreDistribution accepted_pos_hash_score_distribution;
   for(list<JunctionTestInfo>::iterator it = passed_junction_test_info_list.begin(); it != passed_junction_test_info_list.end(); it++)
   {
@@ -748,6 +759,7 @@ void load_junction_alignments(
         break; // to next file
       
       reads_processed++;
+      TRACE_COUNT("reads", 1);
       read_file_summary_info.num_total_reads++;
       read_file_summary_info.num_total_bases+=seq.length();
       
@@ -970,6 +982,7 @@ void load_sam_only_alignments(
         break; // to next file
       
       reads_processed++;
+      TRACE_COUNT("reads", 1);
       if (reads_processed % 10000 == 0)
         cerr << "    READS:" << reads_processed << endl;
                   
@@ -21,6 +21,8 @@
 
 #include "libbreseq/anyoption.h"
 
+#include <mutex>
+#include <sys/resource.h>
 
 using namespace std;
 
@@ -190,6 +192,7 @@ namespace breseq
     options.addUsage("Read File Options", ADVANCED_OPTION);
     options
     ("limit-fold-coverage,l", "Analyze a subset of the input FASTQ sequencing reads with enough bases to provide this theoretical coverage of the reference sequences. A value between 60 and 120 will usually speed up the analysis with no loss in sensitivity for clonal samples. The actual coverage achieved will be somewhat less because not all reads will map (DEFAULT=OFF)", "", ADVANCED_OPTION)
+    ("limit-fold-coverage-random", "Choose the reads analyzed with --limit-fold-coverage at random from throughout the input FASTQ files, rather than taking the first reads. This avoids biases in which reads come first in a file, such as by flowcell tile. The same fraction of the reads is kept from every read file, so the mates in paired read files stay together. A read is chosen by a hash of its position in its file, so the same reads are chosen each time the analysis is run.", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
     ("aligned-sam", "Input files are aligned SAM files, rather than FASTQ files. Junction prediction steps will be skipped. Be aware that breseq assumes: (1) Your SAM file is sorted such that all alignments for a given read are on consecutive lines. You can use 'samtools sort -n' if you are not sure that this is true for the output of your alignment program. (2) You EITHER have alignment scores as additional SAM fields with the form 'AS:i:n', where n is a positive integer and higher values indicate a better alignment OR it defaults to calculating an alignment score that is equal to the number of bases in the read minus the number of inserted bases, deleted bases, and soft clipped bases in the alignment to the reference. The default highly penalizes split-read matches (with CIGAR strings such as M35D303M65).", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
     ("read-min-length", "Reads in the input FASTQ file that are shorter than this length will be ignored. (0 = OFF)", 18, ADVANCED_OPTION)
     ("read-max-same-base-fraction", "Reads in the input FASTQ file in which this fraction or more of the bases are the same will be ignored. (0 = OFF)", 0.9, ADVANCED_OPTION)
@@ -202,7 +205,9 @@ namespace breseq
     ("contig-reference,c", "File containing reference sequences in GenBank, GFF3, or FASTA format. The same coverage distribution will be fit to all of the reference sequences in this file simultaneously. This is appropriate when they are all contigs from a genome that should be present with the same copy number. Use of this option will improve performance when there are many contigs and especially when some are very short (≤1,000 bases).", NULL, ADVANCED_OPTION)
     ("junction-only-reference,s", "File containing reference sequences in GenBank, GFF3, or FASTA format. These references are only used for calling junctions with other reference sequences. An example of appropriate usage is including a transposon sequence not present in a reference genome. Option may be provided multiple times for multiple files.", NULL, ADVANCED_OPTION)
     ("targeted-sequencing,t", "Reference sequences were targeted for ultra-deep sequencing (using pull-downs or amplicons). Do not fit coverage distribution.", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
+    ("packed-reference","Store reference sequences in memory with two bits per base. Reduces memory use for very large references, but looking up reference bases is somewhat slower.", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
     ("user-evidence-gd","User supplied Genome Diff file of JC and/or RA evidence items. The breseq output will report the support for these sequence changes even if they do not pass the normal filters for calling mutations in this sample.", "", ADVANCED_OPTION)
+    ("prepared-reference", "Directory of reference files already converted by 'breseq BATCH' for these same reference files. They are copied into this run instead of loading and converting the references again. (DEFAULT=OFF)", "", ADVANCED_OPTION)
     ;
     
     options.addUsage("", ADVANCED_OPTION);
@@ -225,6 +230,7 @@ namespace breseq
     ("bowtie2-stage1", "Settings for mapping criteria used for the stage 1 alignment. This step is normally meant for quickly aligning near-perfect matches. (DEFAULT=\"" + this->bowtie2_stage1 + "\")", "", ADVANCED_OPTION)
     ("bowtie2-stage2", "Settings for mapping criteria used for the stage 2 alignment. If set to the empty string \"\", then stage 2 alignment is skipped. This step is normally meant for exhaustively mapping reads that were unmapped by stage 1. (DEFAULT=\"" + this->bowtie2_stage2 + "\")", "", ADVANCED_OPTION)
     ("bowtie2-junction", "Settings for mapping criteria used in aligning reads to candidate junctions. (DEFAULT=\"" + this->bowtie2_junction + "\")", "", ADVANCED_OPTION)
+    ("bowtie2-index-cache", "Directory where bowtie2 indexes of the reference sequences are kept and shared between runs. An index is reused by any run with the same reference sequences and bowtie2 version. (DEFAULT=OFF)", "", ADVANCED_OPTION)
     ;
     options.addUsage("In addition to these values, breseq automatically sets the seed size for bowtie2 read mapping (-L option) to a value that is scaled to the read length (r). This value is 0.5 * r for stage 1, 5 + 0.1 * r for stage 2, and 0.3 * r for junction mapping. In each case, it is bounded to the range [4,31] as required by bowtie2. Be warned that breseq internally rescores alignments with a scoring scheme setting +1 for match, -3 for mismatch, -2 for gap open, and -3 for gap extend for consistency when comparing alternative alignments present in the bowtie2 output.", ADVANCED_OPTION);
     
@@ -281,6 +287,7 @@ namespace breseq
     ("brief-html-output", "Don't create detailed output files for evidence (no read alignments or coverage plots)", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
     ("header-genome-diff,g", "Include header information from this GenomeDiff file in output.gd", "", ADVANCED_OPTION)
     ("no-javascript", "Don't include javascript in the HTML output", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
+    ("r-coverage-plots", "Draw coverage plots by running R (the previous, slower method) instead of with the built-in renderer", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
     ;
     
     options.addUsage("", ADVANCED_OPTION);
@@ -297,6 +304,7 @@ namespace breseq
     ("keep-intermediates,k","Do not delete intermediate files.", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
     ("per-position-file", "Create additional file of per-position aligned bases", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
     ("junction-debug", "Output additional junction debugging files", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
+    ("trace", "Write a timing trace of the run in Chrome trace format to data/trace.json, for viewing in chrome://tracing or Perfetto", TAKES_NO_ARGUMENT, ADVANCED_OPTION)
     ;
     
     options.addUsage("", ADVANCED_OPTION);
@@ -313,6 +321,7 @@ namespace breseq
 		options.addUsage("Utility Command Usage: breseq [command] options ...");
     options.addUsage("  Sequence Utility Commands: CONVERT-FASTQ, CONVERT-REFERENCE, GET-SEQUENCE");
     options.addUsage("  Breseq Post-Run Commands: BAM2ALN, BAM2COV, CL-TABULATE");
+    options.addUsage("  Multiple Sample Commands: BATCH");
     options.addUsage("");
     options.addUsage("For help using a utility command, type: breseq [command] "); 
     options.addUsage("");
@@ -367,6 +376,8 @@ namespace breseq
     if (options.count("limit-fold-coverage")) {
       this->read_file_coverage_fold_limit = from_string<double>(options["limit-fold-coverage"]);
     }
+    this->read_file_coverage_fold_limit_random = options.count("limit-fold-coverage-random");
+    ASSERT(!this->read_file_coverage_fold_limit_random || this->read_file_coverage_fold_limit, "Argument --limit-fold-coverage-random requires --limit-fold-coverage");
     
     this->read_file_read_length_min = from_string<double>(options["read-min-length"]);
     this->read_file_max_same_base_fraction = from_string<double>(options["read-max-same-base-fraction"]);
@@ -415,6 +426,7 @@ namespace breseq
     // and a subsequent call to init_reference_sequences()
     
     this->user_evidence_genome_diff_file_name = options["user-evidence-gd"];
+    this->prepared_reference_path = options["prepared-reference"];
     
     this->custom_run_name = options["name"];
     
@@ -449,6 +461,7 @@ namespace breseq
     if (options.count("bowtie2-stage1")) this->bowtie2_stage1 = options["bowtie2-stage1"];
     if (options.count("bowtie2-stage2")) this->bowtie2_stage2 = options["bowtie2-stage2"];
     if (options.count("bowtie2-junction")) this->bowtie2_junction = options["bowtie2-junction"];
+    if (options.count("bowtie2-index-cache")) this->bowtie2_index_cache_path = options["bowtie2-index-cache"];
 
     //! Settings: Junction Prediction
     this->skip_new_junction_prediction = this->skip_new_junction_prediction || options.count("no-junction-prediction");
@@ -467,6 +480,7 @@ namespace breseq
     
     //! Settings: Debugging
     this->keep_all_intermediates = options.count("keep-intermediates");
+    this->trace = options.count("trace");
 
     
     //
@@ -626,6 +640,8 @@ namespace breseq
     if (this->targeted_sequencing)
       this->skip_missing_coverage_prediction = true;
     
+    this->pack_reference_sequences = options.count("packed-reference");
+    
     this->print_mutation_identification_per_position_file = options.count("per-position-file");
     
     this->junction_debug = options.count("junction-debug");
@@ -633,6 +649,7 @@ namespace breseq
     this->max_displayed_reads = from_string<int32_t>(options["max-displayed-reads"]);
     this->skip_alignment_or_plot_generation = options.count("brief-html-output");
     this->no_javascript = options.count("no-javascript");
+    this->r_coverage_plots = options.count("r-coverage-plots");
     if (options.count("header-genome-diff"))
       this->header_genome_diff_file_name = options["header-genome-diff"];
   
@@ -723,6 +740,7 @@ namespace breseq
     //! Read file options
     this->aligned_sam_mode  = false;
     this->read_file_coverage_fold_limit = 0.0;
+    this->read_file_coverage_fold_limit_random = false;
     this->read_file_max_same_base_fraction = 0.9;
     this->read_file_read_length_min = 18;
     
@@ -742,6 +760,7 @@ namespace breseq
     this->candidate_junction_read_limit = 0;
     this->no_unmatched_reads = false;
     this->keep_all_intermediates = false;
+    this->trace = false;
 
     //! Settings: Read Alignment and Candidate Junction Read Alignment
     this->require_match_length = 0;         
@@ -775,6 +794,7 @@ namespace breseq
 
     
     this->num_processors = 1;
+    this->pack_reference_sequences = false;
     
     //! Settings: Candidate Junction Prediction
 		this->preprocess_junction_min_indel_split_length = 3;
@@ -841,6 +861,8 @@ namespace breseq
 		this->lenski_format = false;
 		this->no_evidence = false;
     this->no_javascript = false;
+    this->r_coverage_plots = false;
+    this->coverage_plot_format = "png";
     this->add_metadata_to_gd = true;
     
     ////////////////////
@@ -953,6 +975,7 @@ namespace breseq
 		if (this->base_output_path.size() > 0) this->error_calibration_path = this->base_output_path + "/" + this->error_calibration_path;
 		this->error_counts_file_name = this->error_calibration_path + "/error_counts.tab";
 		this->error_rates_done_file_name = this->error_calibration_path + "/error_rates.done";
+		this->error_rates_plot_done_file_name = this->error_calibration_path + "/error_rates_plot.done";
 
 		this->error_rates_file_name = this->error_calibration_path + "/error_rates.tab";
 		this->error_counts_done_file_name = this->error_calibration_path + "/error_counts.done";
@@ -970,17 +993,9 @@ namespace breseq
 
     this->mutation_identification_done_file_name = this->mutation_identification_path + "/mutation_identification.done";
 		this->mutation_identification_per_position_file_name = this->mutation_identification_path + "/per_position_file.tab";
-		this->complete_coverage_text_file_name = this->mutation_identification_path + "/@.coverage.tab";
-		this->genome_error_counts_file_name = this->mutation_identification_path + "/error_counts.tab";
+		this->complete_coverage_file_name = this->mutation_identification_path + "/@.coverage.bin";
 		this->ra_mc_genome_diff_file_name = this->mutation_identification_path + "/ra_mc_evidence.gd";
 
-    this->polymorphism_statistics_done_file_name = this->mutation_identification_path + "/polymorphism_statistics.done";
-		this->polymorphism_statistics_input_file_name = this->mutation_identification_path + "/polymorphism_statistics_input.tab";
-		this->polymorphism_statistics_output_file_name = this->mutation_identification_path + "/polymorphism_statistics_output.tab";
-		this->polymorphism_statistics_r_script_file_name = this->program_data_path + "/polymorphism_statistics.r";
-		this->polymorphism_statistics_r_script_log_file_name = this->mutation_identification_path + "/polymorphism_statistics_output.log";
-		this->polymorphism_statistics_ra_mc_genome_diff_file_name = this->mutation_identification_path + "/ra_mc_evidence_polymorphism_statistics.gd";
-
     //! Paths: Copy Number Variation
 		this->copy_number_variation_path = "09_copy_number_variation";
     if (this->base_output_path.size() > 0) this->copy_number_variation_path = this->base_output_path + "/" + this->copy_number_variation_path;
@@ -1007,13 +1022,14 @@ namespace breseq
 		this->local_evidence_path = "evidence";
 		this->evidence_path = this->output_path + "/" + this->local_evidence_path;
 		this->evidence_genome_diff_file_name = this->evidence_path + "/evidence.gd";
+    this->evidence_cache_file_name = this->evidence_path + "/output_cache.tab";
 		this->final_genome_diff_file_name = this->output_path + "/output.gd";
     this->annotated_genome_diff_file_name = this->evidence_path + "/annotated.gd";
     
 		this->local_coverage_plot_path = "evidence";
 		this->coverage_plot_path = this->output_path + "/" + this->local_coverage_plot_path;
     this->coverage_plot_r_script_file_name = this->program_data_path + "/plot_coverage.r";    
-		this->overview_coverage_plot_file_name = this->coverage_plot_path + "/@.overview.png";
+		this->overview_coverage_plot_file_name = this->coverage_plot_path + "/@.overview." + this->coverage_plot_format;
 
 		this->output_calibration_path = this->output_path + "/calibration";
 		this->unique_only_coverage_plot_file_name = this->output_calibration_path + "/@.unique_coverage.pdf";
@@ -1035,6 +1051,7 @@ namespace breseq
     this->output_genome_diff_file_name = this->data_path + "/output.gd";
     this->output_annotated_genome_diff_file_name = this->data_path + "/annotated.gd";
     this->data_summary_file_name = this->data_path + "/summary.json";
+    this->trace_file_name = this->data_path + "/trace.json";
 
 
     //! Paths: Experimental
@@ -1328,8 +1345,87 @@ namespace breseq
 		if (!good_to_go) exit(0);
 	}
 
+  ResourceUsage ResourceUsage::current()
+  {
+    ResourceUsage r;
+    
+    struct rusage self_usage, children_usage;
+    getrusage(RUSAGE_SELF, &self_usage);
+    getrusage(RUSAGE_CHILDREN, &children_usage);
+    
+    r.user_time = self_usage.ru_utime.tv_sec + self_usage.ru_utime.tv_usec / 1E6;
+    r.system_time = self_usage.ru_stime.tv_sec + self_usage.ru_stime.tv_usec / 1E6;
+    r.child_user_time = children_usage.ru_utime.tv_sec + children_usage.ru_utime.tv_usec / 1E6;
+    r.child_system_time = children_usage.ru_stime.tv_sec + children_usage.ru_stime.tv_usec / 1E6;
+    
+    // Only available on Linux, where it includes finished child processes
+    ifstream io_file("/proc/self/io");
+    string key;
+    uint64_t value;
+    while (io_file >> key >> value) {
+      if (key == "rchar:") r.bytes_read = value;
+      else if (key == "wchar:") r.bytes_written = value;
+    }
+    
+    return r;
+  }
+  
+  ResourceUsage ResourceUsage::since(const ResourceUsage& start) const
+  {
+    ResourceUsage r(*this);
+    r.user_time -= start.user_time;
+    r.system_time -= start.system_time;
+    r.child_user_time -= start.child_user_time;
+    r.child_system_time -= start.child_system_time;
+    r.bytes_read -= start.bytes_read;
+    r.bytes_written -= start.bytes_written;
+    r.peak_rss = 0;
+    r.child_peak_rss = 0;
+    return r;
+  }
+  
+  uint64_t ResourceUsage::take_peak_rss()
+  {
+    // Only available on Linux: the high-water mark, which writing 5 to
+    // clear_refs resets to the memory in use now
+    uint64_t peak_rss = 0;
+    ifstream status_file("/proc/self/status");
+    string key;
+    while (status_file >> key) {
+      if (key == "VmHWM:") {
+        status_file >> peak_rss;
+        break;
+      }
+      status_file.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    
+    if (peak_rss > 0) {
+      ofstream clear_refs_file("/proc/self/clear_refs");
+      clear_refs_file << "5" << endl;
+      return peak_rss;
+    }
+    
+    // ru_maxrss is in bytes on OS X and kilobytes on Linux
+    struct rusage self_usage;
+    getrusage(RUSAGE_SELF, &self_usage);
+#ifdef __APPLE__
+    return self_usage.ru_maxrss / 1024;
+#else
+    return self_usage.ru_maxrss;
+#endif
+  }
+  
+  uint64_t ResourceUsage::take_child_peak_rss()
+  {
+    return system_child_peak_rss().exchange(0);
+  }
+  
+  // Steps may be started and finished from different threads (see cStepScheduler)
+  static mutex step_mutex;
+
 	bool Settings::do_step(const string& done_key, const string& message)
 	{
+    lock_guard<mutex> lock(step_mutex);
 		string done_file_name = done_key;
 		this->done_key_messages[done_key] = message;
     this->set_current_step_done_key(done_key);
@@ -1354,6 +1450,7 @@ namespace breseq
 
 	void Settings::done_step(const string& done_key)
 	{
+    lock_guard<mutex> lock(step_mutex);
     // Delete intermediate files
     if (!this->keep_all_intermediates) {
       for (vector<string>::iterator it= done_key_intermediate_files[done_key].begin(); it != done_key_intermediate_files[done_key].end(); it++) {
@@ -1364,10 +1461,16 @@ namespace breseq
 		// Create the done file with timing information
 		string done_file_name = done_key;
 		string message = this->done_key_messages[done_key];
-    execution_times.back()._done_key_intermediate_files = done_key_intermediate_files;
 		this->record_end_time(message);
 
-		this->execution_times.back().store(done_file_name);
+    // Not necessarily the last step started, if steps run concurrently
+    for (vector<ExecutionTime>::iterator it = execution_times.begin(); it != execution_times.end(); it++) {
+      if (it->_message != message) continue;
+      it->_done_key_intermediate_files = done_key_intermediate_files;
+      it->store(done_file_name);
+      if (it->_trace_start >= 0) cTrace::record(message, it->_trace_start, cTrace::now());
+      break;
+    }
 	}
   
   
@@ -1385,6 +1488,7 @@ namespace breseq
   // keep intermediate files. Added to current step.
   void Settings::track_intermediate_file(const string& done_key, const string& file_path)
   {
+    lock_guard<mutex> lock(step_mutex);
     done_key_intermediate_files[done_key].push_back(file_path);
   }
   
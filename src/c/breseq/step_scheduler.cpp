@@ -0,0 +1,177 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#include "libbreseq/step_scheduler.h"
+
+#include <condition_variable>
+#include <mutex>
+
+using namespace std;
+
+namespace breseq {
+
+size_t cJobScheduler::add_job(uint32_t num_threads, const vector<size_t>& dependencies, function<void()> run)
+{
+  job_t job;
+  job.num_threads = min(num_threads, m_num_processors);
+  job.dependencies = dependencies;
+  job.run = run;
+  job.state = WAITING;
+
+  // Only earlier jobs can be dependencies, so there can be no cycles
+  for (vector<size_t>::const_iterator it = dependencies.begin(); it != dependencies.end(); it++) {
+    ASSERT(*it < m_jobs.size(), "Job depends on a job that was not added before it.");
+  }
+
+  m_jobs.push_back(job);
+  return m_jobs.size() - 1;
+}
+
+void cJobScheduler::run()
+{
+  mutex jobs_mutex;
+  condition_variable job_finished;
+  uint32_t threads_in_use = 0;
+  vector<thread> threads;
+
+  unique_lock<mutex> lock(jobs_mutex);
+  while (true) {
+
+    bool all_finished = true;
+
+    // Start jobs in the order they were added, when they are ready and there are threads for them
+    for (size_t i = 0; i < m_jobs.size(); i++) {
+      job_t& job = m_jobs[i];
+      if (job.state == FINISHED) continue;
+      all_finished = false;
+      if (job.state == RUNNING) continue;
+
+      bool ready = true;
+      for (vector<size_t>::const_iterator it = job.dependencies.begin(); it != job.dependencies.end(); it++) {
+        ready = ready && (m_jobs[*it].state == FINISHED);
+      }
+      if (!ready) continue;
+
+      if ((threads_in_use > 0) && (threads_in_use + job.num_threads > m_num_processors)) continue;
+
+      job.state = RUNNING;
+      threads_in_use += job.num_threads;
+
+      threads.push_back(thread([&job, &jobs_mutex, &job_finished, &threads_in_use]() {
+        job.run();
+
+        lock_guard<mutex> finished_lock(jobs_mutex);
+        job.state = FINISHED;
+        threads_in_use -= job.num_threads;
+        job_finished.notify_all();
+      }));
+    }
+
+    if (all_finished) break;
+    job_finished.wait(lock);
+  }
+  lock.unlock();
+
+  for (vector<thread>::iterator it = threads.begin(); it != threads.end(); it++) {
+    it->join();
+  }
+}
+
+vector<uint32_t> cJobScheduler::split_threads_by_size(const vector<uint64_t>& sizes, uint32_t num_processors)
+{
+  vector<uint32_t> num_threads(sizes.size(), 1);
+  if (sizes.size() >= num_processors) return num_threads;
+
+  uint64_t total_size = 0;
+  for (vector<uint64_t>::const_iterator it = sizes.begin(); it != sizes.end(); it++) {
+    total_size += *it;
+  }
+
+  // Spare threads are handed out by whole shares, then the rest to the
+  // jobs with the largest remainders
+  uint32_t num_spare = num_processors - sizes.size();
+  uint32_t num_assigned = 0;
+  vector<pair<double, size_t> > remainders;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    double share = total_size ? static_cast<double>(num_spare) * sizes[i] / total_size : static_cast<double>(num_spare) / sizes.size();
+    uint32_t whole_share = static_cast<uint32_t>(share);
+    num_threads[i] += whole_share;
+    num_assigned += whole_share;
+    remainders.push_back(make_pair(share - whole_share, i));
+  }
+
+  stable_sort(remainders.begin(), remainders.end(), [](const pair<double, size_t>& a, const pair<double, size_t>& b) { return a.first > b.first; });
+  for (size_t i = 0; (i < remainders.size()) && (num_assigned < num_spare); i++, num_assigned++) {
+    num_threads[remainders[i].second]++;
+  }
+
+  return num_threads;
+}
+
+void cStepScheduler::add_step(const string& done_key,
+                              const string& message,
+                              const vector<string>& dependencies,
+                              uint32_t num_threads,
+                              function<void()> run,
+                              function<void()> finish)
+{
+  step_t step;
+  step.done_key = done_key;
+  step.message = message;
+  step.num_threads = max<uint32_t>(1, num_threads);
+  step.run = run;
+  step.finish = finish;
+
+  for (vector<string>::const_iterator it = dependencies.begin(); it != dependencies.end(); it++) {
+    for (size_t i = 0; i < m_steps.size(); i++) {
+      if (m_steps[i].done_key == *it) step.dependencies.push_back(i);
+    }
+  }
+
+  m_steps.push_back(step);
+}
+
+void cStepScheduler::run()
+{
+  // Steps are added as jobs in the same order, so they have the same indexes
+  cJobScheduler jobs(m_num_processors);
+
+  for (vector<step_t>::iterator it = m_steps.begin(); it != m_steps.end(); it++) {
+    step_t& step = *it;
+
+    // Completed by an earlier run, so it only needs to be finished
+    if (file_exists(step.done_key.c_str())) {
+      jobs.add_job(0, step.dependencies, [this, &step]() {
+        m_settings.do_step(step.done_key, step.message);
+        if (step.finish) step.finish();
+      });
+      continue;
+    }
+
+    jobs.add_job(step.num_threads, step.dependencies, [this, &step]() {
+      m_settings.do_step(step.done_key, step.message);
+      step.run();
+      m_settings.done_step(step.done_key);
+      if (step.finish) step.finish();
+    });
+  }
+
+  jobs.run();
+}
+
+} // namespace breseq
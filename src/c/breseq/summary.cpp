@@ -529,11 +529,32 @@ PublicOptionsSummary::PublicOptionsSummary(const Settings &t)
   hide_circular_genome_junctions = t.hide_circular_genome_junctions;
 }
   
+PublicExecutionTimeSummary::PublicExecutionTimeSummary(const ExecutionTime &t)
+{
+  step = t._message;
+  time_start = t._formatted_time_start;
+  time_end = t._formatted_time_end;
+  time_elapsed = t._time_elapsed;
+  cpu_user_time = t._resources.user_time;
+  cpu_system_time = t._resources.system_time;
+  children_cpu_user_time = t._resources.child_user_time;
+  children_cpu_system_time = t._resources.child_system_time;
+  peak_memory = t._resources.peak_rss;
+  children_peak_memory = t._resources.child_peak_rss;
+  bytes_read = t._resources.bytes_read;
+  bytes_written = t._resources.bytes_written;
+}
+  
   PublicSummary::PublicSummary(const Summary &s, const Settings &t, const cReferenceSequences &r)
   : reads(s)
   , references(s, r, t.refseq_settings)
   , options(t)
-{ }
+{
+  for (vector<ExecutionTime>::const_iterator it = t.execution_times.begin(); it != t.execution_times.end(); it++) {
+    if (it->_message.empty()) continue;
+    execution_times.push_back(PublicExecutionTimeSummary(*it));
+  }
+}
   
 // PublicReadFileSummary
 void to_json(json& j, const PublicReadFileSummary& s)
@@ -863,6 +884,7 @@ void to_json(json& j, const PublicSummary& s)
     {"reads", s.reads},
     {"references", s.references},
     {"options", s.options},
+    {"execution_times", s.execution_times},
   };
 }
 
@@ -872,6 +894,60 @@ void from_json(const json& j, PublicSummary& s)
   s.reads = j.at("reads").get<PublicReadSummary>();
   s.references = j.at("references").get<PublicReferencesSummary>();
   s.options = j.at("options").get<PublicOptionsSummary>();
+  // Not in files written by older versions
+  if (j.count("execution_times")) s.execution_times = j.at("execution_times").get<PublicExecutionTimeSummaries>();
+}
+
+
+// PublicExecutionTimeSummary
+void to_json(json& j, const PublicExecutionTimeSummary& s)
+{
+  j = json{
+    {"step", s.step},
+    {"time_start", s.time_start},
+    {"time_end", s.time_end},
+    {"time_elapsed", s.time_elapsed},
+    {"cpu_user_time", s.cpu_user_time},
+    {"cpu_system_time", s.cpu_system_time},
+    {"children_cpu_user_time", s.children_cpu_user_time},
+    {"children_cpu_system_time", s.children_cpu_system_time},
+    {"peak_memory", s.peak_memory},
+    {"children_peak_memory", s.children_peak_memory},
+    {"bytes_read", s.bytes_read},
+    {"bytes_written", s.bytes_written},
+  };
+}
+  
+void from_json(const json& j, PublicExecutionTimeSummary& s)
+{
+  s.step = j.at("step").get<string>();
+  s.time_start = j.at("time_start").get<string>();
+  s.time_end = j.at("time_end").get<string>();
+  s.time_elapsed = j.at("time_elapsed").get<double>();
+  s.cpu_user_time = j.at("cpu_user_time").get<double>();
+  s.cpu_system_time = j.at("cpu_system_time").get<double>();
+  s.children_cpu_user_time = j.at("children_cpu_user_time").get<double>();
+  s.children_cpu_system_time = j.at("children_cpu_system_time").get<double>();
+  s.peak_memory = j.at("peak_memory").get<uint64_t>();
+  s.children_peak_memory = j.at("children_peak_memory").get<uint64_t>();
+  s.bytes_read = j.at("bytes_read").get<uint64_t>();
+  s.bytes_written = j.at("bytes_written").get<uint64_t>();
+}
+  
+// PublicExecutionTimeSummaries
+void to_json(json& j, const PublicExecutionTimeSummaries& s)
+{
+  j = json::array();
+  for (PublicExecutionTimeSummaries::const_iterator it = s.begin(); it != s.end(); it++) {
+    j.push_back(*it);
+  }
+}
+  
+void from_json(const json& j, PublicExecutionTimeSummaries& s)
+{
+  for (json::const_iterator it = j.begin(); it != j.end(); ++it) {
+    s.push_back(it->get<PublicExecutionTimeSummary>());
+  }
 }
 
   
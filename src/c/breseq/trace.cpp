@@ -0,0 +1,128 @@
+/*****************************************************************************
+
+ AUTHORS
+
+ Jeffrey E. Barrick <jeffrey.e.barrick@gmail.com>
+ David B. Knoester
+
+ LICENSE AND COPYRIGHT
+
+ Copyright (c) 2008-2010 Michigan State University
+ Copyright (c) 2011-2017 The University of Texas at Austin
+
+ breseq is free software; you can redistribute it and/or modify it under the
+ terms the GNU General Public License as published by the Free Software
+ Foundation; either version 1, or (at your option) any later version.
+
+ *****************************************************************************/
+
+#include "libbreseq/trace.h"
+
+#include "libbreseq/json.hpp"
+
+#include <unistd.h>
+
+using namespace std;
+using nlohmann::json;
+
+namespace breseq {
+
+bool                             cTrace::s_enabled = false;
+string                           cTrace::s_file_name;
+chrono::steady_clock::time_point cTrace::s_origin;
+mutex                            cTrace::s_mutex;
+vector<cTrace::event_t>          cTrace::s_events;
+map<thread::id, uint32_t>        cTrace::s_threads;
+
+thread_local cTraceScope* cTraceScope::s_current = NULL;
+
+void cTrace::open(const string& file_name)
+{
+  lock_guard<mutex> lock(s_mutex);
+  s_file_name = file_name;
+  s_origin = chrono::steady_clock::now();
+  s_events.clear();
+  s_threads.clear();
+  s_threads[this_thread::get_id()] = 0;
+  s_enabled = true;
+}
+
+// Threads are numbered in the order they first record an event, so
+// that the main thread is always listed first
+uint32_t cTrace::thread_index()
+{
+  map<thread::id, uint32_t>::iterator it = s_threads.find(this_thread::get_id());
+  if (it != s_threads.end()) return it->second;
+
+  uint32_t index = s_threads.size();
+  s_threads[this_thread::get_id()] = index;
+  return index;
+}
+
+void cTrace::record(const string& name, int64_t start, int64_t end, const counters_t& counters)
+{
+  if (!s_enabled) return;
+
+  lock_guard<mutex> lock(s_mutex);
+  event_t e;
+  e.name = name;
+  e.start = start;
+  e.end = end;
+  e.thread = thread_index();
+  e.counters = counters;
+  s_events.push_back(e);
+}
+
+void cTrace::close()
+{
+  if (!s_enabled) return;
+
+  lock_guard<mutex> lock(s_mutex);
+  s_enabled = false;
+
+  // Timestamps and durations are in microseconds
+  int32_t pid = getpid();
+  json events = json::array();
+
+  json process_name = { {"name", "process_name"}, {"ph", "M"}, {"pid", pid}, {"tid", 0} };
+  process_name["args"] = { {"name", "breseq"} };
+  events.push_back(process_name);
+
+  for (uint32_t i = 0; i < s_threads.size(); i++) {
+    json thread_name = { {"name", "thread_name"}, {"ph", "M"}, {"pid", pid}, {"tid", i} };
+    thread_name["args"] = { {"name", i ? "thread " + to_string(i) : string("main")} };
+    events.push_back(thread_name);
+  }
+
+  for (vector<event_t>::const_iterator it = s_events.begin(); it != s_events.end(); it++) {
+    json e = {
+      {"name", it->name},
+      {"cat", "breseq"},
+      {"ph", "X"},
+      {"ts", it->start / 1000.0},
+      {"dur", (it->end - it->start) / 1000.0},
+      {"pid", pid},
+      {"tid", it->thread}
+    };
+    if (it->counters.size()) {
+      json args = json::object();
+      for (counters_t::const_iterator c = it->counters.begin(); c != it->counters.end(); c++) {
+        args[c->first] = c->second;
+      }
+      e["args"] = args;
+    }
+    events.push_back(e);
+  }
+
+  json trace = { {"traceEvents", events}, {"displayTimeUnit", "ms"} };
+
+  ofstream out(s_file_name.c_str());
+  ASSERT(out.good(), "Could not open trace file for writing: " + s_file_name);
+  out << trace.dump() << endl;
+  ASSERT(out.good(), "Error writing trace file: " + s_file_name);
+
+  s_events.clear();
+  s_threads.clear();
+}
+
+} // namespace breseq
@@ -0,0 +1,35 @@
+#!/bin/bash
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+# The built-in renderer must draw the same SVG and PNG plots of a fixed
+# region. The PNG is checked by its dimensions (from the IHDR chunk) and hash.
+CURRENT_OUTPUTS[0]="${SELF}/output.svg"
+EXPECTED_OUTPUTS[0]="${SELF}/expected.svg"
+CURRENT_OUTPUTS[1]="${SELF}/output.tab"
+EXPECTED_OUTPUTS[1]="${SELF}/expected.tab"
+REFERENCE_ARG="-r ${DATADIR}/lambda/lambda.5.gbk"
+BAM2COV_ARGS="-f ${DATADIR}/lambda/lambda.5.fasta -b ${DATADIR}/lambda/lambda.5.bam NC_001416-4:2001-2100"
+
+# $1 == PNG file, $2 == byte offset of a 4-byte big-endian integer
+png_uint32() {
+	od -A n -t u1 -j $2 -N 4 $1 | awk '{ print (($1 * 256 + $2) * 256 + $3) * 256 + $4 }'
+}
+
+plot_coverage() {
+	mkdir -p ${SELF}/output
+	${BRESEQ} BAM2COV --format SVG -o ${SELF}/output/plot ${BAM2COV_ARGS} || return 1
+	${BRESEQ} BAM2COV --format PNG -o ${SELF}/output/plot ${BAM2COV_ARGS} || return 1
+
+	cp ${SELF}/output/plot.svg ${CURRENT_OUTPUTS[0]}
+
+	PNG=${SELF}/output/plot.png
+	printf "png_width\t`png_uint32 ${PNG} 16`\n" > ${CURRENT_OUTPUTS[1]}
+	printf "png_height\t`png_uint32 ${PNG} 20`\n" >> ${CURRENT_OUTPUTS[1]}
+	printf "png_sha1\t`${HASH} ${PNG} | cut -d ' ' -f 1`\n" >> ${CURRENT_OUTPUTS[1]}
+}
+
+TESTCMD="plot_coverage"
+
+do_test $1 ${SELF}
@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+# Compare the native negative binomial coverage fit to coverage_distribution.r.
+#
+# Runs 'breseq COVERAGE-DISTRIBUTION --compare-r' on the unique-only coverage
+# distribution files used by the breseq_coverage_distribution_* tests, or on
+# the files given as arguments, and reports the time taken by each fit along
+# with the relative differences in the fit parameters.
+#
+# Usage:  ./tests/benchmark/coverage_distribution.sh [sequence_length:file.tab ...]
+#
+# R must be installed. Without it, coverage_distribution_reference.py redoes
+# the R fit for one file at a time. This script is not run by 'make test'.
+#
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+if [[ -z `which R` ]]; then
+	echo "R is required to compare coverage distribution fits."
+	exit -1
+fi
+
+INPUTS=("$@")
+if [[ ${#INPUTS[@]} -eq 0 ]]; then
+	INPUTS=("48502:${SELF}/../breseq_coverage_distribution_1/input.tab" "4629812:${SELF}/../breseq_coverage_distribution_2/input.tab" \
+		"48502:${SELF}/../breseq_coverage_distribution_3/input.tab" "46298:${SELF}/../breseq_coverage_distribution_4/input.tab")
+fi
+
+for INPUT in "${INPUTS[@]}"; do
+	LENGTH=${INPUT%%:*}
+	FILE=${INPUT#*:}
+	echo "${FILE}"
+
+	START=`date +%s.%N`
+	${BRESEQ} COVERAGE-DISTRIBUTION -l ${LENGTH} -i ${FILE} -o /dev/null > /dev/null 2>&1
+	END=`date +%s.%N`
+	echo "${START} ${END}" | awk '{ printf "  native   %.3f seconds\n", $2 - $1 }'
+
+	START=`date +%s.%N`
+	${BRESEQ} COVERAGE-DISTRIBUTION -l ${LENGTH} -i ${FILE} --compare-r 2>&1 | awk '/^Compared to R/ { found = 1; next } found && NF { printf "  %-40s R = %-12s relative difference = %s\n", $1, $2, $3 }'
+	END=`date +%s.%N`
+	echo "${START} ${END}" | awk '{ printf "  native + R %.3f seconds\n", $2 - $1 }'
+done
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+#
+# Reference fit of a unique-only coverage distribution, written independently
+# of breseq's native CoverageDistribution::fit() by following the fitting part
+# of src/c/breseq/coverage_distribution.r line by line.
+#
+# It is used to make the expected.tab files of the breseq_coverage_distribution_*
+# tests where R is not installed. With R, compare to coverage_distribution.r
+# itself using coverage_distribution.sh instead.
+#
+# R's nlm() is replaced by Nelder-Mead searches over (log(mu), log(size)) from
+# all of the starting means and several starting sizes used by the R script,
+# keeping the lowest value of the same least-squares objective. Sizes are
+# limited to 1e7; past that the objective no longer changes (Poisson limit).
+#
+# Usage:  ./tests/benchmark/coverage_distribution_reference.py file.tab sequence_length
+#
+# Only the Python standard library is needed. This script is not run by 'make test'.
+#
+
+import math
+import sys
+
+MAX_SIZE = 1e7
+
+
+def log_dnbinom(x, size, mu):
+	return (math.lgamma(x + size) - math.lgamma(size) - math.lgamma(x + 1)
+		+ size * math.log(size / (size + mu)) + x * math.log(mu / (size + mu)))
+
+
+def dnbinom(x, size, mu):
+	return math.exp(log_dnbinom(x, size, mu))
+
+
+def pnbinom(q, size, mu):
+	return sum(dnbinom(x, size, mu) for x in range(0, int(q) + 1))
+
+
+def qnbinom(p, size, mu):
+	# Same fuzz as R, so that p exactly at a step returns that value
+	total = 0.0
+	x = 0
+	while True:
+		total += dnbinom(x, size, mu)
+		if total >= p * (1 - 64 * sys.float_info.epsilon):
+			return x
+		x += 1
+
+
+def nelder_mead(f, start, step, max_iterations=4000):
+	points = [list(start), [start[0] + step, start[1]], [start[0], start[1] + step]]
+	values = [f(p) for p in points]
+	for iteration in range(max_iterations):
+		order = sorted(range(3), key=lambda k: values[k])
+		points = [points[k] for k in order]
+		values = [values[k] for k in order]
+		if (values[2] - values[0] < 1e-18) and (max(abs(points[2][k] - points[0][k]) for k in range(2)) < 1e-10):
+			break
+		centroid = [(points[0][k] + points[1][k]) / 2 for k in range(2)]
+		reflected = [2 * centroid[k] - points[2][k] for k in range(2)]
+		f_reflected = f(reflected)
+		if f_reflected < values[0]:
+			expanded = [3 * centroid[k] - 2 * points[2][k] for k in range(2)]
+			f_expanded = f(expanded)
+			if f_expanded < f_reflected:
+				points[2], values[2] = expanded, f_expanded
+			else:
+				points[2], values[2] = reflected, f_reflected
+		elif f_reflected < values[1]:
+			points[2], values[2] = reflected, f_reflected
+		else:
+			contracted = [(centroid[k] + points[2][k]) / 2 for k in range(2)]
+			f_contracted = f(contracted)
+			if f_contracted < values[2]:
+				points[2], values[2] = contracted, f_contracted
+			else:
+				for i in (1, 2):
+					points[i] = [(points[0][k] + points[i][k]) / 2 for k in range(2)]
+					values[i] = f(points[i])
+	return points[0], values[0]
+
+
+def fit(file_name, sequence_length):
+	deletion_propagation_pr_cutoff = 0.05 / math.sqrt(sequence_length)
+
+	# n[i] = number of positions with coverage i (the file lists 1..N in order)
+	n = [0]
+	with open(file_name) as distribution_file:
+		next(distribution_file)
+		for line in distribution_file:
+			coverage, count = line.split()
+			assert int(coverage) == len(n), "Coverage values must be 1, 2, 3, ..."
+			n.append(int(count))
+	N = len(n) - 1
+
+	total = sum(n)
+	m = sum(i * n[i] for i in range(1, N + 1)) / total
+	v = sum(n[i] * (i - m) ** 2 for i in range(1, N + 1)) / (total - 1)
+	D = v / m
+
+	# Peak of the moving average of width 5 at or above a quarter of the mean
+	ma = [None] * (N + 1)
+	for i in range(1, N + 1):
+		if N < 5:
+			ma[i] = n[i]
+		elif (i - 2 >= 1) and (i + 2 <= N):
+			ma[i] = sum(n[i - 2:i + 3]) / 5
+	max_n = 0
+	max_i = 0
+	for i in range(max(int(m / 4), 1), N + 1):
+		if (ma[i] is not None) and (ma[i] > max_n):
+			max_n = ma[i]
+			max_i = i
+
+	# Censor to half to one and a half times the peak, coarse-grained to ~1000 bins
+	start_i = max(math.floor(max_i * 0.5), 1)
+	end_i = min(math.ceil(max_i * 1.5), N)
+	num_per_bin = int((end_i - start_i) / 1000)
+	if num_per_bin > 1:
+		start_i_for_fits = int(start_i / num_per_bin)
+		end_i_for_fits = math.ceil(end_i / num_per_bin)
+		for_fits = [0.0] * (end_i_for_fits + 1)
+		for i in range(max(start_i_for_fits, 1), end_i_for_fits + 1):
+			for j in range(1, num_per_bin + 1):
+				if i * num_per_bin + j <= N:
+					for_fits[i] += n[i * num_per_bin + j]
+	else:
+		num_per_bin = 1
+		start_i_for_fits = start_i
+		end_i_for_fits = end_i
+		for_fits = n[0:end_i + 1]
+	fit_range = range(start_i_for_fits, end_i_for_fits + 1)
+	inner_total = sum(for_fits[i] for i in fit_range)
+
+	def f_nb(mu, size):
+		dist = [dnbinom(i, size, mu) for i in fit_range]
+		dist_total = sum(dist)
+		return sum((for_fits[i] / inner_total - d / dist_total) ** 2 for i, d in zip(fit_range, dist))
+
+	def f_nb_log(p):
+		if p[1] > math.log(MAX_SIZE):
+			return float("inf")
+		return f_nb(math.exp(p[0]), math.exp(p[1]))
+
+	mean_estimate = sum(i * for_fits[i] for i in range(1, end_i_for_fits + 1)) / sum(for_fits[1:end_i_for_fits + 1])
+	try_means = [mean_estimate, end_i_for_fits, start_i_for_fits,
+		1 * (end_i_for_fits + start_i_for_fits) / 4,
+		2 * (end_i_for_fits + start_i_for_fits) / 4,
+		3 * (end_i_for_fits + start_i_for_fits) / 4]
+	best = None
+	for try_mean in try_means:
+		for try_size in (10, 1, 0.1, 100, 1000):
+			point, value = nelder_mead(f_nb_log, [math.log(try_mean), math.log(try_size)], 0.5)
+			point, value = nelder_mead(f_nb_log, point, 0.05)
+			if (best is None) or (value < best[1]):
+				best = (point, value)
+	nb_fit_mu = math.exp(best[0][0])
+	nb_fit_size = math.exp(best[0][1])
+
+	included_fract = pnbinom(end_i_for_fits, nb_fit_size, nb_fit_mu) - pnbinom(start_i_for_fits, nb_fit_size, nb_fit_mu)
+	if included_fract >= 0.01:
+		nb_fit_mu *= num_per_bin
+	else:
+		nb_fit_mu = 0
+		nb_fit_size = 0
+
+	if nb_fit_mu > 0:
+		deletion_propagation_coverage = qnbinom(deletion_propagation_pr_cutoff, nb_fit_size, nb_fit_mu)
+	else:
+		size_estimate = m * m / (v - m) if v > m else -1
+		deletion_propagation_coverage = qnbinom(deletion_propagation_pr_cutoff, size_estimate, m) if size_estimate > 0 else 0
+		if deletion_propagation_coverage < 1:
+			deletion_propagation_coverage = m * 0.1
+	if deletion_propagation_coverage < 1:
+		deletion_propagation_coverage = 1
+	if (nb_fit_mu <= 3) and (m <= 3):
+		deletion_propagation_coverage = -1
+
+	return [("nbinom_size_parameter", nb_fit_size), ("nbinom_mean_parameter", nb_fit_mu),
+		("average", m), ("variance", v), ("dispersion", D),
+		("deletion_coverage_propagation_cutoff", deletion_propagation_coverage)]
+
+
+if __name__ == "__main__":
+	if len(sys.argv) != 3:
+		sys.exit("Usage: %s file.tab sequence_length" % sys.argv[0])
+	# Same format as 'breseq COVERAGE-DISTRIBUTION -o'
+	for name, value in fit(sys.argv[1], int(sys.argv[2])):
+		print("%s\t%.5g" % (name, value))
@@ -0,0 +1,83 @@
+#!/bin/bash
+#
+# Benchmark for reading and writing large GenomeDiff files.
+#
+# Synthesizes a GD with many RA items (like a polymorphism-mode evidence.gd),
+# then times a read + write round trip through 'gdtools HEADER' and reports
+# records per second, both parsing the text and loading from a binary index.
+#
+# Usage:  ./tests/benchmark/gd_io.sh [num_records]
+#
+# If $BASELINE_GDTOOLS points to another gdtools executable (e.g., from an
+# older build) it is timed on the same input and its output is compared to
+# the current one to be sure the formats are identical.
+#
+# This script is not run by 'make test'.
+#
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+NUM_RECORDS=${1:-200000}
+WORKDIR=${SELF}/gd_io_output
+INPUT_GD=${WORKDIR}/input.gd
+
+mkdir -p ${WORKDIR}
+
+echo "Creating synthetic GD with ${NUM_RECORDS} RA records: ${INPUT_GD}"
+awk -v n=${NUM_RECORDS} 'BEGIN {
+	OFS="\t";
+	print "#=GENOME_DIFF\t1.0";
+	print "#=TITLE\tgd_io_benchmark";
+	split("A C G T", bases, " ");
+	for (i = 1; i <= n; i++) {
+		ref = bases[(i % 4) + 1];
+		new = bases[((i + 1) % 4) + 1];
+		print "RA", i, ".", "seq_" (i % 3), i, 0, ref, new, \
+			"consensus_score=" (i % 300) ".5", "frequency=" sprintf("%.3e", (i % 100) / 100), \
+			"major_base=" ref, "major_cov=" (i % 47) "/" (i % 53), "minor_base=" new, "minor_cov=" (i % 7) "/" (i % 5), \
+			"polymorphism_score=" (i % 17) ".2", "prediction=polymorphism", "total_cov=" (i % 47 + i % 7) "/" (i % 53 + i % 5);
+	}
+}' > ${INPUT_GD}
+
+# $1 = gdtools executable, $2 = output file
+time_round_trip() {
+	START=`date +%s.%N`
+	$1 HEADER -i ${INPUT_GD} -o $2 -t BENCHMARK=gd_io > /dev/null 2>&1
+	if [[ "$?" -ne 0 ]]; then
+		echo "Non-zero error code returned by: $1"
+		exit -1
+	fi
+	END=`date +%s.%N`
+	echo "${START} ${END}" | awk -v n=${NUM_RECORDS} '{ t = $2 - $1; printf "%.3f seconds, %.0f records/sec\n", t, (t > 0) ? n / t : 0 }'
+}
+
+echo "Current:  ${GDTOOLS}"
+echo -n "  "
+time_round_trip ${GDTOOLS} ${WORKDIR}/current.gd
+
+echo "Current with binary index (gdtools INDEX):"
+${GDTOOLS} INDEX ${INPUT_GD} > /dev/null 2>&1
+echo -n "  "
+time_round_trip ${GDTOOLS} ${WORKDIR}/indexed.gd
+${GDTOOLS} INDEX -r ${INPUT_GD} > /dev/null 2>&1
+if ! ${DIFF_BIN} -q ${WORKDIR}/current.gd ${WORKDIR}/indexed.gd > /dev/null; then
+	echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+	echo "Outputs differ: ${WORKDIR}/current.gd ${WORKDIR}/indexed.gd"
+	echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+	exit -1
+fi
+
+if [[ -n "${BASELINE_GDTOOLS}" ]]; then
+	echo "Baseline: ${BASELINE_GDTOOLS}"
+	echo -n "  "
+	time_round_trip ${BASELINE_GDTOOLS} ${WORKDIR}/baseline.gd
+	if ${DIFF_BIN} -q ${WORKDIR}/current.gd ${WORKDIR}/baseline.gd > /dev/null; then
+		echo "Outputs are identical."
+	else
+		echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+		echo "Outputs differ: ${WORKDIR}/current.gd ${WORKDIR}/baseline.gd"
+		echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+		exit -1
+	fi
+fi
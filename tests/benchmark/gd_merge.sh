@@ -0,0 +1,84 @@
+#!/bin/bash
+#
+# Benchmark for set operations over many GenomeDiff files.
+#
+# Synthesizes N GD files on the lambda reference that share most of their
+# SNPs and each have their own DEL and UN entries, then times merging them
+# with 'gdtools UNION' and tabulating frequencies with 'gdtools COMPARE'.
+#
+# Usage:  ./tests/benchmark/gd_merge.sh [num_files] [num_mutations_per_file] [num_threads]
+#
+# The current gdtools reads input files for COMPARE using num_threads (default 1).
+#
+# If $BASELINE_GDTOOLS points to another gdtools executable (e.g., from an
+# older build) it is timed on the same input and its outputs are compared to
+# the current ones to be sure they are identical.
+#
+# This script is not run by 'make test'.
+#
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+NUM_FILES=${1:-100}
+NUM_MUTATIONS=${2:-400}
+NUM_THREADS=${3:-1}
+WORKDIR=${SELF}/gd_merge_output
+REFERENCE=${DATADIR}/lambda/lambda.gbk
+
+rm -rf ${WORKDIR}
+mkdir -p ${WORKDIR}/input
+
+echo "Creating ${NUM_FILES} synthetic GD files with about ${NUM_MUTATIONS} mutations each: ${WORKDIR}/input"
+for (( f=1; f<=${NUM_FILES}; f++ )); do
+	awk -v f=${f} -v n=${NUM_MUTATIONS} 'BEGIN {
+		OFS="\t";
+		print "#=GENOME_DIFF\t1.0";
+		print "#=TITLE\tsample_" f;
+		split("A C G T", bases, " ");
+		id = 0;
+		# SNPs drawn from a pool shared by all files
+		for (j = 1; j <= n * 3 / 2; j++) {
+			if ((j * 7 + f) % 3 == 0) continue;
+			print "SNP", ++id, ".", "NC_001416", (j * 8729) % 48000 + 1, bases[(j % 4) + 1];
+		}
+		print "DEL", ++id, ".", "NC_001416", 40001 + (f % 50) * 100, 50;
+		print "UN", ++id, ".", "NC_001416", 20001 + (f % 40) * 500, 20250 + (f % 40) * 500;
+	}' > ${WORKDIR}/input/sample_${f}.gd
+done
+
+# $1 = gdtools executable, $2 = output prefix, $3 = extra COMPARE options
+time_operations() {
+	for OPERATION in UNION COMPARE; do
+		if [[ "${OPERATION}" == "COMPARE" ]]; then
+			ARGS="COMPARE -f GD -r ${REFERENCE} $3"
+		else
+			ARGS="UNION"
+		fi
+		START=`date +%s.%N`
+		$1 ${ARGS} -o $2_${OPERATION}.gd ${WORKDIR}/input/*.gd > /dev/null 2>&1
+		if [[ "$?" -ne 0 ]]; then
+			echo "Non-zero error code returned by: $1 ${OPERATION}"
+			exit -1
+		fi
+		END=`date +%s.%N`
+		echo "${START} ${END}" | awk -v op=${OPERATION} '{ printf "  %-8s %.3f seconds\n", op, $2 - $1 }'
+	done
+}
+
+echo "Current:  ${GDTOOLS}"
+time_operations ${GDTOOLS} ${WORKDIR}/current "-j ${NUM_THREADS}"
+
+if [[ -n "${BASELINE_GDTOOLS}" ]]; then
+	echo "Baseline: ${BASELINE_GDTOOLS}"
+	time_operations ${BASELINE_GDTOOLS} ${WORKDIR}/baseline
+	for OPERATION in UNION COMPARE; do
+		if ! ${DIFF_BIN} -q ${WORKDIR}/current_${OPERATION}.gd ${WORKDIR}/baseline_${OPERATION}.gd > /dev/null; then
+			echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+			echo "Outputs differ: ${WORKDIR}/current_${OPERATION}.gd ${WORKDIR}/baseline_${OPERATION}.gd"
+			echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+			exit -1
+		fi
+	done
+	echo "Outputs are identical."
+fi
@@ -0,0 +1,91 @@
+#!/bin/bash
+#
+# Benchmark for writing large HTML mutation tables.
+#
+# Synthesizes a GD with many SNP and DEL entries on the lambda reference,
+# then times 'gdtools ANNOTATE -f HTML', which writes the same mutation table
+# used for index.html. Annotating the mutations takes most of this time, so
+# 'gdtools ANNOTATE -f GD' is also timed and the difference is reported as
+# the time spent writing HTML. If GNU time is installed as /usr/bin/time, the
+# peak memory use is also reported.
+#
+# Usage:  ./tests/benchmark/html_output.sh [num_mutations]
+#
+# If $BASELINE_GDTOOLS points to another gdtools executable (e.g., from an
+# older build) it is timed on the same input and its output is compared to
+# the current one to be sure they are identical.
+#
+# This script is not run by 'make test'.
+#
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+NUM_MUTATIONS=${1:-5000}
+WORKDIR=${SELF}/html_output_output
+INPUT_GD=${WORKDIR}/input.gd
+REFERENCE=${DATADIR}/lambda/lambda.gbk
+
+mkdir -p ${WORKDIR}
+
+echo "Creating synthetic GD with ${NUM_MUTATIONS} mutations: ${INPUT_GD}"
+awk -v n=${NUM_MUTATIONS} 'BEGIN {
+	OFS="\t";
+	print "#=GENOME_DIFF\t1.0";
+	print "#=TITLE\thtml_output_benchmark";
+	split("A C G T", bases, " ");
+	for (i = 1; i <= n; i++) {
+		if (i % 10 == 0) {
+			print "DEL", i, ".", "NC_001416", (i * 7919) % 48000 + 1, (i % 20) + 1, "frequency=" sprintf("%.2f", (i % 100) / 100);
+		} else {
+			print "SNP", i, ".", "NC_001416", (i * 7919) % 48500 + 1, bases[(i % 4) + 1], "frequency=" sprintf("%.2f", (i % 100) / 100);
+		}
+	}
+}' > ${INPUT_GD}
+
+# $1 = gdtools executable, $2 = output format, $3 = output file
+# Sets ELAPSED to the run time in seconds
+run_annotate() {
+	MEMORY_FILE=${WORKDIR}/memory.txt
+	rm -f ${MEMORY_FILE}
+	START=`date +%s.%N`
+	if [[ -x /usr/bin/time ]] && /usr/bin/time -f "%M" true > /dev/null 2>&1; then
+		/usr/bin/time -o ${MEMORY_FILE} -f "%M" $1 ANNOTATE -f $2 -r ${REFERENCE} -o $3 ${INPUT_GD} > /dev/null 2>&1
+	else
+		$1 ANNOTATE -f $2 -r ${REFERENCE} -o $3 ${INPUT_GD} > /dev/null 2>&1
+	fi
+	if [[ "$?" -ne 0 ]]; then
+		echo "Non-zero error code returned by: $1 ANNOTATE -f $2"
+		exit -1
+	fi
+	END=`date +%s.%N`
+	ELAPSED=`echo "${START} ${END}" | awk '{ printf "%.3f", $2 - $1 }'`
+}
+
+# $1 = gdtools executable, $2 = output prefix
+time_annotate() {
+	run_annotate $1 GD $2.gd
+	GD_ELAPSED=${ELAPSED}
+	run_annotate $1 HTML $2.html
+	echo "${GD_ELAPSED} ${ELAPSED}" | awk '{ printf "  ANNOTATE -f GD %.3f seconds, -f HTML %.3f seconds, writing HTML %.3f seconds", $1, $2, $2 - $1 }'
+	if [[ -s ${MEMORY_FILE} ]]; then
+		awk '{ printf ", %.1f MB peak memory", $1 / 1024 }' ${MEMORY_FILE}
+	fi
+	ls -l $2.html | awk '{ printf ", %.1f MB written\n", $5 / 1024 / 1024 }'
+}
+
+echo "Current:  ${GDTOOLS}"
+time_annotate ${GDTOOLS} ${WORKDIR}/current
+
+if [[ -n "${BASELINE_GDTOOLS}" ]]; then
+	echo "Baseline: ${BASELINE_GDTOOLS}"
+	time_annotate ${BASELINE_GDTOOLS} ${WORKDIR}/baseline
+	if ${DIFF_BIN} -q ${WORKDIR}/current.html ${WORKDIR}/baseline.html > /dev/null; then
+		echo "Outputs are identical."
+	else
+		echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+		echo "Outputs differ: ${WORKDIR}/current.html ${WORKDIR}/baseline.html"
+		echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+		exit -1
+	fi
+fi
@@ -0,0 +1,213 @@
+#!/bin/bash
+#
+# Benchmark of each step of the breseq pipeline.
+#
+# Runs breseq on the datasets of the consistency tests (or the tests named
+# as arguments) and on a synthetic dataset: reads simulated by
+# 'breseq SIMULATE-READ' from a random genome with mutations. For each run,
+# the CPU time and peak memory of each pipeline step, read from the
+# execution times in data/summary.json, and the wall time, CPU time and peak
+# memory of the whole run are written to a tab-delimited results file.
+#
+# If a baseline results file exists, each run and step is compared to it,
+# and the script exits with an error if any takes more CPU time than the
+# baseline by more than the tolerance. Wall time and peak memory are only
+# compared for whole runs: step times are recorded in whole seconds, and a
+# step's peak memory depends on which other steps ran at the same time.
+#
+# Usage:  ./tests/benchmark/pipeline.sh [options] [test_name ...]
+#
+#   -o FILE   results file (DEFAULT=pipeline_output/results.tab)
+#   -b FILE   baseline results file (DEFAULT=pipeline_output/baseline.tab)
+#   -s        save the results as the new baseline instead of comparing
+#   -t FRAC   tolerance as a fraction of the baseline (DEFAULT=0.2)
+#   -g LEN    genome length of the synthetic dataset (DEFAULT=1000000)
+#   -c COV    read coverage of the synthetic dataset, 0 to skip it (DEFAULT=50)
+#
+# Differences of less than 0.5 seconds or 10 MB are not counted as
+# regressions, so that very short steps do not fail on timing noise.
+# $BRESEQ_TEST_THREAD_ARG is passed to breseq, as when running the tests.
+#
+# This script is not run by 'make test'.
+#
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+WORKDIR=${SELF}/pipeline_output
+RESULTS=${WORKDIR}/results.tab
+BASELINE=${WORKDIR}/baseline.tab
+SAVE_BASELINE=0
+TOLERANCE=0.2
+GENOME_LENGTH=1000000
+COVERAGE=50
+MIN_SECONDS=0.5
+MIN_MEMORY_MB=10
+
+while getopts "o:b:st:g:c:" OPT; do
+	case ${OPT} in
+		o) RESULTS=${OPTARG} ;;
+		b) BASELINE=${OPTARG} ;;
+		s) SAVE_BASELINE=1 ;;
+		t) TOLERANCE=${OPTARG} ;;
+		g) GENOME_LENGTH=${OPTARG} ;;
+		c) COVERAGE=${OPTARG} ;;
+		*) echo "Usage: $0 [-o results] [-b baseline] [-s] [-t tolerance] [-g genome_length] [-c coverage] [test_name ...]"; exit -1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+TESTS=("$@")
+if [[ ${#TESTS[@]} -eq 0 ]]; then
+	TESTS=(lambda_mixed_pop \
+		REL606_fragment_advanced_mobile_element REL606_fragment_deletion_between_is \
+		REL606_fragment_is_junction_only REL606_fragment_is_mediated_dels \
+		tmv_plasmid_circular_deletion tmv_plasmid_circular_deletion_end_only tmv_plasmid_circular_deletion_start_only)
+fi
+
+mkdir -p ${WORKDIR} `dirname ${RESULTS}`
+
+# Writes the results for one pipeline run
+# $1 = dataset name, $2 = breseq output directory, $3 = file with the output of 'time'
+record_run() {
+	# Whole run: wall, user and system seconds of breseq and its child processes
+	read WALL USER SYSTEM < $3
+	# Steps: from the execution_times array in summary.json, skipping steps
+	# that were not run. The whole run's peak memory is the largest step's.
+	python3 -c '
+import json, sys
+dataset, wall, cpu = sys.argv[2], float(sys.argv[3]), float(sys.argv[4])
+with open(sys.argv[1]) as summary_file:
+	steps = json.load(summary_file).get("execution_times", [])
+peak_memory = 0
+for step in steps:
+	if not step["time_end"]:
+		continue
+	memory = max(step["peak_memory"], step["children_peak_memory"])
+	peak_memory = max(peak_memory, memory)
+	step_cpu = step["cpu_user_time"] + step["cpu_system_time"] + step["children_cpu_user_time"] + step["children_cpu_system_time"]
+	print("%s\t%s\t%.3f\t%.3f\t%.1f" % (dataset, step["step"], step["time_elapsed"], step_cpu, memory / 1024))
+print("%s\t%s\t%.3f\t%.3f\t%.1f" % (dataset, "TOTAL", wall, cpu, peak_memory / 1024))
+	' $2/data/summary.json $1 ${WALL} `echo "${USER} ${SYSTEM}" | awk '{ print $1 + $2 }'` >> ${RESULTS}
+}
+
+# $1 = dataset name, $2 = breseq output directory, remaining = command
+time_run() {
+	DATASET=$1
+	OUTPUT_DIR=$2
+	shift 2
+	echo "Running: ${DATASET}"
+	TIME_FILE=${WORKDIR}/time.txt
+	TIMEFORMAT="%R %U %S"
+	{ time "$@" > ${WORKDIR}/${DATASET}.log 2>&1 ; } 2> ${TIME_FILE}
+	if [[ ! -e ${OUTPUT_DIR}/data/summary.json ]] || ! grep -q "SUCCESSFULLY COMPLETED" ${WORKDIR}/${DATASET}.log; then
+		echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+		echo "breseq did not complete for: ${DATASET}"
+		echo "See: ${WORKDIR}/${DATASET}.log"
+		echo "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+		exit -1
+	fi
+	record_run ${DATASET} ${OUTPUT_DIR} ${TIME_FILE}
+}
+
+echo -e "dataset\tstep\twall_seconds\tcpu_seconds\tpeak_memory_mb" > ${RESULTS}
+
+for TEST in "${TESTS[@]}"; do
+	TEST_DIR=${SELF}/../${TEST}
+	${TEST_DIR}/testcmd.sh clean > /dev/null 2>&1
+	time_run ${TEST} ${TEST_DIR} ${TEST_DIR}/testcmd.sh test
+	${TEST_DIR}/testcmd.sh clean > /dev/null 2>&1
+done
+
+# Synthetic dataset: a random genome with a SNP or deletion every 10 kb.
+# The same seeds are used every time so runs are comparable.
+if [[ ${COVERAGE} -gt 0 ]]; then
+	SYNTHETIC=synthetic_${GENOME_LENGTH}_${COVERAGE}x
+	SYNTHETIC_DIR=${WORKDIR}/${SYNTHETIC}
+	mkdir -p ${SYNTHETIC_DIR}
+	# GenBank, so that the genome is circular and reads are simulated across the origin
+	awk -v n=${GENOME_LENGTH} 'BEGIN {
+		srand(1);
+		split("a c g t", bases, " ");
+		printf "LOCUS       synthetic %d bp    DNA     circular BCT\n", n;
+		print "FEATURES             Location/Qualifiers";
+		printf "     source          1..%d\n", n;
+		print "ORIGIN";
+		for (i = 1; i <= n; i++) {
+			if (i % 60 == 1) printf "%9d", i;
+			if (i % 10 == 1) printf " ";
+			printf "%s", bases[int(rand() * 4) + 1];
+			if ((i % 60 == 0) || (i == n)) printf "\n";
+		}
+		print "//";
+	}' > ${SYNTHETIC_DIR}/reference.gbk
+	awk -v n=${GENOME_LENGTH} 'BEGIN {
+		OFS = "\t";
+		print "#=GENOME_DIFF\t1.0";
+		split("A C G T", bases, " ");
+		for (i = 1; i * 10000 < n; i++) {
+			if (i % 5 == 0) {
+				print "DEL", i, ".", "synthetic", i * 10000, (i % 20) + 1;
+			} else {
+				print "SNP", i, ".", "synthetic", i * 10000, bases[(i % 4) + 1];
+			}
+		}
+	}' > ${SYNTHETIC_DIR}/mutations.gd
+	echo "Simulating ${COVERAGE}x reads from a ${GENOME_LENGTH} bp genome: ${SYNTHETIC_DIR}"
+	${BRESEQ} SIMULATE-READ -g ${SYNTHETIC_DIR}/mutations.gd -r ${SYNTHETIC_DIR}/reference.gbk \
+		-c ${COVERAGE} -l 100 --seed 1 -o ${SYNTHETIC_DIR}/reads.fastq > /dev/null 2>&1
+	if [[ "$?" -ne 0 ]]; then
+		echo "Non-zero error code returned by: ${BRESEQ} SIMULATE-READ"
+		exit -1
+	fi
+	rm -Rf ${SYNTHETIC_DIR}/0* ${SYNTHETIC_DIR}/output ${SYNTHETIC_DIR}/data
+	time_run ${SYNTHETIC} ${SYNTHETIC_DIR} ${BRESEQ} ${BRESEQ_TEST_THREAD_ARG} -o ${SYNTHETIC_DIR} \
+		-r ${SYNTHETIC_DIR}/reference.gbk ${SYNTHETIC_DIR}/reads.fastq
+fi
+
+echo "Results: ${RESULTS}"
+
+if [[ ${SAVE_BASELINE} -eq 1 ]]; then
+	cp ${RESULTS} ${BASELINE}
+	echo "Saved baseline: ${BASELINE}"
+	exit 0
+fi
+
+if [[ ! -e ${BASELINE} ]]; then
+	echo "No baseline to compare to: ${BASELINE}"
+	echo "Rerun with -s to save these results as the baseline."
+	exit 0
+fi
+
+echo "Comparing to baseline: ${BASELINE} (tolerance ${TOLERANCE})"
+awk -F "\t" -v tolerance=${TOLERANCE} -v min_seconds=${MIN_SECONDS} -v min_memory=${MIN_MEMORY_MB} '
+	function compare(name, current, baseline, min_difference) {
+		if ((current > baseline * (1 + tolerance)) && (current - baseline >= min_difference)) {
+			printf "  %-50s %-14s %10.3f %10.3f  REGRESSION\n", $1 ": " $2, name, baseline, current
+			regressions++
+		}
+	}
+	FNR == 1 { next }
+	NR == FNR { wall[$1 "\t" $2] = $3; cpu[$1 "\t" $2] = $4; memory[$1 "\t" $2] = $5; next }
+	{
+		key = $1 "\t" $2
+		if (!(key in cpu)) next
+		compared++
+		compare("cpu_seconds", $4, cpu[key], min_seconds)
+		if ($2 != "TOTAL") next
+		compare("wall_seconds", $3, wall[key], min_seconds)
+		compare("peak_memory_mb", $5, memory[key], min_memory)
+	}
+	END {
+		printf "Compared %d runs and steps to the baseline.\n", compared
+		if (regressions) {
+			print "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+			printf "%d performance regressions\n", regressions
+			print "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+			exit 1
+		}
+		print "OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO"
+		print "No performance regressions"
+		print "OOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO"
+	}
+' ${BASELINE} ${RESULTS}
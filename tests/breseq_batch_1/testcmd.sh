@@ -0,0 +1,53 @@
+#!/bin/bash
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+# Two samples run with BATCH must give the same results as a single run of
+# breseq on the same reads. Sample sheets with errors must be rejected
+# before anything runs.
+CURRENT_OUTPUTS[0]="${SELF}/output/sample_1/output/evidence/annotated.gd"
+EXPECTED_OUTPUTS[0]="${SELF}/output/single/output/evidence/annotated.gd"
+CURRENT_OUTPUTS[1]="${SELF}/output/sample_2/output/evidence/annotated.gd"
+EXPECTED_OUTPUTS[1]="${SELF}/output/single/output/evidence/annotated.gd"
+REFERENCE_ARG="-r ${DATADIR}/lambda/lambda.5.gbk"
+READS="${DATADIR}/lambda/lambda.short_sequence_repeats.fastq"
+
+# Header lines hold the command line and file names, which differ
+gd_diff() {
+	diff <(grep -v "^#=" $1) <(grep -v "^#=" $2)
+}
+DIFF_BIN=gd_diff
+
+# $1 == sample sheet contents, $2 == expected error message
+batch_must_fail() {
+	printf "$1" > ${SELF}/output/bad_samples.tsv
+	if ${BRESEQ} BATCH ${REFERENCE_ARG} -o ${SELF}/output/bad ${SELF}/output/bad_samples.tsv > ${SELF}/output/bad.log 2>&1; then
+		echo "BATCH accepted a bad sample sheet: $2"
+		return 1
+	fi
+	if ! grep -q "$2" ${SELF}/output/bad.log; then
+		echo "BATCH did not report: $2"
+		cat ${SELF}/output/bad.log
+		return 1
+	fi
+}
+
+run_batch() {
+	mkdir -p ${SELF}/output/reads
+	cp ${READS} ${SELF}/output/reads/lambda.fastq
+	printf "sample_1\t${READS}\t-b 0\nsample_2\t${SELF}/output/reads/lambda.fastq\t-b 0\n" > ${SELF}/output/samples.tsv
+
+	${BRESEQ} ${BRESEQ_TEST_THREAD_ARG} -b 0 -o ${SELF}/output/single ${REFERENCE_ARG} ${READS} > ${SELF}/output/single.log 2>&1 || return 1
+	${BRESEQ} BATCH ${BRESEQ_TEST_THREAD_ARG} ${REFERENCE_ARG} -o ${SELF}/output ${SELF}/output/samples.tsv || return 1
+
+	batch_must_fail "sample_1\t${READS}\nsample_1\t${READS}\n" "Sample name is used more than once" || return 1
+	batch_must_fail "sample_1\t${SELF}/output/missing.fastq\n" "Read file does not exist" || return 1
+	batch_must_fail "reference\t${READS}\n" "Sample name is used for a directory of the batch output" || return 1
+	batch_must_fail "..\t${READS}\n" "Sample name must not start with '.'" || return 1
+	batch_must_fail "a b\t${READS}\n" "Sample name may only contain" || return 1
+}
+
+TESTCMD="run_batch"
+
+do_test $1 ${SELF}
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+# Synthetic REL606-sized negative binomial distribution
+# Expected values are from the fit in coverage_distribution.r, as redone by
+# benchmark/coverage_distribution_reference.py. They must agree within 1%.
+CURRENT_OUTPUTS[0]="${SELF}/output.tab"
+EXPECTED_OUTPUTS[0]="${SELF}/expected.tab"
+DIFF_BIN=fit_diff
+FIT_TOLERANCE=0.01
+
+TESTCMD="\
+    ${BRESEQ} \
+        COVERAGE-DISTRIBUTION \
+        -l 4629812 \
+        -o ${SELF}/output.tab \
+        -i ${SELF}/input.tab \
+    "
+
+do_test $1 ${SELF}
@@ -34,6 +34,32 @@ DIFF_BIN=`which diff`
 # name of testexec file
 TESTEXEC=testcmd.sh
 
+# Use as DIFF_BIN for files of fitted values (name<TAB>value), which need
+# only agree to within a fraction ${FIT_TOLERANCE} of the expected value.
+# Size parameters are compared as 1/size, which is all that a fit can tell
+# apart for nearly Poisson data, and cutoffs to within 1.
+fit_diff() {
+	awk -F "\t" -v tolerance=${FIT_TOLERANCE} '
+		NR == FNR { current[$1] = $2; next }
+		{
+			if (!($1 in current)) { print "missing: " $1; failed = 1; next }
+			c = current[$1] + 0; e = $2 + 0
+			if ($1 ~ /size_parameter$/) {
+				c = (c > 0) ? 1 / c : 0; e = (e > 0) ? 1 / e : 0
+				allowed = tolerance * e + 1e-5
+			} else if ($1 ~ /cutoff$/) {
+				allowed = 1
+			} else {
+				allowed = tolerance * ((e < 0) ? -e : e)
+			}
+			if (((c - e > allowed) || (e - c > allowed))) {
+				print $1 ": " current[$1] " (expected " $2 ")"; failed = 1
+			}
+		}
+		END { exit failed }
+	' $1 $2
+}
+
 # build the expected results from the current output
 # $1 == testdir
 #
@@ -0,0 +1,56 @@
+#!/bin/bash
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+# --limit-fold-coverage-random must keep about the requested coverage
+# (within 10%), choose the same reads when it is run again, and keep the
+# same reads from a gzipped copy given as a second (mate) read file.
+CURRENT_OUTPUTS[0]="${SELF}/output.tab"
+EXPECTED_OUTPUTS[0]="${SELF}/expected.tab"
+REFERENCE_ARG="-r ${DATADIR}/lambda/lambda.5.gbk"
+READS="${DATADIR}/lambda/lambda.short_sequence_repeats.fastq"
+
+# 10-fold coverage of the 9,701 bp reference
+FOLD_COVERAGE=10
+REQUESTED_BASES=97010
+
+# $1 == output path, $2 == fold coverage, remaining == read files
+run_random_limit() {
+	OUTPUT_PATH=$1
+	LIMIT=$2
+	shift 2
+	${BRESEQ} ${BRESEQ_TEST_THREAD_ARG} -k -b 0 -o ${OUTPUT_PATH} ${REFERENCE_ARG} \
+		-l ${LIMIT} --limit-fold-coverage-random $@ > ${OUTPUT_PATH}.log 2>&1
+}
+
+# $1 == converted FASTQ file
+read_sequences() {
+	awk 'NR % 4 == 2' $1
+}
+
+check_random_limit() {
+	mkdir -p ${SELF}/output/reads
+	gzip -c ${READS} > ${SELF}/output/reads/mate.fastq.gz
+	run_random_limit ${SELF}/output/run_1 ${FOLD_COVERAGE} ${READS} || return 1
+	run_random_limit ${SELF}/output/run_2 ${FOLD_COVERAGE} ${READS} || return 1
+	run_random_limit ${SELF}/output/run_mates `expr 2 \* ${FOLD_COVERAGE}` ${READS} ${SELF}/output/reads/mate.fastq.gz || return 1
+
+	CONVERTED=01_sequence_conversion/lambda.short_sequence_repeats.converted.fastq
+	CONVERTED_BASES=`awk 'NR % 4 == 2 { bases += length($0) } END { print bases }' ${SELF}/output/run_1/${CONVERTED}`
+	awk -v bases=${CONVERTED_BASES} -v requested=${REQUESTED_BASES} 'BEGIN {
+		print "coverage_within_10_percent\t" (((bases > 0.9 * requested) && (bases < 1.1 * requested)) ? "yes" : "no (" bases " bases)")
+	}' > ${CURRENT_OUTPUTS[0]}
+
+	SAME="no"
+	if cmp -s ${SELF}/output/run_1/${CONVERTED} ${SELF}/output/run_2/${CONVERTED}; then SAME="yes"; fi
+	printf "same_reads_on_rerun\t${SAME}\n" >> ${CURRENT_OUTPUTS[0]}
+
+	SAME="no"
+	if cmp -s <(read_sequences ${SELF}/output/run_mates/${CONVERTED}) <(read_sequences ${SELF}/output/run_mates/01_sequence_conversion/mate.converted.fastq); then SAME="yes"; fi
+	printf "same_reads_from_mates\t${SAME}\n" >> ${CURRENT_OUTPUTS[0]}
+}
+
+TESTCMD="check_random_limit"
+
+do_test $1 ${SELF}
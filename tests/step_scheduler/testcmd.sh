@@ -0,0 +1,17 @@
+#!/bin/bash
+
+SELF=`dirname ${BASH_SOURCE}`
+. ${SELF}/../common.sh
+
+# Dividing threads among files (fewer processors than files, zero-size
+# files) and running jobs (stage 1 -> stage 2 -> merge, and a job that
+# needs more threads than there are processors)
+CURRENT_OUTPUTS[0]="${SELF}/output.tab"
+EXPECTED_OUTPUTS[0]="${SELF}/expected.tab"
+
+TESTCMD="\
+    ${BRESEQ} TEST-SCHEDULER \
+    -o ${SELF}/output.tab \
+    "
+
+do_test $1 ${SELF}